@@ -82,7 +82,8 @@ bool
 AbstractLog::append(AppendVector* appends, uint32_t numAppends)
 {
     CycleCounter<uint64_t> _(&metrics.totalAppendTicks);
-    SpinLock::Guard lock(appendLock);
+    Tub<SpinLock::Guard> lock;
+    lock.construct(appendLock);
     metrics.totalAppendCalls++;
 
     uint32_t lengths[numAppends];
@@ -100,17 +101,32 @@ AbstractLog::append(AppendVector* appends, uint32_t numAppends)
     if (!head->hasSpaceFor(lengths, numAppends))
         throw FatalError(HERE, "too much data to append to one segment");
 
+    // Only reserve space for the entries while holding the lock. Copying
+    // their contents in is done after dropping it, so that concurrent writers
+    // serialize on the (short) metadata update rather than on the memcpy.
     LogSegment* headBefore = head;
+    uint32_t dataOffsets[numAppends];
     for (uint32_t i = 0; i < numAppends; i++) {
-        bool enoughSpace = append(lock,
-                                  appends[i].type,
-                                  appends[i].buffer,
-                                  &appends[i].reference);
+        bool enoughSpace = reserve(*lock,
+                                   appends[i].type,
+                                   lengths[i],
+                                   &appends[i].reference,
+                                   &dataOffsets[i]);
         if (!enoughSpace)
             throw FatalError(HERE, "Guaranteed append managed to fail");
     }
     assert(head == headBefore);
 
+    // The head cannot be closed or synced past our entries until this count
+    // drops back to zero (see LogSegment::waitForUnfinishedAppends).
+    headBefore->unfinishedAppends.fetch_add(1, std::memory_order_relaxed);
+    lock.destroy();
+
+    for (uint32_t i = 0; i < numAppends; i++)
+        headBefore->copyInReserved(dataOffsets[i], appends[i].buffer);
+
+    headBefore->unfinishedAppends.fetch_sub(1, std::memory_order_release);
+
     return true;
 }
 
@@ -552,6 +568,60 @@ AbstractLog::append(const SpinLock::Guard& lock,
                   outTickCounter);
 }
 
+/**
+ * Reserve space for a typed entry in the head segment without copying in its
+ * contents. This is the first half of the append path used by
+ * append(AppendVector*, uint32_t): the reservation (and all accounting) is
+ * done here under the appendLock, and the caller copies the contents in with
+ * Segment::copyInReserved() after releasing it.
+ *
+ * Unlike the append() cores, this method never allocates a new head. The
+ * caller must already have ensured that the head has space for the entry.
+ *
+ * \param lock
+ *      Ensures that the caller holds the monitor lock; not actually used.
+ * \param type
+ *      Type of the entry. See LogEntryTypes.h.
+ * \param length
+ *      Size of the entry's contents in bytes.
+ * \param[out] outReference
+ *      If the reservation succeeds, a reference to the new entry is returned
+ *      here. The entry may not be accessed through it until its contents have
+ *      been copied in.
+ * \param[out] outDataOffset
+ *      If the reservation succeeds, the offset in the head segment at which
+ *      the entry's contents must be copied is returned here.
+ * \return
+ *      True if the reservation succeeded, false if the head segment did not
+ *      have enough space for it.
+ */
+bool
+AbstractLog::reserve(const SpinLock::Guard& lock,
+                     LogEntryType type,
+                     uint32_t length,
+                     Reference* outReference,
+                     uint32_t* outDataOffset)
+{
+    uint32_t bytesUsedBefore = head->getAppendedLength();
+    if (!head->reserve(type, length, outDataOffset, outReference))
+        return false;
+
+    uint32_t lengthWithMetadata = head->getAppendedLength() - bytesUsedBefore;
+
+    // Update log statistics so that the cleaner can make intelligent decisions
+    // when trying to reclaim memory.
+    head->trackNewEntry(type, lengthWithMetadata);
+    if (type == LOG_ENTRY_TYPE_OBJ ||
+        type == LOG_ENTRY_TYPE_RPCRESULT ||
+        type == LOG_ENTRY_TYPE_PREP ||
+        type == LOG_ENTRY_TYPE_TXPLIST)
+        totalLiveBytes += lengthWithMetadata;
+
+    PerfStats::threadStats.logBytesAppended += lengthWithMetadata;
+
+    return true;
+}
+
 /**
  * Allocate a new head segment, changing the ``head'' field. If the allocation
  * succeeds and the allocated segment is writable (that is, not an emergency
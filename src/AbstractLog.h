@@ -209,6 +209,11 @@ class AbstractLog {
                 Buffer& buffer,
                 Reference* outReference = NULL,
                 uint64_t* outTickCounter = NULL);
+    bool reserve(const SpinLock::Guard& lock,
+                 LogEntryType type,
+                 uint32_t length,
+                 Reference* outReference,
+                 uint32_t* outDataOffset);
     bool allocNewWritableHead();
 
     /// Various handlers for entries appended to this log. Used to obtain
@@ -244,7 +249,9 @@ class AbstractLog {
     /// Lock taken around log append operations. This ensures that parallel
     /// writers do not modify the head segment concurrently. The sync()
     /// method also uses this lock to get a consistent view of the head
-    /// segment in the presence of multiple appending threads.
+    /// segment in the presence of multiple appending threads. Multi-entry
+    /// appends only hold it while reserving space; their contents are copied
+    /// in afterwards (see LogSegment::unfinishedAppends).
     SpinLock appendLock;
 
     // Total amount of log space occupied by long-term data such as
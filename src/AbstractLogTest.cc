@@ -155,6 +155,31 @@ TEST_F(AbstractLogTest, append_multiple_basics) {
     delete[] data;
 }
 
+TEST_F(AbstractLogTest, append_multiple_copiesOutsideLock) {
+    Log::AppendVector v[2];
+    v[0].type = LOG_ENTRY_TYPE_OBJ;
+    v[0].buffer.appendExternal("hello", 5);
+    v[1].type = LOG_ENTRY_TYPE_OBJTOMB;
+    v[1].buffer.appendExternal("world!", 6);
+
+    uint64_t original = l.totalLiveBytes;
+    EXPECT_TRUE(l.append(v, 2));
+    EXPECT_EQ(0U, l.head->unfinishedAppends);
+    EXPECT_TRUE(l.appendLock.try_lock());
+    l.appendLock.unlock();
+
+    Buffer buffer;
+    EXPECT_EQ(LOG_ENTRY_TYPE_OBJ, l.getEntry(v[0].reference, buffer));
+    EXPECT_EQ("hello", TestUtil::toString(&buffer));
+    buffer.reset();
+    EXPECT_EQ(LOG_ENTRY_TYPE_OBJTOMB, l.getEntry(v[1].reference, buffer));
+    EXPECT_EQ("world!", TestUtil::toString(&buffer));
+
+    EXPECT_EQ(1U, l.head->getEntryCount(LOG_ENTRY_TYPE_OBJ));
+    EXPECT_EQ(1U, l.head->getEntryCount(LOG_ENTRY_TYPE_OBJTOMB));
+    EXPECT_EQ(7U, l.totalLiveBytes - original);
+}
+
 TEST_F(AbstractLogTest, append_multipleLogEntries) {
     Log::Reference references[2];
     Buffer logBuffer;
@@ -16,6 +16,7 @@
 #include "BackupClient.h"
 #include "Buffer.h"
 #include "ClientException.h"
+#include "Compression.h"
 #include "CycleCounter.h"
 #include "RawMetrics.h"
 #include "Segment.h"
@@ -518,6 +519,10 @@ StartReadingDataRpc::Result::operator=(Result&& other)
  *      Whether this particular replica should be loaded and filtered at the
  *      start of master recovery (as opposed to having it loaded and filtered
  *      on demand. May be reset on each subsequent write.
+ * \param compress
+ *      If true, the data is compressed before it is sent (unless it doesn't
+ *      shrink), and the backup decompresses it on arrival. Only worth it
+ *      for data which won't change, such as that of closed segments.
  * \return
  *      A vector describing the replication group for the backup
  *      that handled the RPC (secondary replicas will then be
@@ -536,11 +541,12 @@ BackupClient::writeSegment(Context* context,
                            const SegmentCertificate* certificate,
                            bool open,
                            bool close,
-                           bool primary)
+                           bool primary,
+                           bool compress)
 {
     WriteSegmentRpc rpc(context, backupId, masterId, segmentId, segmentEpoch,
                         segment, offset, length, certificate,
-                        open, close, primary);
+                        open, close, primary, compress);
     rpc.wait();
 }
 
@@ -602,6 +608,10 @@ BackupClient::writeSegment(Context* context,
  *      Whether this particular replica should be loaded and filtered at the
  *      start of master recovery (as opposed to having it loaded and filtered
  *      on demand. May be reset on each subsequent write.
+ * \param compress
+ *      If true, the data is compressed before it is sent (unless it doesn't
+ *      shrink), and the backup decompresses it on arrival. Only worth it
+ *      for data which won't change, such as that of closed segments.
  */
 WriteSegmentRpc::WriteSegmentRpc(Context* context,
                                  ServerId backupId,
@@ -614,7 +624,8 @@ WriteSegmentRpc::WriteSegmentRpc(Context* context,
                                  const SegmentCertificate* certificate,
                                  bool open,
                                  bool close,
-                                 bool primary)
+                                 bool primary,
+                                 bool compress)
     : ServerIdRpcWrapper(context, backupId,
                          sizeof(WireFormat::BackupWrite::Response))
 {
@@ -633,7 +644,18 @@ WriteSegmentRpc::WriteSegmentRpc(Context* context,
     reqHdr->open = open;
     reqHdr->close = close;
     reqHdr->primary = primary;
-    if (segment)
+    reqHdr->compressedLength = 0;
+    if (segment && compress && length > 0) {
+        // Only send the compressed form if it is smaller.
+        std::unique_ptr<char[]> data(new char[length]);
+        segment->copyOut(offset, data.get(), length);
+        uint32_t headerLength = request.size();
+        uint32_t capacity = length - 1;
+        reqHdr->compressedLength = Compression::compress(data.get(), length,
+                request.alloc(capacity), capacity);
+        request.truncate(headerLength + reqHdr->compressedLength);
+    }
+    if (segment && reqHdr->compressedLength == 0)
         segment->appendToBuffer(request, offset, length);
     CycleCounter<RawMetric> _(&metrics->master.replicationPostingWriteRpcTicks);
     send();
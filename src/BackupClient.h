@@ -191,7 +191,8 @@ class WriteSegmentRpc : public ServerIdRpcWrapper {
                     uint64_t segmentId, uint64_t segmentEpoch,
                     const Segment* segment, uint32_t offset, uint32_t length,
                     const SegmentCertificate* certificate,
-                    bool open, bool close, bool primary);
+                    bool open, bool close, bool primary,
+                    bool compress = false);
     ~WriteSegmentRpc() {}
     void wait();
 
@@ -229,7 +230,7 @@ class BackupClient {
             ServerId masterId, uint64_t segmentId, uint64_t segmentEpoch,
             const Segment* segment, uint32_t offset, uint32_t length,
             const SegmentCertificate* certificate,
-            bool open, bool close, bool primary);
+            bool open, bool close, bool primary, bool compress = false);
 
   private:
     BackupClient();
@@ -16,12 +16,14 @@
 #include "BackupService.h"
 #include "Buffer.h"
 #include "ClientException.h"
+#include "Compression.h"
 #include "Cycles.h"
 #include "InMemoryStorage.h"
 #include "PerfStats.h"
 #include "ServerConfig.h"
 #include "ShortMacros.h"
 #include "MultiFileStorage.h"
+#include "PmemStorage.h"
 #include "Status.h"
 
 namespace RAMCloud {
@@ -63,6 +65,11 @@ BackupService::BackupService(Context* context,
         storage.reset(new InMemoryStorage(config->segmentSize,
                                           config->backup.numSegmentFrames,
                                           config->backup.writeRateLimit));
+    } else if (config->backup.pmem) {
+        storage.reset(new PmemStorage(config->segmentSize,
+                                      config->backup.numSegmentFrames,
+                                      config->backup.writeRateLimit,
+                                      config->backup.file.c_str()));
     } else {
         size_t maxWriteBuffers = config->backup.maxNonVolatileBuffers;
         if (maxWriteBuffers == 0) {
@@ -73,12 +80,18 @@ BackupService::BackupService(Context* context,
             maxWriteBuffers = config->backup.numSegmentFrames;
         }
 
+        size_t journalSize =
+                size_t(config->backup.journalSegments) * config->segmentSize;
         storage.reset(new MultiFileStorage(config->segmentSize,
                                            config->backup.numSegmentFrames,
                                            config->backup.writeRateLimit,
                                            maxWriteBuffers,
                                            config->backup.file.c_str(),
-                                           O_DIRECT | O_SYNC));
+                                           O_DIRECT | O_SYNC,
+                                           config->backup.ioUring
+                                               ? MultiFileStorage::IO_URING
+                                               : MultiFileStorage::AIO,
+                                           journalSize));
     }
     if (storage->getMetadataSize() < sizeof(BackupReplicaMetadata))
         DIE("Storage metadata block too small to hold BackupReplicaMetadata");
@@ -638,7 +651,27 @@ BackupService::writeSegment(const WireFormat::BackupWrite::Request* reqHdr,
                                reqHdr->segmentEpoch,
                                reqHdr->close, reqHdr->primary);
         }
-        frame->append(*rpc->requestPayload, sizeof(*reqHdr),
+        Buffer* source = rpc->requestPayload;
+        uint32_t sourceOffset = sizeof32(*reqHdr);
+        Buffer decompressed;
+        if (reqHdr->compressedLength != 0) {
+            if (reqHdr->length > segmentSize)
+                throw BackupSegmentOverflowException(HERE);
+            const void* compressed = rpc->requestPayload->getRange(
+                    sourceOffset, reqHdr->compressedLength);
+            void* data = decompressed.alloc(reqHdr->length);
+            if (compressed == NULL ||
+                    !Compression::decompress(compressed,
+                                             reqHdr->compressedLength,
+                                             data, reqHdr->length)) {
+                LOG(WARNING, "Couldn't decompress write to replica <%s,%lu>",
+                    masterId.toString().c_str(), segmentId);
+                throw RequestFormatError(HERE);
+            }
+            source = &decompressed;
+            sourceOffset = 0;
+        }
+        frame->append(*source, sourceOffset,
                       reqHdr->length, reqHdr->offset,
                       metadata.get(), sizeof(*metadata));
         metrics->backup.writeCopyBytes += reqHdr->length;
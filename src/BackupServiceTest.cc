@@ -520,6 +520,36 @@ TEST_F(BackupServiceTest, writeSegment_badOffsetPlusLength) {
         BackupSegmentOverflowException);
 }
 
+TEST_F(BackupServiceTest, writeSegment_compressed) {
+    openSegment(ServerId(99, 0), 88);
+    string s;
+    for (int i = 0; i < 50; i++)
+        s += "compressible ";
+    uint32_t length = downCast<uint32_t>(s.length());
+    Segment segment;
+    segment.copyIn(10, s.c_str(), length);
+    uint64_t bytesWritten = backup->bytesWritten;
+    BackupClient::writeSegment(&context, backupId, ServerId(99, 0), 88, 0,
+                               &segment, 10, length, NULL,
+                               false, false, false, true);
+    auto frameIt = backup->frames.find({{99, 0}, 88});
+    EXPECT_EQ(s, string(static_cast<char*>(frameIt->second->load()) + 10,
+                        length));
+    EXPECT_EQ(bytesWritten + length, backup->bytesWritten);
+}
+
+TEST_F(BackupServiceTest, writeSegment_compressedTooLong) {
+    openSegment(ServerId(99, 0), 88);
+    uint32_t length = config.segmentSize + 1;
+    ASSERT_TRUE(Segment::DEFAULT_SEGMENT_SIZE >= length);
+    Segment segment;
+    EXPECT_THROW(
+        BackupClient::writeSegment(&context, backupId, ServerId(99, 0),
+                                   88, 0, &segment, 0, length, {},
+                                   false, false, false, true),
+        BackupSegmentOverflowException);
+}
+
 TEST_F(BackupServiceTest, writeSegment_closeSegment) {
     openSegment(ServerId(99, 0), 88);
     writeRawString({99, 0}, 88, 10, "test");
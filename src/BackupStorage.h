@@ -437,7 +437,7 @@ class BackupStorage {
     virtual void fry() = 0;
 
     /// See #storageType.
-    enum class Type { UNKNOWN = 0, MEMORY = 1, DISK = 2 };
+    enum class Type { UNKNOWN = 0, MEMORY = 1, DISK = 2, PMEM = 3 };
 
   PROTECTED:
     /**
@@ -13,137 +13,149 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
-#include <thread>
-
 #include "BackupStorage.h"
+#include "Buffer.h"
 #include "Cycles.h"
-#include "Logging.h"
+#include "Logger.h"
+#include "MultiFileStorage.h"
+#include "PmemStorage.h"
 #include "Segment.h"
+#include "ShortMacros.h"
 
 using namespace RAMCloud;
 
-struct Store {
-    Store(MultiFileStorage& storage,
-          const char* segment,
-          BackupStorage::Handle* handle)
-        : storage(storage)
-        , segment(segment)
-        , handle(handle)
-    {
-    }
-
-    void
-    operator()()
-    {
-        uint64_t startTime = Cycles::rdtsc();
-        storage.putSegment(handle, segment);
-        LOG(DEBUG, "StoreOp took %lu us",
-            Cycles::toNanoseconds(Cycles::rdtsc() - startTime) / 1000);
-    }
-
-    MultiFileStorage& storage;
-    const char* segment;
-    BackupStorage::Handle* handle;
-};
-
+/**
+ * Measures the bandwidth of MultiFileStorage with each of its IO engines
+ * (and, optionally, of PmemStorage), for the two patterns that matter on
+ * backups: many replicas being written at once (as when many masters
+ * replicate to the backup), and many replicas being loaded at once (as
+ * during crash recovery). Also measures the latency of small synchronous
+ * appends, which masters wait for on every replicated write.
+ */
 struct Bench {
-    explicit Bench(const char* backupFile)
-        : backupFile(backupFile)
-        , segmentCount(80 * 2)
-        , storage(Segment::SEGMENT_SIZE,
-                  segmentCount,
-                  backupFile,
-                  O_DIRECT | O_SYNC | O_NOATIME)
-        , allocated()
-        , scratch(SegmentAllocator::malloc(Segment::SEGMENT_SIZE))
-        , mb(static_cast<double>(Segment::SEGMENT_SIZE) / (1 << 20))
-    {
-    }
-
-    ~Bench()
+    Bench(const char* backupFiles, uint32_t segmentCount)
+        : backupFiles(backupFiles)
+        , segmentCount(segmentCount)
+        , segmentSize(Segment::DEFAULT_SEGMENT_SIZE)
+        , source()
+        , data(new char[segmentSize])
+        , metadata()
+        , mb(static_cast<double>(segmentSize) * segmentCount / (1 << 20))
     {
-        SegmentAllocator::free(scratch);
+        memset(data.get(), 'x', segmentSize);
+        source.appendExternal(data.get(), downCast<uint32_t>(segmentSize));
+        memset(metadata, 'm', sizeof(metadata));
     }
 
+    /**
+     * Run all of the measurements on MultiFileStorage with a particular
+     * IO engine.
+     *
+     * \param ioEngine
+     *      IO engine to use for the storage.
+     * \param name
+     *      Name of the engine to print.
+     */
     void
-    fill(const uint32_t count)
+    run(MultiFileStorage::IoEngine ioEngine, const char* name)
     {
-        double sum = 0., min = 100000.0, max = 0.;
-        for (uint32_t i = 0; i < count; i++) {
-            auto* handle = storage.allocate(0, i);
-            allocated.push_back(handle);
-            uint64_t start = Cycles::rdtsc();
-            storage.putSegment(handle, scratch);
-            uint64_t putTime = Cycles::rdtsc() - start;
-            double mbSec = mb / Cycles::toSeconds(putTime);
-            LOG(NOTICE, "Stored segment at %.1f MB/s", mbSec);
-            sum += mbSec;
-            max = std::max(max, mbSec);
-            min = std::min(min, mbSec);
+        {
+            MultiFileStorage storage(segmentSize, segmentCount, 0,
+                                     segmentCount, backupFiles.c_str(),
+                                     O_DIRECT | O_SYNC | O_NOATIME, ioEngine);
+            measureBandwidth(storage, name);
         }
-        LOG(WARNING, "=== Min/Avg/Max Put Bandwidth: %.1f %.1f %.1f ===",
-            min, sum / count, max);
+        MultiFileStorage storage(segmentSize, segmentCount, 0, segmentCount,
+                                 backupFiles.c_str(),
+                                 O_DIRECT | O_SYNC | O_NOATIME, ioEngine);
+        measureLatency(storage, name);
     }
 
+    /**
+     * Fill every frame of a fresh storage instance and then load them all
+     * back, printing the bandwidth of each phase.
+     *
+     * \param storage
+     *      Storage to measure; all of its frames must be free.
+     * \param name
+     *      Name of the storage to print.
+     */
     void
-    testRead()
+    measureBandwidth(BackupStorage& storage, const char* name)
     {
-        const uint32_t count = 80;
-
-        fill(count);
-        usleep(1000000);
-
-        double sum = 0., min = 100000.0, max = 0.;
-        foreach (auto* handle, allocated) {
-            uint64_t start = Cycles::rdtsc();
-            storage.getSegment(handle, scratch);
-            uint64_t getTime = Cycles::rdtsc() - start;
-            double mbSec = mb / Cycles::toSeconds(getTime);
-            LOG(NOTICE, "Fetched segment at %.1f MB/s", mbSec);
-            sum += mbSec;
-            max = std::max(max, mbSec);
-            min = std::min(min, mbSec);
+        std::vector<BackupStorage::FrameRef> frames;
+
+        // Write: open all of the replicas and fill them; the IO thread
+        // writes them out concurrently.
+        uint64_t start = Cycles::rdtsc();
+        for (uint32_t i = 0; i < segmentCount; i++) {
+            frames.push_back(storage.open(false));
+            frames.back()->append(source, 0, segmentSize, 0, metadata,
+                                  sizeof(metadata));
+            frames.back()->close();
         }
-        LOG(WARNING, "=== Min/Avg/Max Get Bandwidth: %.1f %.1f %.1f ===",
-            min, sum / count, max);
+        storage.quiesce();
+        double writeSeconds = Cycles::toSeconds(Cycles::rdtsc() - start);
+
+        // Read: start loading all of the replicas at once, as recovery
+        // does, then wait for each of them.
+        start = Cycles::rdtsc();
+        foreach (BackupStorage::FrameRef& frame, frames)
+            frame->startLoading();
+        foreach (BackupStorage::FrameRef& frame, frames) {
+            frame->load();
+            frame->unload();
+        }
+        double readSeconds = Cycles::toSeconds(Cycles::rdtsc() - start);
+
+        LOG(WARNING, "=== %s: write %.1f MB/s, recovery read %.1f MB/s ===",
+            name, mb / writeSeconds, mb / readSeconds);
     }
 
+    /**
+     * Fill a replica with 1 KB synchronous appends, as a master replicating
+     * small writes would, and print the average time for each append.
+     *
+     * \param storage
+     *      Storage to measure; it must have a free frame.
+     * \param name
+     *      Name of the storage to print.
+     */
     void
-    testReadWithWriteInterference()
+    measureLatency(BackupStorage& storage, const char* name)
     {
-        const uint32_t count = 80;
-
-        fill(count);
-        usleep(1000000);
-
-        auto writeList = allocated;
-        std::random_shuffle(writeList.begin(), writeList.end());
-
-        auto writeHandle = writeList.begin();
-
-        double sum = 0., min = 100000.0, max = 0.;
-        int i = 0;
-        foreach (auto* handle, allocated) {
-            if (!(i++ % 3))
-                std::thread(Store(storage, scratch, *(writeHandle++)));
-            uint64_t start = Cycles::rdtsc();
-            storage.getSegment(handle, scratch);
-            uint64_t getTime = Cycles::rdtsc() - start;
-            double mbSec = mb / Cycles::toSeconds(getTime);
-            LOG(NOTICE, "Fetched segment at %.1f MB/s", mbSec);
-            sum += mbSec;
-            max = std::max(max, mbSec);
-            min = std::min(min, mbSec);
+        const uint32_t appendSize = 1024;
+        const uint32_t count = downCast<uint32_t>(segmentSize / appendSize);
+        BackupStorage::FrameRef frame = storage.open(true);
+        uint64_t start = Cycles::rdtsc();
+        for (uint32_t i = 0; i < count; i++) {
+            frame->append(source, i * appendSize, appendSize, i * appendSize,
+                          metadata, sizeof(metadata));
         }
-        LOG(WARNING, "=== Min/Avg/Max Get Bandwidth: %.1f %.1f %.1f ===",
-            min, sum / count, max);
+        double seconds = Cycles::toSeconds(Cycles::rdtsc() - start);
+        LOG(WARNING, "=== %s: %u byte sync append %.2f us ===",
+            name, appendSize, seconds * 1e06 / count);
     }
 
-    const string backupFile;
+    /// Comma-separated list of files for the storage.
+    const string backupFiles;
+
+    /// Number of replicas written and read in each run.
     const uint32_t segmentCount;
-    MultiFileStorage storage;
-    vector<BackupStorage::Handle*> allocated;
-    char* const scratch;
+
+    /// Size of each replica.
+    const size_t segmentSize;
+
+    /// Refers to #data; appended to each replica.
+    Buffer source;
+
+    /// Contents of each replica.
+    std::unique_ptr<char[]> data;
+
+    /// Metadata for each replica.
+    char metadata[64];
+
+    /// Megabytes written and read in each run.
     const double mb;
 
     DISALLOW_COPY_AND_ASSIGN(Bench);
@@ -152,13 +164,32 @@ struct Bench {
 int
 main(int ac, char* av[])
 {
-    const char* backupFile = "/var/tmp/backup.log";
+    const char* backupFiles = "/var/tmp/backup.log";
+    uint32_t segmentCount = 80;
     if (ac > 1)
-        backupFile = av[1];
-    LOG(WARNING, "Writing to %s", backupFile);
+        backupFiles = av[1];
+    if (ac > 2)
+        segmentCount = downCast<uint32_t>(strtoul(av[2], NULL, 10));
+    const char* pmemFile = NULL;
+    if (ac > 3)
+        pmemFile = av[3];
+    LOG(WARNING, "Writing %u segments to %s", segmentCount, backupFiles);
+
+    Bench bench(backupFiles, segmentCount);
+    bench.run(MultiFileStorage::AIO, "aio");
+    bench.run(MultiFileStorage::IO_URING, "io_uring");
+    if (pmemFile) {
+        {
+            PmemStorage storage(bench.segmentSize, segmentCount, 0, pmemFile);
+            bench.measureBandwidth(storage, "pmem");
+        }
+        PmemStorage storage(bench.segmentSize, segmentCount, 0, pmemFile);
+        bench.measureLatency(storage, "pmem");
+    }
 
-    Bench(backupFile).testRead();
-    //Bench(backupFile).testReadWithWriteInterference();
+    // Messages are printed by a separate thread; make sure all of them are
+    // out before exiting.
+    Logger::get().sync();
 
     return 0;
 }
@@ -28,6 +28,11 @@ uint32_t BasicTransport::clientRequestRetransmitCount = 0;
 uint32_t BasicTransport::serverRequestRetransmitCount = 0;
 uint32_t BasicTransport::totalNetworkIssues = 0;
 
+// Definitions for the packet flags, which are passed by reference when
+// constructing MessageAccumulators.
+const uint8_t BasicTransport::FROM_CLIENT;
+const uint8_t BasicTransport::FROM_SERVER;
+
 // Change 0 -> 1 in the following line to enable detailed time tracing in
 // this transport.
 #define TIME_TRACE 0
@@ -60,6 +65,8 @@ BasicTransport::BasicTransport(Context* context, const ServiceLocator* locator,
     , serverTimerList()
     , roundTripBytes(getRoundTripBytes(locator))
     , grantIncrement(5*maxDataPerPacket)
+    , grantList()
+    , overcommit(getOvercommit(locator))
     , timer(this, context->dispatch)
     , timerInterval(0)
     , timeoutIntervals(10)
@@ -75,10 +82,12 @@ BasicTransport::BasicTransport(Context* context, const ServiceLocator* locator,
     timer.start(Cycles::rdtsc() + timerInterval);
 
     LOG(NOTICE, "BasicTransport parameters: maxDataPerPacket %u, "
-            "roundTripBytes %u, grantIncrement %u, pingIntervals %d, "
+            "roundTripBytes %u, grantIncrement %u, overcommit %u, "
+            "highest priority %d, pingIntervals %d, "
             "timeoutIntervals %d, timerInterval %.2f ms",
             maxDataPerPacket, roundTripBytes,
-            grantIncrement, pingIntervals, timeoutIntervals,
+            grantIncrement, overcommit, driver->getHighestPacketPriority(),
+            pingIntervals, timeoutIntervals,
             Cycles::toSeconds(timerInterval)*1e3);
 }
 
@@ -138,9 +147,41 @@ BasicTransport::deleteServerRpc(ServerRpc* serverRpc)
     if ((serverRpc->transmitOffset > 0) || !serverRpc->requestComplete) {
         erase(serverTimerList, *serverRpc);
     }
+    if (serverRpc->requestComplete) {
+        // The driver may still refer to the reply in packets it has
+        // queued.
+        driver->flushPackets();
+    }
     serverRpcPool.destroy(serverRpc);
 }
 
+/**
+ * Parse the "overcommit" option in a service locator, which determines how
+ * many incoming messages may be granted at once.
+ *
+ * \param locator
+ *      Service locator that may contain an "overcommit" option. If NULL,
+ *      or if the option is missing, then a default is supplied.
+ */
+uint32_t
+BasicTransport::getOvercommit(const ServiceLocator* locator)
+{
+    uint32_t result = 4;
+    if ((locator != NULL) && locator->hasOption("overcommit")) {
+        char* end;
+        uint32_t value = downCast<uint32_t>(strtoul(
+                locator->getOption("overcommit").c_str(), &end, 10));
+        if ((*end == 0) && (value != 0)) {
+            result = value;
+        } else {
+            LOG(ERROR, "Bad BasicTransport overcommit option value '%s' "
+                    "(expected positive integer); ignoring option",
+                    locator->getOption("overcommit").c_str());
+        }
+    }
+    return result;
+}
+
 /**
  * Parse option values in a service locator to determine how many bytes
  * of data must be sent to cover the round-trip latency of a connection.
@@ -271,10 +312,13 @@ BasicTransport::recordIssue(uint32_t* counter) {
  *      Extra flags to set in packet headers, such as FROM_CLIENT or
  *      RETRANSMISSION. Must at least specify either FROM_CLIENT or
  *      FROM_SERVER.
+ * \param priority
+ *      Network priority for the packets: the driver's highest priority for
+ *      data sent without a GRANT, otherwise the priority from the GRANT.
  */
 void
 BasicTransport::sendBytes(const Driver::Address* address, RpcId rpcId,
-        Buffer* message, int offset, int length, uint8_t flags)
+        Buffer* message, int offset, int length, uint8_t flags, int priority)
 {
     flags |= NEED_GRANT;
     int messageSize = downCast<int>(message->size());
@@ -291,7 +335,7 @@ BasicTransport::sendBytes(const Driver::Address* address, RpcId rpcId,
         // Message fits entirely in a single packet.
         AllDataHeader header(rpcId, flags, downCast<uint16_t>(length));
         Buffer::Iterator iter(message, 0, length);
-        driver->sendPacket(address, &header, &iter);
+        driver->sendPacket(address, &header, &iter, priority);
     } else {
         // Send multiple packets.
         int bytesLeft = length;
@@ -300,7 +344,7 @@ BasicTransport::sendBytes(const Driver::Address* address, RpcId rpcId,
             DataHeader header(rpcId, message->size(), curOffset, flags);
             int bytesThisPacket = std::min(bytesLeft, maxDataPerPacket);
             Buffer::Iterator iter(message, curOffset, bytesThisPacket);
-            driver->sendPacket(address, &header, &iter);
+            driver->sendPacket(address, &header, &iter, priority);
             curOffset += bytesThisPacket;
             bytesLeft -= bytesThisPacket;
         }
@@ -312,6 +356,130 @@ BasicTransport::sendBytes(const Driver::Address* address, RpcId rpcId,
 #endif
 }
 
+/**
+ * Returns true if we are deliberately withholding GRANTs for a message
+ * because it isn't among the #overcommit shortest messages in grantList;
+ * the sender will be silent until the message moves up the list.
+ *
+ * \param message
+ *      Incoming message to check.
+ */
+bool
+BasicTransport::grantDeferred(MessageAccumulator* message)
+{
+    if (!message->grantLinks.is_linked()) {
+        return false;
+    }
+    uint32_t rank = 0;
+    for (GrantList::iterator it = grantList.begin();
+            (it != grantList.end()) && (rank < overcommit); it++, rank++) {
+        if (&(*it) == message) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Sends GRANTs for the first #overcommit messages in grantList (the ones
+ * with the fewest bytes left to receive), so that each of them has at
+ * least a round-trip's worth of data authorized but not yet received.
+ * Shorter messages are granted higher network priorities. Messages that
+ * have been granted in their entirety are removed from grantList, making
+ * room for others. This method is invoked whenever grantList changes.
+ */
+void
+BasicTransport::issueGrants()
+{
+    // Data sent without a GRANT uses the highest priority (see sendRequest
+    // and sendReply), so granted data starts one level below that.
+    int highestPriority = driver->getHighestPacketPriority();
+    uint32_t rank = 0;
+    for (GrantList::iterator it = grantList.begin();
+            (it != grantList.end()) && (rank < overcommit); ) {
+        MessageAccumulator* message = &(*it);
+        uint32_t received = message->buffer->size();
+        if ((*message->grantOffset < (received + message->roundTripBytes))
+                && (*message->grantOffset < message->totalLength)) {
+            *message->grantOffset = received + message->roundTripBytes
+                    + grantIncrement;
+            uint8_t priority = downCast<uint8_t>(std::max(
+                    highestPriority - 1 - downCast<int>(rank), 0));
+#if TIME_TRACE
+            TimeTrace::record("sending GRANT, sequence %u, offset %u, "
+                    "priority %u",
+                    downCast<uint32_t>(message->rpcId.sequence),
+                    *message->grantOffset, priority);
+#endif
+            GrantHeader grant(message->rpcId, *message->grantOffset,
+                    message->whoFrom, priority);
+            driver->sendPacket(message->address, &grant, NULL);
+        }
+        if (*message->grantOffset >= message->totalLength) {
+            it = grantList.erase(it);
+        } else {
+            it++;
+            rank++;
+        }
+    }
+}
+
+/**
+ * This method is invoked when a DATA packet arrives for a message whose
+ * sender needs GRANTs to transmit all of it. It moves the message to the
+ * appropriate place in grantList, given the bytes still to be received,
+ * then sends any GRANTs that are now due.
+ *
+ * \param message
+ *      Incomplete message that just received data.
+ * \param totalLength
+ *      Total length of the message, from its DATA packets.
+ */
+void
+BasicTransport::scheduleMessage(MessageAccumulator* message,
+        uint32_t totalLength)
+{
+    message->totalLength = totalLength;
+    GrantList::iterator next = grantList.end();
+    if (message->grantLinks.is_linked()) {
+        next = grantList.erase(grantList.iterator_to(*message));
+    } else if (*message->grantOffset >= totalLength) {
+        // We have already granted the entire message.
+        return;
+    }
+
+    // A message's remaining bytes only shrink, so it can only move
+    // toward the front of the list.
+    uint32_t remaining = totalLength - message->buffer->size();
+    while (next != grantList.begin()) {
+        GrantList::iterator prev = next;
+        prev--;
+        if ((prev->totalLength - prev->buffer->size()) <= remaining) {
+            break;
+        }
+        next = prev;
+    }
+    grantList.insert(next, *message);
+    issueGrants();
+}
+
+/**
+ * Removes a message from grantList (if it is there), so that its place
+ * can be given to another message. Invoked when the message is complete
+ * or abandoned.
+ *
+ * \param message
+ *      Incoming message that no longer needs GRANTs.
+ */
+void
+BasicTransport::unscheduleMessage(MessageAccumulator* message)
+{
+    if (message->grantLinks.is_linked()) {
+        erase(grantList, *message);
+        issueGrants();
+    }
+}
+
 /**
  * Given a pointer to a BasicTransport packet, return a human-readable
  * string describing the information in its header.
@@ -370,6 +538,9 @@ BasicTransport::headerToString(const void* packet, uint32_t packetLength)
             const BasicTransport::GrantHeader* grant =
                     static_cast<const BasicTransport::GrantHeader*>(packet);
             result += format(", offset %u", grant->offset);
+            if (grant->priority != 0) {
+                result += format(", priority %u", grant->priority);
+            }
             break;
         }
         case BasicTransport::PacketOpcode::LOG_TIME_TRACE:
@@ -449,6 +620,10 @@ void
 BasicTransport::Session::abort()
 {
     aborted = true;
+
+    // The driver may still refer to request data in packets it has
+    // queued; our caller is free to delete that data once we return.
+    t->driver->flushPackets();
     for (ClientRpcMap::iterator it = t->outgoingRpcs.begin();
             it != t->outgoingRpcs.end(); ) {
         uint64_t sequence = it->first;
@@ -469,6 +644,8 @@ BasicTransport::Session::cancelRequest(RpcNotifier* notifier)
             it != t->outgoingRpcs.end(); it++) {
         ClientRpc* clientRpc = it->second;
         if (clientRpc->notifier == notifier) {
+            // See comment in abort.
+            t->driver->flushPackets();
             t->outgoingRpcs.erase(it);
             t->clientRpcPool.destroy(clientRpc);
 
@@ -517,7 +694,8 @@ BasicTransport::Session::sendRequest(Buffer* request, Buffer* response,
     RpcId id(t->clientId, t->nextSequenceNumber);
     t->nextSequenceNumber++;
     t->outgoingRpcs[id.sequence] = clientRpc;
-    t->sendBytes(serverAddress, id, request, 0, roundTripBytes, FROM_CLIENT);
+    t->sendBytes(serverAddress, id, request, 0, roundTripBytes, FROM_CLIENT,
+            t->driver->getHighestPacketPriority());
     clientRpc->transmitOffset = roundTripBytes;
 }
 
@@ -592,6 +770,7 @@ BasicTransport::IncomingPacketHandler::handlePacket(Driver::Received* received)
                         payload + sizeof32(AllDataHeader),
                         header->messageLength, t->driver, payload);
                 t->outgoingRpcs.erase(header->common.rpcId.sequence);
+                t->driver->flushPackets();
                 clientRpc->notifier->completed();
                 t->clientRpcPool.destroy(clientRpc);
                 return;
@@ -608,7 +787,10 @@ BasicTransport::IncomingPacketHandler::handlePacket(Driver::Received* received)
                         header->offset, received->len, header->common.flags);
 #endif
                 if (!clientRpc->accumulator) {
-                    clientRpc->accumulator.construct(t, clientRpc->response);
+                    clientRpc->accumulator.construct(t, clientRpc->response,
+                            clientRpc->session->serverAddress,
+                            header->common.rpcId, &clientRpc->grantOffset,
+                            clientRpc->session->roundTripBytes, FROM_CLIENT);
                 }
                 clientRpc->accumulator->addPacket(received, header);
                 if (clientRpc->response->size() >= header->totalLength) {
@@ -622,30 +804,14 @@ BasicTransport::IncomingPacketHandler::handlePacket(Driver::Received* received)
                         clientRpc->response->truncate(header->totalLength);
                     }
                     t->outgoingRpcs.erase(header->common.rpcId.sequence);
+                    t->driver->flushPackets();
                     clientRpc->notifier->completed();
                     t->clientRpcPool.destroy(clientRpc);
-                } else {
-                    // See if we need to output a GRANT.
-                    if ((header->common.flags & NEED_GRANT) &&
-                            (clientRpc->grantOffset <
-                            (clientRpc->response->size() +
-                            clientRpc->session->roundTripBytes)) &&
-                            (clientRpc->grantOffset < header->totalLength)) {
-                        clientRpc->grantOffset = clientRpc->response->size()
-                                + clientRpc->session->roundTripBytes
-                                + t->grantIncrement;
-#if TIME_TRACE
-                        TimeTrace::record(
-                                "client sending GRANT, sequence %u, offset %u",
-                                downCast<uint32_t>(
-                                header->common.rpcId.sequence),
-                                clientRpc->grantOffset);
-#endif
-                        GrantHeader grant(header->common.rpcId,
-                                clientRpc->grantOffset, FROM_CLIENT);
-                        t->driver->sendPacket(clientRpc->session->serverAddress,
-                                &grant, NULL);
-                    }
+                } else if ((header->common.flags & NEED_GRANT) ||
+                        clientRpc->accumulator->grantLinks.is_linked()) {
+                    // Let the scheduler decide whether to output a GRANT.
+                    t->scheduleMessage(clientRpc->accumulator.get(),
+                            header->totalLength);
                 }
 #if 0
                 // This code was added for debugging in 2/2016; it should
@@ -692,7 +858,7 @@ BasicTransport::IncomingPacketHandler::handlePacket(Driver::Received* received)
                             header->common.rpcId, clientRpc->request,
                             clientRpc->transmitOffset,
                             header->offset - clientRpc->transmitOffset,
-                            FROM_CLIENT);
+                            FROM_CLIENT, header->priority);
                     clientRpc->transmitOffset = header->offset;
                 }
                 return;
@@ -726,7 +892,8 @@ BasicTransport::IncomingPacketHandler::handlePacket(Driver::Received* received)
                 t->sendBytes(clientRpc->session->serverAddress,
                         header->common.rpcId, clientRpc->request,
                         header->offset, header->length,
-                        FROM_CLIENT|RETRANSMISSION);
+                        FROM_CLIENT|RETRANSMISSION,
+                        t->driver->getHighestPacketPriority());
                 uint32_t resendEnd = header->offset + header->length;
                 if (resendEnd > clientRpc->transmitOffset) {
                     clientRpc->transmitOffset = resendEnd;
@@ -813,7 +980,10 @@ BasicTransport::IncomingPacketHandler::handlePacket(Driver::Received* received)
                             received->sender, header->common.rpcId);
                     t->incomingRpcs[header->common.rpcId] = serverRpc;
                     serverRpc->accumulator.construct(t,
-                            &serverRpc->requestPayload);
+                            &serverRpc->requestPayload,
+                            serverRpc->clientAddress, header->common.rpcId,
+                            &serverRpc->grantOffset, t->roundTripBytes,
+                            FROM_SERVER);
                     t->serverTimerList.push_back(*serverRpc);
                 } else if (serverRpc->requestComplete) {
                     // We've already received the full message, so
@@ -842,30 +1012,14 @@ BasicTransport::IncomingPacketHandler::handlePacket(Driver::Received* received)
                         serverRpc->requestPayload.truncate(header->totalLength);
                     }
                     erase(t->serverTimerList, *serverRpc);
+                    t->unscheduleMessage(serverRpc->accumulator.get());
                     serverRpc->requestComplete = true;
                     t->context->workerManager->handleRpc(serverRpc);
-                } else {
-                    // See if we need to output a GRANT.
-                    if ((header->common.flags & NEED_GRANT) &&
-                            (serverRpc->grantOffset <
-                            (serverRpc->requestPayload.size()
-                            + t->roundTripBytes)) &&
-                            (serverRpc->grantOffset < header->totalLength)) {
-                        serverRpc->grantOffset =
-                                serverRpc->requestPayload.size()
-                                + t->roundTripBytes + t->grantIncrement;
-#if TIME_TRACE
-                        TimeTrace::record(
-                                "server sending GRANT, sequence %u, offset %u",
-                                downCast<uint32_t>(
-                                header->common.rpcId.sequence),
-                                serverRpc->grantOffset);
-#endif
-                        GrantHeader grant(header->common.rpcId,
-                                serverRpc->grantOffset, FROM_SERVER);
-                        t->driver->sendPacket(serverRpc->clientAddress,
-                                &grant, NULL);
-                    }
+                } else if ((header->common.flags & NEED_GRANT) ||
+                        serverRpc->accumulator->grantLinks.is_linked()) {
+                    // Let the scheduler decide whether to output a GRANT.
+                    t->scheduleMessage(serverRpc->accumulator.get(),
+                            header->totalLength);
                 }
                 serverDataDone:
 #if 0
@@ -923,7 +1077,7 @@ BasicTransport::IncomingPacketHandler::handlePacket(Driver::Received* received)
                             header->common.rpcId, &serverRpc->replyPayload,
                             serverRpc->transmitOffset,
                             header->offset - serverRpc->transmitOffset,
-                            FROM_SERVER);
+                            FROM_SERVER, header->priority);
                     serverRpc->transmitOffset = header->offset;
                     if (serverRpc->transmitOffset >=
                             serverRpc->replyPayload.size()) {
@@ -979,7 +1133,8 @@ BasicTransport::IncomingPacketHandler::handlePacket(Driver::Received* received)
                     // retransmitting everything we've already sent).
                     t->sendBytes(serverRpc->clientAddress,
                             serverRpc->rpcId, &serverRpc->replyPayload,
-                            0, t->maxDataPerPacket, FROM_SERVER|RETRANSMISSION);
+                            0, t->maxDataPerPacket, FROM_SERVER|RETRANSMISSION,
+                            t->driver->getHighestPacketPriority());
                 }
                 return;
             }
@@ -1014,7 +1169,8 @@ BasicTransport::IncomingPacketHandler::handlePacket(Driver::Received* received)
                 t->sendBytes(serverRpc->clientAddress,
                         serverRpc->rpcId, &serverRpc->replyPayload,
                         header->offset, header->length,
-                        RETRANSMISSION|FROM_SERVER);
+                        RETRANSMISSION|FROM_SERVER,
+                        t->driver->getHighestPacketPriority());
                 uint32_t resendEnd = header->offset + header->length;
                 if (resendEnd > serverRpc->transmitOffset) {
                     serverRpc->transmitOffset = resendEnd;
@@ -1064,7 +1220,7 @@ void
 BasicTransport::ServerRpc::sendReply()
 {
     t->sendBytes(clientAddress, rpcId, &replyPayload, 0, t->roundTripBytes,
-            FROM_SERVER);
+            FROM_SERVER, t->driver->getHighestPacketPriority());
     if (t->roundTripBytes >= replyPayload.size()) {
         // Note A: delete the ServerRpc object as soon as we have transmitted
         // the last byte. This has the disadvantage that if some of this data
@@ -1087,13 +1243,33 @@ BasicTransport::ServerRpc::sendReply()
  *      The complete message will be assembled here; caller should ensure
  *      that this is initially empty. The caller owns the storage for this
  *      and must ensure that it persists as long as this object persists.
+ * \param address
+ *      Network address of the message's sender, to which GRANTs are sent.
+ * \param rpcId
+ *      Unique identifier for the RPC the message belongs to.
+ * \param grantOffset
+ *      The grantOffset field of the ClientRpc or ServerRpc that owns this
+ *      object; updated as GRANTs are sent.
+ * \param roundTripBytes
+ *      Number of bytes that can be transmitted during the time it takes
+ *      for a round-trip latency.
+ * \param whoFrom
+ *      Must be either FROM_CLIENT, indicating that we are the client, or
+ *      FROM_SERVER, indicating that we are the server.
  */
 BasicTransport::MessageAccumulator::MessageAccumulator(BasicTransport* t,
-        Buffer* buffer)
+        Buffer* buffer, const Driver::Address* address, RpcId rpcId,
+        uint32_t* grantOffset, uint32_t roundTripBytes, uint8_t whoFrom)
     : t(t)
     , buffer(buffer)
     , fragments()
-    , grantOffset(0)
+    , address(address)
+    , rpcId(rpcId)
+    , whoFrom(whoFrom)
+    , roundTripBytes(roundTripBytes)
+    , grantOffset(grantOffset)
+    , totalLength(0)
+    , grantLinks()
 { }
 
 /**
@@ -1101,6 +1277,8 @@ BasicTransport::MessageAccumulator::MessageAccumulator(BasicTransport* t,
  */
 BasicTransport::MessageAccumulator::~MessageAccumulator()
 {
+    t->unscheduleMessage(this);
+
     // If there are any unassembled fragments, then we must release
     // them back to the driver.
     for (FragmentMap::iterator it = fragments.begin();
@@ -1299,6 +1477,14 @@ BasicTransport::Timer::handleTimerEvent()
         // we delete the ClientRpc below.
         it++;
 
+        if (clientRpc->accumulator &&
+                t->grantDeferred(clientRpc->accumulator.get())) {
+            // We're withholding GRANTs for the response in favor of
+            // shorter messages, so the server is expected to be silent.
+            clientRpc->silentIntervals = 0;
+            continue;
+        }
+
         assert(t->timeoutIntervals > 2*t->pingIntervals);
         if (clientRpc->silentIntervals >= t->timeoutIntervals) {
             // A long time has elapsed with no communication whatsoever
@@ -1309,6 +1495,7 @@ BasicTransport::Timer::handleTimerEvent()
                     clientRpc->session->serverAddress->toString().c_str(),
                     sequence);
             t->outgoingRpcs.erase(sequence);
+            t->driver->flushPackets();
             clientRpc->notifier->failed();
             t->clientRpcPool.destroy(clientRpc);
             recordIssue(&clientAbortCount);
@@ -1358,6 +1545,14 @@ BasicTransport::Timer::handleTimerEvent()
         // delete the ServerRpc below.
         it++;
 
+        if (!serverRpc->requestComplete &&
+                t->grantDeferred(serverRpc->accumulator.get())) {
+            // We're withholding GRANTs for the request in favor of
+            // shorter messages, so the client is expected to be silent.
+            serverRpc->silentIntervals = 0;
+            continue;
+        }
+
         // If a long time has elapsed with no communication whatsoever
         // from the client, then abort the RPC. Note: this code should
         // only be executed when we're waiting to transmit or receive
@@ -146,7 +146,10 @@ class BasicTransport : public Transport {
      */
     class MessageAccumulator {
       public:
-        MessageAccumulator(BasicTransport* t, Buffer* buffer);
+        MessageAccumulator(BasicTransport* t, Buffer* buffer,
+                const Driver::Address* address, RpcId rpcId,
+                uint32_t* grantOffset, uint32_t roundTripBytes,
+                uint8_t whoFrom);
         ~MessageAccumulator();
         void addPacket(Driver::Received* received, DataHeader *header);
         void appendFragment(char* payload, uint32_t offset, uint32_t length);
@@ -187,10 +190,30 @@ class BasicTransport : public Transport {
         typedef std::map<uint32_t, MessageFragment>FragmentMap;
         FragmentMap fragments;
 
-        /// Offset into the message of the most recent GRANT packet
-        /// we have sent (i.e., we've already authorized the sender to
-        /// transmit bytes up to this point in the message).
-        uint32_t grantOffset;
+        /// The following fields are used to issue GRANTs for the message:
+        /// where to send them, the RPC they refer to, and FROM_CLIENT or
+        /// FROM_SERVER to indicate which end we are.
+        const Driver::Address* address;
+        RpcId rpcId;
+        uint8_t whoFrom;
+
+        /// The sender may transmit this many bytes of the message without
+        /// waiting for GRANTs; see BasicTransport::roundTripBytes.
+        uint32_t roundTripBytes;
+
+        /// Points to the grantOffset field in the ClientRpc or ServerRpc
+        /// that owns this object: offset into the message of the most
+        /// recent GRANT packet we have sent (i.e., we've already authorized
+        /// the sender to transmit bytes up to this point in the message).
+        uint32_t* grantOffset;
+
+        /// Total length of the message; 0 until the message has been
+        /// passed to scheduleMessage.
+        uint32_t totalLength;
+
+        /// Used to link this object into t->grantList while the sender
+        /// is waiting for GRANTs.
+        IntrusiveListHook grantLinks;
 
       PRIVATE:
         DISALLOW_COPY_AND_ASSIGN(MessageAccumulator);
@@ -452,9 +475,13 @@ class BasicTransport : public Transport {
                                      // sender should now transmit all data up
                                      // to (but not including) this offset, if
                                      // it hasn't already.
+        uint8_t priority;            // Network priority the sender should use
+                                     // for the packets this GRANT authorizes.
 
-        GrantHeader(RpcId rpcId, uint32_t offset, uint8_t flags)
-            : common(PacketOpcode::GRANT, rpcId, flags), offset(offset) {}
+        GrantHeader(RpcId rpcId, uint32_t offset, uint8_t flags,
+                uint8_t priority = 0)
+            : common(PacketOpcode::GRANT, rpcId, flags), offset(offset),
+              priority(priority) {}
     } __attribute__((packed));
 
     /**
@@ -506,12 +533,18 @@ class BasicTransport : public Transport {
 
   PRIVATE:
     void deleteServerRpc(ServerRpc* serverRpc);
+    uint32_t getOvercommit(const ServiceLocator* locator);
     uint32_t getRoundTripBytes(const ServiceLocator* locator);
+    bool grantDeferred(MessageAccumulator* message);
     static string headerToString(const void* header, uint32_t headerLength);
+    void issueGrants();
     static string opcodeSymbol(uint8_t opcode);
     static void recordIssue(uint32_t* counter);
+    void scheduleMessage(MessageAccumulator* message, uint32_t totalLength);
     void sendBytes(const Driver::Address* address, RpcId rpcId,
-            Buffer* message, int offset, int length, uint8_t flags);
+            Buffer* message, int offset, int length, uint8_t flags,
+            int priority = 0);
+    void unscheduleMessage(MessageAccumulator* message);
 
     /// Shared RAMCloud information.
     Context* context;
@@ -575,6 +608,21 @@ class BasicTransport : public Transport {
     /// GRANTS, but it can result in additional buffering in the network.
     uint32_t grantIncrement;
 
+    /// Incoming multi-packet messages (requests and responses) whose
+    /// senders are waiting for GRANTs, sorted in increasing order of bytes
+    /// still to be received. GRANTs are only issued to the first
+    /// #overcommit messages in this list, so short messages complete
+    /// ahead of long ones (SRPT); the rest wait until they move up.
+    INTRUSIVE_LIST_TYPEDEF(MessageAccumulator, grantLinks) GrantList;
+    GrantList grantList;
+
+    /// The number of messages from the front of grantList that may have
+    /// outstanding GRANTs at once ("overcommit" service locator option).
+    /// Granting to more than one message keeps our downlink busy when a
+    /// sender is slow to respond, at the cost of sharing bandwidth
+    /// between them.
+    uint32_t overcommit;
+
     /// Used to implement functionality triggered by time, such as retries
     /// when packets are lost.
     Timer timer;
@@ -177,6 +177,19 @@ TEST_F(BasicTransportTest, getRoundTripBytes_roundUpToEvenPackets) {
     EXPECT_EQ(1200u, transport.getRoundTripBytes(&locator));
 }
 
+TEST_F(BasicTransportTest, getOvercommit) {
+    EXPECT_EQ(4u, transport.getOvercommit(NULL));
+    ServiceLocator locator("mock:overcommit=2");
+    EXPECT_EQ(2u, transport.getOvercommit(&locator));
+
+    ServiceLocator locator2("mock:overcommit=0");
+    TestLog::reset();
+    EXPECT_EQ(4u, transport.getOvercommit(&locator2));
+    EXPECT_EQ("getOvercommit: Bad BasicTransport overcommit option value "
+            "'0' (expected positive integer); ignoring option",
+            TestLog::get());
+}
+
 TEST_F(BasicTransportTest, logIssueStats) {
     BasicTransport::rcvdRetransmitCount = 1;
     BasicTransport::clientAbortCount = 4;
@@ -264,6 +277,182 @@ TEST_F(BasicTransportTest, sendBytes_needGrant) {
             "NEED_GRANT lmn",
             driver->outputLog);
 }
+TEST_F(BasicTransportTest, sendBytes_priority) {
+    transport.maxDataPerPacket = 10;
+    Buffer buffer;
+    buffer.append("abcdefghijklmno", 15);
+    transport.sendBytes(&address1, BasicTransport::RpcId(5, 6), &buffer,
+            0, 15, BasicTransport::FROM_CLIENT, 3);
+    EXPECT_EQ(
+            "priority 3: DATA FROM_CLIENT, rpcId 5.6, totalLength 15, "
+            "offset 0 abcdefghij | "
+            "priority 3: DATA FROM_CLIENT, rpcId 5.6, totalLength 15, "
+            "offset 10 klmno",
+            driver->outputLog);
+}
+
+TEST_F(BasicTransportTest, grantDeferred) {
+    transport.roundTripBytes = 10;
+    transport.grantIncrement = 5;
+    transport.overcommit = 1;
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 100,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 102), 30,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 103), 5,
+            0, BasicTransport::FROM_CLIENT), "ab");
+    BasicTransport::ServerRpc* rpc1 =
+            transport.incomingRpcs[BasicTransport::RpcId(100, 101)];
+    BasicTransport::ServerRpc* rpc2 =
+            transport.incomingRpcs[BasicTransport::RpcId(100, 102)];
+    BasicTransport::ServerRpc* rpc3 =
+            transport.incomingRpcs[BasicTransport::RpcId(100, 103)];
+    EXPECT_TRUE(transport.grantDeferred(rpc1->accumulator.get()));
+    EXPECT_FALSE(transport.grantDeferred(rpc2->accumulator.get()));
+    EXPECT_FALSE(transport.grantDeferred(rpc3->accumulator.get()));
+}
+
+TEST_F(BasicTransportTest, issueGrants_priorities) {
+    driver->highestPriority = 3;
+    transport.roundTripBytes = 10;
+    transport.grantIncrement = 5;
+    transport.overcommit = 2;
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 100,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 102), 30,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.101, offset 20, priority 2 | "
+            "GRANT FROM_SERVER, rpcId 100.102, offset 20, priority 2",
+            driver->outputLog);
+
+    // The longer message is now second, so it gets a lower priority.
+    driver->outputLog.clear();
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 100,
+            5, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "fghijklmno");
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.101, offset 30, priority 1",
+            driver->outputLog);
+}
+TEST_F(BasicTransportTest, issueGrants_removeFullyGranted) {
+    transport.roundTripBytes = 10;
+    transport.grantIncrement = 5;
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 100,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 102), 18,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.101, offset 20 | "
+            "GRANT FROM_SERVER, rpcId 100.102, offset 20",
+            driver->outputLog);
+    ASSERT_EQ(1u, transport.grantList.size());
+    EXPECT_EQ(100u, transport.grantList.front().totalLength);
+
+    // More data for a fully granted message doesn't put it back.
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 102), 18,
+            5, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "fghij");
+    EXPECT_EQ(1u, transport.grantList.size());
+}
+
+TEST_F(BasicTransportTest, scheduleMessage_shortestFirst) {
+    transport.roundTripBytes = 10;
+    transport.grantIncrement = 5;
+    transport.overcommit = 1;
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 100,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.101, offset 20",
+            driver->outputLog);
+
+    // A shorter message moves ahead of the first one.
+    driver->outputLog.clear();
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 102), 30,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.102, offset 20",
+            driver->outputLog);
+    ASSERT_EQ(2u, transport.grantList.size());
+    EXPECT_EQ(30u, transport.grantList.front().totalLength);
+
+    // The longer message gets no more GRANTs while the shorter one
+    // is in progress.
+    driver->outputLog.clear();
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 100,
+            5, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "fghijklmno");
+    EXPECT_EQ("", driver->outputLog);
+    EXPECT_EQ(30u, transport.grantList.front().totalLength);
+
+    // Once the shorter message completes, the longer one gets its GRANT.
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 102), 30,
+            5, BasicTransport::FROM_CLIENT), "fghijklmnopqrstuvwxyz0123");
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.101, offset 30",
+            driver->outputLog);
+    EXPECT_EQ(1u, transport.grantList.size());
+}
+TEST_F(BasicTransportTest, scheduleMessage_moveForward) {
+    transport.roundTripBytes = 10;
+    transport.grantIncrement = 5;
+    transport.overcommit = 1;
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 100,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 102), 90,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    EXPECT_EQ(90u, transport.grantList.front().totalLength);
+
+    // Data for the first message leaves it with fewer bytes remaining.
+    driver->outputLog.clear();
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 100,
+            5, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "fghijklmnopqrstuvwxy");
+    EXPECT_EQ(100u, transport.grantList.front().totalLength);
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.101, offset 40",
+            driver->outputLog);
+}
+TEST_F(BasicTransportTest, unscheduleMessage) {
+    transport.roundTripBytes = 10;
+    transport.grantIncrement = 5;
+    transport.overcommit = 1;
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 100,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcdefghijklmno");
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 102), 200,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcdefghijklmno");
+    driver->outputLog.clear();
+
+    // Deleting the first RPC lets the second one be granted.
+    transport.deleteServerRpc(
+            transport.incomingRpcs[BasicTransport::RpcId(100, 101)]);
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.102, offset 30",
+            driver->outputLog);
+    EXPECT_EQ(1u, transport.grantList.size());
+}
 
 TEST_F(BasicTransportTest, Session_constructor) {
     ServiceLocator locator("basic+udp: host=localhost, port=11101");
@@ -319,6 +508,7 @@ TEST_F(BasicTransportTest, Session_cancelRequest) {
     session->cancelRequest(&notifiers[2]);
     EXPECT_EQ(6u, transport.outgoingRpcs.size());
     EXPECT_EQ(6u, transport.clientRpcPool.outstandingObjects);
+    EXPECT_EQ(4u, driver->flushPacketsCount);
 }
 
 TEST_F(BasicTransportTest, Session_getRpcInfo) {
@@ -389,6 +579,7 @@ TEST_F(BasicTransportTest, handlePacket_allDataFromServer_basics) {
     EXPECT_EQ("response1", TestUtil::toString(&wrapper.response));
     EXPECT_EQ(0lu, transport.outgoingRpcs.size());
     EXPECT_EQ(1u, driver->stealCount);
+    EXPECT_EQ(1u, driver->flushPacketsCount);
 }
 TEST_F(BasicTransportTest, handlePacket_allDataFromServer_tooShort) {
     MockWrapper wrapper("message1");
@@ -534,6 +725,20 @@ TEST_F(BasicTransportTest, handlePacket_grantFromServer) {
             driver->outputLog);
     EXPECT_EQ(15lu, transport.outgoingRpcs[1]->transmitOffset);
 }
+TEST_F(BasicTransportTest, handlePacket_grantFromServer_priority) {
+    MockWrapper wrapper("abcdefghij0123456789");
+    driver->highestPriority = 4;
+    session->roundTripBytes = 10;
+    session->sendRequest(&wrapper.request, &wrapper.response, &wrapper);
+    EXPECT_EQ("priority 4: DATA FROM_CLIENT, rpcId 666.1, totalLength 20, "
+            "offset 0, NEED_GRANT abcdefghij", driver->outputLog);
+    driver->outputLog.clear();
+    driver->receivePacket("mock:server=1",
+            BasicTransport::GrantHeader(BasicTransport::RpcId(666, 1), 15,
+            BasicTransport::FROM_SERVER, 2));
+    EXPECT_EQ("priority 2: DATA FROM_CLIENT, rpcId 666.1, totalLength 20, "
+            "offset 10, NEED_GRANT 01234", driver->outputLog);
+}
 TEST_F(BasicTransportTest, handlePacket_logTimeTraceFromServer) {
     MockWrapper wrapper("message1");
     session->sendRequest(&wrapper.request, &wrapper.response, &wrapper);
@@ -919,6 +1124,7 @@ TEST_F(BasicTransportTest, sendReply_sendEntireMessage) {
     EXPECT_EQ("ALL_DATA FROM_SERVER, rpcId 100.101 0123456789 (+10 more)",
             driver->outputLog);
     EXPECT_EQ("deleteServerRpc: RpcId (100, 101)", TestLog::get());
+    EXPECT_EQ(1u, driver->flushPacketsCount);
 }
 TEST_F(BasicTransportTest, sendReply_sendPartialMessage) {
     BasicTransport::ServerRpc* serverRpc = prepareToRespond();
@@ -948,6 +1154,9 @@ TEST_F(BasicTransportTest, MessageAccumulator_destructor) {
     EXPECT_EQ(0u, driver->releaseCount);
     transport.deleteServerRpc(serverRpc);
     EXPECT_EQ(3u, driver->releaseCount);
+
+    // Nothing was transmitted for this RPC, so there's no need to flush.
+    EXPECT_EQ(0u, driver->flushPacketsCount);
 }
 
 TEST_F(BasicTransportTest, addPacket_basics) {
@@ -1174,6 +1383,35 @@ TEST_F(BasicTransportTest, handleTimerEvent_sendResendFromClient) {
     EXPECT_EQ("RESEND FROM_CLIENT, rpcId 666.1, offset 8, length 147",
             driver->outputLog);
 }
+TEST_F(BasicTransportTest, handleTimerEvent_grantDeferred) {
+    transport.roundTripBytes = 10;
+    transport.grantIncrement = 5;
+    transport.overcommit = 1;
+    transport.timeoutIntervals = 3;
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 102), 50,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcdefghijklmno");
+    driver->receivePacket("mock:client=1",
+            BasicTransport::DataHeader(BasicTransport::RpcId(100, 101), 100,
+            0, BasicTransport::NEED_GRANT|BasicTransport::FROM_CLIENT),
+            "abcde");
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.102, offset 30",
+            driver->outputLog);
+    driver->outputLog.clear();
+
+    // Only the message we granted gets RESENDs and eventually times out.
+    transport.timer.handleTimerEvent();
+    transport.timer.handleTimerEvent();
+    EXPECT_EQ("RESEND FROM_SERVER, rpcId 100.102, offset 15, length 15",
+            driver->outputLog);
+    driver->outputLog.clear();
+    transport.timer.handleTimerEvent();
+    EXPECT_EQ("GRANT FROM_SERVER, rpcId 100.101, offset 20",
+            driver->outputLog);
+    EXPECT_EQ(1u, transport.incomingRpcs.size());
+    EXPECT_EQ(1u, BasicTransport::serverAbortCount);
+}
 TEST_F(BasicTransportTest, handleTimerEvent_serverAbortsRequest) {
     transport.timeoutIntervals = 2;
     driver->receivePacket("mock:client=1",
@@ -0,0 +1,362 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "BatchingSession.h"
+#include "Logger.h"
+#include "ShortMacros.h"
+#include "Status.h"
+#include "WireFormat.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a BatchingSession.
+ *
+ * \param flusher
+ *      Sends the requests held by this session on each pass through the
+ *      dispatch loop.
+ * \param wrapped
+ *      Another Session object; BATCH requests, and requests that can't be
+ *      batched, are sent using this session.
+ */
+BatchingSession::BatchingSession(Flusher* flusher,
+        Transport::SessionRef wrapped)
+    : flusher(flusher)
+    , wrapped(wrapped)
+    , held()
+    , batches()
+    , batchingDisabled(false)
+    , flushLinks()
+{
+    setServiceLocator(wrapped->getServiceLocator());
+}
+
+/**
+ * Destructor for BatchingSessions.
+ */
+BatchingSession::~BatchingSession()
+{
+    if (flushLinks.is_linked()) {
+        flusher->sessions.erase(flusher->sessions.iterator_to(*this));
+    }
+    foreach (Batch* batch, batches) {
+        if (!batch->finished) {
+            wrapped->cancelRequest(batch);
+        }
+        delete batch;
+    }
+}
+
+/// \copydoc Transport::Session::abort
+void
+BatchingSession::abort()
+{
+    // Held requests never reached the wrapped session, so it can't fail
+    // them for us.
+    std::vector<Request> failed;
+    failed.swap(held);
+    if (flushLinks.is_linked()) {
+        flusher->sessions.erase(flusher->sessions.iterator_to(*this));
+    }
+    foreach (Request& request, failed) {
+        request.notifier->failed();
+    }
+    wrapped->abort();
+}
+
+/// \copydoc Transport::Session::cancelRequest
+void
+BatchingSession::cancelRequest(Transport::RpcNotifier* notifier)
+{
+    for (std::vector<Request>::iterator it = held.begin();
+            it != held.end(); it++) {
+        if (it->notifier == notifier) {
+            held.erase(it);
+            if (held.empty() && flushLinks.is_linked()) {
+                flusher->sessions.erase(flusher->sessions.iterator_to(*this));
+            }
+            return;
+        }
+    }
+    foreach (Batch* batch, batches) {
+        if (batch->finished) {
+            continue;
+        }
+        bool found = false;
+        bool live = false;
+        foreach (Request& request, batch->requests) {
+            if (request.notifier == notifier) {
+                request.notifier = NULL;
+                found = true;
+            } else if (request.notifier != NULL) {
+                live = true;
+            }
+        }
+        if (found) {
+            // If other requests in the batch are still wanted, let it
+            // finish and discard this request's response when it arrives.
+            if (!live) {
+                wrapped->cancelRequest(batch);
+                batch->finished = true;
+            }
+            return;
+        }
+    }
+    wrapped->cancelRequest(notifier);
+}
+
+/// \copydoc Transport::Session::getRpcInfo
+string
+BatchingSession::getRpcInfo()
+{
+    return wrapped->getRpcInfo();
+}
+
+/// \copydoc Transport::Session::sendRequest
+void
+BatchingSession::sendRequest(Buffer* request, Buffer* response,
+        Transport::RpcNotifier* notifier)
+{
+    if (batchingDisabled || !isBatchable(request)) {
+        wrapped->sendRequest(request, response, notifier);
+        return;
+    }
+    held.emplace_back(request, response, notifier);
+    if (held.size() >= WireFormat::Batch::MAX_REQUESTS) {
+        flush();
+    } else if (!flushLinks.is_linked()) {
+        flusher->sessions.push_back(*this);
+    }
+}
+
+/**
+ * Send all of the requests held by this session: as a single BATCH
+ * request if there are several of them, otherwise on its own. Also
+ * deletes any BATCH requests that have finished.
+ */
+void
+BatchingSession::flush()
+{
+    if (flushLinks.is_linked()) {
+        flusher->sessions.erase(flusher->sessions.iterator_to(*this));
+    }
+    for (std::list<Batch*>::iterator it = batches.begin();
+            it != batches.end(); ) {
+        if ((*it)->finished) {
+            delete *it;
+            it = batches.erase(it);
+        } else {
+            it++;
+        }
+    }
+
+    if (held.size() == 1) {
+        Request request = held.front();
+        held.clear();
+        wrapped->sendRequest(request.request, request.response,
+                request.notifier);
+        return;
+    }
+    if (held.empty()) {
+        return;
+    }
+
+    Batch* batch = new Batch(this);
+    batch->requests.swap(held);
+    WireFormat::Batch::Request* header =
+            batch->request.emplaceAppend<WireFormat::Batch::Request>();
+    header->common.opcode = WireFormat::Batch::opcode;
+    header->common.service = WireFormat::Batch::service;
+    header->count = downCast<uint32_t>(batch->requests.size());
+    foreach (Request& request, batch->requests) {
+        uint32_t length = request.request->size();
+        batch->request.emplaceAppend<uint32_t>(length);
+        request.request->copy(0, length, batch->request.alloc(length));
+    }
+
+    // The batch must be on the list before it's sent: some transports
+    // complete requests before sendRequest returns.
+    batches.push_back(batch);
+    wrapped->sendRequest(&batch->request, &batch->response, batch);
+}
+
+/**
+ * Returns true if the given request should be batched. Requests must be
+ * short, and they must not modify any state on the server: a response that
+ * doesn't fit in a BATCH response comes back as WireFormat::Batch::RESEND,
+ * in which case the request is executed a second time on its own.
+ *
+ * \param request
+ *      Request that is about to be sent.
+ */
+bool
+BatchingSession::isBatchable(Buffer* request)
+{
+    if (request->size() > MAX_BATCHED_REQUEST) {
+        return false;
+    }
+    const WireFormat::RequestCommon* header =
+            request->getStart<WireFormat::RequestCommon>();
+    if (header == NULL) {
+        return false;
+    }
+    switch (header->opcode) {
+        case WireFormat::READ:
+        case WireFormat::READ_HASHES:
+        case WireFormat::READ_KEYS_AND_VALUE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Construct a Batch.
+ *
+ * \param session
+ *      The session that is sending this batch.
+ */
+BatchingSession::Batch::Batch(BatchingSession* session)
+    : session(session)
+    , requests()
+    , request()
+    , response()
+    , finished(false)
+{
+}
+
+/**
+ * Invoked by the wrapped session when a BATCH response has arrived: hands
+ * each of the responses in it to the RPC it belongs to.
+ */
+void
+BatchingSession::Batch::completed()
+{
+    finished = true;
+    const WireFormat::ResponseCommon* common =
+            response.getStart<WireFormat::ResponseCommon>();
+    const WireFormat::Batch::Response* header =
+            response.getStart<WireFormat::Batch::Response>();
+    if ((header == NULL) || (header->common.status != STATUS_OK)) {
+        // Most likely the server predates BATCH requests (it will have
+        // returned STATUS_UNIMPLEMENTED_REQUEST). Either way, none of the
+        // requests have been executed, so send them again one at a time.
+        Status status = STATUS_RESPONSE_FORMAT_ERROR;
+        if ((common != NULL) && (common->status != STATUS_OK)) {
+            status = common->status;
+        }
+        if (!session->batchingDisabled) {
+            LOG(NOTICE, "BATCH request to %s failed (%s); "
+                    "no longer batching requests for this session",
+                    session->getServiceLocator().c_str(),
+                    statusToString(status));
+            session->batchingDisabled = true;
+        }
+        foreach (Request& request, requests) {
+            if (request.notifier != NULL) {
+                session->wrapped->sendRequest(request.request,
+                        request.response, request.notifier);
+            }
+        }
+        return;
+    }
+
+    uint32_t offset = sizeof(*header);
+    uint32_t count = header->count;
+    for (uint32_t i = 0; i < requests.size(); i++) {
+        Request& request = requests[i];
+        const uint32_t* length = response.getOffset<uint32_t>(offset);
+        if ((i >= count) || (length == NULL) || ((*length !=
+                WireFormat::Batch::RESEND) && (*length >
+                response.size() - offset - sizeof(*length)))) {
+            LOG(WARNING, "BATCH response from %s is malformed: no "
+                    "response for request %u",
+                    session->getServiceLocator().c_str(), i);
+            for (; i < requests.size(); i++) {
+                if (requests[i].notifier != NULL) {
+                    requests[i].notifier->failed();
+                }
+            }
+            return;
+        }
+        offset += downCast<uint32_t>(sizeof(*length));
+        if (*length == WireFormat::Batch::RESEND) {
+            if (request.notifier != NULL) {
+                session->wrapped->sendRequest(request.request,
+                        request.response, request.notifier);
+            }
+            continue;
+        }
+        if (request.notifier != NULL) {
+            request.response->reset();
+            response.copy(offset, *length,
+                    request.response->alloc(*length));
+            request.notifier->completed();
+        }
+        offset += *length;
+    }
+}
+
+/**
+ * Invoked by the wrapped session if the BATCH RPC fails: fails all of the
+ * requests in the batch.
+ */
+void
+BatchingSession::Batch::failed()
+{
+    finished = true;
+    foreach (Request& request, requests) {
+        if (request.notifier != NULL) {
+            request.notifier->failed();
+        }
+    }
+}
+
+/**
+ * Construct a Flusher.
+ *
+ * \param dispatch
+ *      Dispatch object whose polling loop will flush requests.
+ */
+BatchingSession::Flusher::Flusher(Dispatch* dispatch)
+    : Dispatch::Poller(dispatch, "BatchingSession::Flusher")
+    , sessions()
+{
+}
+
+/**
+ * Destructor for Flushers.
+ */
+BatchingSession::Flusher::~Flusher()
+{
+    sessions.clear();
+}
+
+/**
+ * Invoked by the dispatcher on each pass through its polling loop; sends
+ * the requests held by all BatchingSessions.
+ */
+int
+BatchingSession::Flusher::poll()
+{
+    int result = 0;
+    while (!sessions.empty()) {
+        sessions.front().flush();
+        result = 1;
+    }
+    return result;
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,164 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_BATCHINGSESSION_H
+#define RAMCLOUD_BATCHINGSESSION_H
+
+#include <list>
+
+#include "BoostIntrusive.h"
+#include "Dispatch.h"
+#include "Transport.h"
+
+namespace RAMCloud {
+
+/**
+ * A BatchingSession wraps a Transport::Session and combines small requests
+ * sent to it into BATCH requests (see WireFormat::Batch), so that a client
+ * issuing many small RPCs to the same server at once pays the per-message
+ * costs (on both machines) once rather than once per RPC. Requests are
+ * held until the dispatcher next polls, then all of the requests held at
+ * that point are sent together; a request held on its own is sent as is.
+ * The server's responses are split up again and delivered to the
+ * individual RPCs, so batching is invisible to callers.
+ *
+ * Only requests that are short and read-only (see #isBatchable) are
+ * batched; all other requests are passed straight through to the wrapped
+ * session. If the server doesn't understand BATCH requests, the held
+ * requests are sent again one at a time and batching is turned off for
+ * this session.
+ *
+ * Like the Session objects of transports, BatchingSessions may only be used
+ * in the dispatch thread or while holding a Dispatch::Lock.
+ */
+class BatchingSession : public Transport::Session {
+  public:
+    class Flusher;
+
+    explicit BatchingSession(Flusher* flusher, Transport::SessionRef wrapped);
+    ~BatchingSession();
+    void abort();
+    void cancelRequest(Transport::RpcNotifier* notifier);
+    string getRpcInfo();
+    void sendRequest(Buffer* request, Buffer* response,
+            Transport::RpcNotifier* notifier);
+
+    /// Requests longer than this (in bytes) are never batched.
+    static const uint32_t MAX_BATCHED_REQUEST = 1000;
+
+  PRIVATE:
+    /**
+     * Holds the arguments from one call to #sendRequest.
+     */
+    struct Request {
+        Request(Buffer* request, Buffer* response,
+                Transport::RpcNotifier* notifier)
+            : request(request)
+            , response(response)
+            , notifier(notifier)
+        {}
+
+        Buffer* request;
+        Buffer* response;
+
+        /// NULL means the request has been cancelled.
+        Transport::RpcNotifier* notifier;
+    };
+
+    /**
+     * One BATCH request sent to the wrapped session. A Batch serves as
+     * the notifier for the BATCH RPC; it isn't deleted until the next
+     * call to #flush after the RPC completes, since the transport may
+     * still refer to it while it delivers the response.
+     */
+    class Batch : public Transport::RpcNotifier {
+      public:
+        explicit Batch(BatchingSession* session);
+        void completed();
+        void failed();
+
+        /// The session that sent this batch.
+        BatchingSession* session;
+
+        /// The requests in this batch, in the order they appear in
+        /// #request.
+        std::vector<Request> requests;
+
+        /// The BATCH request; contains copies of all of #requests, so the
+        /// callers may reuse their buffers as soon as they cancel.
+        Buffer request;
+
+        /// The BATCH response is received here.
+        Buffer response;
+
+        /// True means this BATCH RPC has completed, failed, or been
+        /// cancelled.
+        bool finished;
+
+      PRIVATE:
+        DISALLOW_COPY_AND_ASSIGN(Batch);
+    };
+
+    void flush();
+    static bool isBatchable(Buffer* request);
+
+    /// Sends the requests held by this session.
+    Flusher* flusher;
+
+    /// Requests are passed on to this session.
+    Transport::SessionRef wrapped;
+
+    /// Requests that haven't yet been sent, in the order they arrived.
+    std::vector<Request> held;
+
+    /// BATCH requests sent by this session that haven't been deleted yet.
+    std::list<Batch*> batches;
+
+    /// True means the server doesn't implement BATCH requests, so all
+    /// requests are passed straight to the wrapped session.
+    bool batchingDisabled;
+
+    /// Used to link this session into Flusher::sessions while it holds
+    /// requests.
+    IntrusiveListHook flushLinks;
+
+    DISALLOW_COPY_AND_ASSIGN(BatchingSession);
+};
+
+/**
+ * A Flusher sends the requests held by BatchingSessions on each pass
+ * through the dispatch loop. A single Flusher serves all of the
+ * BatchingSessions created by a TransportManager, so that the cost of
+ * polling doesn't grow with the number of sessions.
+ */
+class BatchingSession::Flusher : public Dispatch::Poller {
+  public:
+    explicit Flusher(Dispatch* dispatch);
+    ~Flusher();
+    int poll();
+
+  PRIVATE:
+    INTRUSIVE_LIST_TYPEDEF(BatchingSession, flushLinks) SessionList;
+
+    /// BatchingSessions that are holding requests.
+    SessionList sessions;
+
+    friend class BatchingSession;
+    DISALLOW_COPY_AND_ASSIGN(Flusher);
+};
+
+}  // namespace RAMCloud
+
+#endif  // RAMCLOUD_BATCHINGSESSION_H
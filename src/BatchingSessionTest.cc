@@ -0,0 +1,277 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "BatchingSession.h"
+#include "MockTransport.h"
+#include "MockWrapper.h"
+
+namespace RAMCloud {
+
+class BatchingSessionTest : public ::testing::Test {
+  public:
+    Context context;
+    MockTransport transport;
+    BatchingSession::Flusher flusher;
+    Transport::SessionRef sessionRef;
+    BatchingSession* session;
+    MockWrapper rpc1;
+    MockWrapper rpc2;
+    MockWrapper rpc3;
+
+    BatchingSessionTest()
+        : context()
+        , transport(&context)
+        , flusher(context.dispatch)
+        , sessionRef()
+        , session(NULL)
+        , rpc1()
+        , rpc2()
+        , rpc3()
+    {
+        session = new BatchingSession(&flusher, transport.getSession());
+        sessionRef = session;
+        fillRequest(&rpc1, WireFormat::READ, "a");
+        fillRequest(&rpc2, WireFormat::READ, "b");
+        fillRequest(&rpc3, WireFormat::READ, "c");
+    }
+
+    void
+    fillRequest(MockWrapper* rpc, WireFormat::Opcode opcode,
+            const char* contents)
+    {
+        rpc->request.reset();
+        WireFormat::RequestCommon* header =
+                rpc->request.emplaceAppend<WireFormat::RequestCommon>();
+        header->opcode = opcode;
+        header->service = WireFormat::MASTER_SERVICE;
+        rpc->request.appendCopy(contents,
+                downCast<uint32_t>(strlen(contents)));
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(BatchingSessionTest);
+};
+
+TEST_F(BatchingSessionTest, destructor) {
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    session->sendRequest(&rpc2.request, &rpc2.response, &rpc2);
+    flusher.poll();
+    session->sendRequest(&rpc3.request, &rpc3.response, &rpc3);
+    session->cancelRequest(&rpc3);
+    transport.outputLog.clear();
+    sessionRef = NULL;
+    EXPECT_EQ("cancel: ", transport.outputLog);
+    EXPECT_TRUE(flusher.sessions.empty());
+}
+
+TEST_F(BatchingSessionTest, abort) {
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    session->abort();
+    EXPECT_STREQ("completed: 0, failed: 1", rpc1.getState());
+    EXPECT_EQ("abort: ", transport.outputLog);
+    EXPECT_TRUE(flusher.sessions.empty());
+}
+
+TEST_F(BatchingSessionTest, cancelRequest_held) {
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    session->sendRequest(&rpc2.request, &rpc2.response, &rpc2);
+    session->cancelRequest(&rpc1);
+    EXPECT_EQ(1U, session->held.size());
+    EXPECT_FALSE(flusher.sessions.empty());
+    session->cancelRequest(&rpc2);
+    EXPECT_TRUE(flusher.sessions.empty());
+    flusher.poll();
+    EXPECT_EQ("", transport.outputLog);
+}
+
+TEST_F(BatchingSessionTest, cancelRequest_inBatch) {
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    session->sendRequest(&rpc2.request, &rpc2.response, &rpc2);
+    flusher.poll();
+    transport.outputLog.clear();
+
+    // The rest of the batch is still needed.
+    session->cancelRequest(&rpc1);
+    EXPECT_EQ("", transport.outputLog);
+    EXPECT_FALSE(session->batches.front()->finished);
+
+    // Nothing in the batch is needed any more.
+    session->cancelRequest(&rpc2);
+    EXPECT_EQ("cancel: ", transport.outputLog);
+    EXPECT_TRUE(session->batches.front()->finished);
+}
+
+TEST_F(BatchingSessionTest, cancelRequest_notBatched) {
+    fillRequest(&rpc1, WireFormat::WRITE, "a");
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    transport.outputLog.clear();
+    session->cancelRequest(&rpc1);
+    EXPECT_EQ("cancel: ", transport.outputLog);
+}
+
+TEST_F(BatchingSessionTest, sendRequest_notBatchable) {
+    fillRequest(&rpc1, WireFormat::WRITE, "a");
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    EXPECT_EQ("sendRequest: 14 a", transport.outputLog);
+    EXPECT_TRUE(flusher.sessions.empty());
+}
+
+TEST_F(BatchingSessionTest, sendRequest_batchingDisabled) {
+    session->batchingDisabled = true;
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    EXPECT_EQ("sendRequest: 13 a", transport.outputLog);
+}
+
+TEST_F(BatchingSessionTest, sendRequest_held) {
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    session->sendRequest(&rpc2.request, &rpc2.response, &rpc2);
+    EXPECT_EQ("", transport.outputLog);
+    EXPECT_EQ(2U, session->held.size());
+    EXPECT_EQ(1U, flusher.sessions.size());
+}
+
+TEST_F(BatchingSessionTest, sendRequest_batchFull) {
+    MockWrapper rpcs[WireFormat::Batch::MAX_REQUESTS];
+    for (uint32_t i = 0; i < WireFormat::Batch::MAX_REQUESTS; i++) {
+        fillRequest(&rpcs[i], WireFormat::READ, "x");
+        session->sendRequest(&rpcs[i].request, &rpcs[i].response,
+                &rpcs[i]);
+    }
+    EXPECT_EQ(1U, transport.output.size());
+    EXPECT_TRUE(flusher.sessions.empty());
+    EXPECT_EQ(0U, session->held.size());
+}
+
+TEST_F(BatchingSessionTest, flush_singleRequest) {
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    flusher.poll();
+    EXPECT_EQ("sendRequest: 13 a", transport.outputLog);
+    EXPECT_TRUE(flusher.sessions.empty());
+    EXPECT_EQ(0U, session->batches.size());
+}
+
+TEST_F(BatchingSessionTest, flush_batch) {
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    session->sendRequest(&rpc2.request, &rpc2.response, &rpc2);
+    EXPECT_EQ(1, flusher.poll());
+    EXPECT_EQ("sendRequest: 0x30050 2 5 13 1377 3328 /0 b",
+            transport.outputLog);
+    EXPECT_EQ(1U, session->batches.size());
+    EXPECT_EQ(0, flusher.poll());
+}
+
+TEST_F(BatchingSessionTest, flush_deleteFinishedBatches) {
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    session->sendRequest(&rpc2.request, &rpc2.response, &rpc2);
+    flusher.poll();
+    transport.lastNotifier->failed();
+    session->sendRequest(&rpc3.request, &rpc3.response, &rpc3);
+    flusher.poll();
+    EXPECT_EQ(0U, session->batches.size());
+}
+
+TEST_F(BatchingSessionTest, isBatchable) {
+    EXPECT_TRUE(BatchingSession::isBatchable(&rpc1.request));
+    fillRequest(&rpc1, WireFormat::READ_KEYS_AND_VALUE, "a");
+    EXPECT_TRUE(BatchingSession::isBatchable(&rpc1.request));
+    fillRequest(&rpc1, WireFormat::REMOVE, "a");
+    EXPECT_FALSE(BatchingSession::isBatchable(&rpc1.request));
+    string big(BatchingSession::MAX_BATCHED_REQUEST, 'x');
+    fillRequest(&rpc1, WireFormat::READ, big.c_str());
+    EXPECT_FALSE(BatchingSession::isBatchable(&rpc1.request));
+    rpc1.request.reset();
+    rpc1.request.appendCopy("a", 1);
+    EXPECT_FALSE(BatchingSession::isBatchable(&rpc1.request));
+}
+
+TEST_F(BatchingSessionTest, completed_basics) {
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    session->sendRequest(&rpc2.request, &rpc2.response, &rpc2);
+    transport.setInput("0 2 4 abc 3 de");
+    flusher.poll();
+    EXPECT_STREQ("completed: 1, failed: 0", rpc1.getState());
+    EXPECT_EQ("abc/0", TestUtil::toString(&rpc1.response));
+    EXPECT_STREQ("completed: 1, failed: 0", rpc2.getState());
+    EXPECT_EQ("de/0", TestUtil::toString(&rpc2.response));
+    EXPECT_TRUE(session->batches.front()->finished);
+}
+
+TEST_F(BatchingSessionTest, completed_cancelledRequest) {
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    session->sendRequest(&rpc2.request, &rpc2.response, &rpc2);
+    flusher.poll();
+    session->cancelRequest(&rpc1);
+    Buffer* response = &session->batches.front()->response;
+    response->fillFromString("0 2 4 abc 3 de");
+    transport.lastNotifier->completed();
+    EXPECT_STREQ("completed: 0, failed: 0", rpc1.getState());
+    EXPECT_EQ(0U, rpc1.response.size());
+    EXPECT_STREQ("completed: 1, failed: 0", rpc2.getState());
+    EXPECT_EQ("de/0", TestUtil::toString(&rpc2.response));
+}
+
+TEST_F(BatchingSessionTest, completed_errorStatus) {
+    TestLog::Enable _;
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    session->sendRequest(&rpc2.request, &rpc2.response, &rpc2);
+    transport.setInput("8");
+    flusher.poll();
+    EXPECT_EQ("completed: BATCH request to test: failed "
+            "(invalid RPC request type); no longer batching requests for "
+            "this session", TestLog::get());
+    EXPECT_TRUE(session->batchingDisabled);
+    EXPECT_EQ("sendRequest: 0x30050 2 5 13 1377 3328 /0 b | "
+            "sendRequest: 13 a | sendRequest: 13 b",
+            transport.outputLog);
+    EXPECT_STREQ("completed: 0, failed: 0", rpc1.getState());
+}
+
+TEST_F(BatchingSessionTest, completed_resend) {
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    session->sendRequest(&rpc2.request, &rpc2.response, &rpc2);
+    transport.setInput("0 2 -1 3 de");
+    flusher.poll();
+    EXPECT_EQ("sendRequest: 0x30050 2 5 13 1377 3328 /0 b | "
+            "sendRequest: 13 a", transport.outputLog);
+    EXPECT_STREQ("completed: 0, failed: 0", rpc1.getState());
+    EXPECT_STREQ("completed: 1, failed: 0", rpc2.getState());
+}
+
+TEST_F(BatchingSessionTest, completed_malformed) {
+    TestLog::Enable _;
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    session->sendRequest(&rpc2.request, &rpc2.response, &rpc2);
+    session->sendRequest(&rpc3.request, &rpc3.response, &rpc3);
+    transport.setInput("0 3 4 abc 10 de");
+    flusher.poll();
+    EXPECT_EQ("completed: BATCH response from test: is malformed: no "
+            "response for request 1", TestLog::get());
+    EXPECT_STREQ("completed: 1, failed: 0", rpc1.getState());
+    EXPECT_STREQ("completed: 0, failed: 1", rpc2.getState());
+    EXPECT_STREQ("completed: 0, failed: 1", rpc3.getState());
+}
+
+TEST_F(BatchingSessionTest, failed) {
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    session->sendRequest(&rpc2.request, &rpc2.response, &rpc2);
+    flusher.poll();
+    session->cancelRequest(&rpc1);
+    transport.lastNotifier->failed();
+    EXPECT_STREQ("completed: 0, failed: 0", rpc1.getState());
+    EXPECT_STREQ("completed: 0, failed: 1", rpc2.getState());
+    EXPECT_TRUE(session->batches.front()->finished);
+}
+
+}  // namespace RAMCloud
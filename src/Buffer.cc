@@ -13,14 +13,88 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <sys/uio.h>
+
 #include "Buffer.h"
 #include "Memory.h"
+#include "PerfStats.h"
+#include "SpinLock.h"
 #include "Syscall.h"
 
 namespace RAMCloud {
 
 uint32_t Buffer::allocationLogThreshold = 4000;
 
+/**
+ * The blocks of memory used for Buffer allocations (see getNewAllocation)
+ * come in a few fixed sizes ("slab classes"): MIN_SLAB_SIZE bytes and
+ * successive powers of two up to MIN_SLAB_SIZE << (NUM_SLAB_CLASSES-1).
+ * When a Buffer is freed its blocks are kept on free lists for reuse by
+ * later Buffers, so that a server handling a steady stream of RPCs doesn't
+ * call malloc and free for each of them. Larger blocks are always obtained
+ * from malloc.
+ */
+static const uint32_t MIN_SLAB_SIZE = 2048;
+static const int NUM_SLAB_CLASSES = 6;
+
+/**
+ * Each thread keeps up to this many free blocks of each slab class; beyond
+ * that, blocks are returned to sharedSlabs in groups of this size. This
+ * matters because Buffers are often filled in one thread and freed in
+ * another (e.g. a reply is built by a worker and freed by the dispatch
+ * thread once it has been transmitted).
+ */
+static const uint32_t THREAD_SLAB_LIMIT = 8;
+
+/**
+ * Maximum number of free blocks of each slab class in sharedSlabs; beyond
+ * that, blocks are returned to the system.
+ */
+static const uint32_t SHARED_SLAB_LIMIT = 256;
+
+/**
+ * A list of free blocks of the same slab class, linked through their
+ * first word.
+ */
+struct SlabList {
+    void* head;
+    uint32_t count;
+};
+
+/**
+ * Free blocks cached by the current thread; accessed without locking.
+ * Blocks cached by a thread when it exits are not reclaimed.
+ */
+static __thread SlabList threadSlabs[NUM_SLAB_CLASSES];
+
+/**
+ * Free blocks available to all threads; protected by sharedSlabsMutex.
+ */
+static SlabList sharedSlabs[NUM_SLAB_CLASSES];
+static SpinLock sharedSlabsMutex("Buffer::sharedSlabs");
+
+/**
+ * Return the slab class for a block of the given size, or -1 if blocks of
+ * that size are not pooled.
+ *
+ * \param length
+ *      Size of the block, in bytes; on return the size is rounded up to
+ *      the size of the slab class.
+ */
+static int
+getSlabClass(uint32_t* length)
+{
+    uint32_t slabSize = MIN_SLAB_SIZE;
+    for (int slabClass = 0; slabClass < NUM_SLAB_CLASSES; slabClass++) {
+        if (*length <= slabSize) {
+            *length = slabSize;
+            return slabClass;
+        }
+        slabSize <<= 1;
+    }
+    return -1;
+}
+
 /**
  * Default object used to make system calls.
  */
@@ -472,8 +546,36 @@ Buffer::getNewAllocation(uint32_t bytesNeeded, uint32_t* bytesAllocated)
     // allocated for the buffer.
     bytesNeeded += sizeof32(internalAllocation) + totalAllocatedBytes;
     bytesNeeded = (bytesNeeded+7) & ~0x7;
-    char* newAllocation = static_cast<char*>(Memory::xmalloc(HERE,
-            bytesNeeded));
+    char* newAllocation = NULL;
+    int slabClass = getSlabClass(&bytesNeeded);
+    if (slabClass >= 0) {
+        SlabList* list = &threadSlabs[slabClass];
+        if (list->head == NULL) {
+            // Refill this thread's list from the shared one.
+            SpinLock::Guard _(sharedSlabsMutex);
+            SlabList* shared = &sharedSlabs[slabClass];
+            while ((shared->head != NULL)
+                    && (list->count < THREAD_SLAB_LIMIT)) {
+                void* block = shared->head;
+                shared->head = *static_cast<void**>(block);
+                shared->count--;
+                *static_cast<void**>(block) = list->head;
+                list->head = block;
+                list->count++;
+            }
+        }
+        if (list->head != NULL) {
+            newAllocation = static_cast<char*>(list->head);
+            list->head = *static_cast<void**>(list->head);
+            list->count--;
+            PerfStats::threadStats.bufferSlabHits++;
+        }
+    }
+    if (newAllocation == NULL) {
+        newAllocation = static_cast<char*>(Memory::xmalloc(HERE,
+                bytesNeeded));
+        PerfStats::threadStats.bufferSlabMisses++;
+    }
     totalAllocatedBytes += bytesNeeded;
     if (totalAllocatedBytes >= Buffer::allocationLogThreshold) {
         RAMCLOUD_LOG(NOTICE, "buffer has consumed %u bytes of extra storage, "
@@ -484,11 +586,51 @@ Buffer::getNewAllocation(uint32_t bytesNeeded, uint32_t* bytesAllocated)
     if (!allocations) {
         allocations.construct();
     }
-    allocations->push_back(newAllocation);
+    allocations->emplace_back(newAllocation, bytesNeeded);
     *bytesAllocated = bytesNeeded;
     return newAllocation;
 }
 
+/**
+ * Release a block of memory created by getNewAllocation: it is kept for
+ * reuse by future Buffers if possible, otherwise returned to the system.
+ *
+ * \param allocation
+ *      The block to release.
+ */
+void
+Buffer::freeAllocation(const Allocation& allocation)
+{
+    uint32_t length = allocation.length;
+    int slabClass = getSlabClass(&length);
+    if ((slabClass < 0) || (length != allocation.length)) {
+        free(allocation.memory);
+        return;
+    }
+    SlabList* list = &threadSlabs[slabClass];
+    if (list->count >= THREAD_SLAB_LIMIT) {
+        // This thread's list is full: pass its blocks on to the shared
+        // list, where other threads can find them.
+        SpinLock::Guard _(sharedSlabsMutex);
+        SlabList* shared = &sharedSlabs[slabClass];
+        while (list->head != NULL) {
+            void* block = list->head;
+            list->head = *static_cast<void**>(block);
+            if (shared->count < SHARED_SLAB_LIMIT) {
+                *static_cast<void**>(block) = shared->head;
+                shared->head = block;
+                shared->count++;
+            } else {
+                free(block);
+            }
+        }
+        list->count = 0;
+    }
+    *reinterpret_cast<void**>(allocation.memory) = list->head;
+    list->head = allocation.memory;
+    list->count++;
+}
+
 /**
  * Return the number of discontiguous chunks of storage used by the buffer.
  */
@@ -897,6 +1039,35 @@ Buffer::Iterator::operator=(const Iterator& other)
     return *this;
 }
 
+/**
+ * Describe the remaining bytes of this iterator as a scatter/gather list
+ * that refers to the Buffer's storage in place, so the bytes can be handed
+ * to the kernel or a NIC without copying them; the iterator advances past
+ * the bytes described.
+ *
+ * \param iovecs
+ *      Filled in with one entry for each chunk, starting at the current
+ *      position.
+ * \param maxIovecs
+ *      The most entries to fill in. If the remaining bytes cover more
+ *      chunks than this, the iterator is left at the first chunk that
+ *      wasn't described.
+ * \return
+ *      The number of entries filled in.
+ */
+uint32_t
+Buffer::Iterator::fillIovecs(struct iovec* iovecs, uint32_t maxIovecs)
+{
+    uint32_t count = 0;
+    while (!isDone() && (count < maxIovecs)) {
+        iovecs[count].iov_base = currentData;
+        iovecs[count].iov_len = currentLength;
+        count++;
+        next();
+    }
+    return count;
+}
+
 /**
  * Count the number of distinct chunks of storage covered by the
  * remaining bytes of this iterator.
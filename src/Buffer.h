@@ -21,6 +21,8 @@
 #include "Minimal.h"
 #include "Tub.h"
 
+struct iovec;
+
 namespace RAMCloud {
 class Syscall;
 
@@ -278,6 +280,23 @@ class Buffer {
     uint32_t write(uint32_t offset, uint32_t length, FILE* f);
 
   PRIVATE:
+    /**
+     * Describes one block of memory obtained by getNewAllocation.
+     */
+    struct Allocation {
+        Allocation(char* memory, uint32_t length)
+            : memory(memory)
+            , length(length)
+        {}
+
+        /// First byte of the block.
+        char* memory;
+
+        /// Total size of the block, in bytes.
+        uint32_t length;
+    };
+
+    static void freeAllocation(const Allocation& allocation);
     char* getNewAllocation(uint32_t bytesNeeded, uint32_t* bytesAllocated);
 
     /**
@@ -301,10 +320,10 @@ class Buffer {
             current = next;
         }
 
-        // Free any malloc-ed memory.
+        // Free any dynamically allocated memory.
         if (allocations) {
             for (uint32_t i = 0; i < allocations->size(); i++) {
-                free((*allocations)[i]);
+                freeAllocation((*allocations)[i]);
             }
             if (isReset) {
                 allocations->clear();
@@ -358,7 +377,7 @@ class Buffer {
     /// track of all the allocations so they can be freed by reset. This is
     /// a Tub so that we don't have to construct and destroy the vector
     /// unless it is actually used (which is fairly rare).
-    Tub<std::vector<void*>> allocations;
+    Tub<std::vector<Allocation>> allocations;
 
     /// In some situations we have extra storage space available that
     /// isn't part of a Chunk. When this happens, the variables below
@@ -479,6 +498,7 @@ class Buffer {
             return currentLength;
         }
 
+        uint32_t fillIovecs(struct iovec* iovecs, uint32_t maxIovecs);
         uint32_t getNumberChunks();
 
         /**
@@ -15,11 +15,14 @@
 
 #include <string.h>
 #include <strings.h>
+#include <sys/uio.h>
+#include <thread>
 
 #include "TestUtil.h"
 #include "Buffer.h"
 #include "Logger.h"
 #include "MockSyscall.h"
+#include "PerfStats.h"
 
 namespace RAMCloud {
 
@@ -199,7 +202,7 @@ TEST_F(BufferTest, alloc_allocateNewSpace) {
     buffer.appendChunk(&chunk);
     buffer.availableLength = 200;
     buffer.alloc(400 - sizeof32(Buffer::Chunk));
-    EXPECT_EQ(1000u, buffer.extraAppendBytes);
+    EXPECT_EQ(1648u, buffer.extraAppendBytes);
     EXPECT_TRUE(buffer.allocations);
     EXPECT_EQ(1u, buffer.allocations->size());
 }
@@ -247,9 +250,9 @@ TEST_F(BufferTest, allocAux_getNewAllocation) {
     Buffer buffer;
     buffer.availableLength = 0;
     char* p = static_cast<char*>(buffer.allocAux(400));
-    EXPECT_EQ(1400u, buffer.totalAllocatedBytes);
-    EXPECT_EQ(1000u, p - buffer.firstAvailable);
-    EXPECT_EQ(1000u, buffer.availableLength);
+    EXPECT_EQ(2048u, buffer.totalAllocatedBytes);
+    EXPECT_EQ(1648u, p - buffer.firstAvailable);
+    EXPECT_EQ(1648u, buffer.availableLength);
 }
 
 TEST_F(BufferTest, allocPrepend_bufferEmpty) {
@@ -476,8 +479,8 @@ TEST_F(BufferTest, getNewAllocation) {
     uint32_t actualLength;
     char* result = buffer.getNewAllocation(193, &actualLength);
     EXPECT_TRUE(result != NULL);
-    EXPECT_EQ(1200u, actualLength);
-    EXPECT_EQ(1200u, buffer.totalAllocatedBytes);
+    EXPECT_EQ(2048u, actualLength);
+    EXPECT_EQ(2048u, buffer.totalAllocatedBytes);
     EXPECT_TRUE(buffer.allocations);
     EXPECT_EQ(1u, buffer.allocations->size());
     EXPECT_EQ("", TestLog::get());
@@ -485,13 +488,66 @@ TEST_F(BufferTest, getNewAllocation) {
     // Second allocation: check for log message about threshold.
     result = buffer.getNewAllocation(600, &actualLength);
     EXPECT_TRUE(result != NULL);
-    EXPECT_EQ(2800u, actualLength);
-    EXPECT_EQ(4000u, buffer.totalAllocatedBytes);
+    EXPECT_EQ(4096u, actualLength);
+    EXPECT_EQ(6144u, buffer.totalAllocatedBytes);
     EXPECT_EQ(2u, buffer.allocations->size());
-    EXPECT_EQ("getNewAllocation: buffer has consumed 4000 bytes of "
-            "extra storage, current allocation: 2800 bytes",
+    EXPECT_EQ("getNewAllocation: buffer has consumed 6144 bytes of "
+            "extra storage, current allocation: 4096 bytes",
             TestLog::get());
-    EXPECT_EQ(8000u, Buffer::allocationLogThreshold);
+    EXPECT_EQ(12288u, Buffer::allocationLogThreshold);
+}
+TEST_F(BufferTest, getNewAllocation_reuseFreedBlock) {
+    uint32_t actualLength;
+    char* block;
+    {
+        Buffer buffer;
+        block = buffer.getNewAllocation(100, &actualLength);
+    }
+    uint64_t hits = PerfStats::threadStats.bufferSlabHits;
+    uint64_t misses = PerfStats::threadStats.bufferSlabMisses;
+    Buffer buffer;
+    EXPECT_EQ(block, buffer.getNewAllocation(100, &actualLength));
+    EXPECT_EQ(2048u, actualLength);
+    EXPECT_EQ(hits + 1, PerfStats::threadStats.bufferSlabHits);
+    EXPECT_EQ(misses, PerfStats::threadStats.bufferSlabMisses);
+}
+TEST_F(BufferTest, getNewAllocation_tooLargeForSlab) {
+    uint64_t hits = PerfStats::threadStats.bufferSlabHits;
+    uint64_t misses = PerfStats::threadStats.bufferSlabMisses;
+    Buffer buffer;
+    uint32_t actualLength;
+    buffer.getNewAllocation(100000, &actualLength);
+    EXPECT_EQ(101000u, actualLength);
+    EXPECT_EQ(hits, PerfStats::threadStats.bufferSlabHits);
+    EXPECT_EQ(misses + 1, PerfStats::threadStats.bufferSlabMisses);
+}
+
+// Frees enough blocks in the current thread to overflow its free list.
+static void
+freeManyBlocks()
+{
+    Buffer buffers[20];
+    for (int i = 0; i < 20; i++) {
+        uint32_t actualLength;
+        buffers[i].getNewAllocation(100, &actualLength);
+    }
+}
+
+// Allocates a block and returns this thread's count of pooled allocations.
+static void
+allocateOneBlock(uint64_t* hits)
+{
+    Buffer buffer;
+    uint32_t actualLength;
+    buffer.getNewAllocation(100, &actualLength);
+    *hits = PerfStats::threadStats.bufferSlabHits;
+}
+
+TEST_F(BufferTest, freeAllocation_shareWithOtherThreads) {
+    std::thread(freeManyBlocks).join();
+    uint64_t hits = 0;
+    std::thread(allocateOneBlock, &hits).join();
+    EXPECT_EQ(1u, hits);
 }
 
 TEST_F(BufferTest, getNumberChunks) {
@@ -822,6 +878,30 @@ TEST_F(BufferTest, Iterator_constructor_withRange) {
     EXPECT_EQ(2u, it4.bytesLeft);
 }
 
+TEST_F(BufferTest, Iterator_fillIovecs) {
+    Buffer buffer;
+    const char* abcd = "abcd";
+    const char* digits = "012345";
+    buffer.appendExternal(abcd, 4);
+    buffer.appendExternal(digits, 6);
+    buffer.appendExternal("ABCDEFG", 7);
+    Buffer::Iterator it(&buffer, 2, 10);
+    struct iovec iovecs[2];
+    EXPECT_EQ(2u, it.fillIovecs(iovecs, 2));
+    EXPECT_EQ(abcd + 2, static_cast<const char*>(iovecs[0].iov_base));
+    EXPECT_EQ(2u, iovecs[0].iov_len);
+    EXPECT_EQ(digits, static_cast<const char*>(iovecs[1].iov_base));
+    EXPECT_EQ(6u, iovecs[1].iov_len);
+
+    // The iterator is left at the chunk that didn't fit.
+    EXPECT_EQ("AB", string(static_cast<const char*>(it.getData()),
+            it.getLength()));
+    EXPECT_EQ(1u, it.fillIovecs(iovecs, 2));
+    EXPECT_EQ(2u, iovecs[0].iov_len);
+    EXPECT_TRUE(it.isDone());
+    EXPECT_EQ(0u, it.fillIovecs(iovecs, 2));
+}
+
 TEST_F(BufferTest, Iterator_getNumberChunks_none) {
     Buffer buffer;
     Buffer::Iterator it(&buffer);
@@ -13,10 +13,13 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <thread>
+
 #include "ClientException.h"
 #include "Cycles.h"
 #include "Logger.h"
 #include "LogCleaner.h"
+#include "MasterService.h"
 #include "Memory.h"
 #include "ObjectManager.h"
 #include "SegmentIterator.h"
@@ -31,31 +34,20 @@ class CleanerCompactionBenchmark {
 
   public:
     Context context;
-    ClusterClock clusterClock;
-    ClientLeaseValidator clientLeaseValidator;
     ServerConfig config;
     ServerList serverList;
-    TabletManager tabletManager;
-    MasterTableMetadata masterTableMetadata;
-    UnackedRpcResults unackedRpcResults;
-    TransactionManager transactionManager;
-    TxRecoveryManager txRecoveryManager;
-    ServerId serverId;
+    MasterService* masterService;
     ObjectManager* objectManager;
 
+    // The cleaner reaches the ObjectManager through the context's
+    // MasterService (when scanning tombstones, for instance), so use the one
+    // a real MasterService owns rather than a stand-alone instance.
     CleanerCompactionBenchmark(string logSize, string hashTableSize,
-        int numSegments)
+        int numSegments, int cleanerThreads = 1)
         : context()
-        , clusterClock()
-        , clientLeaseValidator(&context, &clusterClock)
         , config(ServerConfig::forTesting())
         , serverList(&context)
-        , tabletManager()
-        , masterTableMetadata()
-        , unackedRpcResults(&context, NULL, &clientLeaseValidator)
-        , transactionManager(&context, NULL, &unackedRpcResults)
-        , txRecoveryManager(&context)
-        , serverId(1, 1)
+        , masterService(NULL)
         , objectManager(NULL)
     {
         Logger::get().setLogLevels(WARNING);
@@ -65,28 +57,23 @@ class CleanerCompactionBenchmark {
         config.services = {};
         config.master.numReplicas = 0;
         config.master.disableLogCleaner = true;
+        config.master.cleanerThreadCount = cleanerThreads;
         config.segmentSize = Segment::DEFAULT_SEGMENT_SIZE;
         config.segletSize = Seglet::DEFAULT_SEGLET_SIZE;
-        objectManager = new ObjectManager(&context,
-                                          &serverId,
-                                          &config,
-                                          &tabletManager,
-                                          &masterTableMetadata,
-                                          &unackedRpcResults,
-                                          &transactionManager,
-                                          &txRecoveryManager);
-        unackedRpcResults.resetFreer(objectManager);
+        masterService = new MasterService(&context, &config);
+        objectManager = &masterService->objectManager;
     }
 
     ~CleanerCompactionBenchmark()
     {
-        delete objectManager;
+        delete masterService;
     }
 
     void
-    run(uint32_t numSegments, uint32_t dataLen)
+    fill(uint32_t numSegments, uint32_t dataLen, uint32_t deletePercentage)
     {
-        tabletManager.addTablet(0, 0, ~0UL, TabletManager::NORMAL);
+        masterService->tabletManager.addTablet(0, 0, ~0UL,
+                                               TabletManager::NORMAL);
 
         /*
          * Fill up 'numSegments' worth of segments in the log with objects of
@@ -112,9 +99,10 @@ class CleanerCompactionBenchmark {
         } while (objectManager->log.head->id <= numSegments);
 
         /*
-         * Delete 10% of the objects we just added at random.
+         * Delete 'deletePercentage' percent of the objects we just added at
+         * random.
          */
-        for (uint64_t i = 0; i < nextKeyVal / 10; i++) {
+        for (uint64_t i = 0; i < nextKeyVal * deletePercentage / 100; i++) {
             uint64_t r = generateRandom() % nextKeyVal;
             Key key(0, &r, sizeof(r));
             Status status = objectManager->removeObject(key, NULL, NULL);
@@ -123,6 +111,12 @@ class CleanerCompactionBenchmark {
                 i--;
             }
         }
+    }
+
+    void
+    run(uint32_t numSegments, uint32_t dataLen)
+    {
+        fill(numSegments, dataLen, 10);
 
         /*
          * Now compact each segment.
@@ -142,6 +136,8 @@ class CleanerCompactionBenchmark {
         uint64_t totalEntriesScanned = 0;
         for (size_t i = 0; i < arrayLength(metrics->totalEntriesScanned); i++)
             totalEntriesScanned += metrics->totalEntriesScanned[i];
+        if (totalEntriesScanned == 0)
+            return;
         printf("  Avg Time / Entry Scanned:     %.0f ns\n",
             Cycles::toSeconds(ticks / totalEntriesScanned) * 1.0e9);
 
@@ -154,6 +150,65 @@ class CleanerCompactionBenchmark {
                               metrics->totalRelocationCallbacks) * 1.0e9);
     }
 
+    /*
+     * Stands in for an idle cleaner thread: keeps joining whatever disk
+     * cleaning pass is being shared until told to stop.
+     */
+    static void
+    helperThread(LogCleaner* cleaner, std::atomic<bool>* stop)
+    {
+        LogCleaner::CleanerThreadState state;
+        while (!*stop) {
+            if (!cleaner->helpWithDiskCleaning(&state))
+                std::this_thread::yield();
+        }
+    }
+
+    void
+    runDiskCleaning(uint32_t numSegments, uint32_t dataLen, int numThreads)
+    {
+        fill(numSegments, dataLen, 50);
+
+        /*
+         * Clean everything we just wrote on disk, with the other cleaner
+         * threads helping with each pass.
+         */
+        LogCleaner* cleaner = objectManager->log.cleaner;
+        std::atomic<bool> stop(false);
+        std::vector<std::thread> helpers;
+        for (int i = 1; i < numThreads; i++)
+            helpers.emplace_back(helperThread, cleaner, &stop);
+
+        LogCleanerMetrics::OnDisk<>* metrics = &cleaner->onDiskMetrics;
+        uint64_t before = Cycles::rdtsc();
+        uint64_t segmentsCleaned = 0;
+        while (segmentsCleaned < numSegments) {
+            cleaner->doDiskCleaning();
+
+            // Cleaned segments are only freed (and their space made available
+            // for survivors) once the log head rolls over.
+            objectManager->log.rollHeadOver();
+            if (metrics->totalSegmentsCleaned == segmentsCleaned)
+                break;
+            segmentsCleaned = metrics->totalSegmentsCleaned;
+        }
+        uint64_t ticks = Cycles::rdtsc() - before;
+
+        stop = true;
+        foreach (std::thread& helper, helpers)
+            helper.join();
+
+        double seconds = Cycles::toSeconds(ticks);
+        uint64_t bytesCleaned = metrics->totalDiskBytesInCleanedSegments;
+        printf("%2d threads: cleaned %lu segments in %lu ms (%.1f MB/s, "
+            "%lu runs)\n",
+            numThreads,
+            segmentsCleaned,
+            Cycles::toNanoseconds(ticks) / 1000 / 1000,
+            static_cast<double>(bytesCleaned) / seconds / 1e06,
+            metrics->totalRuns.load());
+    }
+
     DISALLOW_COPY_AND_ASSIGN(CleanerCompactionBenchmark);
 };
 
@@ -171,5 +226,16 @@ main()
         rsb.run(numSegments, dataBytes[i]);
     }
 
+    // Disk cleaning bandwidth as a function of the number of cleaner threads
+    // sharing each pass.
+    int threadCounts[] = { 1, 2, 4, 8, 0 };
+    printf("==========================\n");
+    printf("Disk cleaning, %u byte objects, 50%% deleted\n", dataBytes[0]);
+    for (int i = 0; threadCounts[i] != 0; i++) {
+        RAMCloud::CleanerCompactionBenchmark rsb("2048", "10%", numSegments,
+                                                 threadCounts[i]);
+        rsb.runDiskCleaning(numSegments, dataBytes[0], threadCounts[i]);
+    }
+
     return 0;
 }
@@ -289,6 +289,8 @@ try
     OptionParser optionParser(clientOptions, argc, argv);
     context.transportManager->setSessionTimeout(
             optionParser.options.getSessionTimeout());
+    context.transportManager->setBatchRequests(
+            optionParser.options.getBatchRequests());
 
     LOG(NOTICE, "client: Connecting to %s",
         optionParser.options.getCoordinatorLocator().c_str());
@@ -55,6 +55,7 @@ namespace po = boost::program_options;
 #include "PerfStats.h"
 #include "IndexLookup.h"
 #include "RamCloud.h"
+#include "RpcLatencyStats.h"
 #include "Util.h"
 #include "TimeTrace.h"
 #include "Transaction.h"
@@ -5731,6 +5732,44 @@ readVaryingKeyLength()
     }
 }
 
+// Per-server latency distributions for random reads and writes, as
+// measured by the servers themselves (queueing and service time for each
+// opcode, from the GET_RPC_LATENCIES server control).
+void
+rpcLatencies()
+{
+    if (clientIndex != 0)
+        return;
+    const int numKeys = 10000;
+    const uint16_t keyLength = 30;
+    int size = objectSize;
+    fillTable(dataTable, numKeys, keyLength, size);
+
+    char key[keyLength];
+    char value[size];
+    memset(value, 'x', size);
+    Buffer before, after, output;
+    cluster->serverControlAll(WireFormat::GET_RPC_LATENCIES, NULL, 0,
+            &before);
+    uint64_t stopTime = Cycles::rdtsc() + Cycles::fromSeconds(2.0);
+    for (int i = 0; Cycles::rdtsc() < stopTime; i++) {
+        makeKey(downCast<int>(generateRandom() % numKeys), keyLength, key);
+        if ((i % 10) == 0) {
+            cluster->write(dataTable, key, keyLength, value, size);
+        } else {
+            cluster->read(dataTable, key, keyLength, &output);
+        }
+    }
+    cluster->serverControlAll(WireFormat::GET_RPC_LATENCIES, NULL, 0,
+            &after);
+
+    printf("# Server-side RPC latencies (microseconds) for random reads and\n");
+    printf("# writes of %d-byte objects (1 write for every 9 reads).\n", size);
+    printf("# Generated by 'clusterperf.py rpcLatencies'\n#\n");
+    printf("%s", RpcLatencyStats::printClusterLatencies(&before,
+            &after).c_str());
+}
+
 // Write times for objects with string keys of different lengths.
 void
 writeVaryingKeyLength()
@@ -6227,6 +6266,7 @@ TestInfo tests[] = {
     {"readRandom", readRandom},
     {"readThroughput", readThroughput},
     {"readVaryingKeyLength", readVaryingKeyLength},
+    {"rpcLatencies", rpcLatencies},
     {"writeVaryingKeyLength", writeVaryingKeyLength},
     {"writeAsyncSync", writeAsyncSync},
     {"writeDistRandom", writeDistRandom},
@@ -0,0 +1,282 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Compression.h"
+
+namespace RAMCloud {
+
+namespace Compression {
+
+namespace {
+
+/// log2 of the number of entries in the compressor's hash table.
+const uint32_t HASH_LOG = 12;
+
+/// The last few bytes of the input are always emitted as literals, which
+/// guarantees the final record carries no match.
+const uint32_t LAST_LITERALS = 5;
+
+/// Back references can reach at most this far.
+const uint32_t MAX_OFFSET = 65535;
+
+/// A length nibble of this value means more length bytes follow.
+const uint32_t RUN_MASK = 15;
+
+uint32_t
+read32(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint32_t
+hash(uint32_t sequence)
+{
+    return (sequence * 2654435761U) >> (32 - HASH_LOG);
+}
+
+/**
+ * Append the extra bytes for a length that didn't fit in its token nibble.
+ * Returns the new output position, or NULL if there isn't enough space.
+ */
+uint8_t*
+writeLength(uint8_t* op, uint8_t* oend, uint32_t length)
+{
+    for (; length >= 255; length -= 255) {
+        if (op >= oend)
+            return NULL;
+        *op++ = 255;
+    }
+    if (op >= oend)
+        return NULL;
+    *op++ = static_cast<uint8_t>(length);
+    return op;
+}
+
+/**
+ * Append one record to the output. A record with matchLength of 0 is the
+ * final, literals-only record. Returns the new output position, or NULL if
+ * there isn't enough space.
+ */
+uint8_t*
+writeRecord(uint8_t* op, uint8_t* oend,
+            const uint8_t* literals, uint32_t literalLength,
+            uint32_t offset, uint32_t matchLength)
+{
+    if (op >= oend)
+        return NULL;
+    uint8_t* token = op++;
+    uint32_t matchCode = matchLength ? matchLength - MIN_MATCH : 0;
+
+    *token = static_cast<uint8_t>(std::min(literalLength, RUN_MASK) << 4);
+    if (literalLength >= RUN_MASK) {
+        op = writeLength(op, oend, literalLength - RUN_MASK);
+        if (op == NULL)
+            return NULL;
+    }
+    if (literalLength > static_cast<uint32_t>(oend - op))
+        return NULL;
+    memcpy(op, literals, literalLength);
+    op += literalLength;
+
+    if (matchLength == 0)
+        return op;
+
+    if (oend - op < 2)
+        return NULL;
+    *op++ = static_cast<uint8_t>(offset);
+    *op++ = static_cast<uint8_t>(offset >> 8);
+
+    *token = static_cast<uint8_t>(*token | std::min(matchCode, RUN_MASK));
+    if (matchCode >= RUN_MASK)
+        op = writeLength(op, oend, matchCode - RUN_MASK);
+    return op;
+}
+
+/**
+ * Read the extra bytes of a length that didn't fit in its token nibble.
+ * Returns false if the input ends first.
+ */
+bool
+readLength(const uint8_t*& ip, const uint8_t* iend, uint32_t& length)
+{
+    uint8_t b;
+    do {
+        if (ip >= iend)
+            return false;
+        b = *ip++;
+        length += b;
+    } while (b == 255);
+    return true;
+}
+
+} // anonymous namespace
+
+/**
+ * Compress a block of memory.
+ *
+ * \param input
+ *      The bytes to compress.
+ * \param inputLength
+ *      Number of bytes at \a input.
+ * \param[out] output
+ *      Where the compressed bytes are written.
+ * \param outputCapacity
+ *      Number of bytes available at \a output. If this is at least
+ *      maxCompressedLength(inputLength), compression cannot fail.
+ * \return
+ *      The length of the compressed data, or 0 if it would not fit in
+ *      \a outputCapacity bytes. Callers that only want to keep the result
+ *      if it saves space should pass a capacity smaller than the input.
+ */
+uint32_t
+compress(const void* input, uint32_t inputLength,
+         void* output, uint32_t outputCapacity)
+{
+    const uint8_t* const in = static_cast<const uint8_t*>(input);
+    const uint8_t* const end = in + inputLength;
+    const uint8_t* ip = in;
+    const uint8_t* anchor = in;
+    uint8_t* op = static_cast<uint8_t*>(output);
+    uint8_t* const oend = op + outputCapacity;
+
+    if (inputLength >= MIN_MATCH + LAST_LITERALS) {
+        const uint8_t* const matchLimit = end - LAST_LITERALS;
+        uint32_t table[1 << HASH_LOG];
+        memset(table, 0, sizeof(table));
+
+        // Misses make us skip ahead faster, so incompressible data isn't
+        // much more expensive than compressible data.
+        uint32_t misses = 0;
+        while (ip + MIN_MATCH <= matchLimit) {
+            uint32_t sequence = read32(ip);
+            uint32_t h = hash(sequence);
+            const uint8_t* ref = in + table[h];
+            table[h] = static_cast<uint32_t>(ip - in);
+
+            if (ref >= ip || ip - ref > MAX_OFFSET || read32(ref) != sequence) {
+                ip += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+
+            uint32_t matchLength = MIN_MATCH;
+            while (ip + matchLength < matchLimit &&
+                   ref[matchLength] == ip[matchLength])
+                matchLength++;
+
+            op = writeRecord(op, oend, anchor,
+                             static_cast<uint32_t>(ip - anchor),
+                             static_cast<uint32_t>(ip - ref), matchLength);
+            if (op == NULL)
+                return 0;
+            ip += matchLength;
+            anchor = ip;
+        }
+    }
+
+    op = writeRecord(op, oend, anchor, static_cast<uint32_t>(end - anchor),
+                     0, 0);
+    if (op == NULL)
+        return 0;
+    return static_cast<uint32_t>(op - static_cast<uint8_t*>(output));
+}
+
+/**
+ * Decompress data produced by compress(). The input is fully validated, so
+ * it is safe to call this on corrupt data.
+ *
+ * \param input
+ *      Compressed bytes.
+ * \param inputLength
+ *      Number of bytes at \a input.
+ * \param[out] output
+ *      Where the decompressed bytes are written.
+ * \param outputLength
+ *      Exact length of the decompressed data.
+ * \return
+ *      True if the input decompressed to exactly \a outputLength bytes,
+ *      false if it is malformed.
+ */
+bool
+decompress(const void* input, uint32_t inputLength,
+           void* output, uint32_t outputLength)
+{
+    const uint8_t* ip = static_cast<const uint8_t*>(input);
+    const uint8_t* const iend = ip + inputLength;
+    uint8_t* const out = static_cast<uint8_t*>(output);
+    uint8_t* op = out;
+    uint8_t* const oend = out + outputLength;
+
+    while (ip < iend) {
+        uint32_t token = *ip++;
+
+        uint32_t literalLength = token >> 4;
+        if (literalLength == RUN_MASK && !readLength(ip, iend, literalLength))
+            return false;
+        if (literalLength > static_cast<uint32_t>(iend - ip) ||
+                literalLength > static_cast<uint32_t>(oend - op))
+            return false;
+        memcpy(op, ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+
+        if (ip == iend)
+            return op == oend;
+
+        if (iend - ip < 2)
+            return false;
+        uint32_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > static_cast<uint32_t>(op - out))
+            return false;
+
+        uint32_t matchLength = token & RUN_MASK;
+        if (matchLength == RUN_MASK && !readLength(ip, iend, matchLength))
+            return false;
+        matchLength += MIN_MATCH;
+        if (matchLength > static_cast<uint32_t>(oend - op))
+            return false;
+
+        // Matches may overlap the bytes they produce (e.g. a run of one
+        // repeated byte has offset 1), so copy forwards a byte at a time
+        // unless they can't.
+        const uint8_t* match = op - offset;
+        if (offset >= matchLength) {
+            memcpy(op, match, matchLength);
+            op += matchLength;
+        } else {
+            for (uint32_t i = 0; i < matchLength; i++)
+                *op++ = *match++;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Return the largest size compress() can produce for an input of the given
+ * length (incompressible data grows slightly).
+ */
+uint32_t
+maxCompressedLength(uint32_t inputLength)
+{
+    return inputLength + inputLength / 255 + 16;
+}
+
+} // namespace Compression
+
+} // namespace RAMCloud
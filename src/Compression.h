@@ -0,0 +1,59 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_COMPRESSION_H
+#define RAMCLOUD_COMPRESSION_H
+
+#include "Common.h"
+
+namespace RAMCloud {
+
+/**
+ * A small, fast LZ77 codec used to compress object values stored in the log.
+ * It trades compression ratio for speed: compressing takes a single pass with
+ * a hash table of recently seen 4-byte sequences, and decompressing is little
+ * more than a series of memcpy()s.
+ *
+ * The compressed format is a sequence of records, each consisting of a token
+ * byte, a run of literal bytes copied from the input, and a back reference
+ * to a match earlier in the output:
+ *
+ * +-------+-----------------+----------+--------+----------------+
+ * | token | literal len ... | literals | offset | match len ...  |
+ * +-------+-----------------+----------+--------+----------------+
+ *
+ * The high 4 bits of the token hold the number of literals and the low 4
+ * bits the length of the match minus MIN_MATCH. A nibble of 15 means the
+ * length continues in the following bytes, each of which is added to it
+ * until one is less than 255. The offset is a 16-bit little-endian distance
+ * back from the current output position. The final record has literals
+ * only, and no offset or match.
+ */
+namespace Compression {
+
+/// Shortest match worth encoding as a back reference.
+static const uint32_t MIN_MATCH = 4;
+
+uint32_t compress(const void* input, uint32_t inputLength,
+                  void* output, uint32_t outputCapacity);
+bool decompress(const void* input, uint32_t inputLength,
+                void* output, uint32_t outputLength);
+uint32_t maxCompressedLength(uint32_t inputLength);
+
+} // namespace Compression
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_COMPRESSION_H
@@ -0,0 +1,109 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+
+#include "Compression.h"
+
+namespace RAMCloud {
+
+/**
+ * Compress and decompress a string, returning the result of the round trip
+ * (or "<failed>"). The compressed length is returned in compressedLength.
+ */
+static string
+roundTrip(const string& input, uint32_t* compressedLength = NULL)
+{
+    uint32_t length = downCast<uint32_t>(input.size());
+    std::vector<uint8_t> compressed(Compression::maxCompressedLength(length));
+    uint32_t n = Compression::compress(input.data(), length,
+            compressed.data(), downCast<uint32_t>(compressed.size()));
+    if (compressedLength != NULL)
+        *compressedLength = n;
+    if (n == 0)
+        return "<failed>";
+    string output(length, '\0');
+    if (!Compression::decompress(compressed.data(), n, &output[0], length))
+        return "<failed>";
+    return output;
+}
+
+TEST(CompressionTest, compress_empty) {
+    uint32_t compressedLength;
+    EXPECT_EQ("", roundTrip("", &compressedLength));
+    EXPECT_EQ(1U, compressedLength);
+}
+
+TEST(CompressionTest, compress_short) {
+    uint32_t compressedLength;
+    EXPECT_EQ("abcdefg", roundTrip("abcdefg", &compressedLength));
+    EXPECT_EQ(8U, compressedLength);
+}
+
+TEST(CompressionTest, compress_repetitive) {
+    string input;
+    for (int i = 0; i < 100; i++)
+        input += format("key%d=value%d;", i % 7, i % 7);
+    uint32_t compressedLength;
+    EXPECT_EQ(input, roundTrip(input, &compressedLength));
+    EXPECT_LT(compressedLength, input.size() / 5);
+}
+
+TEST(CompressionTest, compress_longRuns) {
+    // Overlapping matches (offset 1) and lengths needing extra bytes for
+    // both literals and matches.
+    string input = string(1000, 'a');
+    for (int i = 0; i < 300; i++)
+        input += static_cast<char>(generateRandom());
+    input += string(5000, 'b');
+    EXPECT_EQ(input, roundTrip(input));
+}
+
+TEST(CompressionTest, compress_incompressible) {
+    string input;
+    for (int i = 0; i < 4096; i++)
+        input += static_cast<char>(generateRandom());
+    uint32_t compressedLength;
+    EXPECT_EQ(input, roundTrip(input, &compressedLength));
+    EXPECT_LE(compressedLength, Compression::maxCompressedLength(4096));
+
+    // Not enough room.
+    uint8_t output[4096];
+    EXPECT_EQ(0U, Compression::compress(input.data(), 4096, output, 4095));
+}
+
+TEST(CompressionTest, decompress_corrupt) {
+    string input = string(500, 'x') + "tail";
+    uint8_t compressed[600];
+    uint32_t n = Compression::compress(input.data(), 504, compressed, 600);
+    ASSERT_NE(0U, n);
+    char output[504];
+    EXPECT_TRUE(Compression::decompress(compressed, n, output, 504));
+
+    // Wrong output length.
+    EXPECT_FALSE(Compression::decompress(compressed, n, output, 503));
+    char big[505];
+    EXPECT_FALSE(Compression::decompress(compressed, n, big, 505));
+
+    // Truncated input.
+    EXPECT_FALSE(Compression::decompress(compressed, n - 1, output, 504));
+    EXPECT_FALSE(Compression::decompress(compressed, 0, output, 504));
+
+    // Back reference before the start of the output.
+    uint8_t bad[] = { 0x10, 'a', 0x05, 0x00, 0x00 };
+    EXPECT_FALSE(Compression::decompress(bad, sizeof32(bad), output, 10));
+}
+
+}  // namespace RAMCloud
@@ -601,7 +601,11 @@ try {
         for (int i = 0; i < count; i++) {
             int fd = events[i].data.fd;
             int readyEvents = 0;
-            if (events[i].events & EPOLLIN) {
+            // Errors are reported as readable: the handler will discover
+            // them when it reads. This includes notifications on a socket's
+            // error queue (e.g. MSG_ZEROCOPY completions), which raise
+            // EPOLLERR alone and would otherwise be re-reported forever.
+            if (events[i].events & (EPOLLIN|EPOLLERR)) {
                 readyEvents |= READABLE;
             }
             if (events[i].events & EPOLLOUT) {
@@ -0,0 +1,117 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "DispatchShard.h"
+#include "Dispatch.h"
+#include "PerfStats.h"
+#include "ShortMacros.h"
+#include "TransportManager.h"
+#include "WorkerManager.h"
+
+namespace RAMCloud {
+
+/**
+ * Start a new dispatch thread and wait until it is listening for requests.
+ *
+ * \param context
+ *      The server's main Context. Its services must already be registered,
+ *      and its TransportManager must share its listening ports.
+ * \param localLocator
+ *      Service locators on which to listen; normally the same as the main
+ *      dispatch thread's.
+ * \param maxCores
+ *      Passed to this shard's WorkerManager: the number of worker threads
+ *      it may normally keep busy.
+ *
+ * \throw Exception
+ *      The shard couldn't listen on \a localLocator.
+ */
+DispatchShard::DispatchShard(Context* context, const string& localLocator,
+                             uint32_t maxCores)
+    : parent(context)
+    , localLocator(localLocator)
+    , maxCores(maxCores)
+    , state(STARTING)
+    , error()
+    , thread()
+{
+    thread = std::thread(main, this);
+    while (state.load() == STARTING)
+        std::this_thread::yield();
+    if (state.load() == FAILED) {
+        thread.join();
+        throw Exception(HERE, format("Dispatch shard couldn't listen on "
+                "'%s': %s", localLocator.c_str(), error.c_str()));
+    }
+}
+
+/**
+ * Stop the shard's dispatch thread. Requests still being serviced by its
+ * workers are finished first. Servers normally never do this; it is used
+ * during testing.
+ */
+DispatchShard::~DispatchShard()
+{
+    if (thread.joinable()) {
+        state.store(STOPPING);
+        thread.join();
+    }
+}
+
+/**
+ * The top-level method for a shard's dispatch thread. The shard's Context
+ * lives on this thread's stack: its Dispatch belongs to whichever thread
+ * creates it.
+ *
+ * \param shard
+ *      The shard this thread runs.
+ */
+void
+DispatchShard::main(DispatchShard* shard)
+{
+    Context context(true);
+    for (int i = 0; i < WireFormat::INVALID_SERVICE; i++)
+        context.services[i] = shard->parent->services[i];
+    context.serverList = shard->parent->serverList;
+    context.transportManager->setSessionTimeout(
+            shard->parent->transportManager->getSessionTimeout());
+    context.transportManager->setShareListeningPorts(true);
+    context.workerManager = new WorkerManager(&context, shard->maxCores);
+    context.workerManager->setInlineShortRpcs(
+            shard->parent->workerManager->getInlineShortRpcs());
+    try {
+        context.transportManager->initialize(shard->localLocator.c_str());
+    } catch (Exception& e) {
+        shard->error = e.message;
+        shard->state.store(FAILED);
+        return;
+    }
+    LOG(NOTICE, "Dispatch shard listening on %s",
+        context.transportManager->getListeningLocatorsString().c_str());
+    shard->state.store(RUNNING);
+
+    // Same as Dispatch::run, but stoppable.
+    PerfStats::registerStats(&PerfStats::threadStats);
+    Dispatch* dispatch = context.dispatch;
+    while (shard->state.load() != STOPPING) {
+        uint64_t prev = dispatch->currentTime;
+        if (dispatch->poll() > 0) {
+            PerfStats::threadStats.dispatchActiveCycles +=
+                    dispatch->currentTime - prev;
+        }
+    }
+}
+
+} // namespace RAMCloud
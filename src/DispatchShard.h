@@ -0,0 +1,81 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_DISPATCHSHARD_H
+#define RAMCLOUD_DISPATCHSHARD_H
+
+#include <thread>
+
+#include "Atomic.h"
+#include "Context.h"
+
+namespace RAMCloud {
+
+/**
+ * A DispatchShard runs an additional dispatch thread on a server, with its
+ * own Context, its own listening transports and its own WorkerManager.
+ * With a single dispatch thread, small RPCs saturate that thread long
+ * before the workers run out of cores; shards spread the transport work
+ * across several threads.
+ *
+ * Every shard listens on the same service locators as the server's main
+ * dispatch thread (see TransportManager::setShareListeningPorts), so the
+ * kernel steers each incoming connection or packet flow to one of them,
+ * RSS-style; a given client always reaches the same shard. A shard only
+ * serves incoming requests, using the services registered in the main
+ * Context. Everything else, including all outgoing RPCs, stays with the
+ * main dispatch thread.
+ */
+class DispatchShard {
+  PUBLIC:
+    DispatchShard(Context* context, const string& localLocator,
+                  uint32_t maxCores);
+    ~DispatchShard();
+
+  PRIVATE:
+    static void main(DispatchShard* shard);
+
+    /// The server's main Context. Services, the server list and the
+    /// session timeout are taken from it.
+    Context* parent;
+
+    /// Service locators on which this shard listens for requests.
+    const string localLocator;
+
+    /// Passed to this shard's WorkerManager.
+    const uint32_t maxCores;
+
+    /// Values for #state:
+    enum {
+        STARTING,                       /// The thread is setting up.
+        RUNNING,                        /// The thread is serving requests.
+        FAILED,                         /// Setting up failed; see #error.
+        STOPPING                        /// The destructor wants the thread
+                                        /// to exit.
+    };
+    Atomic<int> state;
+
+    /// If #state is FAILED, describes what went wrong.
+    string error;
+
+    /// The shard's dispatch thread.
+    std::thread thread;
+
+    DISALLOW_COPY_AND_ASSIGN(DispatchShard);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_DISPATCHSHARD_H
@@ -0,0 +1,83 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "DispatchShard.h"
+#include "MockService.h"
+#include "MockWrapper.h"
+#include "TransportManager.h"
+#include "WorkerManager.h"
+
+namespace RAMCloud {
+
+class DispatchShardTest : public ::testing::Test {
+  public:
+    Context context;
+    Context serverContext;
+    MockService service;
+
+    DispatchShardTest()
+        : context()
+        , serverContext()
+        , service()
+    {
+        serverContext.services[WireFormat::BACKUP_SERVICE] = &service;
+        serverContext.workerManager = new WorkerManager(&serverContext, 1);
+        serverContext.transportManager->setShareListeningPorts(true);
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(DispatchShardTest);
+};
+
+TEST_F(DispatchShardTest, constructor_sharesPort) {
+    const char* locator = "tcp:host=localhost,port=11120";
+    serverContext.transportManager->initialize(locator);
+    DispatchShard shard(&serverContext, locator, 1);
+    EXPECT_EQ(DispatchShard::RUNNING, shard.state.load());
+}
+
+TEST_F(DispatchShardTest, constructor_cantListen) {
+    string message("no exception");
+    try {
+        DispatchShard shard(&serverContext, "bogus:", 1);
+    } catch (Exception& e) {
+        message = e.message;
+    }
+    EXPECT_EQ("Dispatch shard couldn't listen on 'bogus:': Servers must "
+            "listen on at least one service locator, but no possible "
+            "transports were found for 'bogus:'", message);
+}
+
+TEST_F(DispatchShardTest, main_servesRequests) {
+    const char* locator = "tcp:host=localhost,port=11121";
+    DispatchShard shard(&serverContext, locator, 1);
+
+    Transport::SessionRef session =
+            context.transportManager->getSession(locator);
+    MockWrapper rpc;
+    rpc.request.emplaceAppend<int32_t>(0x10000);
+    rpc.request.emplaceAppend<int32_t>(3);
+    rpc.request.emplaceAppend<int32_t>(4);
+    session->sendRequest(&rpc.request, &rpc.response, &rpc);
+    for (int i = 0; i < 1000 && rpc.completedCount == 0; i++) {
+        context.dispatch->poll();
+        usleep(1000);
+    }
+    EXPECT_STREQ("completed: 1, failed: 0", rpc.getState());
+    EXPECT_EQ("0x10001 4 5", TestUtil::toString(&rpc.response));
+    EXPECT_EQ("rpc: 0x10000 3 4", service.log);
+}
+
+}  // namespace RAMCloud
@@ -777,6 +777,23 @@ TEST_F(DispatchTest, epollThreadMain_signalEventsAndExit) {
     EXPECT_EQ("epoll thread finished", *localLog);
 }
 
+TEST_F(DispatchTest, epollThreadMain_errorReportedAsReadable) {
+    epoll_event events[2];
+    events[0].data.fd = 43;
+    events[0].events = EPOLLERR;
+    events[1].data.fd = -1;
+    sys->epollWaitEvents = events;
+    sys->epollWaitCount = 2;
+    dispatch.readyFd = -1;
+    std::thread(epollThreadWrapper, &dispatch).detach();
+    waitForReadyFd(1.0);
+    EXPECT_EQ(43, dispatch.readyFd);
+    EXPECT_EQ(Dispatch::FileEvent::READABLE, dispatch.readyEvents);
+    dispatch.readyFd = -1;
+    usleep(5000);
+    EXPECT_EQ("epoll thread finished", *localLog);
+}
+
 TEST_F(DispatchTest, Timer_constructorDestructor) {
     DummyTimer* t1 = new DummyTimer("t1", &dispatch);
     DummyTimer* t2 = new DummyTimer("t2", 100, &dispatch);
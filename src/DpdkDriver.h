@@ -63,7 +63,8 @@ class DpdkDriver : public Driver
     virtual void sendPacket(const Address *addr,
                             const void *header,
                             uint32_t headerLen,
-                            Buffer::Iterator *payload);
+                            Buffer::Iterator *payload,
+                            int priority = 0);
     virtual string getServiceLocator();
 
     /**
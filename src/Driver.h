@@ -151,12 +151,30 @@ class Driver {
     /// \copydoc Transport::dumpStats
     virtual void dumpStats() {}
 
+    /**
+     * Transmit any packets that earlier calls to sendPacket have queued
+     * inside the driver. A transport must invoke this before it frees
+     * (or allows its caller to free) payload data passed to sendPacket,
+     * since a driver may refer to that data in place until the packet
+     * has been transmitted.
+     */
+    virtual void flushPackets() {}
+
     /**
      * The maximum number of bytes this Driver can transmit in a single call
      * to sendPacket including both header and payload.
      */
     virtual uint32_t getMaxPacketSize() = 0;
 
+    /**
+     * Returns the highest priority level that may be passed to sendPacket;
+     * packets with higher priorities are transmitted ahead of those with
+     * lower ones when they meet in the network. The default of 0 is for
+     * drivers (or networks) that don't support priorities, in which case
+     * all packets are treated alike.
+     */
+    virtual int getHighestPacketPriority() { return 0; }
+
     /**
      * Invoked by a transport when it has finished processing the data
      * in an incoming packet; used by drivers to recycle packet buffers
@@ -242,12 +260,18 @@ class Driver {
      *      portion of the packet after the header).  May be NULL to
      *      indicate "no payload". Note: caller must preserve the buffer
      *      data (but not the actual iterator) even after the method returns,
-     *      since the data may not yet have been transmitted.
+     *      since the data may not yet have been transmitted; once
+     *      #flushPackets has returned the data may be freed.
+     * \param priority
+     *      Network priority for the packet, from 0 (lowest) up to the
+     *      value returned by #getHighestPacketPriority. Drivers without
+     *      priority support ignore this.
      */
     virtual void sendPacket(const Address* recipient,
                             const void* header,
                             uint32_t headerLen,
-                            Buffer::Iterator *payload) = 0;
+                            Buffer::Iterator *payload,
+                            int priority = 0) = 0;
 
     /**
      * Alternate form of sendPacket.
@@ -265,13 +289,16 @@ class Driver {
      *      indicate "no payload". Note: caller must preserve the buffer
      *      data (but not the actual iterator) even after the method returns,
      *      since the data may not yet have been transmitted.
+     * \param priority
+     *      Network priority for the packet; see above.
      */
     template<typename T>
     void sendPacket(const Address* recipient,
                             const T* header,
-                            Buffer::Iterator *payload)
+                            Buffer::Iterator *payload,
+                            int priority = 0)
     {
-        sendPacket(recipient, header, sizeof(T), payload);
+        sendPacket(recipient, header, sizeof(T), payload, priority);
     }
 
     /**
@@ -135,8 +135,20 @@ appendObjectsToBuffer(Log& log,
         Buffer objectBuffer;
         log.getEntry(references[index], objectBuffer);
 
-        Object object(objectBuffer);
-        uint32_t length = objectBuffer.size();
+        // Objects whose values are compressed in the log are rebuilt with
+        // their values decompressed; clients never see compressed values.
+        Buffer keysAndValue;
+        Buffer decompressedBuffer;
+        Buffer* source = &objectBuffer;
+        if (Object(objectBuffer).isValueCompressed()) {
+            Object compressed(objectBuffer);
+            compressed.decompressValue(keysAndValue);
+            compressed.assembleForLog(decompressedBuffer);
+            source = &decompressedBuffer;
+        }
+
+        Object object(*source);
+        uint32_t length = source->size();
         if (keysOnly) {
             uint32_t dataLength = object.getValueLength();
             length -= dataLength;
@@ -147,7 +159,7 @@ appendObjectsToBuffer(Log& log,
         }
 
         buffer->emplaceAppend<uint32_t>(length);
-        buffer->append(&objectBuffer, 0, length);
+        buffer->append(source, 0, length);
     }
 
     return -1;
@@ -0,0 +1,256 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "ErasureCode.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+namespace {
+
+/**
+ * Arithmetic in GF(2^8), generated by the polynomial x^8 + x^4 + x^3 + x^2 + 1
+ * (0x11d). Addition is exclusive or; multiplication goes through a table.
+ */
+struct GaloisField {
+    GaloisField()
+        : exp()
+        , log()
+        , product()
+    {
+        uint32_t x = 1;
+        for (uint32_t i = 0; i < 255; i++) {
+            exp[i] = downCast<uint8_t>(x);
+            exp[i + 255] = downCast<uint8_t>(x);
+            log[x] = downCast<uint8_t>(i);
+            x <<= 1;
+            if (x & 0x100)
+                x ^= 0x11d;
+        }
+        for (uint32_t a = 1; a < 256; a++) {
+            for (uint32_t b = 1; b < 256; b++)
+                product[a][b] = exp[log[a] + log[b]];
+        }
+    }
+
+    /// Return the multiplicative inverse of a (which must be nonzero).
+    uint8_t
+    inverse(uint8_t a) const
+    {
+        return exp[255 - log[a]];
+    }
+
+    /**
+     * Add \a coefficient times each byte of \a source to the corresponding
+     * byte of \a destination.
+     */
+    void
+    multiplyAdd(uint8_t coefficient, const uint8_t* source,
+                uint8_t* destination, uint32_t length) const
+    {
+        if (coefficient == 0)
+            return;
+        if (coefficient == 1) {
+            for (uint32_t i = 0; i < length; i++)
+                destination[i] ^= source[i];
+            return;
+        }
+        const uint8_t* row = product[coefficient];
+        for (uint32_t i = 0; i < length; i++)
+            destination[i] ^= row[source[i]];
+    }
+
+    /// exp[i] is the generator raised to the power i (for i < 510).
+    uint8_t exp[510];
+
+    /// log[x] is the power to which the generator is raised to give x.
+    uint8_t log[256];
+
+    /// product[a][b] is a times b.
+    uint8_t product[256][256];
+};
+
+const GaloisField&
+field()
+{
+    static GaloisField gf;
+    return gf;
+}
+
+}
+
+/**
+ * Construct an RS(k, m) code.
+ *
+ * \param dataFragments
+ *      k: the number of fragments the data is split into, and the number
+ *      needed to rebuild it. Must be at least 1.
+ * \param parityFragments
+ *      m: the number of additional fragments computed; up to this many
+ *      fragments may be lost. k + m must be at most 256.
+ * \throw FatalError
+ *      If k and m are out of range.
+ */
+ErasureCode::ErasureCode(uint32_t dataFragments, uint32_t parityFragments)
+    : dataFragments(dataFragments)
+    , parityFragments(parityFragments)
+    , matrix((dataFragments + parityFragments) * dataFragments)
+{
+    if (dataFragments == 0 || dataFragments + parityFragments > 256) {
+        throw FatalError(HERE, format("Invalid erasure code RS(%u, %u)",
+                                      dataFragments, parityFragments));
+    }
+
+    const GaloisField& gf = field();
+    for (uint32_t i = 0; i < dataFragments; i++)
+        matrix[i * dataFragments + i] = 1;
+
+    // Parity row i, column j is 1 / (x_i + y_j), with x_i = k + i and
+    // y_j = j: all of the x's and y's are distinct, so this is a Cauchy
+    // matrix.
+    for (uint32_t i = 0; i < parityFragments; i++) {
+        uint32_t row = dataFragments + i;
+        for (uint32_t j = 0; j < dataFragments; j++) {
+            matrix[row * dataFragments + j] =
+                    gf.inverse(downCast<uint8_t>(row ^ j));
+        }
+    }
+}
+
+/**
+ * Split data into fragments and compute the parity fragments.
+ *
+ * \param data
+ *      Data to encode.
+ * \param length
+ *      Number of bytes at \a data.
+ * \param fragments
+ *      Where to store the k + m fragments, in order (data fragments first);
+ *      each must have room for getFragmentLength(length) bytes.
+ */
+void
+ErasureCode::encode(const void* data, uint32_t length,
+                    const std::vector<void*>& fragments) const
+{
+    assert(fragments.size() == getFragmentCount());
+    const GaloisField& gf = field();
+    const uint8_t* input = static_cast<const uint8_t*>(data);
+    const uint32_t fragmentLength = getFragmentLength(length);
+
+    for (uint32_t j = 0; j < dataFragments; j++) {
+        uint32_t start = std::min(j * fragmentLength, length);
+        uint32_t bytes = std::min(fragmentLength, length - start);
+        memcpy(fragments[j], input + start, bytes);
+        memset(static_cast<uint8_t*>(fragments[j]) + bytes, 0,
+               fragmentLength - bytes);
+    }
+
+    for (uint32_t row = dataFragments; row < getFragmentCount(); row++) {
+        uint8_t* parity = static_cast<uint8_t*>(fragments[row]);
+        memset(parity, 0, fragmentLength);
+        for (uint32_t j = 0; j < dataFragments; j++) {
+            gf.multiplyAdd(coefficient(row, j),
+                           static_cast<const uint8_t*>(fragments[j]),
+                           parity, fragmentLength);
+        }
+    }
+}
+
+/**
+ * Rebuild data from any k of its fragments.
+ *
+ * \param fragments
+ *      The k + m fragments produced by #encode, in order; NULL for those
+ *      that are unavailable.
+ * \param length
+ *      Number of bytes of data that were encoded.
+ * \param data
+ *      Where to store the rebuilt data; must have room for \a length bytes.
+ * \return
+ *      True if the data was rebuilt; false if fewer than k fragments
+ *      were available.
+ */
+bool
+ErasureCode::decode(const std::vector<const void*>& fragments,
+                    uint32_t length, void* data) const
+{
+    assert(fragments.size() == getFragmentCount());
+    const GaloisField& gf = field();
+    uint8_t* output = static_cast<uint8_t*>(data);
+    const uint32_t fragmentLength = getFragmentLength(length);
+    const uint32_t k = dataFragments;
+
+    // Use the first k fragments available; data fragments come first, so
+    // as few as possible need to be computed.
+    std::vector<uint32_t> rows;
+    for (uint32_t i = 0; i < getFragmentCount() && rows.size() < k; i++) {
+        if (fragments[i] != NULL)
+            rows.push_back(i);
+    }
+    if (rows.size() < k)
+        return false;
+
+    // Invert the rows of the encoding matrix for the fragments used, with
+    // Gauss-Jordan elimination. Row j of the inverse gives data fragment j
+    // as a combination of them.
+    std::vector<uint8_t> a(k * k);
+    std::vector<uint8_t> inverse(k * k);
+    for (uint32_t r = 0; r < k; r++) {
+        for (uint32_t c = 0; c < k; c++)
+            a[r * k + c] = coefficient(rows[r], c);
+        inverse[r * k + r] = 1;
+    }
+    for (uint32_t c = 0; c < k; c++) {
+        uint32_t pivot = c;
+        while (a[pivot * k + c] == 0)
+            pivot++;
+        if (pivot != c) {
+            for (uint32_t i = 0; i < k; i++) {
+                std::swap(a[pivot * k + i], a[c * k + i]);
+                std::swap(inverse[pivot * k + i], inverse[c * k + i]);
+            }
+        }
+        uint8_t scale = gf.inverse(a[c * k + c]);
+        for (uint32_t i = 0; i < k; i++) {
+            a[c * k + i] = gf.product[scale][a[c * k + i]];
+            inverse[c * k + i] = gf.product[scale][inverse[c * k + i]];
+        }
+        for (uint32_t r = 0; r < k; r++) {
+            uint8_t factor = a[r * k + c];
+            if (r == c || factor == 0)
+                continue;
+            gf.multiplyAdd(factor, &a[c * k], &a[r * k], k);
+            gf.multiplyAdd(factor, &inverse[c * k], &inverse[r * k], k);
+        }
+    }
+
+    for (uint32_t j = 0; j < k; j++) {
+        uint32_t start = std::min(j * fragmentLength, length);
+        uint32_t bytes = std::min(fragmentLength, length - start);
+        if (fragments[j] != NULL) {
+            memcpy(output + start, fragments[j], bytes);
+            continue;
+        }
+        memset(output + start, 0, bytes);
+        for (uint32_t r = 0; r < k; r++) {
+            gf.multiplyAdd(inverse[j * k + r],
+                           static_cast<const uint8_t*>(fragments[rows[r]]),
+                           output + start, bytes);
+        }
+    }
+    return true;
+}
+
+} // namespace RAMCloud
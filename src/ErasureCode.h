@@ -0,0 +1,99 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_ERASURECODE_H
+#define RAMCLOUD_ERASURECODE_H
+
+#include <vector>
+
+#include "Common.h"
+
+namespace RAMCloud {
+
+/**
+ * A systematic Reed-Solomon code, RS(k, m), over GF(2^8). A block of data
+ * (such as a closed segment) is split into k data fragments of equal length,
+ * and m parity fragments of the same length are computed from them; the
+ * original data can be rebuilt from any k of the k + m fragments. Storing
+ * the fragments on k + m different backups tolerates the loss of any m of
+ * them, at a cost of (k + m) / k times the size of the data, rather than the
+ * m + 1 times needed by full replicas.
+ *
+ * The data fragments are just the data itself (padded with zeroes at the
+ * end), so the data can be read without decoding while they are all
+ * available. The parity fragments are computed with a Cauchy matrix, every
+ * square submatrix of which is invertible; this is what guarantees that any
+ * k fragments suffice.
+ *
+ * Instances are immutable, so they may be shared between threads.
+ */
+class ErasureCode {
+  public:
+    ErasureCode(uint32_t dataFragments, uint32_t parityFragments);
+
+    void encode(const void* data, uint32_t length,
+                const std::vector<void*>& fragments) const;
+    bool decode(const std::vector<const void*>& fragments, uint32_t length,
+                void* data) const;
+
+    /// Return k, the number of fragments needed to rebuild the data.
+    uint32_t getDataFragments() const { return dataFragments; }
+
+    /// Return m, the number of fragments that may be lost.
+    uint32_t getParityFragments() const { return parityFragments; }
+
+    /// Return k + m, the number of fragments produced by #encode.
+    uint32_t getFragmentCount() const
+    {
+        return dataFragments + parityFragments;
+    }
+
+    /**
+     * Return the length of each fragment for data of the given length.
+     */
+    uint32_t getFragmentLength(uint32_t length) const
+    {
+        return (length + dataFragments - 1) / dataFragments;
+    }
+
+  PRIVATE:
+    /**
+     * Return the coefficient by which data fragment \a column is multiplied
+     * in computing fragment \a row.
+     */
+    uint8_t coefficient(uint32_t row, uint32_t column) const
+    {
+        return matrix[row * dataFragments + column];
+    }
+
+    /// k: the number of data fragments.
+    const uint32_t dataFragments;
+
+    /// m: the number of parity fragments.
+    const uint32_t parityFragments;
+
+    /**
+     * The (k + m) x k encoding matrix, in row-major order: fragment i is
+     * the product of row i with the data fragments. The first k rows are
+     * the identity matrix.
+     */
+    std::vector<uint8_t> matrix;
+
+    DISALLOW_COPY_AND_ASSIGN(ErasureCode);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_ERASURECODE_H
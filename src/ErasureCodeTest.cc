@@ -0,0 +1,153 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+
+#include "ErasureCode.h"
+
+namespace RAMCloud {
+
+class ErasureCodeTest : public ::testing::Test {
+  public:
+    ErasureCode code;
+    string data;
+    std::vector<string> fragments;
+
+    ErasureCodeTest()
+        : code(4, 2)
+        , data()
+        , fragments()
+    {
+        // An odd length, so the last data fragment is padded.
+        for (int i = 0; i < 1001; i++)
+            data.push_back(static_cast<char>(i * 37 + (i >> 3)));
+        encode();
+    }
+
+    void
+    encode()
+    {
+        uint32_t length = downCast<uint32_t>(data.size());
+        fragments.assign(code.getFragmentCount(),
+                         string(code.getFragmentLength(length), 'x'));
+        std::vector<void*> pointers;
+        for (auto& fragment : fragments)
+            pointers.push_back(&fragment[0]);
+        code.encode(data.data(), length, pointers);
+    }
+
+    /**
+     * Decode #fragments, treating those whose bit is set in \a missing as
+     * unavailable, and return the result (or "<failed>").
+     */
+    string
+    decode(uint32_t missing)
+    {
+        std::vector<const void*> pointers;
+        for (uint32_t i = 0; i < fragments.size(); i++)
+            pointers.push_back((missing & (1 << i)) ? NULL
+                                                    : fragments[i].data());
+        string output(data.size(), '\0');
+        if (!code.decode(pointers, downCast<uint32_t>(data.size()),
+                         &output[0]))
+            return "<failed>";
+        return output;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(ErasureCodeTest);
+};
+
+TEST_F(ErasureCodeTest, constructor) {
+    EXPECT_EQ(4U, code.getDataFragments());
+    EXPECT_EQ(2U, code.getParityFragments());
+    EXPECT_EQ(6U, code.getFragmentCount());
+    EXPECT_EQ(1U, code.coefficient(0, 0));
+    EXPECT_EQ(0U, code.coefficient(0, 1));
+    EXPECT_EQ(1U, code.coefficient(3, 3));
+    EXPECT_NE(0U, code.coefficient(4, 0));
+    EXPECT_NE(0U, code.coefficient(5, 3));
+
+    EXPECT_THROW(ErasureCode(0, 2), FatalError);
+    EXPECT_THROW(ErasureCode(200, 57), FatalError);
+    ErasureCode largest(200, 56);
+    EXPECT_EQ(256U, largest.getFragmentCount());
+}
+
+TEST_F(ErasureCodeTest, getFragmentLength) {
+    EXPECT_EQ(0U, code.getFragmentLength(0));
+    EXPECT_EQ(1U, code.getFragmentLength(1));
+    EXPECT_EQ(1U, code.getFragmentLength(4));
+    EXPECT_EQ(2U, code.getFragmentLength(5));
+    EXPECT_EQ(251U, code.getFragmentLength(1001));
+}
+
+TEST_F(ErasureCodeTest, encode) {
+    // Data fragments are just the data, with the last one zero-padded.
+    EXPECT_EQ(data.substr(0, 251), fragments[0]);
+    EXPECT_EQ(data.substr(753, 248), fragments[3].substr(0, 248));
+    EXPECT_EQ(string(3, '\0'), fragments[3].substr(248));
+
+    // Each parity byte depends on every data fragment.
+    string before = fragments[4];
+    data[753] ^= 1;
+    encode();
+    EXPECT_NE(before[0], fragments[4][0]);
+    EXPECT_EQ(before.substr(1), fragments[4].substr(1));
+}
+
+TEST_F(ErasureCodeTest, decode_allFragments) {
+    EXPECT_EQ(data, decode(0));
+}
+
+TEST_F(ErasureCodeTest, decode_anyTwoMissing) {
+    for (uint32_t i = 0; i < 6; i++) {
+        for (uint32_t j = i; j < 6; j++) {
+            EXPECT_EQ(data, decode((1 << i) | (1 << j)))
+                    << "missing " << i << " and " << j;
+        }
+    }
+}
+
+TEST_F(ErasureCodeTest, decode_tooFewFragments) {
+    EXPECT_EQ("<failed>", decode(0x7));
+    EXPECT_EQ("<failed>", decode(0x38));
+}
+
+TEST_F(ErasureCodeTest, decode_shortData) {
+    data = "ab";
+    encode();
+    EXPECT_EQ(1U, fragments[0].size());
+    EXPECT_EQ(string(1, '\0'), fragments[2]);
+    EXPECT_EQ("ab", decode(0x3));
+    EXPECT_EQ("ab", decode(0x30));
+}
+
+TEST_F(ErasureCodeTest, decode_onlyParityNeeded) {
+    ErasureCode mirror(1, 3);
+    data = "mirrored";
+    std::vector<string> copies(4, string(data.size(), 'x'));
+    std::vector<void*> pointers;
+    for (auto& copy : copies)
+        pointers.push_back(&copy[0]);
+    mirror.encode(data.data(), downCast<uint32_t>(data.size()), pointers);
+
+    std::vector<const void*> available = {NULL, NULL, NULL, copies[3].data()};
+    string output(data.size(), '\0');
+    EXPECT_TRUE(mirror.decode(available, downCast<uint32_t>(data.size()),
+                              &output[0]));
+    EXPECT_EQ(data, output);
+}
+
+}  // namespace RAMCloud
@@ -0,0 +1,448 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+#include "FileIoUring.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+/**
+ * Default object used to make system calls.
+ */
+static Syscall defaultSyscall;
+
+/**
+ * Used by this class to make all system calls.  In normal production
+ * use it points to defaultSyscall; for testing it points to a mock
+ * object.
+ */
+Syscall* FileIoUring::sys = &defaultSyscall;
+
+/**
+ * Construct a FileIoUring: create the io_uring instance, map its rings,
+ * and register the files with the kernel.
+ *
+ * \param fds
+ *      Open file descriptors for the files to read and write; requests
+ *      refer to files by their index in this vector. The caller remains
+ *      responsible for closing them (after destroying this object).
+ * \param entries
+ *      Number of requests that may be outstanding at once. The kernel may
+ *      round this up.
+ *
+ * \throw FatalError
+ *      The kernel doesn't support io_uring or the reads and writes used
+ *      by this class.
+ */
+FileIoUring::FileIoUring(const std::vector<int>& fds, uint32_t entries)
+    : ringFd(-1)
+    , sqEntries(0)
+    , submissionRing(MAP_FAILED)
+    , submissionRingSize(0)
+    , completionRing(MAP_FAILED)
+    , completionRingSize(0)
+    , sqes(static_cast<io_uring_sqe*>(MAP_FAILED))
+    , sqHead(NULL)
+    , sqTail(NULL)
+    , sqArray(NULL)
+    , sqMask(0)
+    , cqHead(NULL)
+    , cqTail(NULL)
+    , cqMask(0)
+    , cqes(NULL)
+    , localSqTail(0)
+    , fds(fds)
+    , filesRegistered(false)
+    , buffersRegistrable(false)
+    , registeredBuffers()
+    , requests()
+    , freeRequests()
+{
+    // The destructor won't run if construction fails part way, so clean
+    // up explicitly on errors.
+    try {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        ringFd = sys->ioUringSetup(entries, &params);
+        if (ringFd < 0) {
+            throw FatalError(HERE, "io_uring_setup failed", errno);
+        }
+
+        // Plain (non-vectored) reads and writes arrived in Linux 5.6,
+        // together with probing.
+        char probeSpace[sizeof(io_uring_probe) +
+                256 * sizeof(io_uring_probe_op)];
+        memset(probeSpace, 0, sizeof(probeSpace));
+        io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(probeSpace);
+        if (sys->ioUringRegister(ringFd, IORING_REGISTER_PROBE, probe,
+                256) != 0) {
+            throw FatalError(HERE, "io_uring probe failed", errno);
+        }
+        if ((probe->last_op < IORING_OP_WRITE) ||
+                !(probe->ops[IORING_OP_READ].flags &
+                IO_URING_OP_SUPPORTED) ||
+                !(probe->ops[IORING_OP_WRITE].flags &
+                IO_URING_OP_SUPPORTED)) {
+            throw FatalError(HERE, "kernel doesn't support io_uring reads "
+                    "and writes");
+        }
+
+        submissionRingSize = params.sq_off.array +
+                params.sq_entries * sizeof(uint32_t);
+        completionRingSize = params.cq_off.cqes +
+                params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            submissionRingSize = completionRingSize =
+                    std::max(submissionRingSize, completionRingSize);
+        }
+        submissionRing = mmap(NULL, submissionRingSize,
+                PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ringFd,
+                IORING_OFF_SQ_RING);
+        if (submissionRing == MAP_FAILED) {
+            throw FatalError(HERE, "couldn't map io_uring submission ring",
+                    errno);
+        }
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            completionRing = submissionRing;
+        } else {
+            completionRing = mmap(NULL, completionRingSize,
+                    PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ringFd,
+                    IORING_OFF_CQ_RING);
+            if (completionRing == MAP_FAILED) {
+                throw FatalError(HERE,
+                        "couldn't map io_uring completion ring", errno);
+            }
+        }
+        sqes = static_cast<io_uring_sqe*>(mmap(NULL,
+                params.sq_entries * sizeof(io_uring_sqe),
+                PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ringFd,
+                IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) {
+            throw FatalError(HERE, "couldn't map io_uring submission entries",
+                    errno);
+        }
+
+        char* sq = static_cast<char*>(submissionRing);
+        sqHead = reinterpret_cast<uint32_t*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+        sqArray = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+        sqMask = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+        localSqTail = *sqTail;
+        char* cq = static_cast<char*>(completionRing);
+        cqHead = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        // Never allow more requests outstanding than there are submission
+        // entries; since the completion ring is twice as large, it can't
+        // overflow.
+        sqEntries = params.sq_entries;
+        requests.resize(params.sq_entries);
+        for (uint32_t i = params.sq_entries; i > 0; i--) {
+            freeRequests.push_back(i - 1);
+        }
+
+        // Registration is an optimization, so failures here aren't fatal
+        // (e.g., registered buffers count against RLIMIT_MEMLOCK, and
+        // sparse tables need Linux 5.19).
+        std::vector<int> fdArray(fds);
+        filesRegistered = (sys->ioUringRegister(ringFd, IORING_REGISTER_FILES,
+                fdArray.data(), downCast<uint32_t>(fdArray.size())) == 0);
+        io_uring_rsrc_register table;
+        memset(&table, 0, sizeof(table));
+        table.nr = MAX_REGISTERED_BUFFERS;
+        table.flags = IORING_RSRC_REGISTER_SPARSE;
+        buffersRegistrable = (sys->ioUringRegister(ringFd,
+                IORING_REGISTER_BUFFERS2, &table, sizeof(table)) == 0);
+    } catch (...) {
+        release();
+        throw;
+    }
+}
+
+/**
+ * Destructor for FileIoUring. Requests still outstanding are cancelled,
+ * so callers should normally wait for them to complete first.
+ */
+FileIoUring::~FileIoUring()
+{
+    release();
+}
+
+/**
+ * Retrieve the completion of a request, if any have completed, without
+ * blocking.
+ *
+ * \param[out] request
+ *      Filled in with the description of the request that completed.
+ * \param[out] result
+ *      Filled in with the number of bytes transferred by the request, or a
+ *      negated errno value if it failed.
+ * \return
+ *      True if a completion was returned; false if no outstanding request
+ *      has completed.
+ */
+bool
+FileIoUring::getCompletion(Request* request, int* result)
+{
+    uint32_t head = *cqHead;
+    if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    io_uring_cqe* cqe = &cqes[head & cqMask];
+    uint32_t id = downCast<uint32_t>(cqe->user_data);
+    *result = cqe->res;
+    __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+    *request = requests[id];
+    freeRequests.push_back(id);
+    return true;
+}
+
+/**
+ * Return true if the given buffer was registered with #registerBuffer.
+ *
+ * \param buffer
+ *      Start of the buffer.
+ */
+bool
+FileIoUring::isRegistered(void* buffer) const
+{
+    return registeredBuffers.find(static_cast<char*>(buffer)) !=
+            registeredBuffers.end();
+}
+
+/**
+ * Queue a read; it will be passed to the kernel by the next call to
+ * #submit. The caller must ensure that #getAvailableRequests is nonzero.
+ *
+ * \param tag
+ *      Identifies the request in its completion.
+ * \param fileIndex
+ *      Index in the fds passed to the constructor of the file to read.
+ * \param buffer
+ *      Where to store the data read. Must remain valid until the request
+ *      completes.
+ * \param length
+ *      Number of bytes to read.
+ * \param offset
+ *      Offset in the file of the first byte to read.
+ */
+void
+FileIoUring::read(uint64_t tag, uint32_t fileIndex, void* buffer,
+                  size_t length, off_t offset)
+{
+    prepare(IORING_OP_READ, IORING_OP_READ_FIXED, tag, fileIndex, buffer,
+            length, offset, false);
+}
+
+/**
+ * Register a buffer with the kernel, so that the pages of the buffer are
+ * pinned once, rather than by every read or write that uses it. Buffers
+ * remain registered until this object is destroyed, so they must not be
+ * freed before then.
+ *
+ * \param buffer
+ *      Start of the buffer.
+ * \param length
+ *      Size of the buffer in bytes.
+ * \return
+ *      True if the buffer is registered; false if it couldn't be (reads
+ *      and writes using it still work, but are a bit slower).
+ */
+bool
+FileIoUring::registerBuffer(void* buffer, size_t length)
+{
+    if (isRegistered(buffer)) {
+        return true;
+    }
+    if (!buffersRegistrable ||
+            (registeredBuffers.size() >= MAX_REGISTERED_BUFFERS)) {
+        return false;
+    }
+    uint16_t index = downCast<uint16_t>(registeredBuffers.size());
+    iovec iov;
+    iov.iov_base = buffer;
+    iov.iov_len = length;
+    io_uring_rsrc_update2 update;
+    memset(&update, 0, sizeof(update));
+    update.offset = index;
+    update.data = reinterpret_cast<uint64_t>(&iov);
+    update.nr = 1;
+    if (sys->ioUringRegister(ringFd, IORING_REGISTER_BUFFERS_UPDATE, &update,
+            sizeof(update)) < 0) {
+        LOG(WARNING, "Couldn't register buffer with io_uring (%s); IO will "
+                "use unregistered buffers from now on", strerror(errno));
+        buffersRegistrable = false;
+        return false;
+    }
+    registeredBuffers[static_cast<char*>(buffer)] = {length, index};
+    return true;
+}
+
+/**
+ * Pass all of the requests queued by #read and #write that the kernel
+ * hasn't yet consumed to it, in a single system call.
+ *
+ * \throw FatalError
+ *      The kernel refused the requests.
+ */
+void
+FileIoUring::submit()
+{
+    uint32_t count = localSqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    if (count == 0) {
+        return;
+    }
+    __atomic_store_n(sqTail, localSqTail, __ATOMIC_RELEASE);
+    while (sys->ioUringEnter(ringFd, count, 0, 0) < 0) {
+        // EAGAIN and EBUSY are transient resource shortages.
+        if ((errno != EAGAIN) && (errno != EBUSY) && (errno != EINTR)) {
+            throw FatalError(HERE, "io_uring_enter failed", errno);
+        }
+    }
+}
+
+/**
+ * Submit any queued requests, then block until at least one outstanding
+ * request has completed (returns immediately if there are no outstanding
+ * requests or a completion is already available).
+ *
+ * \throw FatalError
+ *      The kernel refused the requests.
+ */
+void
+FileIoUring::waitForCompletion()
+{
+    submit();
+    while ((getOutstandingRequests() > 0) &&
+            (*cqHead == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))) {
+        if (sys->ioUringEnter(ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0) {
+            if ((errno != EAGAIN) && (errno != EBUSY) && (errno != EINTR)) {
+                throw FatalError(HERE, "io_uring_enter failed", errno);
+            }
+        }
+    }
+}
+
+/**
+ * Queue a write; it will be passed to the kernel by the next call to
+ * #submit. The caller must ensure that #getAvailableRequests is nonzero.
+ *
+ * \param tag
+ *      Identifies the request in its completion.
+ * \param fileIndex
+ *      Index in the fds passed to the constructor of the file to write.
+ * \param buffer
+ *      Data to write. Must remain valid until the request completes.
+ * \param length
+ *      Number of bytes to write.
+ * \param offset
+ *      Offset in the file at which to write the first byte.
+ */
+void
+FileIoUring::write(uint64_t tag, uint32_t fileIndex, const void* buffer,
+                   size_t length, off_t offset)
+{
+    prepare(IORING_OP_WRITE, IORING_OP_WRITE_FIXED, tag, fileIndex,
+            const_cast<void*>(buffer), length, offset, true);
+}
+
+// - private -
+
+/**
+ * Fill in a submission entry for a read or write (shared code for #read
+ * and #write). The fixed-buffer form of the operation is used if the
+ * data lies within a registered buffer.
+ */
+void
+FileIoUring::prepare(uint8_t opcode, uint8_t fixedOpcode, uint64_t tag,
+                     uint32_t fileIndex, void* buffer, size_t length,
+                     off_t offset, bool write)
+{
+    if (freeRequests.empty()) {
+        throw FatalError(HERE, "too many outstanding io_uring requests");
+    }
+    uint32_t id = freeRequests.back();
+    freeRequests.pop_back();
+    Request& request = requests[id];
+    request.tag = tag;
+    request.fileIndex = fileIndex;
+    request.write = write;
+    request.offset = offset;
+    request.length = length;
+
+    uint32_t index = localSqTail & sqMask;
+    io_uring_sqe* sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqArray[index] = index;
+    localSqTail++;
+
+    sqe->opcode = opcode;
+    if (filesRegistered) {
+        sqe->fd = fileIndex;
+        sqe->flags = IOSQE_FIXED_FILE;
+    } else {
+        sqe->fd = fds[fileIndex];
+    }
+    sqe->addr = reinterpret_cast<uint64_t>(buffer);
+    sqe->len = downCast<uint32_t>(length);
+    sqe->off = offset;
+    sqe->user_data = id;
+
+    // Find the registered buffer (if any) that starts at or before the
+    // data, and check whether the data fits inside it.
+    char* start = static_cast<char*>(buffer);
+    std::map<char*, std::pair<size_t, uint16_t>>::iterator it =
+            registeredBuffers.upper_bound(start);
+    if (it != registeredBuffers.begin()) {
+        --it;
+        if (start + length <= it->first + it->second.first) {
+            sqe->opcode = fixedOpcode;
+            sqe->buf_index = it->second.second;
+        }
+    }
+}
+
+/**
+ * Close the io_uring instance and unmap its rings (whatever has been
+ * set up so far, if the constructor failed).
+ */
+void
+FileIoUring::release()
+{
+    if (ringFd >= 0) {
+        sys->close(ringFd);
+        ringFd = -1;
+    }
+    if (sqes != MAP_FAILED) {
+        munmap(sqes, sqEntries * sizeof(io_uring_sqe));
+        sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    }
+    if ((completionRing != MAP_FAILED) && (completionRing != submissionRing)) {
+        munmap(completionRing, completionRingSize);
+    }
+    completionRing = MAP_FAILED;
+    if (submissionRing != MAP_FAILED) {
+        munmap(submissionRing, submissionRingSize);
+        submissionRing = MAP_FAILED;
+    }
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,176 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_FILEIOURING_H
+#define RAMCLOUD_FILEIOURING_H
+
+#include <map>
+
+#include "Common.h"
+#include "Syscall.h"
+
+// Defined in <linux/io_uring.h>, which isn't included here because it
+// defines macros (such as BLOCK_SIZE) that collide with names in RAMCloud.
+struct io_uring_cqe;
+struct io_uring_sqe;
+
+namespace RAMCloud {
+
+/**
+ * A FileIoUring issues reads and writes on a fixed set of files through a
+ * Linux io_uring instance. Compared with POSIX AIO (which glibc emulates with
+ * a pool of threads that each make a blocking system call), any number of
+ * requests can be handed to the kernel with a single system call, and
+ * completions are reaped from memory shared with the kernel. The files are
+ * registered with the kernel when the ring is created, and buffers may be
+ * registered too (see #registerBuffer), which saves the kernel from looking
+ * up the file and pinning the pages of the buffer on every request.
+ *
+ * Requests are queued with #read and #write and passed to the kernel
+ * together by #submit; completions are retrieved with #getCompletion and
+ * #waitForCompletion. This class is not thread-safe: it is intended to be
+ * driven by a single thread, such as the IO thread of MultiFileStorage.
+ */
+class FileIoUring {
+  public:
+    /**
+     * Describes a read or write made with #read or #write; returned by
+     * #getCompletion once the request has completed.
+     */
+    struct Request {
+        /// Value supplied by the caller to identify the request.
+        uint64_t tag;
+
+        /// Index (in the fds passed to the constructor) of the file read
+        /// or written.
+        uint32_t fileIndex;
+
+        /// True for writes, false for reads.
+        bool write;
+
+        /// Offset in the file of the first byte read or written.
+        off_t offset;
+
+        /// Number of bytes requested.
+        size_t length;
+    };
+
+    FileIoUring(const std::vector<int>& fds, uint32_t entries);
+    ~FileIoUring();
+    bool getCompletion(Request* request, int* result);
+    bool isRegistered(void* buffer) const;
+    void read(uint64_t tag, uint32_t fileIndex, void* buffer, size_t length,
+              off_t offset);
+    bool registerBuffer(void* buffer, size_t length);
+    void submit();
+    void waitForCompletion();
+    void write(uint64_t tag, uint32_t fileIndex, const void* buffer,
+               size_t length, off_t offset);
+
+    /**
+     * Return the number of additional requests that can be made before
+     * some of the outstanding ones must complete.
+     */
+    uint32_t getAvailableRequests() const
+    {
+        return downCast<uint32_t>(freeRequests.size());
+    }
+
+    /**
+     * Return the number of requests that have been made but whose
+     * completions haven't been returned by #getCompletion.
+     */
+    uint32_t getOutstandingRequests() const
+    {
+        return downCast<uint32_t>(requests.size() - freeRequests.size());
+    }
+
+    /// Maximum number of buffers that may be registered.
+    static const uint32_t MAX_REGISTERED_BUFFERS = 128;
+
+    static Syscall* sys;
+
+  PRIVATE:
+    void prepare(uint8_t opcode, uint8_t fixedOpcode, uint64_t tag,
+                 uint32_t fileIndex, void* buffer, size_t length,
+                 off_t offset, bool write);
+    void release();
+
+    /// File descriptor for the io_uring instance.
+    int ringFd;
+
+    /// Number of entries in the submission ring (as returned by
+    /// io_uring_setup).
+    uint32_t sqEntries;
+
+    /// Memory shared with the kernel for the submission ring's indexes, and
+    /// its length in bytes.
+    void* submissionRing;
+    size_t submissionRingSize;
+
+    /// Memory shared with the kernel for the completion ring, and its
+    /// length in bytes.
+    void* completionRing;
+    size_t completionRingSize;
+
+    /// Submission queue entries (shared with the kernel).
+    io_uring_sqe* sqes;
+
+    /// Pointers into submissionRing.
+    uint32_t* sqHead;
+    uint32_t* sqTail;
+    uint32_t* sqArray;
+    uint32_t sqMask;
+
+    /// Pointers into completionRing.
+    uint32_t* cqHead;
+    uint32_t* cqTail;
+    uint32_t cqMask;
+    io_uring_cqe* cqes;
+
+    /// Our copy of the submission ring's tail: entries up to here have been
+    /// filled in, but the kernel isn't told about those beyond *sqTail
+    /// until #submit is called.
+    uint32_t localSqTail;
+
+    /// The files read and written, in the order of their registration
+    /// with the kernel.
+    std::vector<int> fds;
+
+    /// True if #fds were registered with the kernel, so that requests
+    /// can refer to files by index.
+    bool filesRegistered;
+
+    /// True if the kernel provided a (sparse) table for registered
+    /// buffers; false means #registerBuffer always fails.
+    bool buffersRegistrable;
+
+    /// Buffers registered with the kernel: maps from the start of each
+    /// buffer to its length and its index in the kernel's table.
+    std::map<char*, std::pair<size_t, uint16_t>> registeredBuffers;
+
+    /// Descriptions of requests, indexed by the user_data of their
+    /// submissions; entries not listed in #freeRequests are outstanding.
+    std::vector<Request> requests;
+
+    /// Indexes of the entries in #requests that are available for use.
+    std::vector<uint32_t> freeRequests;
+
+    DISALLOW_COPY_AND_ASSIGN(FileIoUring);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_FILEIOURING_H
@@ -0,0 +1,213 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+
+#include "TestUtil.h"
+#include "FileIoUring.h"
+#include "MockSyscall.h"
+
+namespace RAMCloud {
+
+class FileIoUringTest : public ::testing::Test {
+  public:
+    const char* path1;
+    const char* path2;
+    std::vector<int> fds;
+    Tub<FileIoUring> ring;
+
+    FileIoUringTest()
+        : path1("/tmp/ramcloud-file-io-uring-test-delete-this-1")
+        , path2("/tmp/ramcloud-file-io-uring-test-delete-this-2")
+        , fds()
+        , ring()
+    {
+        fds.push_back(open(path1, O_CREAT | O_RDWR | O_TRUNC, 0666));
+        fds.push_back(open(path2, O_CREAT | O_RDWR | O_TRUNC, 0666));
+        ring.construct(fds, 8);
+    }
+
+    ~FileIoUringTest()
+    {
+        ring.destroy();
+        close(fds[0]);
+        close(fds[1]);
+        unlink(path1);
+        unlink(path2);
+    }
+
+    // Wait for the next completion and return a description of it.
+    string
+    nextCompletion()
+    {
+        FileIoUring::Request request;
+        int result;
+        ring->waitForCompletion();
+        if (!ring->getCompletion(&request, &result)) {
+            return "no completion";
+        }
+        return format("tag %lu file %u %s %lu bytes at %lu: %d", request.tag,
+                request.fileIndex, request.write ? "write" : "read",
+                request.length, request.offset, result);
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(FileIoUringTest);
+};
+
+TEST_F(FileIoUringTest, constructor) {
+    EXPECT_TRUE(ring->filesRegistered);
+    EXPECT_EQ(8u, ring->getAvailableRequests());
+    EXPECT_EQ(0u, ring->getOutstandingRequests());
+}
+
+TEST_F(FileIoUringTest, constructor_setupFails) {
+    MockSyscall sys;
+    sys.ioUringSetupErrno = ENOSYS;
+    Syscall* savedSyscall = FileIoUring::sys;
+    FileIoUring::sys = &sys;
+    string message("no exception");
+    try {
+        FileIoUring ring2(fds, 8);
+    } catch (FatalError& e) {
+        message = e.message;
+    }
+    FileIoUring::sys = savedSyscall;
+    EXPECT_EQ("io_uring_setup failed: Function not implemented", message);
+}
+
+TEST_F(FileIoUringTest, getCompletion) {
+    FileIoUring::Request request;
+    int result;
+    EXPECT_FALSE(ring->getCompletion(&request, &result));
+
+    char data[] = "abcdef";
+    ring->write(7, 1, data, 6, 100);
+    ring->submit();
+    EXPECT_EQ(1u, ring->getOutstandingRequests());
+    EXPECT_EQ("tag 7 file 1 write 6 bytes at 100: 6", nextCompletion());
+    EXPECT_EQ(0u, ring->getOutstandingRequests());
+    EXPECT_EQ(8u, ring->getAvailableRequests());
+    EXPECT_FALSE(ring->getCompletion(&request, &result));
+
+    // Errors are returned as negated errno values.
+    ring->read(8, 5, data, 6, 0);
+    ring->submit();
+    EXPECT_EQ("tag 8 file 5 read 6 bytes at 0: -9", nextCompletion());
+}
+
+TEST_F(FileIoUringTest, registerBuffer) {
+    char buffer[4096];
+    EXPECT_FALSE(ring->isRegistered(buffer));
+    EXPECT_TRUE(ring->registerBuffer(buffer, sizeof(buffer)));
+    EXPECT_TRUE(ring->isRegistered(buffer));
+    EXPECT_FALSE(ring->isRegistered(buffer + 1));
+
+    // Registering again is a no-op.
+    EXPECT_TRUE(ring->registerBuffer(buffer, sizeof(buffer)));
+    EXPECT_EQ(1u, ring->registeredBuffers.size());
+
+    // The table is full.
+    for (uint32_t i = 1; i < FileIoUring::MAX_REGISTERED_BUFFERS; i++) {
+        ring->registeredBuffers[buffer + i] = {1, downCast<uint16_t>(i)};
+    }
+    EXPECT_FALSE(ring->registerBuffer(buffer + 2048, 2048));
+
+    // Sparse tables aren't supported.
+    ring->registeredBuffers.clear();
+    ring->buffersRegistrable = false;
+    EXPECT_FALSE(ring->registerBuffer(buffer, sizeof(buffer)));
+}
+
+TEST_F(FileIoUringTest, registerBuffer_fails) {
+    TestLog::Enable _;
+    // Registering a buffer that doesn't exist fails.
+    EXPECT_FALSE(ring->registerBuffer(NULL, 4096));
+    EXPECT_EQ("registerBuffer: Couldn't register buffer with io_uring "
+              "(Bad address); IO will use unregistered buffers from now on",
+              TestLog::get());
+    EXPECT_FALSE(ring->buffersRegistrable);
+}
+
+TEST_F(FileIoUringTest, readAndWrite) {
+    char registered[8192];
+    ASSERT_TRUE(ring->registerBuffer(registered, sizeof(registered)));
+    char unregistered[100];
+    memcpy(registered + 1000, "registered", 10);
+    memcpy(unregistered, "unregistered", 12);
+
+    // Both writes go to the kernel in one system call; the first uses the
+    // registered buffer.
+    ring->write(1, 0, registered + 1000, 10, 0);
+    ring->write(2, 1, unregistered, 12, 50);
+    io_uring_sqe* sqe = &ring->sqes[(ring->localSqTail - 2) & ring->sqMask];
+    EXPECT_EQ(IORING_OP_WRITE_FIXED, sqe->opcode);
+    EXPECT_EQ(0, sqe->buf_index);
+    EXPECT_EQ(IOSQE_FIXED_FILE, sqe->flags);
+    sqe = &ring->sqes[(ring->localSqTail - 1) & ring->sqMask];
+    EXPECT_EQ(IORING_OP_WRITE, sqe->opcode);
+    ring->submit();
+    string completions = nextCompletion();
+    completions += "; " + nextCompletion();
+    EXPECT_TRUE(TestUtil::contains(completions,
+            "tag 1 file 0 write 10 bytes at 0: 10"));
+    EXPECT_TRUE(TestUtil::contains(completions,
+            "tag 2 file 1 write 12 bytes at 50: 12"));
+
+    // Data extending past the end of a registered buffer can't use it.
+    ring->read(3, 1, registered + 8190, 12, 50);
+    sqe = &ring->sqes[(ring->localSqTail - 1) & ring->sqMask];
+    EXPECT_EQ(IORING_OP_READ, sqe->opcode);
+    ring->submit();
+    EXPECT_EQ("tag 3 file 1 read 12 bytes at 50: 12", nextCompletion());
+
+    memset(registered, 0, sizeof(registered));
+    ring->read(4, 0, registered, 10, 0);
+    sqe = &ring->sqes[(ring->localSqTail - 1) & ring->sqMask];
+    EXPECT_EQ(IORING_OP_READ_FIXED, sqe->opcode);
+    ring->read(5, 1, registered + 100, 12, 50);
+    ring->submit();
+    nextCompletion();
+    nextCompletion();
+    EXPECT_EQ("registered", string(registered, 10));
+    EXPECT_EQ("unregistered", string(registered + 100, 12));
+}
+
+TEST_F(FileIoUringTest, readAndWrite_tooManyRequests) {
+    char data[10];
+    for (int i = 0; i < 8; i++) {
+        ring->read(i, 0, data, 0, 0);
+    }
+    EXPECT_EQ(0u, ring->getAvailableRequests());
+    EXPECT_THROW(ring->read(8, 0, data, 0, 0), FatalError);
+    ring->submit();
+    for (int i = 0; i < 8; i++) {
+        nextCompletion();
+    }
+    EXPECT_EQ(8u, ring->getAvailableRequests());
+}
+
+TEST_F(FileIoUringTest, waitForCompletion_nothingOutstanding) {
+    // Must return immediately.
+    ring->waitForCompletion();
+}
+
+TEST_F(FileIoUringTest, waitForCompletion_submits) {
+    char data[] = "xyz";
+    ring->write(9, 0, data, 3, 0);
+    EXPECT_EQ("tag 9 file 0 write 3 bytes at 0: 3", nextCompletion());
+}
+
+}  // namespace RAMCloud
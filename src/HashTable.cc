@@ -13,11 +13,18 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <immintrin.h>
+
 #include "Common.h"
+#include "Fence.h"
 #include "HashTable.h"
 
 namespace RAMCloud {
 
+HashTable::TagMatchFunction HashTable::matchTags =
+        &HashTable::matchTagsFirstCall;
+HashTable::TagMatchMode HashTable::tagMatchMode = TAG_MATCH_SCALAR;
+
 /**
  * Reinitialize a hash table entry as unused.
  */
@@ -168,8 +175,10 @@ HashTable::Entry::unpack(UnpackedEntry& ue) const
  * Construct an empty set of candidates.
  */
 HashTable::Candidates::Candidates()
-    : bucket(NULL)
+    : table(NULL)
+    , bucket(NULL)
     , index()
+    , matches()
     , secondaryHash()
 {
 }
@@ -180,11 +189,14 @@ HashTable::Candidates::Candidates()
  * given secondaryHash.
  */
 void
-HashTable::Candidates::init(CacheLine* cl, uint64_t secondaryHash)
+HashTable::Candidates::init(HashTable* table, CacheLine* cl,
+                            uint64_t secondaryHash)
 {
+    this->table = table;
     bucket = cl;
-    index = -1;
+    index = 0;
     this->secondaryHash = secondaryHash;
+    matches = matchTags(cl, secondaryHash);
     next();
 }
 
@@ -218,8 +230,11 @@ HashTable::Candidates::setReference(uint64_t reference)
 void
 HashTable::Candidates::remove()
 {
-    if (bucket != NULL)
+    if (bucket != NULL) {
         bucket->entries[index].clear();
+        if (table != NULL)
+            table->numEntries.add(-1);
+    }
 }
 
 /**
@@ -228,33 +243,24 @@ HashTable::Candidates::remove()
 void
 HashTable::Candidates::next()
 {
-    while (true) {
-        // Not found in the cache line, see if there's a chain to
-        // another cache line.
-        if (index == ENTRIES_PER_CACHE_LINE && bucket != NULL) {
-            Entry* entry = &bucket->entries[ENTRIES_PER_CACHE_LINE - 1];
-            bucket = entry->getChainPointer();
-            index = -1;
-        }
-
-        if (bucket == NULL)
+    while (bucket != NULL) {
+        if (matches != 0) {
+            // The hash within the hash table entry matches, so with
+            // high probability this is the pointer we're looking
+            // for. We'll report this index to the user of this
+            // class in the next getReference() call so that they
+            // can verify the match.
+            index = BitOps::findFirstSet(matches) - 1;
+            matches &= matches - 1;
             return;
-
-        // Resume in the current cache line.
-        index++;
-        Entry* candidate = &bucket->entries[index];
-        while (index < ENTRIES_PER_CACHE_LINE) {
-            if (candidate->hashMatches(secondaryHash)) {
-                // The hash within the hash table entry matches, so with
-                // high probability this is the pointer we're looking
-                // for. We'll report this index to the user of this
-                // class in the next getReference() call so that they
-                // can verify the match.
-                return;
-            }
-            candidate++;
-            index++;
         }
+
+        // Not found in the cache line, see if there's a chain to
+        // another cache line.
+        bucket = bucket->entries[ENTRIES_PER_CACHE_LINE - 1].getChainPointer();
+        index = 0;
+        if (bucket != NULL)
+            matches = matchTags(bucket, secondaryHash);
     }
 }
 
@@ -279,6 +285,12 @@ HashTable::Candidates::isDone()
 HashTable::HashTable(uint64_t numBuckets)
     : numBuckets(BitOps::powerOfTwoLessOrEqual(numBuckets))
     , buckets(this->numBuckets * sizeof(CacheLine))
+    , newBuckets()
+    , splitIndex(0)
+    , numEntries(0)
+    , numOverflowLines(0)
+    , maxChainLength(1)
+    , numResizes(0)
 {
     if (numBuckets != this->numBuckets) {
         RAMCLOUD_LOG(DEBUG,
@@ -296,22 +308,12 @@ HashTable::HashTable(uint64_t numBuckets)
  */
 HashTable::~HashTable()
 {
-    uint32_t lastEntryIndex = ENTRIES_PER_CACHE_LINE - 1;
-
-    for (uint64_t i = 0; i < numBuckets; ++i) {
-        CacheLine* currBucket = &buckets.get()[i];
-
-        // Skip the first bucket and break the chain
-        Entry* last = &currBucket->entries[lastEntryIndex];
-        currBucket = last->getChainPointer();
-        last->clear();
+    for (uint64_t i = 0; i < numBuckets; ++i)
+        freeOverflowLines(&buckets.get()[i]);
 
-        while (currBucket != NULL) {
-            CacheLine *nextBucket
-                        = currBucket->entries[lastEntryIndex].getChainPointer();
-            free(currBucket);
-            currBucket = nextBucket;
-        }
+    if (newBuckets) {
+        for (uint64_t i = 0; i < 2 * numBuckets; ++i)
+            freeOverflowLines(&newBuckets->get()[i]);
     }
 }
 
@@ -336,7 +338,7 @@ HashTable::lookup(KeyHash keyHash, Candidates& candidates)
     // caller as it examines possible candidates.
     uint64_t secondaryHash;
     CacheLine *bucket = findBucket(keyHash, &secondaryHash);
-    candidates.init(bucket, secondaryHash);
+    candidates.init(this, bucket, secondaryHash);
 }
 
 /**
@@ -355,8 +357,31 @@ void
 HashTable::insert(KeyHash keyHash, uint64_t reference)
 {
     uint64_t secondaryHash;
-    int overflowBuckets = 0;
     CacheLine* bucket = findBucket(keyHash, &secondaryHash);
+    insertIntoBucket(bucket, keyHash, secondaryHash, reference);
+    numEntries.inc();
+}
+
+/**
+ * Store a reference in the first free entry of a bucket chain, allocating
+ * a new overflow cache line at the end of the chain if the bucket is full.
+ * This does not modify #numEntries; callers that add a new element to the
+ * table are responsible for that.
+ *
+ * \param bucket
+ *      The first cache line of the bucket to insert into.
+ * \param keyHash
+ *      Hash of the key naming the element to insert.
+ * \param secondaryHash
+ *      The secondary hash bits computed from \a keyHash.
+ * \param reference
+ *      Reference to the element to insert.
+ */
+void
+HashTable::insertIntoBucket(CacheLine* bucket, KeyHash keyHash,
+                            uint64_t secondaryHash, uint64_t reference)
+{
+    int overflowBuckets = 0;
     while (true) {
         Entry* entry = bucket->entries;
         for (size_t i = 0; i < ENTRIES_PER_CACHE_LINE; i++) {
@@ -374,9 +399,10 @@ HashTable::insert(KeyHash keyHash, uint64_t reference)
         bucket = last->getChainPointer();
         if (bucket == NULL) {
             // no empty space found, allocate a new cache line
+            uint64_t unused;
             RAMCLOUD_CLOG(NOTICE, "Allocating overflow bucket %d for index %lu",
                     overflowBuckets,
-                    findBucketIndex(numBuckets, keyHash, &secondaryHash));
+                    findBucketIndex(numBuckets, keyHash, &unused));
             void *buf = Memory::xmemalign(HERE, sizeof(CacheLine),
                                           sizeof(CacheLine));
             bucket = static_cast<CacheLine *>(buf);
@@ -384,6 +410,13 @@ HashTable::insert(KeyHash keyHash, uint64_t reference)
             for (size_t i = 1; i < ENTRIES_PER_CACHE_LINE; i++)
                 bucket->entries[i].clear();
             last->setChainPointer(bucket);
+            numOverflowLines.inc();
+
+            // Racy, but only used for statistics; an occasional lost update
+            // just means the reported maximum lags behind briefly.
+            uint64_t chainLength = overflowBuckets + 1;
+            if (chainLength > maxChainLength.load())
+                maxChainLength.store(chainLength);
         }
     }
 }
@@ -396,7 +429,9 @@ HashTable::insert(KeyHash keyHash, uint64_t reference)
  * \param cookie
  *      An opaque parameter to pass to the callback function.
  * \param bucket
- *      An index into the HashTable's buckets.  Must be < #numBuckets.
+ *      An index into the HashTable's buckets.  Must be < #numBuckets. If a
+ *      resize is in progress this refers to the bucket in the old table,
+ *      regardless of whether it has been migrated yet.
  * \return
  *      The total number of callbacks fired (i.e. the number of elements
  *      in the HashTable).
@@ -405,9 +440,36 @@ uint64_t
 HashTable::forEachInBucket(void (*callback)(uint64_t, void *),
                            void *cookie,
                            uint64_t bucket)
+{
+    // Buckets that have already been migrated by an ongoing resize now
+    // live in two places in the new table.
+    if (bucket < splitIndex) {
+        return forEachInChain(callback, cookie, &newBuckets->get()[bucket]) +
+               forEachInChain(callback, cookie,
+                              &newBuckets->get()[bucket + numBuckets]);
+    }
+    return forEachInChain(callback, cookie, &buckets.get()[bucket]);
+}
+
+/**
+ * Apply the given callback function to each element stored in a single
+ * chain of cache lines. Helper for #forEachInBucket().
+ *
+ * \param callback
+ *      The callback to fire on each element stored in the chain.
+ * \param cookie
+ *      An opaque parameter to pass to the callback function.
+ * \param cl
+ *      The first cache line of the chain.
+ * \return
+ *      The total number of callbacks fired.
+ */
+uint64_t
+HashTable::forEachInChain(void (*callback)(uint64_t, void *),
+                          void *cookie,
+                          CacheLine* cl)
 {
     uint64_t numCalls = 0;
-    CacheLine *cl = &buckets.get()[bucket];
     while (1) {
         for (uint32_t j = 0; j < ENTRIES_PER_CACHE_LINE; j++) {
             Entry *e = &cl->entries[j];
@@ -449,12 +511,53 @@ HashTable::forEach(void (*callback)(uint64_t, void *), void *cookie)
 
 /**
  * Prefetch the cacheline associated with the given key hash.
+ *
+ * This is typically called before the caller has taken the lock for the
+ * bucket, so it must not follow #newBuckets (which may be released by a
+ * concurrent #finishResize()). While a resize is in progress it may prefetch
+ * the bucket's old location instead, which is harmless.
  */
 void
 HashTable::prefetchBucket(KeyHash keyHash)
 {
     uint64_t dummy;
-    prefetch(findBucket(keyHash, &dummy));
+    prefetch(&buckets.get()[findBucketIndex(numBuckets, keyHash, &dummy)]);
+}
+
+/**
+ * Prefetch the log entries referenced by the first cache line of the bucket
+ * associated with the given key hash, for those entries whose secondary hash
+ * matches. This is the second stage of group prefetching (the first being
+ * #prefetchBucket()): once the bucket is in cache, it lets the caller overlap
+ * the cache misses on the candidate objects of several keys before looking
+ * any of them up.
+ *
+ * Unlike #prefetchBucket(), this reads the bucket's contents, so the caller
+ * must hold the lock for the bucket. Overflow cache lines are not followed.
+ *
+ * \param keyHash
+ *      Hash of the key whose candidates should be prefetched.
+ * \return
+ *      The number of candidate references that were prefetched.
+ */
+uint32_t
+HashTable::prefetchCandidates(KeyHash keyHash)
+{
+    uint64_t secondaryHash;
+    CacheLine* bucket = findBucket(keyHash, &secondaryHash);
+    uint32_t numPrefetched = 0;
+
+    for (uint32_t matches = matchTags(bucket, secondaryHash); matches != 0;
+            matches &= matches - 1) {
+        Entry& entry = bucket->entries[BitOps::findFirstSet(matches) - 1];
+        // The entry header, object header and the start of the key are
+        // all needed to confirm a match; they almost always fit within
+        // the first two cache lines.
+        prefetch(reinterpret_cast<const void*>(entry.getReference()),
+                 2 * BYTES_PER_CACHE_LINE);
+        numPrefetched++;
+    }
+    return numPrefetched;
 }
 
 /**
@@ -477,7 +580,9 @@ HashTable::entriesPerCacheLine()
 }
 
 /**
- * Returns the number of buckets allocated to the table.
+ * Returns the number of buckets allocated to the table. While a resize is in
+ * progress this is the size of the old table; bucket indexes passed to
+ * #forEachInBucket() and #migrateBucket() are relative to it.
  */
 uint64_t
 HashTable::getNumBuckets() const
@@ -485,6 +590,174 @@ HashTable::getNumBuckets() const
     return numBuckets;
 }
 
+/**
+ * Returns the number of references currently stored in the table.
+ */
+uint64_t
+HashTable::getNumEntries() const
+{
+    return numEntries.load();
+}
+
+/**
+ * Returns the fraction of the entries in the bucket array (not counting
+ * overflow lines) that would be in use if references were spread evenly.
+ * Values approaching 1.0 mean that a significant number of buckets have
+ * overflowed into chained cache lines.
+ */
+double
+HashTable::getLoadFactor() const
+{
+    uint64_t capacity = numBuckets * ENTRIES_PER_CACHE_LINE;
+    if (splitIndex > 0)
+        capacity += splitIndex * ENTRIES_PER_CACHE_LINE;
+    return static_cast<double>(numEntries.load()) /
+           static_cast<double>(capacity);
+}
+
+/**
+ * Fill in a protocol buffer with statistics about the occupancy and shape of
+ * the table. Used to service GET_SERVER_STATISTICS requests.
+ *
+ * \param[out] stats
+ *      Protocol buffer to fill in.
+ */
+void
+HashTable::getStatistics(ProtoBuf::HashTableStatistics* stats) const
+{
+    stats->set_num_buckets(numBuckets);
+    stats->set_num_entries(numEntries.load());
+    stats->set_load_factor(getLoadFactor());
+    stats->set_num_overflow_lines(numOverflowLines.load());
+    stats->set_max_chain_length(maxChainLength.load());
+    stats->set_num_resizes(numResizes);
+    stats->set_resize_in_progress(isResizing());
+    stats->set_resize_split_index(splitIndex);
+}
+
+/**
+ * Begin doubling the size of the table. This allocates the new bucket array
+ * but does not move any references; the caller must subsequently invoke
+ * #migrateBucket() for every bucket index from 0 to #getNumBuckets() - 1,
+ * in order, and then #finishResize(). Lookups and inserts may continue
+ * throughout.
+ *
+ * This must not be called while another thread might be calling
+ * #migrateBucket() or #finishResize(), and has no effect if a resize is
+ * already in progress.
+ */
+void
+HashTable::startResize()
+{
+    if (newBuckets)
+        return;
+
+    RAMCLOUD_LOG(NOTICE, "Growing hash table from %lu to %lu buckets "
+                 "(%lu entries, load factor %.2f)", numBuckets,
+                 2 * numBuckets, numEntries.load(), getLoadFactor());
+    // LargeBlockOfMemory hands back zeroed pages, which is the same as
+    // every entry having been cleared.
+    newBuckets.construct(2 * numBuckets * sizeof(CacheLine));
+    assert(splitIndex == 0);
+}
+
+/**
+ * Returns true if #startResize() has been called but #finishResize() has
+ * not yet completed.
+ */
+bool
+HashTable::isResizing() const
+{
+    return newBuckets;
+}
+
+/**
+ * Returns the index of the next bucket that #migrateBucket() should be
+ * invoked on. Only meaningful while a resize is in progress.
+ */
+uint64_t
+HashTable::getSplitIndex() const
+{
+    return splitIndex;
+}
+
+/**
+ * Move all references in one bucket of the old table into the appropriate
+ * buckets of the new, larger table, and free any overflow lines that were
+ * chained to it.
+ *
+ * The caller must ensure that no other thread accesses the old bucket or
+ * either of the two new buckets it splits into (bucket and bucket +
+ * #getNumBuckets()) while this runs, e.g. by holding the lock that protects
+ * them.
+ *
+ * \param bucket
+ *      Index of the bucket to migrate. Must equal #getSplitIndex().
+ * \param getKeyHash
+ *      Function that returns the full KeyHash of a reference stored in the
+ *      table.
+ * \param cookie
+ *      Opaque parameter passed through to \a getKeyHash.
+ */
+void
+HashTable::migrateBucket(uint64_t bucket, KeyHashFunction getKeyHash,
+                         void* cookie)
+{
+    assert(newBuckets);
+    assert(bucket == splitIndex);
+    assert(bucket < numBuckets);
+
+    uint64_t newNumBuckets = 2 * numBuckets;
+    CacheLine* cl = &buckets.get()[bucket];
+    while (cl != NULL) {
+        for (uint32_t i = 0; i < ENTRIES_PER_CACHE_LINE; i++) {
+            Entry* e = &cl->entries[i];
+            if (e->isAvailable() || e->getChainPointer() != NULL)
+                continue;
+            uint64_t reference = e->getReference();
+            KeyHash keyHash = getKeyHash(reference, cookie);
+            uint64_t secondaryHash;
+            uint64_t newIndex = findBucketIndex(newNumBuckets, keyHash,
+                                                &secondaryHash);
+            assert((newIndex & (numBuckets - 1)) == bucket);
+            insertIntoBucket(&newBuckets->get()[newIndex], keyHash,
+                             secondaryHash, reference);
+        }
+        cl = cl->entries[ENTRIES_PER_CACHE_LINE - 1].getChainPointer();
+    }
+
+    uint64_t freedLines = freeOverflowLines(&buckets.get()[bucket]);
+    numOverflowLines.add(-static_cast<int64_t>(freedLines));
+    memset(&buckets.get()[bucket], 0, sizeof(CacheLine));
+
+    // Publish the migration only after the new buckets are fully populated.
+    Fence::leave();
+    splitIndex = bucket + 1;
+}
+
+/**
+ * Complete a resize once every bucket has been migrated: the new table
+ * replaces the old one and the old bucket array is released.
+ *
+ * The caller must ensure that no other thread is accessing the table while
+ * this runs (ObjectManager, for instance, holds every bucket lock).
+ */
+void
+HashTable::finishResize()
+{
+    assert(newBuckets);
+    assert(splitIndex == numBuckets);
+
+    buckets.swap(*newBuckets);
+    newBuckets.destroy();
+    numBuckets *= 2;
+    splitIndex = 0;
+    numResizes++;
+    maxChainLength = 1;
+    RAMCLOUD_LOG(NOTICE, "Hash table resize to %lu buckets complete "
+                 "(load factor now %.2f)", numBuckets, getLoadFactor());
+}
+
 /**
  * Find the bucket index corresponding to a particular key.
  * This also calculates the secondary hash bits used to disambiguate entries
@@ -528,7 +801,191 @@ HashTable::CacheLine*
 HashTable::findBucket(KeyHash keyHash, uint64_t *secondaryHash) //const
 {
     uint64_t bucketIndex = findBucketIndex(numBuckets, keyHash, secondaryHash);
+    if (expect_false(bucketIndex < splitIndex)) {
+        // This bucket has already been split by an ongoing resize.
+        bucketIndex = findBucketIndex(2 * numBuckets, keyHash, secondaryHash);
+        return &newBuckets->get()[bucketIndex];
+    }
     return &buckets.get()[bucketIndex];
 }
 
+/**
+ * Return whether the given tag matching implementation can be used on
+ * this processor.
+ */
+bool
+HashTable::isTagMatchModeSupported(TagMatchMode mode)
+{
+    switch (mode) {
+    case TAG_MATCH_SCALAR:
+        return true;
+    case TAG_MATCH_SSE:
+        return __builtin_cpu_supports("sse4.1");
+    case TAG_MATCH_AVX2:
+        return __builtin_cpu_supports("avx2");
+    }
+    return false;
+}
+
+/**
+ * Select the implementation used by all hash tables to compare the secondary
+ * hashes of a cache line's entries during lookups. This is normally chosen
+ * automatically; it's exposed for testing and benchmarking.
+ *
+ * \param mode
+ *      The implementation to use.
+ * \return
+ *      True if the mode was selected, false if the processor doesn't support
+ *      it (in which case the current mode is unchanged).
+ */
+bool
+HashTable::setTagMatchMode(TagMatchMode mode)
+{
+    if (!isTagMatchModeSupported(mode))
+        return false;
+
+    switch (mode) {
+    case TAG_MATCH_SCALAR:
+        matchTags = &matchTagsScalar;
+        break;
+    case TAG_MATCH_SSE:
+        matchTags = &matchTagsSse;
+        break;
+    case TAG_MATCH_AVX2:
+        matchTags = &matchTagsAvx2;
+        break;
+    }
+    tagMatchMode = mode;
+    return true;
+}
+
+/**
+ * Return the tag matching implementation currently used for lookups.
+ */
+HashTable::TagMatchMode
+HashTable::getTagMatchMode()
+{
+    if (matchTags == &matchTagsFirstCall)
+        matchTagsFirstCall(NULL, 0);
+    return tagMatchMode;
+}
+
+/**
+ * Portable implementation of #TagMatchFunction: examine the entries one by
+ * one.
+ */
+uint32_t
+HashTable::matchTagsScalar(const CacheLine* cl, uint64_t secondaryHash)
+{
+    uint32_t matches = 0;
+    for (uint32_t i = 0; i < ENTRIES_PER_CACHE_LINE; i++) {
+        if (cl->entries[i].hashMatches(secondaryHash))
+            matches |= 1U << i;
+    }
+    return matches;
+}
+
+/**
+ * Bits of an Entry that must equal those of the searched-for secondary hash
+ * (shifted into position) for the entry to match: the secondary hash itself
+ * and the chain bit, which must be clear. An entry of all zeroes is unused
+ * and never matches, even when the secondary hash is 0.
+ */
+static const uint64_t TAG_MATCH_BITS = 0xffff800000000000UL;
+
+/**
+ * SSE4.1 implementation of #TagMatchFunction: examine two entries per
+ * instruction.
+ */
+__attribute__((target("sse4.1")))
+uint32_t
+HashTable::matchTagsSse(const CacheLine* cl, uint64_t secondaryHash)
+{
+    const __m128i tagBits = _mm_set1_epi64x(TAG_MATCH_BITS);
+    const __m128i wanted = _mm_set1_epi64x(secondaryHash << 48);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i* entries = reinterpret_cast<const __m128i*>(cl->entries);
+
+    uint32_t matches = 0;
+    for (uint32_t i = 0; i < ENTRIES_PER_CACHE_LINE / 2; i++) {
+        __m128i e = _mm_loadu_si128(&entries[i]);
+        __m128i hit = _mm_andnot_si128(_mm_cmpeq_epi64(e, zero),
+                _mm_cmpeq_epi64(_mm_and_si128(e, tagBits), wanted));
+        matches |= static_cast<uint32_t>(
+                _mm_movemask_pd(_mm_castsi128_pd(hit))) << (2 * i);
+    }
+    return matches;
+}
+
+/**
+ * AVX2 implementation of #TagMatchFunction: examine four entries per
+ * instruction.
+ */
+__attribute__((target("avx2")))
+uint32_t
+HashTable::matchTagsAvx2(const CacheLine* cl, uint64_t secondaryHash)
+{
+    const __m256i tagBits = _mm256_set1_epi64x(TAG_MATCH_BITS);
+    const __m256i wanted = _mm256_set1_epi64x(secondaryHash << 48);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i* entries = reinterpret_cast<const __m256i*>(cl->entries);
+
+    __m256i lo = _mm256_loadu_si256(&entries[0]);
+    __m256i hi = _mm256_loadu_si256(&entries[1]);
+    __m256i hitLo = _mm256_andnot_si256(_mm256_cmpeq_epi64(lo, zero),
+            _mm256_cmpeq_epi64(_mm256_and_si256(lo, tagBits), wanted));
+    __m256i hitHi = _mm256_andnot_si256(_mm256_cmpeq_epi64(hi, zero),
+            _mm256_cmpeq_epi64(_mm256_and_si256(hi, tagBits), wanted));
+    return static_cast<uint32_t>(
+            _mm256_movemask_pd(_mm256_castsi256_pd(hitLo))) |
+           (static_cast<uint32_t>(
+            _mm256_movemask_pd(_mm256_castsi256_pd(hitHi))) << 4);
+}
+
+/**
+ * Initial value of #matchTags: select the fastest implementation this
+ * processor supports, then use it to handle the call.
+ */
+uint32_t
+HashTable::matchTagsFirstCall(const CacheLine* cl, uint64_t secondaryHash)
+{
+    if (!setTagMatchMode(TAG_MATCH_AVX2) && !setTagMatchMode(TAG_MATCH_SSE))
+        setTagMatchMode(TAG_MATCH_SCALAR);
+    if (cl == NULL)
+        return 0;
+    return matchTags(cl, secondaryHash);
+}
+
+/**
+ * Free all of the overflow cache lines chained onto a bucket, leaving the
+ * bucket's first (inline) cache line with no chain pointer.
+ *
+ * \param bucket
+ *      The first cache line of the bucket.
+ * \return
+ *      The number of overflow lines freed.
+ */
+uint64_t
+HashTable::freeOverflowLines(CacheLine* bucket)
+{
+    uint32_t lastEntryIndex = ENTRIES_PER_CACHE_LINE - 1;
+    uint64_t numFreed = 0;
+
+    // Skip the first bucket and break the chain
+    Entry* last = &bucket->entries[lastEntryIndex];
+    CacheLine* currBucket = last->getChainPointer();
+    if (currBucket == NULL)
+        return 0;
+    last->clear();
+
+    while (currBucket != NULL) {
+        CacheLine *nextBucket
+                    = currBucket->entries[lastEntryIndex].getChainPointer();
+        free(currBucket);
+        currBucket = nextBucket;
+        numFreed++;
+    }
+    return numFreed;
+}
+
 } // namespace RAMCloud
@@ -23,6 +23,9 @@
 #include "Memory.h"
 #include "MurmurHash3.h"
 #include "Key.h"
+#include "Atomic.h"
+#include "Tub.h"
+#include "ServerStatistics.pb.h"
 
 namespace RAMCloud {
 
@@ -52,6 +55,13 @@ namespace RAMCloud {
  * buckets). In this case, the last hash table entry in each of the
  * non-terminal cache lines has a pointer to the next cache line instead of a
  * log reference.
+ *
+ * When looking up a key, all of the entries of a cache line are compared
+ * against the key's secondary hash at once (see #TagMatchMode), producing a
+ * bitmask of the matching entries. This uses AVX2 or SSE instructions when
+ * the processor supports them, chosen at runtime, and a scalar loop
+ * otherwise. Misses in particular benefit, since every line of the bucket's
+ * chain must be examined before concluding the key isn't present.
  */
 class HashTable {
   PRIVATE:
@@ -154,8 +164,24 @@ class HashTable {
     };
     static_assert(sizeof(CacheLine) == sizeof(Entry) * ENTRIES_PER_CACHE_LINE,
                   "HashTable entries don't fit evenly into a cacheline");
+    static_assert(ENTRIES_PER_CACHE_LINE == 8,
+                  "HashTable tag matching assumes 8 entries per cacheline");
 
   public:
+    /**
+     * The implementations available for comparing the secondary hashes of
+     * all entries in a cache line against a key being looked up. By default
+     * the fastest one supported by the processor is used.
+     */
+    enum TagMatchMode {
+        /// Compare one entry at a time.
+        TAG_MATCH_SCALAR = 0,
+        /// Compare two entries per SSE4.1 instruction.
+        TAG_MATCH_SSE,
+        /// Compare four entries per AVX2 instruction.
+        TAG_MATCH_AVX2,
+    };
+
     /**
      * This class is essentially an iterator for potential matches found during
      * a lookup operation. This exists because the HashTable::lookup() method
@@ -186,7 +212,11 @@ class HashTable {
         bool isDone();
 
       PRIVATE:
-        void init(CacheLine* cl, uint64_t secondaryHash);
+        void init(HashTable* table, CacheLine* cl, uint64_t secondaryHash);
+
+        /// The table being iterated over. Used to keep its entry count up to
+        /// date when a candidate is removed.
+        HashTable* table;
 
         /// Pointer to the hash table bucket we're currently iterating over.
         CacheLine* bucket;
@@ -194,6 +224,10 @@ class HashTable {
         /// Index into bucket we're currently iterating over.
         uint32_t index;
 
+        /// Bitmask of the entries in bucket after #index whose secondary
+        /// hash matches; bit i corresponds to bucket->entries[i].
+        uint32_t matches;
+
         /// This iterator only returns references to entries that share this
         /// secondaryHash. All others cannot possibly be matches. This helps
         /// to reduce the number of candidates whose keys are extracted from
@@ -212,13 +246,36 @@ class HashTable {
                              uint64_t bucket);
     uint64_t forEach(void (*callback)(uint64_t, void *), void *cookie);
     void prefetchBucket(KeyHash keyHash);
+    uint32_t prefetchCandidates(KeyHash keyHash);
     static uint32_t bytesPerCacheLine();
     static uint32_t entriesPerCacheLine();
     uint64_t getNumBuckets() const;
+    uint64_t getNumEntries() const;
+    double getLoadFactor() const;
+    void getStatistics(ProtoBuf::HashTableStatistics* stats) const;
     static uint64_t findBucketIndex(uint64_t numBuckets,
                                     KeyHash keyHash,
                                     uint64_t *secondaryHash);
 
+    /**
+     * Signature of the function used during resizing to recover the full
+     * KeyHash of a reference stored in the table. Entries only keep the
+     * secondary hash bits, which are not enough to determine which of the
+     * two new buckets an entry belongs in.
+     */
+    typedef KeyHash (*KeyHashFunction)(uint64_t reference, void* cookie);
+
+    void startResize();
+    bool isResizing() const;
+    uint64_t getSplitIndex() const;
+    void migrateBucket(uint64_t bucket, KeyHashFunction getKeyHash,
+                       void* cookie);
+    void finishResize();
+
+    static bool isTagMatchModeSupported(TagMatchMode mode);
+    static bool setTagMatchMode(TagMatchMode mode);
+    static TagMatchMode getTagMatchMode();
+
   PRIVATE:
 
     // forward declarations
@@ -226,11 +283,46 @@ class HashTable {
     struct CacheLine;
 
     CacheLine * findBucket(KeyHash keyHash, uint64_t *secondaryHash);
+    void insertIntoBucket(CacheLine* bucket, KeyHash keyHash,
+                          uint64_t secondaryHash, uint64_t reference);
+    static uint64_t forEachInChain(void (*callback)(uint64_t, void *),
+                                   void *cookie,
+                                   CacheLine* cl);
+    static uint64_t freeOverflowLines(CacheLine* bucket);
+
+    /**
+     * Signature of the functions that compare the secondary hash of every
+     * entry in a cache line against a given secondary hash. They return a
+     * bitmask with bit i set if entries[i] is a reference (not a chain
+     * pointer or an empty entry) whose secondary hash matches.
+     */
+    typedef uint32_t (*TagMatchFunction)(const CacheLine* cl,
+                                         uint64_t secondaryHash);
+    static uint32_t matchTagsScalar(const CacheLine* cl,
+                                    uint64_t secondaryHash);
+    static uint32_t matchTagsSse(const CacheLine* cl, uint64_t secondaryHash);
+    static uint32_t matchTagsAvx2(const CacheLine* cl, uint64_t secondaryHash);
+    static uint32_t matchTagsFirstCall(const CacheLine* cl,
+                                       uint64_t secondaryHash);
 
     /**
-     * The number of buckets allocated to the table.
+     * The tag matching implementation in use. This starts out pointing at
+     * #matchTagsFirstCall(), which selects the best supported implementation
+     * the first time any table is searched.
      */
-    const uint64_t numBuckets;
+    static TagMatchFunction matchTags;
+
+    /**
+     * The mode that #matchTags implements (meaningless until #matchTags has
+     * been selected).
+     */
+    static TagMatchMode tagMatchMode;
+
+    /**
+     * The number of buckets allocated to the table. While a resize is in
+     * progress this is the size of the old table (#buckets).
+     */
+    uint64_t numBuckets;
 
     /**
      * The array of buckets.
@@ -238,6 +330,42 @@ class HashTable {
      */
     LargeBlockOfMemory<CacheLine> buckets;
 
+    /**
+     * While a resize is in progress, the array of 2 * #numBuckets buckets
+     * that #buckets is being migrated into. Empty otherwise.
+     */
+    Tub<LargeBlockOfMemory<CacheLine>> newBuckets;
+
+    /**
+     * Index of the next bucket in #buckets to be migrated to #newBuckets.
+     * All buckets with lower indexes live in #newBuckets. This is always 0
+     * when the table is not being resized. It is only modified with the lock
+     * covering bucket #splitIndex held, so readers holding the lock for their
+     * own bucket always see a consistent value.
+     */
+    volatile uint64_t splitIndex;
+
+    /**
+     * Number of references currently stored in the table.
+     */
+    Atomic<uint64_t> numEntries;
+
+    /**
+     * Number of overflow cache lines currently chained onto buckets.
+     */
+    Atomic<uint64_t> numOverflowLines;
+
+    /**
+     * Length, in cache lines, of the longest bucket chain ever created by
+     * #insert() since the last resize.
+     */
+    Atomic<uint64_t> maxChainLength;
+
+    /**
+     * Number of times this table has been doubled in size.
+     */
+    uint64_t numResizes;
+
     friend void hashTableBenchmark(uint64_t nkeys, uint64_t nlines);
     DISALLOW_COPY_AND_ASSIGN(HashTable);
 };
@@ -43,6 +43,49 @@ class TestObject {
     uint64_t key;
 } __attribute__((aligned(64)));
 
+/**
+ * Look up a range of integer keys in the table and return how long it took.
+ *
+ * \param ht
+ *      The table to search. Its references point to TestObjects.
+ * \param firstKey
+ *      The first key to look up.
+ * \param numKeys
+ *      The number of consecutive keys to look up, starting at firstKey.
+ * \param expectHits
+ *      True if all of the keys are in the table, false if none are.
+ * \return
+ *      The number of cycles taken by the lookups.
+ */
+uint64_t
+lookupKeys(HashTable& ht, uint64_t firstKey, uint64_t numKeys,
+           bool expectHits)
+{
+    // don't use a CycleCounter, as we may want to run without PERF_COUNTERS
+    uint64_t start = Cycles::rdtsc();
+    HashTable::Candidates c;
+    for (uint64_t i = firstKey; i < firstKey + numKeys; i++) {
+        Key key(0, &i, sizeof(i));
+        bool success = false;
+
+        ht.lookup(key.getHash(), c);
+        while (!c.isDone()) {
+            TestObject* candidateObject =
+                reinterpret_cast<TestObject*>(c.getReference());
+            Key candidateKey(0,
+                             &candidateObject->key,
+                             sizeof(candidateObject->key));
+            if (candidateKey == key) {
+                success = true;
+                break;
+            }
+            c.next();
+        }
+        assert(success == expectHits);
+    }
+    return Cycles::rdtsc() - start;
+}
+
 } // anonymous namespace
 
 void
@@ -111,40 +154,37 @@ hashTableBenchmark(uint64_t nkeys, uint64_t nlines)
 
     printf("Starting lookups in 3 seconds (get your measurements ready!)\n");
     sleep(3);
-    printf("running lookup measurements...");
-    fflush(stdout);
-
-    // don't use a CycleCounter, as we may want to run without PERF_COUNTERS
-    uint64_t lookupCycles = Cycles::rdtsc();
-    for (i = 0; i < nkeys; i++) {
-        Key key(0, &i, sizeof(i));
-        uint64_t reference = 0;
-        bool success = false;
 
-        ht.lookup(key.getHash(), c);
-        while (!c.isDone()) {
-            reference = c.getReference();
-            TestObject* candidateObject =
-                reinterpret_cast<TestObject*>(reference);
-            Key candidateKey(0,
-                             &candidateObject->key,
-                             sizeof(candidateObject->key));
-            if (candidateKey == key) {
-                success = true;
-                break;
-            }
-            c.next();
+    const char* modeNames[] = { "scalar", "sse", "avx2" };
+    HashTable::TagMatchMode defaultMode = HashTable::getTagMatchMode();
+    HashTable::TagMatchMode modes[] = { HashTable::TAG_MATCH_SCALAR,
+                                        HashTable::TAG_MATCH_SSE,
+                                        HashTable::TAG_MATCH_AVX2 };
+    foreach (HashTable::TagMatchMode mode, modes) {
+        if (!HashTable::setTagMatchMode(mode)) {
+            printf("tag matching mode %s not supported; skipping\n",
+                   modeNames[mode]);
+            continue;
         }
-        assert(success);
-        assert(reinterpret_cast<TestObject*>(reference)->key == i);
-    }
-    i = Cycles::rdtsc() - lookupCycles;
-    printf("done!\n");
 
-    printf("== lookup() took %.3f s ==\n", Cycles::toSeconds(i));
-
-    printf("    external avg: %lu ticks, %lu nsec\n", i / nkeys,
-        Cycles::toNanoseconds(i / nkeys));
+        printf("running %s lookup measurements...", modeNames[mode]);
+        fflush(stdout);
+        uint64_t hitCycles = lookupKeys(ht, 0, nkeys, true);
+        uint64_t missCycles = lookupKeys(ht, nkeys, nkeys, false);
+        printf("done!\n");
+
+        printf("== %s lookup() hits took %.3f s ==\n", modeNames[mode],
+               Cycles::toSeconds(hitCycles));
+        printf("    external avg: %lu ticks, %lu nsec, %.0f lookups/sec\n",
+               hitCycles / nkeys, Cycles::toNanoseconds(hitCycles / nkeys),
+               static_cast<double>(nkeys) / Cycles::toSeconds(hitCycles));
+        printf("== %s lookup() misses took %.3f s ==\n", modeNames[mode],
+               Cycles::toSeconds(missCycles));
+        printf("    external avg: %lu ticks, %lu nsec, %.0f lookups/sec\n",
+               missCycles / nkeys, Cycles::toNanoseconds(missCycles / nkeys),
+               static_cast<double>(nkeys) / Cycles::toSeconds(missCycles));
+    }
+    HashTable::setTagMatchMode(defaultMode);
 
     uint64_t *histogram = static_cast<uint64_t *>(
         Memory::xmalloc(HERE, nlines * sizeof(histogram[0])));
@@ -674,6 +674,82 @@ TEST_F(HashTableTest, lookup) {
     delete v;
 }
 
+TEST_F(HashTableTest, prefetchCandidates) {
+    HashTable ht(1);
+    KeyHash hashA = 0x0001000000000000UL;
+    KeyHash hashB = 0x0002000000000000UL;
+    EXPECT_EQ(0U, ht.prefetchCandidates(hashA));
+
+    ht.insert(hashA, 0x1000);
+    ht.insert(hashB, 0x2000);
+    ht.insert(hashA, 0x3000);
+    EXPECT_EQ(2U, ht.prefetchCandidates(hashA));
+    EXPECT_EQ(1U, ht.prefetchCandidates(hashB));
+
+    // Only the first cache line of the bucket is examined.
+    for (uint64_t i = 0; i < HashTable::ENTRIES_PER_CACHE_LINE; i++)
+        ht.insert(hashA, 0x4000 + i * 0x1000);
+    EXPECT_EQ(HashTable::ENTRIES_PER_CACHE_LINE - 2,
+              ht.prefetchCandidates(hashA));
+}
+
+TEST_F(HashTableTest, matchTags) {
+    HashTable::CacheLine cl;
+    cl.entries[0].clear();
+    cl.entries[1].setReference(5, 0x1000);
+    cl.entries[2].setReference(0, 0x2000);
+    cl.entries[3].setReference(5, 0x3000);
+    cl.entries[4].setReference(0xffff, 0x7fffffffffffUL);
+    cl.entries[5].setReference(6, 0x5000);
+    cl.entries[6].setReference(5, 0x6000);
+    cl.entries[7].setChainPointer(
+            reinterpret_cast<HashTable::CacheLine*>(0x7000));
+
+    HashTable::TagMatchMode originalMode = HashTable::getTagMatchMode();
+    HashTable::TagMatchMode modes[] = { HashTable::TAG_MATCH_SCALAR,
+                                        HashTable::TAG_MATCH_SSE,
+                                        HashTable::TAG_MATCH_AVX2 };
+    foreach (HashTable::TagMatchMode mode, modes) {
+        if (!HashTable::setTagMatchMode(mode)) {
+            EXPECT_FALSE(HashTable::isTagMatchModeSupported(mode));
+            continue;
+        }
+        EXPECT_EQ(mode, HashTable::getTagMatchMode());
+        EXPECT_EQ(0x4aU, HashTable::matchTags(&cl, 5)) << mode;
+        EXPECT_EQ(0x04U, HashTable::matchTags(&cl, 0)) << mode;
+        EXPECT_EQ(0x10U, HashTable::matchTags(&cl, 0xffff)) << mode;
+        EXPECT_EQ(0x20U, HashTable::matchTags(&cl, 6)) << mode;
+        EXPECT_EQ(0x00U, HashTable::matchTags(&cl, 7)) << mode;
+    }
+    EXPECT_TRUE(HashTable::setTagMatchMode(originalMode));
+}
+
+TEST_F(HashTableTest, lookup_allTagMatchModes) {
+    HashTable::TagMatchMode originalMode = HashTable::getTagMatchMode();
+    HashTable::TagMatchMode modes[] = { HashTable::TAG_MATCH_SCALAR,
+                                        HashTable::TAG_MATCH_SSE,
+                                        HashTable::TAG_MATCH_AVX2 };
+
+    // Spans several chained cache lines in a single bucket.
+    setup(0, HashTable::ENTRIES_PER_CACHE_LINE * 3);
+    foreach (HashTable::TagMatchMode mode, modes) {
+        if (!HashTable::setTagMatchMode(mode))
+            continue;
+
+        for (uint64_t i = 0; i < numEnt; i++) {
+            string key = format("%lu", i);
+            Key k(0, key.c_str(), downCast<uint16_t>(key.length()));
+            uint64_t outRef;
+            EXPECT_TRUE(lookup(&ht, k, outRef)) << mode;
+            EXPECT_EQ(values[i]->u64Address(), outRef) << mode;
+        }
+        Key missing(0, "missing", 7);
+        uint64_t outRef;
+        EXPECT_FALSE(lookup(&ht, missing, outRef)) << mode;
+    }
+    EXPECT_TRUE(HashTable::setTagMatchMode(originalMode));
+}
+
 #if 0
 TEST_F(HashTableTest, remove) {
     HashTable ht(1);
@@ -823,4 +899,110 @@ TEST_F(HashTableTest, forEach) {
         EXPECT_EQ(1U, checkoff[i].count);
 }
 
+/**
+ * KeyHashFunction used by the resize tests; references are TestObject
+ * pointers.
+ */
+static KeyHash
+test_resize_getKeyHash(uint64_t ref, void *cookie)
+{
+    TestObject* o = reinterpret_cast<TestObject*>(ref);
+    Key key(o->tableId, o->stringKeyPtr, o->stringKeyLength);
+    return key.getHash();
+}
+
+TEST_F(HashTableTest, insert_statistics) {
+    HashTable ht(1);
+    TestObject objects[20];
+    for (uint32_t i = 0; i < 20; i++) {
+        objects[i].setKey(format("%u", i));
+        Key key(0, objects[i].stringKeyPtr, objects[i].stringKeyLength);
+        ht.insert(key.getHash(), objects[i].u64Address());
+    }
+    EXPECT_EQ(20UL, ht.getNumEntries());
+    EXPECT_EQ(2UL, ht.numOverflowLines.load());
+    EXPECT_EQ(3UL, ht.maxChainLength.load());
+    EXPECT_DOUBLE_EQ(2.5, ht.getLoadFactor());
+
+    HashTable::Candidates candidates;
+    Key key(0, objects[0].stringKeyPtr, objects[0].stringKeyLength);
+    ht.lookup(key.getHash(), candidates);
+    candidates.remove();
+    EXPECT_EQ(19UL, ht.getNumEntries());
+}
+
+TEST_F(HashTableTest, resize) {
+    HashTable ht(4);
+    uint32_t arrayLen = 256;
+    TestObject* objects = new TestObject[arrayLen];
+    for (uint32_t i = 0; i < arrayLen; i++) {
+        objects[i].setKey(format("%u", i));
+        Key key(0, objects[i].stringKeyPtr, objects[i].stringKeyLength);
+        ht.insert(key.getHash(), objects[i].u64Address());
+    }
+    EXPECT_LT(0UL, ht.numOverflowLines.load());
+
+    ht.startResize();
+    EXPECT_TRUE(ht.isResizing());
+    EXPECT_EQ(4UL, ht.getNumBuckets());
+
+    // Migrate half of the buckets; everything must still be reachable
+    // through both lookup and forEach.
+    ht.migrateBucket(0, test_resize_getKeyHash, NULL);
+    ht.migrateBucket(1, test_resize_getKeyHash, NULL);
+    EXPECT_EQ(2UL, ht.getSplitIndex());
+    for (uint32_t i = 0; i < arrayLen; i++) {
+        Key key(0, objects[i].stringKeyPtr, objects[i].stringKeyLength);
+        uint64_t outRef;
+        EXPECT_TRUE(lookup(&ht, key, outRef));
+        EXPECT_EQ(objects[i].u64Address(), outRef);
+    }
+    EXPECT_EQ(arrayLen, ht.forEach(test_forEach_callback,
+                                   reinterpret_cast<void *>(57)));
+
+    // New inserts land in the right half of the table.
+    TestObject extra(0, "extra");
+    Key extraKey(0, extra.stringKeyPtr, extra.stringKeyLength);
+    ht.insert(extraKey.getHash(), extra.u64Address());
+
+    ht.migrateBucket(2, test_resize_getKeyHash, NULL);
+    ht.migrateBucket(3, test_resize_getKeyHash, NULL);
+    ht.finishResize();
+    EXPECT_FALSE(ht.isResizing());
+    EXPECT_EQ(8UL, ht.getNumBuckets());
+    EXPECT_EQ(0UL, ht.getSplitIndex());
+    EXPECT_EQ(1UL, ht.numResizes);
+    EXPECT_EQ(arrayLen + 1, ht.getNumEntries());
+
+    for (uint32_t i = 0; i < arrayLen; i++) {
+        Key key(0, objects[i].stringKeyPtr, objects[i].stringKeyLength);
+        uint64_t outRef;
+        EXPECT_TRUE(lookup(&ht, key, outRef));
+        EXPECT_EQ(objects[i].u64Address(), outRef);
+    }
+    uint64_t outRef;
+    EXPECT_TRUE(lookup(&ht, extraKey, outRef));
+    EXPECT_EQ(arrayLen + 1, ht.forEach(test_forEach_callback,
+                                       reinterpret_cast<void *>(57)));
+    for (uint32_t i = 0; i < arrayLen; i++)
+        EXPECT_EQ(2U, objects[i].count);
+    delete[] objects;
+}
+
+TEST_F(HashTableTest, getStatistics) {
+    HashTable ht(8);
+    TestObject a(0, "0");
+    Key aKey(a.tableId, a.stringKeyPtr, a.stringKeyLength);
+    ht.insert(aKey.getHash(), a.u64Address());
+
+    ProtoBuf::HashTableStatistics stats;
+    ht.getStatistics(&stats);
+    EXPECT_EQ(8UL, stats.num_buckets());
+    EXPECT_EQ(1UL, stats.num_entries());
+    EXPECT_DOUBLE_EQ(1.0 / 64, stats.load_factor());
+    EXPECT_EQ(0UL, stats.num_overflow_lines());
+    EXPECT_EQ(1UL, stats.max_chain_length());
+    EXPECT_FALSE(stats.resize_in_progress());
+}
+
 } // namespace RAMCloud
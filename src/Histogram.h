@@ -271,6 +271,79 @@ class Histogram {
         return -1;
     }
 
+    /**
+     * Get the sample value at or below which the given percentage of all
+     * samples fall. Unlike #getMedian, the result is expressed in the same
+     * units as the samples (i.e. the bucket index times the bucket width).
+     *
+     * If no samples were stored, returns 0. If the percentile falls within
+     * the outliers, this method returns -1 (see #getMedian).
+     *
+     * \param percentile
+     *      Percentage of samples to account for, between 0 and 100.
+     */
+    uint64_t
+    getPercentile(double percentile) const
+    {
+        uint64_t totalSamples = getTotalSamples();
+        if (totalSamples == 0)
+            return 0;
+
+        double target = percentile * static_cast<double>(totalSamples) / 100;
+        uint64_t currentCount = 0;
+        for (uint32_t i = 0; i < numBuckets; i++) {
+            currentCount += buckets[i];
+            if (currentCount > 0 &&
+                    static_cast<double>(currentCount) >= target)
+                return i * bucketWidth;
+        }
+        return -1;
+    }
+
+    /**
+     * Add all of the samples from another histogram to this one. Both
+     * histograms must have the same number of buckets and bucket width.
+     *
+     * \param other
+     *      Histogram whose samples will be added.
+     */
+    void
+    merge(const Histogram& other)
+    {
+        if (other.numBuckets != numBuckets || other.bucketWidth != bucketWidth)
+            throw FatalError(HERE, "histograms have different shapes");
+        for (uint64_t i = 0; i < numBuckets; i++)
+            buckets[i] += other.buckets[i];
+        sampleSum += other.sampleSum;
+        outliers += other.outliers;
+        if (other.min < min)
+            min = other.min;
+        if (other.max > max)
+            max = other.max;
+    }
+
+    /**
+     * Remove the samples recorded in an earlier snapshot of this histogram,
+     * leaving just the samples stored since the snapshot was taken. The
+     * minimum and maximum can't be recovered this way, so they are left
+     * alone (and cover all samples ever stored).
+     *
+     * \param earlier
+     *      An earlier copy of this histogram, with the same number of
+     *      buckets and bucket width.
+     */
+    void
+    subtract(const Histogram& earlier)
+    {
+        if (earlier.numBuckets != numBuckets ||
+                earlier.bucketWidth != bucketWidth)
+            throw FatalError(HERE, "histograms have different shapes");
+        for (uint64_t i = 0; i < numBuckets; i++)
+            buckets[i] -= earlier.buckets[i];
+        sampleSum -= earlier.sampleSum;
+        outliers -= earlier.outliers;
+    }
+
     /**
      * Serialize the histogram to a protocol buffer for network transmission.
      */
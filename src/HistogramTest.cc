@@ -203,6 +203,68 @@ TEST_F(HistogramTest, getMedian) {
     EXPECT_EQ(5UL, h2.getMedian());
 }
 
+TEST_F(HistogramTest, getPercentile) {
+    Histogram noSamples(10, 10);
+    EXPECT_EQ(0UL, noSamples.getPercentile(99));
+
+    Histogram h(10, 10);
+    for (int i = 0; i < 90; i++)
+        h.storeSample(20);
+    for (int i = 0; i < 9; i++)
+        h.storeSample(52);
+    h.storeSample(87);
+    EXPECT_EQ(20UL, h.getPercentile(50));
+    EXPECT_EQ(20UL, h.getPercentile(90));
+    EXPECT_EQ(50UL, h.getPercentile(90.5));
+    EXPECT_EQ(50UL, h.getPercentile(99));
+    EXPECT_EQ(90UL, h.getPercentile(100));
+
+    // percentile falls within outliers
+    h.storeSample(1000);
+    EXPECT_EQ(-1UL, h.getPercentile(100));
+}
+
+TEST_F(HistogramTest, merge) {
+    Histogram h1(10, 1);
+    h1.storeSample(3);
+    h1.storeSample(50);
+    Histogram h2(10, 1);
+    h2.storeSample(1);
+    h2.storeSample(3);
+    h2.storeSample(60);
+
+    h1.merge(h2);
+    EXPECT_EQ(1UL, h1.buckets[1]);
+    EXPECT_EQ(2UL, h1.buckets[3]);
+    EXPECT_EQ(2UL, h1.outliers);
+    EXPECT_EQ(1UL, h1.min);
+    EXPECT_EQ(60UL, h1.max);
+    EXPECT_EQ(117UL, downCast<uint64_t>(h1.sampleSum));
+
+    Histogram h3(10, 2);
+    EXPECT_THROW(h1.merge(h3), FatalError);
+}
+
+TEST_F(HistogramTest, subtract) {
+    Histogram h(10, 1);
+    h.storeSample(3);
+    h.storeSample(50);
+    Histogram earlier(h);
+    h.storeSample(3);
+    h.storeSample(4);
+
+    h.subtract(earlier);
+    EXPECT_EQ(1UL, h.buckets[3]);
+    EXPECT_EQ(1UL, h.buckets[4]);
+    EXPECT_EQ(0UL, h.outliers);
+    EXPECT_EQ(2UL, h.getTotalSamples());
+    EXPECT_EQ(7UL, downCast<uint64_t>(h.sampleSum));
+    EXPECT_EQ(50UL, h.max);
+
+    Histogram h2(11, 1);
+    EXPECT_THROW(h.subtract(h2), FatalError);
+}
+
 TEST_F(HistogramTest, serialize) {
     // Covered by 'constructor_deserializer'.
 }
@@ -275,7 +275,8 @@ void
 InfUdDriver::sendPacket(const Driver::Address *addr,
                         const void *header,
                         uint32_t headerLen,
-                        Buffer::Iterator *payload)
+                        Buffer::Iterator *payload,
+                        int priority)
 {
     uint32_t totalLength = headerLen +
                            (payload ? payload->size() : 0);
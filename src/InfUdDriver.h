@@ -56,7 +56,8 @@ class InfUdDriver : public Driver {
     virtual void sendPacket(const Driver::Address *addr,
                             const void *header,
                             uint32_t headerLen,
-                            Buffer::Iterator *payload);
+                            Buffer::Iterator *payload,
+                            int priority = 0);
     virtual string getServiceLocator();
 
     virtual Driver::Address* newAddress(const ServiceLocator* serviceLocator) {
@@ -0,0 +1,460 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/mman.h>
+
+#include "IoUring.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+/**
+ * Default object used to make system calls.
+ */
+static Syscall defaultSyscall;
+
+/**
+ * Used by this class to make all system calls.  In normal production
+ * use it points to defaultSyscall; for testing it points to a mock
+ * object.
+ */
+Syscall* IoUring::sys = &defaultSyscall;
+
+/**
+ * Construct an IoUring: create the io_uring instance, map its rings, and
+ * hand the receive buffers to the kernel.
+ *
+ * \param dispatch
+ *      Dispatch object whose poll loop will submit requests and deliver
+ *      completions.
+ *
+ * \throw FatalError
+ *      The kernel doesn't support io_uring or one of the features used
+ *      by this class.
+ */
+IoUring::IoUring(Dispatch* dispatch)
+    : Dispatch::Poller(dispatch, "IoUring")
+    , ringFd(-1)
+    , params()
+    , submissionRing(MAP_FAILED)
+    , submissionRingSize(0)
+    , completionRing(MAP_FAILED)
+    , completionRingSize(0)
+    , sqes(static_cast<io_uring_sqe*>(MAP_FAILED))
+    , sqHead(NULL)
+    , sqTail(NULL)
+    , sqFlags(NULL)
+    , sqArray(NULL)
+    , sqMask(0)
+    , cqHead(NULL)
+    , cqTail(NULL)
+    , cqMask(0)
+    , cqes(NULL)
+    , localSqTail(0)
+    , buffers(NULL)
+    , handlers()
+    , nextId(1)
+{
+    // The destructor won't run if construction fails part way, so clean
+    // up explicitly on errors.
+    try {
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = COMPLETION_ENTRIES;
+        ringFd = sys->ioUringSetup(SUBMISSION_ENTRIES, &params);
+        if (ringFd < 0) {
+            throw FatalError(HERE, "io_uring_setup failed", errno);
+        }
+
+        // Multishot receives arrived in Linux 6.0, together with the
+        // zero-copy send opcode; there is no way to probe for them
+        // directly, so use the opcode as a stand-in.
+        char probeSpace[sizeof(io_uring_probe) +
+                256 * sizeof(io_uring_probe_op)];
+        memset(probeSpace, 0, sizeof(probeSpace));
+        io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(probeSpace);
+        if (sys->ioUringRegister(ringFd, IORING_REGISTER_PROBE, probe,
+                256) != 0) {
+            throw FatalError(HERE, "io_uring probe failed", errno);
+        }
+        if ((probe->last_op < IORING_OP_SEND_ZC) ||
+                !(probe->ops[IORING_OP_SEND_ZC].flags &
+                IO_URING_OP_SUPPORTED)) {
+            throw FatalError(HERE,
+                    "kernel doesn't support multishot io_uring receives");
+        }
+
+        submissionRingSize = params.sq_off.array +
+                params.sq_entries * sizeof(uint32_t);
+        completionRingSize = params.cq_off.cqes +
+                params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            submissionRingSize = completionRingSize =
+                    std::max(submissionRingSize, completionRingSize);
+        }
+        submissionRing = mmap(NULL, submissionRingSize,
+                PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ringFd,
+                IORING_OFF_SQ_RING);
+        if (submissionRing == MAP_FAILED) {
+            throw FatalError(HERE, "couldn't map io_uring submission ring",
+                    errno);
+        }
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            completionRing = submissionRing;
+        } else {
+            completionRing = mmap(NULL, completionRingSize,
+                    PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ringFd,
+                    IORING_OFF_CQ_RING);
+            if (completionRing == MAP_FAILED) {
+                throw FatalError(HERE,
+                        "couldn't map io_uring completion ring", errno);
+            }
+        }
+        sqes = static_cast<io_uring_sqe*>(mmap(NULL,
+                params.sq_entries * sizeof(io_uring_sqe),
+                PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ringFd,
+                IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) {
+            throw FatalError(HERE, "couldn't map io_uring submission entries",
+                    errno);
+        }
+
+        char* sq = static_cast<char*>(submissionRing);
+        sqHead = reinterpret_cast<uint32_t*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+        sqFlags = reinterpret_cast<uint32_t*>(sq + params.sq_off.flags);
+        sqArray = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+        sqMask = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+        localSqTail = *sqTail;
+        char* cq = static_cast<char*>(completionRing);
+        cqHead = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        // Hand all of the receive buffers to the kernel. This is done with
+        // a (legacy) provide-buffers request rather than a registered
+        // buffer ring, which isn't reliable on all of the kernels that
+        // support multishot receives.
+        buffers = new char[RECEIVE_BUFFERS * RECEIVE_BUFFER_SIZE];
+        io_uring_sqe* sqe = getSqe();
+        sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+        sqe->fd = RECEIVE_BUFFERS;
+        sqe->addr = reinterpret_cast<uint64_t>(buffers);
+        sqe->len = RECEIVE_BUFFER_SIZE;
+        sqe->off = 0;
+        sqe->buf_group = BUFFER_GROUP;
+        sqe->user_data = 0;
+        if (submit() != 1) {
+            throw FatalError(HERE, "couldn't provide io_uring receive buffers");
+        }
+    } catch (...) {
+        release();
+        throw;
+    }
+}
+
+/**
+ * Destructor for IoUring. Any Handlers still using this object must be
+ * destroyed first.
+ */
+IoUring::~IoUring()
+{
+    release();
+}
+
+/**
+ * Close the io_uring instance and free the memory associated with it
+ * (whatever has been allocated so far, if the constructor failed).
+ */
+void
+IoUring::release()
+{
+    // Closing the ring cancels all of its requests and releases the
+    // receive buffers.
+    if (ringFd >= 0) {
+        sys->close(ringFd);
+        ringFd = -1;
+    }
+    delete[] buffers;
+    buffers = NULL;
+    if (sqes != MAP_FAILED) {
+        munmap(sqes, params.sq_entries * sizeof(io_uring_sqe));
+        sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    }
+    if ((completionRing != MAP_FAILED) && (completionRing != submissionRing)) {
+        munmap(completionRing, completionRingSize);
+    }
+    completionRing = MAP_FAILED;
+    if (submissionRing != MAP_FAILED) {
+        munmap(submissionRing, submissionRingSize);
+        submissionRing = MAP_FAILED;
+    }
+}
+
+/**
+ * Start accepting connections on a listening socket. The handler is
+ * notified of each new connection until it is destroyed or an error
+ * occurs.
+ *
+ * \param handler
+ *      Receives the completions; any previous request for this handler
+ *      must have ended.
+ * \param fd
+ *      Socket on which #listen has been invoked.
+ */
+void
+IoUring::accept(Handler* handler, int fd)
+{
+    handler->operation = Handler::ACCEPT;
+    handler->operationFd = fd;
+    prepareRequest(handler);
+}
+
+/**
+ * Start receiving data from a socket. The handler is notified each time
+ * data arrives, until it is destroyed or the connection ends.
+ *
+ * \param handler
+ *      Receives the completions; any previous request for this handler
+ *      must have ended.
+ * \param fd
+ *      Connected socket to read.
+ */
+void
+IoUring::receive(Handler* handler, int fd)
+{
+    handler->operation = Handler::RECEIVE;
+    handler->operationFd = fd;
+    prepareRequest(handler);
+}
+
+/**
+ * This method is invoked by Dispatch during each pass through its polling
+ * loop. It delivers any completions that have arrived and then submits all
+ * of the requests made since the last call (including those made by
+ * handlers during this call) in a single system call.
+ *
+ * \return
+ *      1 if any completions were delivered, 0 otherwise.
+ */
+int
+IoUring::poll()
+{
+    int result = 0;
+
+    // If the completion ring overflowed, the kernel holds the extra
+    // completions until it is asked for them.
+    if (__atomic_load_n(sqFlags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW) {
+        submit(IORING_ENTER_GETEVENTS);
+    }
+
+    uint32_t head = *cqHead;
+    uint32_t tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        io_uring_cqe cqe = cqes[head & cqMask];
+        head++;
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+
+        int bufferId = -1;
+        char* data = NULL;
+        if (cqe.flags & IORING_CQE_F_BUFFER) {
+            bufferId = downCast<int>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            data = buffers + bufferId * RECEIVE_BUFFER_SIZE;
+        }
+        std::unordered_map<uint64_t, Handler*>::iterator it =
+                handlers.find(cqe.user_data);
+        if (it == handlers.end()) {
+            if (bufferId >= 0) {
+                recycleBuffer(downCast<uint16_t>(bufferId));
+            }
+        } else {
+            Handler* handler = it->second;
+            result = 1;
+            bool more = (cqe.flags & IORING_CQE_F_MORE);
+            bool rearm = !more && ((cqe.res > 0) ||
+                    ((cqe.res == 0) && (handler->operation == Handler::ACCEPT))
+                    || (cqe.res == -ENOBUFS));
+
+            // Running out of receive buffers ends a multishot receive; it
+            // is simply restarted below, after the buffer returns.
+            if (cqe.res != -ENOBUFS) {
+                handler->handleCompletion(cqe.res, data);
+            }
+            if (bufferId >= 0) {
+                recycleBuffer(downCast<uint16_t>(bufferId));
+            }
+
+            // The handler may have been destroyed, or may have made a
+            // new request, so look it up again before restarting it.
+            if (rearm) {
+                it = handlers.find(cqe.user_data);
+                if (it != handlers.end()) {
+                    prepareRequest(it->second);
+                }
+            }
+        }
+        if (head == tail) {
+            tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        }
+    }
+
+    if (localSqTail != __atomic_load_n(sqHead, __ATOMIC_ACQUIRE)) {
+        submit();
+    }
+    return result;
+}
+
+/**
+ * Cancel the request (if any) for a handler; it will receive no further
+ * completions. Invoked when a Handler is destroyed.
+ */
+void
+IoUring::cancel(Handler* handler)
+{
+    handlers.erase(handler->operationId);
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = handler->operationId;
+    sqe->user_data = 0;
+    handler->operation = Handler::NONE;
+    handler->operationId = 0;
+}
+
+/**
+ * Return a cleared entry in the submission ring, submitting the entries
+ * already queued if the ring is full.
+ */
+io_uring_sqe*
+IoUring::getSqe()
+{
+    if (localSqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >=
+            params.sq_entries) {
+        submit();
+        if (localSqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >=
+                params.sq_entries) {
+            throw FatalError(HERE, "io_uring submission ring is full");
+        }
+    }
+    uint32_t index = localSqTail & sqMask;
+    io_uring_sqe* sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqArray[index] = index;
+    localSqTail++;
+    return sqe;
+}
+
+/**
+ * Queue a submission for a handler's current request; it will be passed
+ * to the kernel at the end of the next call to #poll.
+ */
+void
+IoUring::prepareRequest(Handler* handler)
+{
+    if (handler->operationId == 0) {
+        handler->operationId = nextId;
+        nextId++;
+    }
+    handlers[handler->operationId] = handler;
+    io_uring_sqe* sqe = getSqe();
+    sqe->fd = handler->operationFd;
+    sqe->user_data = handler->operationId;
+    if (handler->operation == Handler::ACCEPT) {
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    } else {
+        sqe->opcode = IORING_OP_RECV;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUFFER_GROUP;
+    }
+}
+
+/**
+ * Return a receive buffer to the kernel once its data has been consumed.
+ * The request is queued like any other and is passed to the kernel ahead
+ * of any receives restarted after it.
+ *
+ * \param bufferId
+ *      Index of the buffer in #buffers.
+ */
+void
+IoUring::recycleBuffer(uint16_t bufferId)
+{
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+    sqe->fd = 1;
+    sqe->addr = reinterpret_cast<uint64_t>(buffers +
+            bufferId * RECEIVE_BUFFER_SIZE);
+    sqe->len = RECEIVE_BUFFER_SIZE;
+    sqe->off = bufferId;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = 0;
+}
+
+/**
+ * Pass all of the submissions the kernel hasn't yet consumed to it.
+ *
+ * \param flags
+ *      Flags for io_uring_enter.
+ * \return
+ *      The number of entries submitted.
+ */
+int
+IoUring::submit(unsigned int flags)
+{
+    uint32_t count = localSqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    __atomic_store_n(sqTail, localSqTail, __ATOMIC_RELEASE);
+    int r = sys->ioUringEnter(ringFd, count, 0, flags);
+    if (r < 0) {
+        // The entries stay in the ring and will be retried on the next
+        // call (EAGAIN and EBUSY are transient resource shortages).
+        if ((errno != EAGAIN) && (errno != EBUSY) && (errno != EINTR)) {
+            LOG(ERROR, "io_uring_enter failed: %s", strerror(errno));
+        }
+        return 0;
+    }
+    return r;
+}
+
+/**
+ * Constructor for Handlers.
+ *
+ * \param ring
+ *      IoUring that will execute this handler's requests. NULL means
+ *      the handler won't be used (e.g. because its owner uses
+ *      Dispatch::File instead).
+ */
+IoUring::Handler::Handler(IoUring* ring)
+    : ring(ring)
+    , operation(NONE)
+    , operationFd(-1)
+    , operationId(0)
+{
+}
+
+/**
+ * Destructor for Handlers: cancels any outstanding request.
+ */
+IoUring::Handler::~Handler()
+{
+    if ((ring != NULL) && (operation != NONE)) {
+        ring->cancel(this);
+    }
+}
+
+} // namespace RAMCloud
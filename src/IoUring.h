@@ -0,0 +1,188 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_IOURING_H
+#define RAMCLOUD_IOURING_H
+
+#include <linux/io_uring.h>
+#include <unordered_map>
+
+#include "Dispatch.h"
+#include "Syscall.h"
+
+namespace RAMCloud {
+
+/**
+ * An IoUring drives a Linux io_uring instance from the dispatch loop, as an
+ * alternative to Dispatch::File for sockets that are read continuously.
+ * Requests are placed in the submission ring as they are made and handed
+ * to the kernel together, with a single io_uring_enter call at the end of
+ * the next pass through #poll. Completions are reaped from shared memory
+ * without any system call. Accepts and receives are multishot: one request
+ * keeps producing completions until it is cancelled, and receives draw
+ * their memory from a pool of buffers handed to the kernel in advance. A socket
+ * receiving steadily therefore costs no system calls at all on the receive
+ * path, compared with an epoll notification plus one or more recv calls for
+ * every message with Dispatch::File.
+ *
+ * Multishot receives need Linux 6.0 or later; the constructor throws
+ * FatalError on kernels that can't support this class, and callers are
+ * expected to fall back to Dispatch::File in that case.
+ *
+ * Like other Dispatch handlers, an IoUring may only be used in the dispatch
+ * thread or while holding a Dispatch::Lock.
+ */
+class IoUring : public Dispatch::Poller {
+  public:
+    /**
+     * A Handler receives the completions for a request made with #accept
+     * or #receive. Each Handler has at most one request outstanding;
+     * the request is cancelled when the Handler is destroyed.
+     */
+    class Handler {
+      public:
+        explicit Handler(IoUring* ring);
+        virtual ~Handler();
+
+        /**
+         * This method is defined by a subclass and invoked by #poll for
+         * each completion of the Handler's request. The Handler may be
+         * destroyed by this method.
+         *
+         * \param result
+         *      For accepts, the file descriptor of a new connection. For
+         *      receives, the number of bytes received; 0 means the peer
+         *      closed the connection. A negative value is an errno value
+         *      (negated) for an error that ended the request.
+         * \param data
+         *      For receives with a positive result, the bytes received.
+         *      They belong to the IoUring and are only valid until this
+         *      method returns. NULL otherwise.
+         */
+        virtual void handleCompletion(int result, char* data) = 0;
+
+      PROTECTED:
+        /// The IoUring that executes requests for this Handler; NULL means
+        /// the Handler is unused.
+        IoUring* ring;
+
+      PRIVATE:
+        /// Kinds of request a Handler can make.
+        enum Operation { NONE, ACCEPT, RECEIVE };
+
+        /// The request most recently made for this Handler.
+        Operation operation;
+
+        /// File descriptor for the current request.
+        int operationFd;
+
+        /// Identifies this Handler's requests to the kernel (user_data in
+        /// submissions and completions); 0 means no request has been made.
+        uint64_t operationId;
+
+        friend class IoUring;
+        DISALLOW_COPY_AND_ASSIGN(Handler);
+    };
+
+    explicit IoUring(Dispatch* dispatch);
+    ~IoUring();
+    void accept(Handler* handler, int fd);
+    void receive(Handler* handler, int fd);
+    int poll();
+
+    /// Number of entries in the submission ring.
+    static const uint32_t SUBMISSION_ENTRIES = 256;
+
+    /// Number of entries in the completion ring. Multishot requests may
+    /// produce many completions per submission, so this is larger than
+    /// the submission ring.
+    static const uint32_t COMPLETION_ENTRIES = 4 * SUBMISSION_ENTRIES;
+
+    /// Number of receive buffers handed to the kernel.
+    static const uint32_t RECEIVE_BUFFERS = 128;
+
+    /// Size of each receive buffer; a single completion never carries more
+    /// than this many bytes.
+    static const uint32_t RECEIVE_BUFFER_SIZE = 16384;
+
+    /// Buffer group identifier under which the receive buffers are
+    /// provided.
+    static const uint16_t BUFFER_GROUP = 1;
+
+    static Syscall* sys;
+
+  PRIVATE:
+    void cancel(Handler* handler);
+    io_uring_sqe* getSqe();
+    void prepareRequest(Handler* handler);
+    void recycleBuffer(uint16_t bufferId);
+    void release();
+    int submit(unsigned int flags = 0);
+
+    /// File descriptor for the io_uring instance.
+    int ringFd;
+
+    /// Parameters returned by io_uring_setup, including the offsets of the
+    /// fields below within the mapped rings.
+    io_uring_params params;
+
+    /// Memory shared with the kernel for the submission ring's indexes, and
+    /// its length in bytes.
+    void* submissionRing;
+    size_t submissionRingSize;
+
+    /// Memory shared with the kernel for the completion ring, and its
+    /// length in bytes.
+    void* completionRing;
+    size_t completionRingSize;
+
+    /// Submission queue entries (shared with the kernel).
+    io_uring_sqe* sqes;
+
+    /// Pointers into submissionRing.
+    uint32_t* sqHead;
+    uint32_t* sqTail;
+    uint32_t* sqFlags;
+    uint32_t* sqArray;
+    uint32_t sqMask;
+
+    /// Pointers into completionRing.
+    uint32_t* cqHead;
+    uint32_t* cqTail;
+    uint32_t cqMask;
+    io_uring_cqe* cqes;
+
+    /// Our copy of the submission ring's tail: entries up to here have been
+    /// filled in, but the kernel isn't told about those beyond *sqTail
+    /// until #submit is called.
+    uint32_t localSqTail;
+
+    /// Memory for the receive buffers: RECEIVE_BUFFERS buffers of
+    /// RECEIVE_BUFFER_SIZE bytes each.
+    char* buffers;
+
+    /// Maps from an id in user_data to the Handler that made the request.
+    std::unordered_map<uint64_t, Handler*> handlers;
+
+    /// Used to assign Handler ids; 0 is reserved for requests (such as
+    /// cancellations) whose completions are ignored.
+    uint64_t nextId;
+
+    DISALLOW_COPY_AND_ASSIGN(IoUring);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_IOURING_H
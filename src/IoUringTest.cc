@@ -0,0 +1,213 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/socket.h>
+
+#include "TestUtil.h"
+#include "IoUring.h"
+#include "IpAddress.h"
+#include "MockSyscall.h"
+#include "ServiceLocator.h"
+
+namespace RAMCloud {
+
+// Records the completions it receives.
+class RecordingHandler : public IoUring::Handler {
+  public:
+    explicit RecordingHandler(IoUring* ring)
+        : IoUring::Handler(ring)
+        , log()
+    {}
+
+    void
+    handleCompletion(int result, char* data)
+    {
+        if (!log.empty()) {
+            log += "; ";
+        }
+        if ((data != NULL) && (result > 0)) {
+            log += string(data, result);
+        } else {
+            log += format("%d", result);
+        }
+    }
+
+    string log;
+    DISALLOW_COPY_AND_ASSIGN(RecordingHandler);
+};
+
+class IoUringTest : public ::testing::Test {
+  public:
+    Dispatch dispatch;
+    Tub<IoUring> ring;
+    int fds[2];
+
+    IoUringTest()
+        : dispatch(false)
+        , ring()
+        , fds()
+    {
+        ring.construct(&dispatch);
+        EXPECT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    }
+
+    ~IoUringTest()
+    {
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    // Run the dispatcher until the handler has logged something (but give
+    // up if it takes too long).
+    void
+    waitForLog(RecordingHandler* handler)
+    {
+        // See "Timing-Dependent Tests" in designNotes.
+        for (int i = 0; i < 1000; i++) {
+            dispatch.poll();
+            if (!handler->log.empty())
+                return;
+            usleep(1000);
+        }
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(IoUringTest);
+};
+
+TEST_F(IoUringTest, constructor_setupFails) {
+    MockSyscall sys;
+    sys.ioUringSetupErrno = ENOSYS;
+    Syscall* savedSyscall = IoUring::sys;
+    IoUring::sys = &sys;
+    string message("no exception");
+    try {
+        IoUring ring2(&dispatch);
+    } catch (FatalError& e) {
+        message = e.message;
+    }
+    IoUring::sys = savedSyscall;
+    EXPECT_EQ("io_uring_setup failed: Function not implemented", message);
+}
+
+TEST_F(IoUringTest, receive) {
+    RecordingHandler handler(ring.get());
+    ring->receive(&handler, fds[0]);
+    EXPECT_EQ(0, dispatch.poll());
+
+    // The request stays armed after each completion.
+    write(fds[1], "abc", 3);
+    waitForLog(&handler);
+    EXPECT_EQ("abc", handler.log);
+    handler.log.clear();
+    write(fds[1], "defg", 4);
+    waitForLog(&handler);
+    EXPECT_EQ("defg", handler.log);
+}
+
+TEST_F(IoUringTest, receive_endOfFile) {
+    RecordingHandler handler(ring.get());
+    ring->receive(&handler, fds[0]);
+    dispatch.poll();
+    close(fds[1]);
+    fds[1] = socket(AF_UNIX, SOCK_STREAM, 0);
+    waitForLog(&handler);
+    EXPECT_EQ("0", handler.log);
+}
+
+TEST_F(IoUringTest, receive_buffersRecycled) {
+    RecordingHandler handler(ring.get());
+    ring->receive(&handler, fds[0]);
+    dispatch.poll();
+
+    // Receive more completions than there are buffers.
+    for (uint32_t i = 0; i < 2 * IoUring::RECEIVE_BUFFERS; i++) {
+        handler.log.clear();
+        write(fds[1], "x", 1);
+        waitForLog(&handler);
+        ASSERT_EQ("x", handler.log);
+    }
+}
+
+TEST_F(IoUringTest, accept) {
+    ServiceLocator locator("tcp:host=localhost,port=11130");
+    IpAddress address(&locator);
+    int listenFd = socket(PF_INET, SOCK_STREAM, 0);
+    int optval = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+    ASSERT_EQ(0, bind(listenFd, &address.address, sizeof(address.address)));
+    ASSERT_EQ(0, listen(listenFd, 10));
+    RecordingHandler handler(ring.get());
+    ring->accept(&handler, listenFd);
+    dispatch.poll();
+
+    int clientFd = socket(PF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(0, connect(clientFd, &address.address,
+            sizeof(address.address)));
+    waitForLog(&handler);
+    int acceptedFd = atoi(handler.log.c_str());
+    EXPECT_GT(acceptedFd, 0);
+
+    // The accepted socket is connected to the client.
+    write(clientFd, "ping", 4);
+    char buffer[10];
+    EXPECT_EQ(4, read(acceptedFd, buffer, sizeof(buffer)));
+    close(acceptedFd);
+    close(clientFd);
+    close(listenFd);
+}
+
+TEST_F(IoUringTest, handlerDestructor_cancels) {
+    Tub<RecordingHandler> handler;
+    handler.construct(ring.get());
+    ring->receive(handler.get(), fds[0]);
+    dispatch.poll();
+    handler.destroy();
+    EXPECT_EQ(0U, ring->handlers.size());
+    dispatch.poll();
+
+    // Data arriving now stays in the socket.
+    write(fds[1], "abc", 3);
+    usleep(1000);
+    dispatch.poll();
+    char buffer[10];
+    EXPECT_EQ(3, recv(fds[0], buffer, sizeof(buffer), MSG_DONTWAIT));
+}
+
+TEST_F(IoUringTest, poll_handlerDeletedDuringCompletion) {
+    // A handler that deletes itself when it is invoked.
+    class SuicidalHandler : public IoUring::Handler {
+      public:
+        explicit SuicidalHandler(IoUring* ring, int* count)
+            : IoUring::Handler(ring), count(count) {}
+        void handleCompletion(int result, char* data) {
+            (*count)++;
+            delete this;
+        }
+        int* count;
+        DISALLOW_COPY_AND_ASSIGN(SuicidalHandler);
+    };
+    int count = 0;
+    ring->receive(new SuicidalHandler(ring.get(), &count), fds[0]);
+    dispatch.poll();
+    write(fds[1], "abc", 3);
+    for (int i = 0; (i < 1000) && (count == 0); i++) {
+        dispatch.poll();
+        usleep(1000);
+    }
+    EXPECT_EQ(1, count);
+    EXPECT_EQ(0U, ring->handlers.size());
+}
+
+}  // namespace RAMCloud
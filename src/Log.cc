@@ -16,6 +16,7 @@
 #include <assert.h>
 #include <stdint.h>
 
+#include "Cycles.h"
 #include "Log.h"
 #include "LogCleaner.h"
 #include "PerfStats.h"
@@ -67,6 +68,10 @@ Log::Log(Context* context,
       context(context),
       cleaner(NULL),
       syncLock("Log::syncLock"),
+      syncWaiters(0),
+      groupCommitMaxWindowCycles(0),
+      groupCommitMaxBytes(0),
+      groupCommitWindowCycles(0),
       metrics()
 {
     cleaner = new LogCleaner(context,
@@ -115,6 +120,8 @@ Log::getMetrics(ProtoBuf::LogMetrics& m)
     AbstractLog::getMetrics(m);
     m.set_total_sync_calls(metrics.totalSyncCalls);
     m.set_total_sync_ticks(metrics.totalSyncTicks);
+    m.set_total_sync_rounds(metrics.totalSyncRounds);
+    m.set_total_group_commit_wait_ticks(metrics.totalGroupCommitWaitTicks);
     cleaner->getMetrics(*m.mutable_cleaner_metrics());
 }
 
@@ -149,6 +156,12 @@ Log::getHead() {
  * that may arrive out-of-order). The log also currently operates strictly
  * in-order, so there'd be no opportunity for small writes to skip ahead of
  * large ones anyway.
+ *
+ * Batching can be made more aggressive with group commit (see
+ * setGroupCommitOptions()). When enabled and writes are arriving concurrently,
+ * the thread that ends up doing the replication first waits a short, adaptive
+ * window so that writers still in the middle of appending can share the same
+ * replication round.
  */
 void
 Log::sync()
@@ -187,15 +200,25 @@ Log::sync()
     // log while we wait. Once we grab the sync lock, take the append lock again
     // to ensure our new view of the head is consistent.
     lock.destroy();
+    syncWaiters++;
     SpinLock::Guard _(syncLock);
+    syncWaiters--;
     lock.construct(appendLock);
 
     // See if we still have work to do. It's possible that another thread
     // already did the syncing we needed for us.
     if (appendedLength > originalHead->syncedLength) {
+        // Give concurrent writers a chance to join this replication round.
+        if (groupCommitMaxWindowCycles.load(std::memory_order_relaxed) != 0) {
+            lock.destroy();
+            waitForGroupCommit(originalHead, appendedLength);
+            lock.construct(appendLock);
+        }
+
         // Get the latest segment length and certificate. This allows us to
         // batch up other appends that came in while we were waiting.
         SegmentCertificate certificate;
+        originalHead->waitForUnfinishedAppends();
         appendedLength = originalHead->getAppendedLength(&certificate);
 
         // Drop the append lock. We don't want to block other appending threads
@@ -204,6 +227,7 @@ Log::sync()
 
         originalHead->replicatedSegment->sync(appendedLength, &certificate);
         originalHead->syncedLength = appendedLength;
+        metrics.totalSyncRounds++;
         TEST_LOG("log synced");
     } else {
         TEST_LOG("sync not needed: already fully replicated");
@@ -253,6 +277,7 @@ Log::syncTo(Log::Reference reference)
         // If segment != head, segment must have been closed and its replication
         // is queued already. Forcing sync of head segment will also make sure
         // that the closed segment is fully replicated.
+        head->waitForUnfinishedAppends();
         uint32_t appendedLength = head->getAppendedLength(&certificate);
 
         // Drop the append lock. We don't want to block other appending
@@ -303,10 +328,106 @@ Log::rollHeadOver()
     return LogPosition(head->id, head->getAppendedLength());
 }
 
+/**
+ * Configure group commit for sync(). With group commit enabled, a thread that
+ * is about to replicate the head waits up to a short window for other writers
+ * to append, so that all of them share one replication round. The actual
+ * window adapts to load between 0 and the maximum given here: it is only
+ * opened when other syncs are queued up, grows while other writers keep
+ * joining, and shrinks back to nothing when they stop.
+ *
+ * This method is thread-safe and may be called at any time, for instance in
+ * response to a runtime option change.
+ *
+ * \param maxWindowMicros
+ *      Longest time, in microseconds, a sync may wait for other writers to
+ *      join its replication round. 0 disables group commit.
+ * \param maxBytes
+ *      Stop waiting as soon as this many bytes have been appended since the
+ *      wait began. 0 means the window is only bounded by time.
+ */
+void
+Log::setGroupCommitOptions(uint32_t maxWindowMicros, uint32_t maxBytes)
+{
+    groupCommitMaxBytes = maxBytes;
+    groupCommitMaxWindowCycles = Cycles::fromMicroseconds(maxWindowMicros);
+}
+
+/**
+ * Change how far ahead of incoming writes the log cleaner tries to stay (see
+ * LogCleaner::setTargetHeadroom()). This method is thread-safe.
+ *
+ * \param millis
+ *      Start cleaning early if free memory would last less than this many
+ *      milliseconds at the current write rate. 0 disables pacing.
+ */
+void
+Log::setCleanerTargetHeadroom(uint32_t millis)
+{
+    cleaner->setTargetHeadroom(millis);
+}
+
 /******************************************************************************
  * PRIVATE METHODS
  ******************************************************************************/
 
+/**
+ * Hold off replicating the given segment for the current group commit window
+ * so that concurrent writers can append and share the upcoming replication
+ * round, then adapt the window for the next round. Called by sync() with
+ * syncLock held and appendLock released.
+ *
+ * \param segment
+ *      The head segment that is about to be replicated.
+ * \param appendedLength
+ *      Length of the segment that the calling sync() needs replicated. Bytes
+ *      appended beyond this are from writers joining the group commit.
+ */
+void
+Log::waitForGroupCommit(LogSegment* segment, uint32_t appendedLength)
+{
+    assert(!syncLock.try_lock());
+
+    uint64_t maxWindow = groupCommitMaxWindowCycles.load();
+    uint64_t minWindow = std::min(maxWindow,
+            Cycles::fromMicroseconds(MIN_GROUP_COMMIT_WINDOW_USEC));
+    uint32_t maxBytes = groupCommitMaxBytes.load();
+
+    // Other syncs queued behind us mean writes are arriving concurrently. If
+    // there are none and the window has already collapsed, the log is lightly
+    // loaded and waiting would only add latency.
+    bool contended = syncWaiters.load() > 0;
+    if (groupCommitWindowCycles == 0) {
+        if (!contended)
+            return;
+        groupCommitWindowCycles = minWindow;
+    }
+    groupCommitWindowCycles = std::min(groupCommitWindowCycles, maxWindow);
+
+    // The length is read without appendLock; a stale value only makes us
+    // wait a little longer or shorter than intended.
+    uint32_t joinedBytes = 0;
+    uint64_t start = Cycles::rdtsc();
+    uint64_t now = start;
+    while (now - start < groupCommitWindowCycles) {
+        joinedBytes = segment->getAppendedLength() - appendedLength;
+        if (maxBytes != 0 && joinedBytes >= maxBytes)
+            break;
+        now = Cycles::rdtsc();
+    }
+    metrics.totalGroupCommitWaitTicks += now - start;
+
+    if (contended || joinedBytes > 0) {
+        groupCommitWindowCycles = std::min(2 * groupCommitWindowCycles,
+                                           maxWindow);
+    } else {
+        groupCommitWindowCycles /= 2;
+        if (groupCommitWindowCycles < minWindow)
+            groupCommitWindowCycles = 0;
+    }
+    TEST_LOG("%u bytes joined", joinedBytes);
+}
+
 /**
  * Allocate a new head segment for the log. This is used by the AbstractLog
  * superclass when a new segment is needed.
@@ -323,6 +444,11 @@ Log::allocNextSegment(bool mustNotFail)
 {
     assert(!appendLock.try_lock());
 
+    // Allocating a new head closes the current one, which publishes its final
+    // length to backups. Make sure every entry reserved in it is complete.
+    if (head != NULL)
+        head->waitForUnfinishedAppends();
+
     if (mustNotFail)
         return segmentManager->allocHeadSegment(SegmentManager::MUST_NOT_FAIL);
     else
@@ -17,6 +17,7 @@
 #define RAMCLOUD_LOG_H
 
 #include <stdint.h>
+#include <atomic>
 #include <unordered_map>
 #include <vector>
 
@@ -63,10 +64,12 @@ class ServerConfig;
  * replicated. If the data must be made durable before continuing, code must
  * explicitly invoke the sync() method to flush all previous appends to backups.
  *
- * This class is thread-safe. Multiple threads may invoke append() in parallel,
- * but all appends are serialized by a single SpinLock. The sync() method will
- * batch multiple append operations to backups to improve throughput, especially
- * when individual entries are small.
+ * This class is thread-safe. Multiple threads may invoke append() in parallel.
+ * Appends serialize on a single SpinLock only while reserving space in the
+ * head segment; multi-entry appends copy their contents in after releasing
+ * it, so copies from different threads proceed in parallel. The sync() method
+ * will batch multiple append operations to backups to improve throughput,
+ * especially when individual entries are small.
  */
 class Log : public AbstractLog {
   public:
@@ -84,9 +87,17 @@ class Log : public AbstractLog {
     void sync();
     void syncTo(Log::Reference reference);
     LogPosition rollHeadOver();
+    void setGroupCommitOptions(uint32_t maxWindowMicros, uint32_t maxBytes);
+    void setCleanerTargetHeadroom(uint32_t millis);
 
   PRIVATE:
     LogSegment* allocNextSegment(bool mustNotFail);
+    void waitForGroupCommit(LogSegment* segment, uint32_t appendedLength);
+
+    /// Smallest group commit window sync() will wait for. When an adaptive
+    /// window shrinks below this it is dropped to 0 (no waiting) until
+    /// concurrent syncs are seen again.
+    static const uint32_t MIN_GROUP_COMMIT_WINDOW_USEC = 1;
 
     INTRUSIVE_LIST_TYPEDEF(LogSegment, listEntries) SegmentList;
 
@@ -109,6 +120,26 @@ class Log : public AbstractLog {
     /// this one must be acquired first to avoid deadlock.
     SpinLock syncLock;
 
+    /// Number of threads in sync() currently waiting to acquire syncLock.
+    /// A non-zero value means writes are arriving concurrently, which is
+    /// what causes the group commit window to open (see waitForGroupCommit).
+    std::atomic<uint32_t> syncWaiters;
+
+    /// Upper bound on how long, in cycles, sync() will hold off replicating
+    /// so that concurrent writers can join the same replication round. 0
+    /// disables group commit. Set with setGroupCommitOptions().
+    std::atomic<uint64_t> groupCommitMaxWindowCycles;
+
+    /// sync() stops waiting for more writers once this many bytes have been
+    /// appended since it started waiting. 0 means no limit.
+    std::atomic<uint32_t> groupCommitMaxBytes;
+
+    /// Current adaptive group commit window in cycles, never greater than
+    /// groupCommitMaxWindowCycles. It doubles after rounds in which other
+    /// writers showed up and halves after rounds in which none did. Only
+    /// accessed with syncLock held.
+    uint64_t groupCommitWindowCycles;
+
     /// Various event counters and performance measurements taken during log
     /// operation.
     class Metrics {
@@ -116,6 +147,8 @@ class Log : public AbstractLog {
         Metrics()
             : totalSyncCalls(0)
             , totalSyncTicks(0)
+            , totalSyncRounds(0)
+            , totalGroupCommitWaitTicks(0)
         {
         }
 
@@ -124,6 +157,14 @@ class Log : public AbstractLog {
 
         /// Total number of cpu cycles spent syncing appended log entries.
         uint64_t totalSyncTicks;
+
+        /// Total number of times sync() actually replicated the head. The
+        /// ratio of totalSyncCalls to this is the average group commit size.
+        uint64_t totalSyncRounds;
+
+        /// Total number of cpu cycles sync() spent holding off replication
+        /// so that other writers could join a group commit.
+        uint64_t totalGroupCommitWaitTicks;
     } metrics;
 
     friend class LogIterator;
@@ -25,6 +25,7 @@
 #include "Segment.h"
 #include "SegmentIterator.h"
 #include "ServerConfig.h"
+#include "Tub.h"
 #include "WallTime.h"
 
 namespace RAMCloud {
@@ -60,6 +61,7 @@ LogCleaner::LogCleaner(Context* context,
       cleanableSegments(segmentManager, config, context, onDiskMetrics),
       writeCostThreshold(config->master.cleanerWriteCostThreshold),
       disableInMemoryCleaning(config->master.disableInMemoryCleaning),
+      segregateHotEntries(config->master.cleanerHotColdSegregation),
       numThreads(config->master.cleanerThreadCount),
       segletSize(config->segletSize),
       segmentSize(config->segmentSize),
@@ -67,14 +69,19 @@ LogCleaner::LogCleaner(Context* context,
       disableCount(0),
       cleanerIdle(),
       mutex(),
+      passPublished(),
+      activePass(NULL),
+      passLock("LogCleaner::passLock"),
       doWorkTicks(0),
       doWorkSleepTicks(0),
       inMemoryMetrics(),
       onDiskMetrics(),
       threadMetrics(numThreads),
+      pacingMetrics(),
       threadsShouldExit(false),
       threads(),
-      balancer(NULL)
+      balancer(NULL),
+      pacer(this)
 {
     if (!segmentManager.initializeSurvivorReserve(numThreads *
                                                   SURVIVOR_SEGMENTS_TO_RESERVE))
@@ -180,6 +187,22 @@ LogCleaner::getMetrics(ProtoBuf::LogMetrics_CleanerMetrics& m)
     inMemoryMetrics.serialize(*m.mutable_in_memory_metrics());
     onDiskMetrics.serialize(*m.mutable_on_disk_metrics());
     threadMetrics.serialize(*m.mutable_thread_metrics());
+    pacingMetrics.serialize(*m.mutable_pacing_metrics());
+}
+
+/**
+ * Change how far ahead of incoming writes the cleaner tries to stay. See
+ * LogCleaner::Pacer for details.
+ *
+ * \param millis
+ *      The cleaner will start working before memory utilization thresholds
+ *      are reached if the free memory left would last less than this many
+ *      milliseconds at the current write rate. 0 disables this behavior.
+ */
+void
+LogCleaner::setTargetHeadroom(uint32_t millis)
+{
+    pacer.setTargetHeadroom(millis);
 }
 
 /******************************************************************************
@@ -251,6 +274,7 @@ LogCleaner::doWork(CleanerThreadState* state)
     }
     if (!goToSleep) {
         threadMetrics.noteThreadStart();
+        pacer.sample();
         switch (balancer->requestTask(state)) {
         case Balancer::CLEAN_DISK:
           {
@@ -267,7 +291,9 @@ LogCleaner::doWork(CleanerThreadState* state)
           }
 
         case Balancer::SLEEP:
-            goToSleep = true;
+            // Nothing for this thread to start on its own, but another one
+            // may have a disk cleaning pass that could use the help.
+            goToSleep = !helpWithDiskCleaning(state);
             break;
         }
 
@@ -289,8 +315,10 @@ LogCleaner::doWork(CleanerThreadState* state)
         // if we don't, but it can make some locks look artificially contended
         // when there's no cleaning to be done and threads manage to caravan
         // together.
+        // Wake up early if a disk cleaning pass is published in the meantime.
         useconds_t r = downCast<useconds_t>(generateRandom() % POLL_USEC) / 10;
-        usleep(POLL_USEC + r);
+        Lock lock(mutex);
+        passPublished.wait_for(lock, std::chrono::microseconds(POLL_USEC + r));
     }
 }
 
@@ -434,11 +462,6 @@ LogCleaner::doDiskCleaning()
     onDiskMetrics.memoryUtilizationAtStartSum +=
         segmentManager.getMemoryUtilization();
 
-    // Extract the currently live entries of the segments we're cleaning and
-    // sort them by age.
-    EntryVector entries;
-    getSortedEntries(segmentsToClean, entries, &localMetrics);
-
     uint64_t maxLiveBytes = 0;
     uint32_t segletsBefore = 0;
     foreach (LogSegment* segment, segmentsToClean) {
@@ -449,12 +472,39 @@ LogCleaner::doDiskCleaning()
         segletsBefore += segment->getSegletsAllocated();
     }
 
+    // Every stream of survivors we write to (one for cold entries and maybe
+    // one for hot entries, in each thread working on the pass) can end with
+    // a partially filled segment. A pass must never produce more segments
+    // than it cleans, so only use as many streams as there are segments
+    // beyond those the live data is sure to fill, plus one.
+    size_t liveSegments = (maxLiveBytes + segmentSize - 1) / segmentSize;
+    size_t maxStreams = segmentsToClean.size() - liveSegments + 1;
+    bool separateHotEntries = segregateHotEntries && maxStreams >= 2;
+    size_t maxWorkers = std::min(downCast<size_t>(numThreads),
+                                 maxStreams / (separateHotEntries ? 2 : 1));
+
+    // If there's room for more than one thread, let idle cleaner threads
+    // help out.
+    Tub<DiskCleaningPass> pass;
+    if (maxWorkers > 1) {
+        pass.construct(segmentsToClean, separateHotEntries,
+                       downCast<uint32_t>(maxWorkers));
+        if (!publishPass(pass.get()))
+            pass.destroy();
+    }
+
+    // Extract the currently live entries of the segments we're cleaning and
+    // sort them by age.
+    EntryVector entries;
+    getSortedEntries(segmentsToClean, entries, &localMetrics,
+                     separateHotEntries, pass.get());
+
     // Relocate the live entries to survivor segments. Be sure to use local
     // counters and merge them into our global metrics afterwards to avoid
     // cache line ping-ponging in the hot path.
     LogSegmentVector survivors;
     uint64_t entryBytesAppended = relocateLiveEntries(entries, survivors,
-            &localMetrics);
+            &localMetrics, pass.get());
 
     uint32_t segmentsAfter = downCast<uint32_t>(survivors.size());
     uint32_t segletsAfter = 0;
@@ -565,26 +615,57 @@ LogCleaner::sortEntriesByTimestamp(EntryVector& entries)
  *      Vector containing sorted live entries in the segment.
  * \param[out] localMetrics
  *      Contains various performance counters that are incremented here.
+ * \param separateHotEntries
+ *      If true, ask the entry handlers whether each entry is hot and record
+ *      the answer in the returned Entry, so that relocateLiveEntries() will
+ *      write hot entries to their own survivors. Otherwise all entries are
+ *      treated as cold.
+ * \param pass
+ *      If not NULL, the shared pass (already published with publishPass())
+ *      that idle cleaner threads may help scan the segments of. Each thread
+ *      sorts the entries it extracted and this method merges the results.
+ *      Afterwards the pass is ready for relocateLiveEntries().
  */
 void
 LogCleaner::getSortedEntries(LogSegmentVector& segmentsToClean,
                              EntryVector& outEntries,
-                             LogCleanerMetrics::OnDisk<uint64_t>* localMetrics)
+                             LogCleanerMetrics::OnDisk<uint64_t>* localMetrics,
+                             bool separateHotEntries,
+                             DiskCleaningPass* pass)
 {
     AtomicCycleCounter _(&onDiskMetrics.getSortedEntriesTicks);
 
-    foreach (LogSegment* segment, segmentsToClean) {
-        for (SegmentIterator it(*segment); !it.isDone(); it.next()) {
-            LogEntryType type = it.getType();
-            Buffer buffer;
-            it.appendToBuffer(buffer);
-            uint32_t timestamp = entryHandlers.getTimestamp(type, buffer);
-            outEntries.push_back(Entry(segment->getReference(it.getOffset()),
-                                       timestamp));
+    if (pass == NULL) {
+        foreach (LogSegment* segment, segmentsToClean)
+            extractEntries(segment, outEntries, separateHotEntries);
+        sortEntriesByTimestamp(outEntries);
+    } else {
+        scanSegments(pass, &pass->workers[0]);
+
+        // Wait for any helpers to finish their share of the scan. Nobody
+        // joins the scan once the pass has moved on to sorting.
+        while (true) {
+            {
+                SpinLock::Guard guard(passLock);
+                if (pass->scanningWorkers == 0) {
+                    pass->phase = DiskCleaningPass::SORTING;
+                    break;
+                }
+            }
+            std::this_thread::yield();
         }
-    }
 
-    sortEntriesByTimestamp(outEntries);
+        foreach (DiskCleaningPass::Worker& worker, pass->workers) {
+            size_t sorted = outEntries.size();
+            outEntries.insert(outEntries.end(), worker.entries.begin(),
+                              worker.entries.end());
+            std::inplace_merge(outEntries.begin(),
+                               outEntries.begin() + sorted,
+                               outEntries.end(),
+                               TimestampComparer());
+            EntryVector().swap(worker.entries);
+        }
+    }
 
     foreach (LogSegment* segment, segmentsToClean) {
         localMetrics->totalMemoryBytesInCleanedSegments +=
@@ -600,10 +681,39 @@ LogCleaner::getSortedEntries(LogSegmentVector& segmentsToClean,
         outEntries.size(), segmentsToClean.size());
 }
 
+/**
+ * Append an Entry for every entry in the given segment to a vector. The
+ * entries are not sorted.
+ *
+ * \param segment
+ *      The segment being cleaned to extract entries from.
+ * \param[out] outEntries
+ *      Vector the extracted entries are appended to.
+ * \param separateHotEntries
+ *      See getSortedEntries().
+ */
+void
+LogCleaner::extractEntries(LogSegment* segment,
+                           EntryVector& outEntries,
+                           bool separateHotEntries)
+{
+    for (SegmentIterator it(*segment); !it.isDone(); it.next()) {
+        LogEntryType type = it.getType();
+        Buffer buffer;
+        it.appendToBuffer(buffer);
+        uint32_t timestamp = entryHandlers.getTimestamp(type, buffer);
+        bool hot = separateHotEntries &&
+                   entryHandlers.isHot(type, buffer);
+        outEntries.push_back(Entry(segment->getReference(it.getOffset()),
+                                   timestamp, hot));
+    }
+}
+
 /**
  * Given a vector of entries from segments being cleaned, write them out to
  * survivor segments in order and alert their owning module (MasterService,
- * usually), that they've been relocated.
+ * usually), that they've been relocated. Entries marked hot are written to
+ * a different set of survivors than the rest.
  *
  * \param entries
  *      Vector the entries from segments being cleaned that may need to be
@@ -613,6 +723,11 @@ LogCleaner::getSortedEntries(LogSegmentVector& segmentsToClean,
  *      returned here.
  * \param[out] localMetrics
  *      Contains various performance counters that are incremented here.
+ * \param pass
+ *      If not NULL, the shared pass that #entries were extracted for (see
+ *      getSortedEntries()). Idle cleaner threads may help relocate the
+ *      entries, each into survivors of its own. The pass is withdrawn from
+ *      #activePass before this method returns.
  * \return
  *      The number of live bytes appended to survivors is returned. This value
  *      includes any segment metadata overhead. This makes it directly
@@ -622,16 +737,106 @@ LogCleaner::getSortedEntries(LogSegmentVector& segmentsToClean,
 uint64_t
 LogCleaner::relocateLiveEntries(EntryVector& entries,
                             LogSegmentVector& outSurvivors,
-                            LogCleanerMetrics::OnDisk<uint64_t>* localMetrics)
+                            LogCleanerMetrics::OnDisk<uint64_t>* localMetrics,
+                            DiskCleaningPass* pass)
 {
     CycleCounter<uint64_t> _(&localMetrics->relocateLiveEntriesTicks);
 
-    LogSegment* survivor = NULL;
     uint64_t totalEntryBytesAppended = 0;
-    uint32_t currentLiveEntries[TOTAL_LOG_ENTRY_TYPES] = { 0 };
-    uint32_t currentLiveEntryLengths[TOTAL_LOG_ENTRY_TYPES] = { 0 };
 
-    foreach (Entry& entry, entries) {
+    if (pass == NULL) {
+        SurvivorStream coldStream, hotStream;
+        totalEntryBytesAppended = relocateEntries(entries.begin(),
+                                                  entries.end(),
+                                                  &coldStream,
+                                                  &hotStream,
+                                                  outSurvivors,
+                                                  localMetrics);
+        if (coldStream.survivor != NULL)
+            finishSurvivor(&coldStream);
+        if (hotStream.survivor != NULL)
+            finishSurvivor(&hotStream);
+    } else {
+        {
+            SpinLock::Guard guard(passLock);
+            pass->entries = &entries;
+            pass->phase = DiskCleaningPass::RELOCATING;
+        }
+
+        relocateChunks(pass, &pass->workers[0]);
+
+        // Wait for the helpers to finish, then withdraw the pass so that no
+        // more threads join it.
+        while (true) {
+            {
+                SpinLock::Guard guard(passLock);
+                if (pass->unfinishedWorkers == 0) {
+                    activePass = NULL;
+                    break;
+                }
+            }
+            std::this_thread::yield();
+        }
+
+        foreach (DiskCleaningPass::Worker& worker, pass->workers) {
+            outSurvivors.insert(outSurvivors.end(), worker.survivors.begin(),
+                                worker.survivors.end());
+            localMetrics->merge(worker.metrics);
+            totalEntryBytesAppended += worker.bytesAppended;
+        }
+    }
+
+    // Ensure that the survivors have been synced to backups before proceeding.
+    double survivorMb = static_cast<double>(totalEntryBytesAppended);
+    survivorMb /= 1e06;
+    uint64_t start = Cycles::rdtsc();
+    foreach (LogSegment* survivor, outSurvivors) {
+        CycleCounter<uint64_t> __(&localMetrics->survivorSyncTicks);
+        survivor->replicatedSegment->sync(survivor->getAppendedLength());
+    }
+    double elapsed = Cycles::toSeconds(Cycles::rdtsc() - start);
+    LOG(NOTICE, "Cleaner finished syncing survivor segments: %.1f ms, "
+            "%.1f MB/sec", elapsed*1e03, survivorMb/elapsed);
+
+    return totalEntryBytesAppended;
+}
+
+/**
+ * Relocate a range of sorted entries into a cold and a hot stream of
+ * survivor segments. Any survivors that must be allocated along the way are
+ * appended to a vector. The streams' current survivors are left open, so
+ * that a later range can continue filling them; the caller must eventually
+ * finish them with finishSurvivor().
+ *
+ * \param begin
+ *      The first entry to relocate.
+ * \param end
+ *      One past the last entry to relocate.
+ * \param coldStream
+ *      Stream to write entries that aren't marked hot to.
+ * \param hotStream
+ *      Stream to write entries marked hot to.
+ * \param outSurvivors
+ *      Newly allocated survivor segments are appended to this vector.
+ * \param[out] localMetrics
+ *      Contains various performance counters that are incremented here.
+ * \return
+ *      The number of bytes appended to survivors, including any segment
+ *      metadata overhead.
+ */
+uint64_t
+LogCleaner::relocateEntries(EntryVector::iterator begin,
+                            EntryVector::iterator end,
+                            SurvivorStream* coldStream,
+                            SurvivorStream* hotStream,
+                            LogSegmentVector& outSurvivors,
+                            LogCleanerMetrics::OnDisk<uint64_t>* localMetrics)
+{
+    uint64_t totalEntryBytesAppended = 0;
+
+    for (EntryVector::iterator it = begin; it != end; ++it) {
+        Entry& entry = *it;
+        SurvivorStream& stream = entry.hot ? *hotStream : *coldStream;
         Buffer buffer;
         LogEntryType type = entry.reference.getEntry(
             &segmentManager.getAllocator(), &buffer);
@@ -640,38 +845,31 @@ LogCleaner::relocateLiveEntries(EntryVector& entries,
         RelocStatus s = relocateEntry(type,
                                       buffer,
                                       reference,
-                                      survivor,
+                                      stream.survivor,
                                       localMetrics,
                                       &bytesAppended);
 
         if (expect_false(s == RELOCATION_FAILED)) {
-            if (survivor != NULL) {
-                for (size_t i = 0; i < TOTAL_LOG_ENTRY_TYPES; i++) {
-                    survivor->trackNewEntries(static_cast<LogEntryType>(i),
-                                              currentLiveEntries[i],
-                                              currentLiveEntryLengths[i]);
-                }
-                memset(currentLiveEntries, 0, sizeof(currentLiveEntries));
-                memset(currentLiveEntryLengths, 0,
-                       sizeof(currentLiveEntryLengths));
-                closeSurvivor(survivor);
-            }
+            if (stream.survivor != NULL)
+                finishSurvivor(&stream);
 
             // Allocate a survivor segment to write into. This call may block if
             // one is not available right now.
             CycleCounter<uint64_t> waitTicks(
                 &localMetrics->waitForFreeSurvivorsTicks);
-            survivor = segmentManager.allocSideSegment(
+            stream.survivor = segmentManager.allocSideSegment(
                 SegmentManager::FOR_CLEANING | SegmentManager::MUST_NOT_FAIL,
                 NULL);
-            assert(survivor != NULL);
+            assert(stream.survivor != NULL);
             waitTicks.stop();
-            outSurvivors.push_back(survivor);
+            outSurvivors.push_back(stream.survivor);
+            if (entry.hot)
+                localMetrics->totalHotSurvivorsCreated++;
 
             s = relocateEntry(type,
                               buffer,
                               reference,
-                              survivor,
+                              stream.survivor,
                               localMetrics,
                               &bytesAppended);
             if (s == RELOCATION_FAILED)
@@ -684,35 +882,178 @@ LogCleaner::relocateLiveEntries(EntryVector& entries,
             localMetrics->totalLiveEntriesScanned[type]++;
             localMetrics->totalLiveScannedEntryLengths[type] +=
                 buffer.size();
-            currentLiveEntries[type]++;
-            currentLiveEntryLengths[type] += bytesAppended;
+            stream.liveEntries[type]++;
+            stream.liveEntryLengths[type] += bytesAppended;
+            if (entry.hot)
+                localMetrics->totalHotEntriesRelocated++;
         }
 
         totalEntryBytesAppended += bytesAppended;
     }
 
-    if (survivor != NULL) {
-        for (size_t i = 0; i < TOTAL_LOG_ENTRY_TYPES; i++) {
-            survivor->trackNewEntries(static_cast<LogEntryType>(i),
-                                      currentLiveEntries[i],
-                                      currentLiveEntryLengths[i]);
+    return totalEntryBytesAppended;
+}
+
+/**
+ * Make a disk cleaning pass available to idle cleaner threads (see
+ * helpWithDiskCleaning()) and wake up any that are sleeping.
+ *
+ * \param pass
+ *      The pass to share. The calling thread is its leader and must take it
+ *      through getSortedEntries() and relocateLiveEntries(), which withdraws
+ *      it again.
+ * \return
+ *      True if the pass was published. False if another pass is already
+ *      being shared, in which case the caller must clean on its own.
+ */
+bool
+LogCleaner::publishPass(DiskCleaningPass* pass)
+{
+    {
+        SpinLock::Guard guard(passLock);
+        if (activePass != NULL)
+            return false;
+        activePass = pass;
+    }
+    passPublished.notify_all();
+    return true;
+}
+
+/**
+ * Join the disk cleaning pass currently published by another cleaner thread,
+ * if there is one with room for another thread, and work on it until all of
+ * its entries have been claimed for relocation.
+ *
+ * \param state
+ *      State of the calling cleaner thread. Time spent helping is counted as
+ *      disk cleaning time.
+ * \return
+ *      True if this thread helped with a pass, false if there was nothing to
+ *      help with.
+ */
+bool
+LogCleaner::helpWithDiskCleaning(CleanerThreadState* state)
+{
+    DiskCleaningPass* pass;
+    DiskCleaningPass::Worker* worker;
+    bool scan;
+    {
+        SpinLock::Guard guard(passLock);
+        pass = activePass;
+        if (pass == NULL || pass->joinedWorkers == pass->workers.size())
+            return false;
+        worker = &pass->workers[pass->joinedWorkers++];
+        scan = (pass->phase == DiskCleaningPass::SCANNING);
+        if (scan)
+            pass->scanningWorkers++;
+        pass->unfinishedWorkers++;
+    }
+
+    CycleCounter<uint64_t> _(&state->diskCleaningTicks);
+
+    if (scan)
+        scanSegments(pass, worker);
+
+    // Wait for the leader to merge and sort what has been scanned.
+    while (true) {
+        {
+            SpinLock::Guard guard(passLock);
+            if (pass->phase == DiskCleaningPass::RELOCATING)
+                break;
         }
-        closeSurvivor(survivor);
+        std::this_thread::yield();
     }
 
-    // Ensure that the survivors have been synced to backups before proceeding.
-    double survivorMb = static_cast<double>(totalEntryBytesAppended);
-    survivorMb /= 1e06;
-    uint64_t start = Cycles::rdtsc();
-    foreach (survivor, outSurvivors) {
-        CycleCounter<uint64_t> __(&localMetrics->survivorSyncTicks);
-        survivor->replicatedSegment->sync(survivor->getAppendedLength());
+    relocateChunks(pass, worker);
+    return true;
+}
+
+/**
+ * Extract entries from unscanned segments of a shared pass until every
+ * segment has been claimed, then sort them. Used by both the leader and
+ * helpers of a pass.
+ *
+ * \param pass
+ *      The pass the calling thread is working on.
+ * \param worker
+ *      The calling thread's slot in the pass.
+ */
+void
+LogCleaner::scanSegments(DiskCleaningPass* pass,
+                         DiskCleaningPass::Worker* worker)
+{
+    size_t i;
+    while ((i = pass->nextSegment++) < pass->segmentsToClean.size()) {
+        extractEntries(pass->segmentsToClean[i], worker->entries,
+                       pass->separateHotEntries);
     }
-    double elapsed = Cycles::toSeconds(Cycles::rdtsc() - start);
-    LOG(NOTICE, "Cleaner finished syncing survivor segments: %.1f ms, "
-            "%.1f MB/sec", elapsed*1e03, survivorMb/elapsed);
+    sortEntriesByTimestamp(worker->entries);
 
-    return totalEntryBytesAppended;
+    SpinLock::Guard guard(passLock);
+    pass->scanningWorkers--;
+}
+
+/**
+ * Relocate chunks of a shared pass's sorted entries into the calling
+ * thread's own survivors until every chunk has been claimed. Used by both
+ * the leader and helpers of a pass. Once this returns a helper must not
+ * touch the pass again; the leader may destroy it at any time.
+ *
+ * \param pass
+ *      The pass the calling thread is working on. Must be in the RELOCATING
+ *      stage.
+ * \param worker
+ *      The calling thread's slot in the pass.
+ */
+void
+LogCleaner::relocateChunks(DiskCleaningPass* pass,
+                           DiskCleaningPass::Worker* worker)
+{
+    EntryVector& entries = *pass->entries;
+    size_t chunk;
+    while ((chunk = pass->nextChunk++) * RELOCATION_CHUNK_ENTRIES <
+           entries.size()) {
+        size_t begin = chunk * RELOCATION_CHUNK_ENTRIES;
+        size_t end = std::min(begin + RELOCATION_CHUNK_ENTRIES,
+                              entries.size());
+        worker->bytesAppended += relocateEntries(entries.begin() + begin,
+                                                 entries.begin() + end,
+                                                 &worker->coldStream,
+                                                 &worker->hotStream,
+                                                 worker->survivors,
+                                                 &worker->metrics);
+    }
+
+    if (worker->coldStream.survivor != NULL)
+        finishSurvivor(&worker->coldStream);
+    if (worker->hotStream.survivor != NULL)
+        finishSurvivor(&worker->hotStream);
+
+    SpinLock::Guard guard(passLock);
+    pass->unfinishedWorkers--;
+}
+
+/**
+ * Tell the current survivor of a stream which live entries were appended to
+ * it, then close it (see closeSurvivor()). Afterwards the stream has no
+ * survivor and its counts are zeroed, ready for the next one.
+ *
+ * \param stream
+ *      The stream whose survivor is full or no longer needed. Its survivor
+ *      must not be NULL.
+ */
+void
+LogCleaner::finishSurvivor(SurvivorStream* stream)
+{
+    for (size_t i = 0; i < TOTAL_LOG_ENTRY_TYPES; i++) {
+        stream->survivor->trackNewEntries(static_cast<LogEntryType>(i),
+                                          stream->liveEntries[i],
+                                          stream->liveEntryLengths[i]);
+    }
+    memset(stream->liveEntries, 0, sizeof(stream->liveEntries));
+    memset(stream->liveEntryLengths, 0, sizeof(stream->liveEntryLengths));
+    closeSurvivor(stream->survivor);
+    stream->survivor = NULL;
 }
 
 /**
@@ -753,15 +1094,17 @@ LogCleaner::Balancer::isMemoryLow(CleanerThreadState* thread)
 
     // We need to clean if memory is low and there's space that could be
     // reclaimed. It's not worth cleaning if almost everything is alive.
+    // Below the thresholds, the pacer may still want us to clean if writes
+    // will otherwise use up the remaining memory too soon.
     int baseThreshold = std::max(90, (100 + L) / 2);
     if (T < baseThreshold)
-        return false;
+        return cleaner->pacer.isCleaningNeeded(thread, T, L);
 
     // Employ multiple threads only when we fail to keep up with fewer of them.
     if (thread->threadNumber > 0) {
         int thresh = baseThreshold + 2 * static_cast<int>(thread->threadNumber);
         if (T < std::min(99, thresh))
-            return false;
+            return cleaner->pacer.isCleaningNeeded(thread, T, L);
     }
 
     return true;
@@ -904,6 +1247,147 @@ LogCleaner::FixedBalancer::isDiskCleaningNeeded(CleanerThreadState* thread)
     return true;
 }
 
+/**
+ * Construct a new Pacer. Pacing is disabled until setTargetHeadroom() is
+ * called with a non-zero value.
+ *
+ * \param cleaner
+ *      The cleaner whose threads are being paced.
+ */
+LogCleaner::Pacer::Pacer(LogCleaner* cleaner)
+    : cleaner(cleaner)
+    , lock("LogCleaner::Pacer::lock")
+    , lastSampleTicks(0)
+    , lastHeadBytes(0)
+    , lastBytesFreed(0)
+    , lastCleanerTicks(0)
+    , writeBytesPerSecond(0)
+    , cleanerBytesPerSecond(0)
+    , targetHeadroomMillis(0)
+    , threadsWanted(0)
+{
+}
+
+/**
+ * Update the pacer's estimates of the write and cleaning rates and decide
+ * how many cleaner threads should be working. This is called by every
+ * cleaner thread each time around its loop, but does nothing unless at
+ * least SAMPLE_USEC have passed since the last sample.
+ */
+void
+LogCleaner::Pacer::sample()
+{
+    if (!lock.try_lock())
+        return;
+    SpinLock::Guard _(lock, std::adopt_lock);
+
+    uint64_t now = Cycles::rdtsc();
+    if (lastSampleTicks != 0 &&
+      Cycles::toMicroseconds(now - lastSampleTicks) < SAMPLE_USEC)
+        return;
+
+    uint64_t headBytes = cleaner->segmentManager.getTotalHeadBytesAllocated();
+    uint64_t bytesFreed = cleaner->inMemoryMetrics.totalBytesFreed +
+                          cleaner->onDiskMetrics.totalMemoryBytesFreed;
+    uint64_t cleanerTicks = cleaner->inMemoryMetrics.totalTicks +
+                            cleaner->onDiskMetrics.totalTicks;
+
+    if (lastSampleTicks != 0) {
+        double seconds = Cycles::toSeconds(now - lastSampleTicks);
+        double writeRate = static_cast<double>(headBytes - lastHeadBytes) /
+                           seconds;
+        writeBytesPerSecond += (writeRate - writeBytesPerSecond) / SMOOTHING;
+
+        // Cleaning metrics are only merged once a pass or compaction is
+        // done, so there is nothing to learn from samples with no new work.
+        if (cleanerTicks > lastCleanerTicks) {
+            double cleanerRate =
+                static_cast<double>(bytesFreed - lastBytesFreed) /
+                Cycles::toSeconds(cleanerTicks - lastCleanerTicks);
+            if (cleanerBytesPerSecond == 0)
+                cleanerBytesPerSecond = cleanerRate;
+            else
+                cleanerBytesPerSecond +=
+                    (cleanerRate - cleanerBytesPerSecond) / SMOOTHING;
+        }
+    }
+
+    lastSampleTicks = now;
+    lastHeadBytes = headBytes;
+    lastBytesFreed = bytesFreed;
+    lastCleanerTicks = cleanerTicks;
+
+    uint64_t headroom = ~0UL;
+    if (writeBytesPerSecond >= 1) {
+        headroom = static_cast<uint64_t>(
+            static_cast<double>(cleaner->segmentManager.getFreeMemoryBytes()) *
+            1000 / writeBytesPerSecond);
+    }
+
+    uint32_t target = targetHeadroomMillis;
+    uint32_t wanted = 0;
+    if (target != 0 && headroom < target) {
+        // Employ as many threads as it takes to free memory as fast as it is
+        // being consumed. Until we know how fast a thread cleans, start with
+        // one and see.
+        wanted = 1;
+        if (cleanerBytesPerSecond > 0) {
+            double threads = std::ceil(writeBytesPerSecond /
+                                       cleanerBytesPerSecond);
+            wanted = static_cast<uint32_t>(std::min(
+                static_cast<double>(cleaner->numThreads), threads));
+            wanted = std::max(1U, wanted);
+        }
+    }
+    threadsWanted = wanted;
+
+    cleaner->pacingMetrics.totalSamples++;
+    if (wanted > 0)
+        cleaner->pacingMetrics.totalPacedSamples++;
+    cleaner->pacingMetrics.writeBytesPerSecond =
+        static_cast<uint64_t>(writeBytesPerSecond);
+    cleaner->pacingMetrics.cleanerBytesPerSecond =
+        static_cast<uint64_t>(cleanerBytesPerSecond);
+    cleaner->pacingMetrics.headroomMillis = headroom;
+    cleaner->pacingMetrics.targetHeadroomMillis = target;
+    cleaner->pacingMetrics.threadsWanted = wanted;
+}
+
+/**
+ * Decide whether a cleaner thread should clean even though memory utilization
+ * hasn't reached the balancer's threshold for that thread.
+ *
+ * \param thread
+ *      State of the cleaner thread asking.
+ * \param T
+ *      Percentage of memory in use (see Balancer::isMemoryLow()).
+ * \param L
+ *      Percentage of memory in use by live objects.
+ * eturn
+ *      True if, as of the last sample, the pacer wants this thread working
+ *      and there is some dead space for it to reclaim.
+ */
+bool
+LogCleaner::Pacer::isCleaningNeeded(CleanerThreadState* thread, int T, int L)
+{
+    if (T <= L)
+        return false;
+    return thread->threadNumber < threadsWanted;
+}
+
+/**
+ * Set the headroom the pacer should maintain. The new target takes effect at
+ * the next sample.
+ *
+ * \param millis
+ *      See LogCleaner::setTargetHeadroom().
+ */
+void
+LogCleaner::Pacer::setTargetHeadroom(uint32_t millis)
+{
+    targetHeadroomMillis = millis;
+}
+
 /**
  * Construct a Disabler object. Once the constructor returns, the caller
  * can be certain that no cleaner threads are running, or will run until
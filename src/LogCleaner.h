@@ -27,6 +27,7 @@
 #include "LogEntryRelocator.h"
 #include "LogSegment.h"
 #include "SegmentManager.h"
+#include "SpinLock.h"
 #include "ReplicaManager.h"
 
 #include "LogMetrics.pb.h"
@@ -55,6 +56,17 @@ class ServerConfig;
  * so those segments will maintain high utilization and therefore require
  * less cleaning. Second, new data is more likely to fragment, so segments
  * containing newer data will hopefully be cheaper to clean in the future.
+ *
+ * Age alone says nothing about how soon an entry will be overwritten, though.
+ * If configured to, the cleaner also asks the LogEntryHandlers which entries
+ * are "hot" (frequently rewritten) and relocates them into a separate stream
+ * of survivor segments. Those survivors empty out quickly on their own, while
+ * cold survivors stay nearly full and rarely need to be cleaned again.
+ *
+ * A single disk cleaning pass may be shared by several cleaner threads. Those
+ * that have no cleaning of their own to do scan segments and relocate entries
+ * on behalf of the thread that started the pass, each writing into its own
+ * survivor segments.
  */
 class LogCleaner {
   public:
@@ -67,6 +79,7 @@ class LogCleaner {
     void start();
     void stop();
     void getMetrics(ProtoBuf::LogMetrics_CleanerMetrics& m);
+    void setTargetHeadroom(uint32_t millis);
 
     /// The maximum amount of live data we'll process in any single disk
     /// cleaning pass. The units are full segments. The cleaner will multiply
@@ -111,6 +124,12 @@ class LogCleaner {
     /// seglets at the ends of survivor segments.
     enum { SURVIVOR_SEGMENTS_TO_RESERVE = 15 };
 
+    /// When several threads share a disk cleaning pass, they claim sorted
+    /// entries to relocate in chunks of this many at a time. Small enough to
+    /// balance the load well, large enough that the shared counter is not
+    /// contended.
+    enum { RELOCATION_CHUNK_ENTRIES = 256 };
+
     /// The minimum amount of memory utilization we will begin cleaning at using
     /// the in-memory cleaner.
     enum { MIN_MEMORY_UTILIZATION = 90 };
@@ -127,13 +146,16 @@ class LogCleaner {
      * cache of its timestamp. The purpose of this is to make sorting entries
      * by age much faster by caching the timestamp when we first examine the
      * entry in getSortedEntries(), rather than extracting it on each sort
-     * comparison.
+     * comparison. The entry's hotness is cached alongside so that
+     * relocateLiveEntries() knows which survivor stream it belongs in.
      */
     class Entry {
       public:
-        Entry(Segment::Reference reference, uint32_t timestamp)
+        Entry(Segment::Reference reference, uint32_t timestamp,
+              bool hot = false)
             : reference(reference),
-              timestamp(timestamp)
+              timestamp(timestamp),
+              hot(hot)
         {
             static_assert(sizeof(Entry) == 16, "Entry isn't the expected size");
         }
@@ -144,6 +166,10 @@ class LogCleaner {
 
         /// Timestamp of the entry (see WallTime). Used to sort the entries.
         uint32_t timestamp;
+
+        /// True if the entry handlers expect this entry to be overwritten
+        /// soon. Hot entries are relocated to their own survivor segments.
+        bool hot;
     };
     typedef std::vector<Entry> EntryVector;
 
@@ -162,6 +188,153 @@ class LogCleaner {
         }
     };
 
+    /**
+     * A sequence of survivor segments being filled by a disk cleaning pass.
+     * Each pass writes cold entries to one stream and, if segregating hot
+     * entries, hot entries to another, so that the two never share a
+     * survivor segment. Counts of the live entries appended to the current
+     * survivor are accumulated here and handed to the segment when it is
+     * closed.
+     */
+    class SurvivorStream {
+      public:
+        SurvivorStream()
+            : survivor(NULL),
+              liveEntries(),
+              liveEntryLengths()
+        {
+        }
+
+        /// Survivor currently being appended to. NULL until the first live
+        /// entry for this stream is found.
+        LogSegment* survivor;
+
+        /// Number of live entries of each type appended to #survivor.
+        uint32_t liveEntries[TOTAL_LOG_ENTRY_TYPES];
+
+        /// Bytes of live entries of each type appended to #survivor.
+        uint32_t liveEntryLengths[TOTAL_LOG_ENTRY_TYPES];
+
+        DISALLOW_COPY_AND_ASSIGN(SurvivorStream);
+    };
+
+    /**
+     * Shared state for a disk cleaning pass that several cleaner threads
+     * work on together. The thread that chose the segments (the "leader")
+     * publishes the pass in #activePass and cleaner threads that have
+     * nothing else to do join it (see helpWithDiskCleaning()).
+     *
+     * Work is handed out through shared counters rather than being divided
+     * up front: during the scan each thread repeatedly claims the next
+     * unscanned segment, and once the leader has merged the sorted entries
+     * each thread repeatedly claims the next chunk of entries to relocate.
+     * Threads that run out of work simply take more, so the pass is never
+     * held up waiting on a slow thread's fixed share. Every thread relocates
+     * into its own survivor segments, which keeps the relocation path free
+     * of any locking beyond what the entry handlers already do.
+     */
+    class DiskCleaningPass {
+      public:
+        /// Stages of a pass, in order. The leader moves the pass from one
+        /// stage to the next.
+        enum Phase { SCANNING, SORTING, RELOCATING };
+
+        /**
+         * Everything one thread produces while working on the pass. Each
+         * thread owns exactly one of these, so nothing in here is shared.
+         */
+        class Worker {
+          public:
+            Worker()
+                : entries(),
+                  coldStream(),
+                  hotStream(),
+                  survivors(),
+                  metrics(),
+                  bytesAppended(0)
+            {
+            }
+
+            /// Entries extracted from the segments this thread scanned,
+            /// sorted by timestamp once the scan is complete.
+            EntryVector entries;
+
+            /// Survivor streams this thread relocates cold and hot entries
+            /// into.
+            SurvivorStream coldStream;
+            SurvivorStream hotStream;
+
+            /// Every survivor segment this thread allocated.
+            LogSegmentVector survivors;
+
+            /// Counters for this thread's share of the pass.
+            LogCleanerMetrics::OnDisk<uint64_t> metrics;
+
+            /// Bytes this thread appended to its survivors.
+            uint64_t bytesAppended;
+
+            DISALLOW_COPY_AND_ASSIGN(Worker);
+        };
+
+        DiskCleaningPass(LogSegmentVector& segmentsToClean,
+                         bool separateHotEntries,
+                         uint32_t maxWorkers)
+            : segmentsToClean(segmentsToClean),
+              separateHotEntries(separateHotEntries),
+              workers(maxWorkers),
+              phase(SCANNING),
+              joinedWorkers(1),
+              scanningWorkers(1),
+              unfinishedWorkers(1),
+              nextSegment(0),
+              entries(NULL),
+              nextChunk(0)
+        {
+        }
+
+        /// Segments being cleaned in this pass.
+        LogSegmentVector& segmentsToClean;
+
+        /// See getSortedEntries().
+        const bool separateHotEntries;
+
+        /// One slot per thread that may work on the pass. The leader always
+        /// uses the first; helpers take the rest in the order they join.
+        /// The number of slots is chosen so that the partially filled
+        /// survivors each thread leaves behind can never make the pass
+        /// produce more segments than it cleans.
+        std::vector<Worker> workers;
+
+        /// Current stage of the pass. Protected by LogCleaner::passLock.
+        Phase phase;
+
+        /// Number of entries in #workers that have been handed out.
+        /// Protected by LogCleaner::passLock.
+        uint32_t joinedWorkers;
+
+        /// Number of threads still scanning segments. The leader sorts once
+        /// this drops to zero. Protected by LogCleaner::passLock.
+        uint32_t scanningWorkers;
+
+        /// Number of threads that have not yet finished relocating. The pass
+        /// is over once this drops to zero. Protected by
+        /// LogCleaner::passLock.
+        uint32_t unfinishedWorkers;
+
+        /// Index in #segmentsToClean of the next segment to be scanned.
+        std::atomic<size_t> nextSegment;
+
+        /// All of the pass's entries, sorted. Set by the leader before the
+        /// pass enters the RELOCATING stage.
+        EntryVector* entries;
+
+        /// Index of the next chunk of #entries (RELOCATION_CHUNK_ENTRIES
+        /// long) to be relocated.
+        std::atomic<size_t> nextChunk;
+
+        DISALLOW_COPY_AND_ASSIGN(DiskCleaningPass);
+    };
+
     class CleanerThreadState {
       public:
         CleanerThreadState()
@@ -220,6 +393,70 @@ class LogCleaner {
         const uint32_t cleaningPercentage;
     };
 
+    /**
+     * The Pacer lets the cleaner get ahead of incoming writes instead of
+     * waiting for memory utilization to cross the balancer's thresholds.
+     * Cleaner threads periodically sample how quickly new head segments are
+     * consuming memory and how quickly a busy cleaner thread frees it. If
+     * the free memory left would last less than a target amount of time
+     * (the "headroom") at the current write rate, the pacer asks for enough
+     * threads to match the write rate, even if utilization is still low.
+     *
+     * Pacing is disabled until a non-zero target headroom is set (see
+     * LogCleaner::setTargetHeadroom()).
+     */
+    class Pacer {
+      public:
+        explicit Pacer(LogCleaner* cleaner);
+        void sample();
+        bool isCleaningNeeded(CleanerThreadState* thread, int T, int L);
+        void setTargetHeadroom(uint32_t millis);
+
+        /// Minimum interval between two samples of the write and cleaning
+        /// rates.
+        enum { SAMPLE_USEC = 10000 };
+
+        /// Each new sample contributes 1/SMOOTHING of the pacer's rate
+        /// estimates, so that a brief burst of writes (or a cleaning pass
+        /// whose work is all accounted for at once) doesn't whipsaw the
+        /// number of threads in use.
+        enum { SMOOTHING = 4 };
+
+      PRIVATE:
+        /// The cleaner whose segment manager and metrics are sampled.
+        LogCleaner* cleaner;
+
+        /// Serializes calls to sample(). Threads that find it taken simply
+        /// skip sampling, since somebody else is already doing it.
+        SpinLock lock;
+
+        /// Cycles::rdtsc() at the time of the last sample, or 0 if no
+        /// sample has been taken yet.
+        uint64_t lastSampleTicks;
+
+        /// Values of the sampled counters as of the last sample.
+        uint64_t lastHeadBytes;
+        uint64_t lastBytesFreed;
+        uint64_t lastCleanerTicks;
+
+        /// Smoothed rate at which writes consume memory.
+        double writeBytesPerSecond;
+
+        /// Smoothed rate at which a single busy cleaner thread frees memory.
+        /// 0 until the cleaner has done some work.
+        double cleanerBytesPerSecond;
+
+        /// Headroom to maintain, in milliseconds. 0 disables pacing.
+        std::atomic<uint32_t> targetHeadroomMillis;
+
+        /// Number of cleaner threads that should be working as of the last
+        /// sample. Threads numbered below this value clean whenever there is
+        /// anything worth reclaiming.
+        std::atomic<uint32_t> threadsWanted;
+
+        DISALLOW_COPY_AND_ASSIGN(Pacer);
+    };
+
     static void cleanerThreadEntry(LogCleaner* logCleaner, Context* context);
     int getLiveObjectUtilization();
     int getUndeadTombstoneUtilization();
@@ -235,10 +472,29 @@ class LogCleaner {
     void sortEntriesByTimestamp(EntryVector& entries);
     void getSortedEntries(LogSegmentVector& segmentsToClean,
                           EntryVector& outEntries,
-                          LogCleanerMetrics::OnDisk<uint64_t>* localMetrics);
+                          LogCleanerMetrics::OnDisk<uint64_t>* localMetrics,
+                          bool separateHotEntries = false,
+                          DiskCleaningPass* pass = NULL);
+    void extractEntries(LogSegment* segment,
+                        EntryVector& outEntries,
+                        bool separateHotEntries);
     uint64_t relocateLiveEntries(EntryVector& entries,
                             LogSegmentVector& outSurvivors,
-                            LogCleanerMetrics::OnDisk<uint64_t>* localMetrics);
+                            LogCleanerMetrics::OnDisk<uint64_t>* localMetrics,
+                            DiskCleaningPass* pass = NULL);
+    uint64_t relocateEntries(EntryVector::iterator begin,
+                             EntryVector::iterator end,
+                             SurvivorStream* coldStream,
+                             SurvivorStream* hotStream,
+                             LogSegmentVector& outSurvivors,
+                             LogCleanerMetrics::OnDisk<uint64_t>* localMetrics);
+    bool publishPass(DiskCleaningPass* pass);
+    bool helpWithDiskCleaning(CleanerThreadState* state);
+    void scanSegments(DiskCleaningPass* pass,
+                      DiskCleaningPass::Worker* worker);
+    void relocateChunks(DiskCleaningPass* pass,
+                        DiskCleaningPass::Worker* worker);
+    void finishSurvivor(SurvivorStream* stream);
     void closeSurvivor(LogSegment* survivor);
     void waitForAvailableSurvivors(size_t count, uint64_t& outTicks);
 
@@ -364,6 +620,12 @@ class LogCleaner {
     /// cleaner will run in its place.
     bool disableInMemoryCleaning;
 
+    /// If true, disk cleaning passes ask the entry handlers which live
+    /// entries are hot and relocate those to separate survivor segments, so
+    /// that data likely to die soon isn't mixed in with data that will be
+    /// around for a while.
+    bool segregateHotEntries;
+
     /// The number of cleaner threads to run concurrently. More threads will
     /// allow the system to perform more cleaning and compaction in parallel to
     /// keep up with higher write rates and memory utilizations.
@@ -395,6 +657,19 @@ class LogCleaner {
     /// objects).
     std::mutex mutex;
 
+    /// Signaled when a disk cleaning pass is published in #activePass, so
+    /// that sleeping cleaner threads can join it right away. Used with
+    /// #mutex.
+    std::condition_variable passPublished;
+
+    /// The disk cleaning pass that idle cleaner threads may currently help
+    /// with, or NULL if there is none. Only one pass is shared at a time.
+    DiskCleaningPass* activePass;
+
+    /// Protects #activePass and the bookkeeping fields of the pass it points
+    /// to.
+    SpinLock passLock;
+
     /// Number of cpu cycles spent in the doWork() routine.
     LogCleanerMetrics::Atomic64BitType doWorkTicks;
 
@@ -418,6 +693,9 @@ class LogCleaner {
     /// Metrics kept for measuring how many threads the cleaner is using.
     LogCleanerMetrics::Threads threadMetrics;
 
+    /// Metrics describing the decisions made by #pacer.
+    LogCleanerMetrics::Pacing pacingMetrics;
+
     /// Set by halt() to indicate that the cleaning thread(s) should exit.
     bool threadsShouldExit;
 
@@ -431,6 +709,11 @@ class LogCleaner {
     /// when to compact in memory, and how many of our threads to employ.
     Balancer* balancer;
 
+    /// Decides when to start cleaning early because writes are consuming
+    /// memory faster than the cleaner could keep up with once utilization
+    /// thresholds are reached. Consulted by #balancer.
+    Pacer pacer;
+
     friend class CleanerCompactionBenchmark;
 
     DISALLOW_COPY_AND_ASSIGN(LogCleaner);
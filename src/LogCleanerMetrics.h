@@ -262,7 +262,9 @@ class OnDisk {
           lastRunTimestamp(0),
           cleanedSegmentMemoryHistogram(101, 1),
           cleanedSegmentDiskHistogram(101, 1),
-          allSegmentsDiskHistogram(101, 1)
+          allSegmentsDiskHistogram(101, 1),
+          totalHotSurvivorsCreated(0),
+          totalHotEntriesRelocated(0)
     {
         memset(totalEntriesScanned, 0, sizeof(totalEntriesScanned));
         memset(totalLiveEntriesScanned, 0, sizeof(totalLiveEntriesScanned));
@@ -324,6 +326,8 @@ class OnDisk {
             *m.mutable_cleaned_segment_disk_histogram());
         allSegmentsDiskHistogram.serialize(
             *m.mutable_all_segments_disk_histogram());
+        m.set_total_hot_survivors_created(totalHotSurvivorsCreated);
+        m.set_total_hot_entries_relocated(totalHotEntriesRelocated);
     }
 
     /**
@@ -372,6 +376,8 @@ class OnDisk {
         MERGE_FIELD(relocationAppendTicks);
         MERGE_FIELD(closeSurvivorTicks);
         MERGE_FIELD(survivorSyncTicks);
+        MERGE_FIELD(totalHotSurvivorsCreated);
+        MERGE_FIELD(totalHotEntriesRelocated);
 #undef MERGE_FIELD
     }
 
@@ -533,6 +539,13 @@ class OnDisk {
     /// Histogram of disk space utilizations for all segments prior to running
     /// a disk cleaner pass. Includes segments chosen to clean in that pass.
     Histogram allSegmentsDiskHistogram;
+
+    /// Total number of survivor segments created to hold entries that the
+    /// LogEntryHandlers reported as hot. Included in totalSurvivorsCreated.
+    CounterType totalHotSurvivorsCreated;
+
+    /// Total number of hot entries relocated to hot survivor segments.
+    CounterType totalHotEntriesRelocated;
 };
 
 /**
@@ -619,6 +632,77 @@ class Threads {
     Tub<CycleCounter<uint64_t>> cycleCounter;
 };
 
+/**
+ * Metrics describing the decisions of the cleaner's pacer (see
+ * LogCleaner::Pacer), which compares the rate at which writes consume memory
+ * with the rate at which the cleaner can free it and puts threads to work
+ * before utilization thresholds are reached if memory would otherwise run
+ * out too soon.
+ */
+class Pacing {
+  public:
+    /**
+     * Construct a new Pacing metrics object with all counters zeroed.
+     */
+    Pacing()
+        : totalSamples(0),
+          totalPacedSamples(0),
+          writeBytesPerSecond(0),
+          cleanerBytesPerSecond(0),
+          headroomMillis(0),
+          targetHeadroomMillis(0),
+          threadsWanted(0)
+    {
+    }
+
+    /**
+     * Serialize the metrics in this class to the given protocol buffer so we
+     * can ship it to another machine.
+     *
+     * \param[out] m
+     *      The protocol buffer to fill in.
+     */
+    void
+    serialize(ProtoBuf::LogMetrics_CleanerMetrics_PacingMetrics& m) const
+    {
+        m.set_total_samples(totalSamples);
+        m.set_total_paced_samples(totalPacedSamples);
+        m.set_write_bytes_per_second(writeBytesPerSecond);
+        m.set_cleaner_bytes_per_second(cleanerBytesPerSecond);
+        m.set_headroom_millis(headroomMillis);
+        m.set_target_headroom_millis(targetHeadroomMillis);
+        m.set_threads_wanted(threadsWanted);
+    }
+
+    /// Total number of times the pacer has measured write and cleaning rates.
+    Atomic64BitType totalSamples;
+
+    /// Number of samples after which the pacer asked for cleaning because
+    /// free memory would last less than the target headroom at the current
+    /// write rate.
+    Atomic64BitType totalPacedSamples;
+
+    /// The pacer's most recent (smoothed) estimate of the rate at which
+    /// incoming writes consume memory.
+    Atomic64BitType writeBytesPerSecond;
+
+    /// The pacer's most recent (smoothed) estimate of the rate at which a
+    /// single busy cleaner thread frees memory.
+    Atomic64BitType cleanerBytesPerSecond;
+
+    /// How long free memory would last at the current write rate as of the
+    /// most recent sample. ~0 if nothing is being written.
+    Atomic64BitType headroomMillis;
+
+    /// The headroom the pacer is currently trying to maintain. 0 means
+    /// pacing is disabled.
+    Atomic64BitType targetHeadroomMillis;
+
+    /// Number of cleaner threads the pacer wants working as of the most
+    /// recent sample, independent of utilization thresholds.
+    Atomic64BitType threadsWanted;
+};
+
 } // namespace LogCleanerMetrics
 
 } // namespace RAMCloud
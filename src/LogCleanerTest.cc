@@ -35,11 +35,15 @@
 
 namespace RAMCloud {
 
-class TestEntryHandlers : public LogEntryHandlers {
+// Not called TestEntryHandlers: CleanableSegmentManagerTest has a class by
+// that name, and the linker would pick one of the two vtables for both.
+class CleanerTestEntryHandlers : public LogEntryHandlers {
   public:
-    TestEntryHandlers()
+    CleanerTestEntryHandlers()
         : timestamp(0),
-          attemptToRelocate(false)
+          attemptToRelocate(false),
+          objectsAreHot(false),
+          isHotCalls(0)
     {
     }
 
@@ -49,6 +53,13 @@ class TestEntryHandlers : public LogEntryHandlers {
         return timestamp;
     }
 
+    bool
+    isHot(LogEntryType type, Buffer& buffer)
+    {
+        isHotCalls++;
+        return objectsAreHot && type == LOG_ENTRY_TYPE_OBJ;
+    }
+
     void
     relocate(LogEntryType type,
              Buffer& oldBuffer,
@@ -63,6 +74,8 @@ class TestEntryHandlers : public LogEntryHandlers {
 
     uint32_t timestamp;
     bool attemptToRelocate;
+    bool objectsAreHot;
+    int isHotCalls;
 };
 
 class CleanerServerConfig {
@@ -98,7 +111,7 @@ class LogCleanerTest : public ::testing::Test {
     ReplicaManager replicaManager;
     SegletAllocator allocator;
     SegmentManager segmentManager;
-    TestEntryHandlers entryHandlers;
+    CleanerTestEntryHandlers entryHandlers;
     LogCleaner cleaner;
     LogCleaner::CleanerThreadState threadState;
 
@@ -320,6 +333,176 @@ TEST_F(LogCleanerTest, doDiskCleaning) {
         TestLog::get());
 }
 
+TEST_F(LogCleanerTest, doDiskCleaning_hotColdSegregation) {
+    cleaner.segregateHotEntries = true;
+
+    // A single segment with live data can't be split into two survivors
+    // without using more segments than were cleaned, so hotness isn't even
+    // consulted.
+    LogSegment* segment = segmentManager.allocHeadSegment();
+    clearLiveBytes(segment);
+    segment->trackNewEntries(LOG_ENTRY_TYPE_OBJ, 1, 100);
+    segmentManager.allocHeadSegment(); // roll over
+    getNewCandidates();
+    cleaner.doDiskCleaning();
+    EXPECT_EQ(1U, cleaner.onDiskMetrics.totalRuns.load());
+    EXPECT_EQ(0, entryHandlers.isHotCalls);
+
+    // With two nearly empty segments there's room for both streams.
+    clearLiveBytes(segmentManager.allocHeadSegment());
+    clearLiveBytes(segmentManager.allocHeadSegment());
+    segmentManager.allocHeadSegment(); // roll over
+    getNewCandidates();
+    cleaner.doDiskCleaning();
+    EXPECT_EQ(2U, cleaner.onDiskMetrics.totalRuns.load());
+    EXPECT_LT(0, entryHandlers.isHotCalls);
+}
+
+TEST_F(LogCleanerTest, getSortedEntries_hotEntries) {
+    entryHandlers.objectsAreHot = true;
+    LogSegment* a = segmentManager.allocHeadSegment();
+    a->append(LOG_ENTRY_TYPE_OBJ, "hot", 4);
+    LogSegmentVector segments;
+    segments.push_back(a);
+    LogCleanerMetrics::OnDisk<uint64_t> metrics;
+
+    LogCleaner::EntryVector entries;
+    cleaner.getSortedEntries(segments, entries, &metrics);
+    int hotEntries = 0;
+    foreach (LogCleaner::Entry& entry, entries)
+        hotEntries += entry.hot;
+    EXPECT_EQ(0, hotEntries);
+
+    entries.clear();
+    cleaner.getSortedEntries(segments, entries, &metrics, true);
+    foreach (LogCleaner::Entry& entry, entries) {
+        Buffer buffer;
+        LogEntryType type = entry.reference.getEntry(
+            &segmentManager.getAllocator(), &buffer);
+        EXPECT_EQ(type == LOG_ENTRY_TYPE_OBJ, entry.hot);
+        hotEntries += entry.hot;
+    }
+    EXPECT_EQ(1, hotEntries);
+}
+
+TEST_F(LogCleanerTest, relocateLiveEntries_hotEntries) {
+    entryHandlers.attemptToRelocate = true;
+    entryHandlers.objectsAreHot = true;
+    LogSegment* a = segmentManager.allocHeadSegment();
+    a->append(LOG_ENTRY_TYPE_OBJ, "hot", 4);
+    a->append(LOG_ENTRY_TYPE_OBJTOMB, "cold", 5);
+    a->append(LOG_ENTRY_TYPE_OBJ, "hotter", 7);
+    LogSegmentVector segments;
+    segments.push_back(a);
+    LogCleanerMetrics::OnDisk<uint64_t> metrics;
+    LogCleaner::EntryVector entries;
+    cleaner.getSortedEntries(segments, entries, &metrics, true);
+
+    LogSegmentVector survivors;
+    cleaner.relocateLiveEntries(entries, survivors, &metrics);
+    ASSERT_EQ(2U, survivors.size());
+    EXPECT_EQ(1U, metrics.totalHotSurvivorsCreated);
+    EXPECT_EQ(2U, metrics.totalHotEntriesRelocated);
+
+    // Hot objects and everything else end up in different survivors.
+    foreach (LogSegment* survivor, survivors) {
+        EXPECT_TRUE(survivor->closed);
+        if (survivor->getEntryCount(LOG_ENTRY_TYPE_OBJ) != 0) {
+            EXPECT_EQ(2U, survivor->getEntryCount(LOG_ENTRY_TYPE_OBJ));
+            EXPECT_EQ(0U, survivor->getEntryCount(LOG_ENTRY_TYPE_OBJTOMB));
+        } else {
+            EXPECT_EQ(1U, survivor->getEntryCount(LOG_ENTRY_TYPE_OBJTOMB));
+        }
+    }
+}
+
+TEST_F(LogCleanerTest, publishPass) {
+    LogSegmentVector segments;
+    LogCleaner::DiskCleaningPass pass(segments, false, 2);
+    LogCleaner::DiskCleaningPass other(segments, false, 2);
+    EXPECT_TRUE(cleaner.publishPass(&pass));
+    EXPECT_EQ(&pass, cleaner.activePass);
+    EXPECT_FALSE(cleaner.publishPass(&other));
+    EXPECT_EQ(&pass, cleaner.activePass);
+    cleaner.activePass = NULL;
+}
+
+TEST_F(LogCleanerTest, helpWithDiskCleaning_nothingToHelpWith) {
+    EXPECT_FALSE(cleaner.helpWithDiskCleaning(&threadState));
+
+    // A pass with room for only its leader.
+    LogSegmentVector segments;
+    LogCleaner::DiskCleaningPass pass(segments, false, 1);
+    cleaner.publishPass(&pass);
+    EXPECT_FALSE(cleaner.helpWithDiskCleaning(&threadState));
+    EXPECT_EQ(1U, pass.joinedWorkers);
+    EXPECT_EQ(1U, pass.unfinishedWorkers);
+    cleaner.activePass = NULL;
+}
+
+static void
+helpWithDiskCleaningThread(LogCleaner* cleaner,
+                           LogCleaner::CleanerThreadState* state,
+                           bool* helped)
+{
+    *helped = cleaner->helpWithDiskCleaning(state);
+}
+
+TEST_F(LogCleanerTest, helpWithDiskCleaning_sharedPass) {
+    entryHandlers.attemptToRelocate = true;
+    LogSegmentVector segments;
+    LogSegment* a = segmentManager.allocHeadSegment();
+    a->append(LOG_ENTRY_TYPE_OBJ, "hi", 3);
+    a->append(LOG_ENTRY_TYPE_OBJ, "bye", 4);
+    LogSegment* b = segmentManager.allocHeadSegment();
+    b->append(LOG_ENTRY_TYPE_OBJ, ":-)", 4);
+    segments.push_back(a);
+    segments.push_back(b);
+
+    LogCleaner::DiskCleaningPass pass(segments, false, 2);
+    ASSERT_TRUE(cleaner.publishPass(&pass));
+
+    // Make sure the helper has joined before the leader gets going.
+    bool helped = false;
+    LogCleaner::CleanerThreadState helperState;
+    std::thread helper(helpWithDiskCleaningThread, &cleaner, &helperState,
+                       &helped);
+    while (true) {
+        SpinLock::Guard guard(cleaner.passLock);
+        if (pass.joinedWorkers == 2)
+            break;
+    }
+
+    LogCleanerMetrics::OnDisk<uint64_t> metrics;
+    LogCleaner::EntryVector entries;
+    cleaner.getSortedEntries(segments, entries, &metrics, false, &pass);
+    EXPECT_EQ(LogCleaner::DiskCleaningPass::SORTING, pass.phase);
+    EXPECT_EQ(0U, pass.scanningWorkers);
+    for (size_t i = 1; i < entries.size(); i++)
+        EXPECT_LE(entries[i - 1].timestamp, entries[i].timestamp);
+
+    LogSegmentVector survivors;
+    uint64_t bytes = cleaner.relocateLiveEntries(entries, survivors,
+                                                 &metrics, &pass);
+    helper.join();
+    EXPECT_TRUE(helped);
+    EXPECT_TRUE(cleaner.activePass == NULL);
+    EXPECT_EQ(0U, pass.unfinishedWorkers);
+    EXPECT_LT(0U, bytes);
+
+    // Every entry made it into a survivor, no matter who relocated it.
+    uint32_t objects = 0;
+    uint64_t scanned = 0;
+    foreach (LogSegment* survivor, survivors) {
+        EXPECT_TRUE(survivor->closed);
+        objects += survivor->getEntryCount(LOG_ENTRY_TYPE_OBJ);
+    }
+    for (size_t i = 0; i < arrayLength(metrics.totalEntriesScanned); i++)
+        scanned += metrics.totalEntriesScanned[i];
+    EXPECT_EQ(3U, objects);
+    EXPECT_EQ(entries.size(), scanned);
+}
+
 // The tests below were disabled a long time ago by Steve Rumble and
 // never got reworked to reflect his changes, so they are currently
 // broken.
@@ -636,6 +819,87 @@ TEST_F(LogCleanerTest, Disabler_basics) {
     EXPECT_EQ(0, cleaner.disableCount);
 }
 
+TEST_F(LogCleanerTest, Pacer_sample) {
+    LogCleaner::Pacer& pacer = cleaner.pacer;
+    LogCleanerMetrics::Pacing& metrics = cleaner.pacingMetrics;
+    pacer.setTargetHeadroom(100);
+
+    // The first sample only records the starting point.
+    pacer.sample();
+    EXPECT_EQ(1U, metrics.totalSamples);
+    EXPECT_EQ(0U, pacer.threadsWanted);
+    EXPECT_EQ(100U, metrics.targetHeadroomMillis);
+
+    // Too soon for another sample.
+    pacer.sample();
+    EXPECT_EQ(1U, metrics.totalSamples);
+
+    // Writes far outpacing the free memory left: ask for a thread even
+    // though we don't know how fast it cleans yet.
+    pacer.lastSampleTicks = Cycles::rdtsc() - Cycles::fromSeconds(1);
+    segmentManager.totalHeadBytesAllocated += 400000000000UL;
+    pacer.sample();
+    EXPECT_EQ(2U, metrics.totalSamples);
+    EXPECT_EQ(1U, metrics.totalPacedSamples);
+    EXPECT_EQ(1U, pacer.threadsWanted);
+    EXPECT_EQ(0U, metrics.cleanerBytesPerSecond);
+    EXPECT_NEAR(1e11, static_cast<double>(metrics.writeBytesPerSecond), 1e10);
+    EXPECT_LT(metrics.headroomMillis, 100U);
+
+    // Once cleaning rates are known, ask for as many threads as it takes to
+    // keep up, but no more than we have.
+    pacer.lastSampleTicks = Cycles::rdtsc() - Cycles::fromSeconds(1);
+    cleaner.inMemoryMetrics.totalBytesFreed += 30000000000UL;
+    cleaner.inMemoryMetrics.totalTicks += Cycles::fromSeconds(1);
+    pacer.sample();
+    EXPECT_NEAR(3e10, static_cast<double>(metrics.cleanerBytesPerSecond),
+                1e08);
+    EXPECT_EQ(std::min(3U, serverConfig()->master.cleanerThreadCount),
+              pacer.threadsWanted);
+
+    // Plenty of headroom once writes stop.
+    for (int i = 0; i < 20; i++) {
+        pacer.lastSampleTicks = Cycles::rdtsc() - Cycles::fromSeconds(1);
+        pacer.sample();
+    }
+    EXPECT_EQ(0U, pacer.threadsWanted);
+    EXPECT_EQ(0U, metrics.threadsWanted);
+
+    // No pacing at all without a target.
+    pacer.setTargetHeadroom(0);
+    pacer.lastSampleTicks = Cycles::rdtsc() - Cycles::fromSeconds(1);
+    segmentManager.totalHeadBytesAllocated += 400000000000UL;
+    pacer.sample();
+    EXPECT_EQ(0U, pacer.threadsWanted);
+}
+
+TEST_F(LogCleanerTest, Pacer_isCleaningNeeded) {
+    LogCleaner::Pacer& pacer = cleaner.pacer;
+    threadState.threadNumber = 0;
+    EXPECT_FALSE(pacer.isCleaningNeeded(&threadState, 50, 20));
+
+    pacer.threadsWanted = 1;
+    EXPECT_TRUE(pacer.isCleaningNeeded(&threadState, 50, 20));
+    EXPECT_FALSE(pacer.isCleaningNeeded(&threadState, 50, 50));
+    threadState.threadNumber = 1;
+    EXPECT_FALSE(pacer.isCleaningNeeded(&threadState, 50, 20));
+}
+
+TEST_F(LogCleanerTest, Balancer_isMemoryLow_paced) {
+    cleaner.disableInMemoryCleaning = false;
+    SegmentManager::mockMemoryUtilization = 50;
+    CleanableSegmentManager::mockLiveObjectUtilization = 20;
+    EXPECT_EQ(LogCleaner::Balancer::SLEEP,
+              cleaner.balancer->requestTask(&threadState));
+
+    cleaner.pacer.threadsWanted = 1;
+    EXPECT_EQ(LogCleaner::Balancer::COMPACT_MEMORY,
+              cleaner.balancer->requestTask(&threadState));
+
+    SegmentManager::mockMemoryUtilization = 0;
+    CleanableSegmentManager::mockLiveObjectUtilization = 0;
+}
+
 // The Disabler sleep/wakeup mechanism was already tested previously.
 
 #if 0
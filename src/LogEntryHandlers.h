@@ -41,6 +41,17 @@ class LogEntryHandlers {
      */
     virtual uint32_t getTimestamp(LogEntryType type, Buffer& buffer) = 0;
 
+    /**
+     * This method is called by the cleaner to decide which survivor
+     * segments an entry should be relocated to. It should return true if
+     * the entry is likely to be overwritten or deleted soon (for instance,
+     * because its key has been written frequently of late), in which case
+     * the cleaner will keep it apart from longer-lived entries. Handlers
+     * that do not track this may rely on the default, which treats every
+     * entry as cold.
+     */
+    virtual bool isHot(LogEntryType type, Buffer& buffer) { return false; }
+
     /**
      * This method is called for each entry the encountered in segments
      * being cleaned. If the caller wants to retain the data, it should
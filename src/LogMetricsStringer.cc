@@ -170,6 +170,24 @@ LogMetricsStringer::getGenericCleanerMetrics()
             i++, d(ticks) / d(totalTicks) * 100);
     }
 
+    if (cleanerMetrics.has_pacing_metrics()) {
+        const ProtoBuf::LogMetrics_CleanerMetrics_PacingMetrics& pacing =
+            cleanerMetrics.pacing_metrics();
+        s += ls + format("  Pacing Target Headroom:        %lu ms\n",
+            pacing.target_headroom_millis());
+        s += ls + format("    Write Rate:                  %.2f MB/s\n",
+            d(pacing.write_bytes_per_second()) / 1e06);
+        s += ls + format("    Cleaner Rate (per thread):   %.2f MB/s\n",
+            d(pacing.cleaner_bytes_per_second()) / 1e06);
+        s += ls + format("    Threads Wanted:              %lu\n",
+            pacing.threads_wanted());
+        s += ls + format("    Paced Samples:               %lu (%.2f%% of "
+            "samples)\n",
+            pacing.total_paced_samples(),
+            100.0 * d(pacing.total_paced_samples()) /
+            d(pacing.total_samples()));
+    }
+
     return s;
 }
 
@@ -233,6 +251,15 @@ LogMetricsStringer::getDiskCleanerMetrics()
         d(totalCleaned) / cleanerTime,
         onDiskMetrics.total_empty_segments_cleaned());
 
+    // Compare across runs with different cleaner thread counts to see how
+    // well disk cleaning passes scale.
+    uint32_t cleanerThreads = serverConfig->master().cleaner_thread_count();
+    s += ls + format("  Cleaning Bandwidth:            %.2f MB/s "
+        "(%.2f MB/s while cleaning, %u threads)\n",
+        d(diskBytesInCleanedSegments) / elapsedTime / 1e06,
+        d(diskBytesInCleanedSegments) / cleanerTime / 1e06,
+        cleanerThreads);
+
     uint64_t survivorsCreated = onDiskMetrics.total_survivors_created();
     s += ls + format("  Total Survivors Created:       %lu (%.2f/s, "
         "%.2f/s active)\n",
@@ -240,6 +267,13 @@ LogMetricsStringer::getDiskCleanerMetrics()
         d(survivorsCreated) / elapsedTime,
         d(survivorsCreated) / cleanerTime);
 
+    s += ls + format("  Hot Survivors Created:         %lu (%.2f%% of "
+        "survivors, %lu hot entries relocated)\n",
+        onDiskMetrics.total_hot_survivors_created(),
+        100.0 * d(onDiskMetrics.total_hot_survivors_created()) /
+            d(survivorsCreated),
+        onDiskMetrics.total_hot_entries_relocated());
+
     s += ls + format("  Avg Time to Clean Segment:     %.2f ms\n",
         cleanerTime / d(totalCleaned) * 1000);
 
@@ -499,6 +533,15 @@ LogMetricsStringer::getLogMetrics()
         syncTime, 100.0 * syncTime / elapsedTime);
     s += ls + format("    Avg Per Operation (RPC):     %.2f us\n",
         syncTime * 1.0e6 / d(logMetrics->total_sync_calls()));
+    s += ls + format("    Replication Rounds:          %lu "
+        "(%.2f syncs/round)\n",
+        logMetrics->total_sync_rounds(),
+        d(logMetrics->total_sync_calls()) /
+            d(logMetrics->total_sync_rounds()));
+    double groupCommitTime = Cycles::toSeconds(
+        logMetrics->total_group_commit_wait_ticks(), serverHz);
+    s += ls + format("    Group Commit Waiting:        %.3f sec (%.2f%%)\n",
+        groupCommitTime, 100.0 * groupCommitTime / elapsedTime);
 
     double noMemTime = Cycles::toSeconds(logMetrics->total_no_space_ticks(),
                                          serverHz);
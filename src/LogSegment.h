@@ -95,6 +95,7 @@ class LogSegment : public Segment {
           cleanableCompactionEntries(),
           tombstoneScanEntries(),
           syncedLength(0),
+          unfinishedAppends(0),
           lastCompactionTimestamp(WallTime::secondsTimestamp()),
           lastTombstoneScanTimestamp(WallTime::secondsTimestamp()),
           entryCounts(),
@@ -207,6 +208,21 @@ class LogSegment : public Segment {
         trackNewEntries(type, 1, lengthWithMetadata);
     }
 
+    /**
+     * Spin until every append that has reserved space in this segment has
+     * finished copying in its entry contents (see AbstractLog::append). The
+     * caller must hold the log's appendLock so that no new reservations can
+     * be made while waiting; afterwards the segment's appended length and
+     * certificate describe fully-written entries and may be replicated.
+     */
+    void
+    waitForUnfinishedAppends()
+    {
+        while (unfinishedAppends.load(std::memory_order_acquire) != 0) {
+            // Copies are short and run outside the appendLock; just spin.
+        }
+    }
+
     void
     trackDeadEntry(LogEntryType type, uint32_t lengthWithMetadata)
     {
@@ -304,6 +320,13 @@ class LogSegment : public Segment {
     /// appending to the log.
     uint32_t syncedLength;
 
+    /// Number of appends that have reserved space in this segment while
+    /// holding the log's appendLock, but are still copying their entry
+    /// contents in after having released it. Anything that publishes the
+    /// segment's length (syncing or closing the head) must first wait for
+    /// this to drop to zero.
+    std::atomic<uint32_t> unfinishedAppends;
+
     /// Timestamp when this segment was last compacted or created. Used by the
     /// cleaner to decide when to scan for dead tombstones. Sometimes segments
     /// will accumulate tombstones and appear cold even though many of the
@@ -241,6 +241,98 @@ TEST_F(LogTest, sync) {
     EXPECT_EQ(5U, l.metrics.totalSyncCalls);
 }
 
+static void
+syncThread(Log* log, std::atomic<bool>* done)
+{
+    log->sync();
+    *done = true;
+}
+
+TEST_F(LogTest, sync_waitsForUnfinishedAppends) {
+    l.sync();
+    l.append(LOG_ENTRY_TYPE_OBJ, "hi", 2);
+
+    // Pretend another thread has reserved space in the head but is still
+    // copying its entry in. The sync must not publish the head's length
+    // until that copy completes.
+    l.head->unfinishedAppends++;
+    std::atomic<bool> done(false);
+    std::thread thread(syncThread, &l, &done);
+    usleep(10000);
+    EXPECT_FALSE(done);
+    EXPECT_NE(l.head->syncedLength, l.head->getAppendedLength());
+
+    l.head->unfinishedAppends--;
+    thread.join();
+    EXPECT_TRUE(done);
+    EXPECT_EQ(l.head->syncedLength, l.head->getAppendedLength());
+}
+
+TEST_F(LogTest, sync_groupCommit) {
+    l.sync();
+    l.append(LOG_ENTRY_TYPE_OBJ, "hi", 2);
+    l.setGroupCommitOptions(5, 0);
+    uint64_t roundsBefore = l.metrics.totalSyncRounds;
+
+    // Nobody else is syncing, so the window stays closed.
+    TestLog::Enable _("waitForGroupCommit");
+    l.sync();
+    EXPECT_EQ("", TestLog::get());
+    EXPECT_EQ(0u, l.groupCommitWindowCycles);
+    EXPECT_EQ(roundsBefore + 1, l.metrics.totalSyncRounds);
+    EXPECT_EQ(l.head->syncedLength, l.head->getAppendedLength());
+}
+
+TEST_F(LogTest, waitForGroupCommit) {
+    l.sync();
+    SpinLock::Guard _(l.syncLock);
+    TestLog::Enable __;
+    Cycles::mockCyclesPerSec = 1e09;
+    uint64_t minWindow = 1000 * Log::MIN_GROUP_COMMIT_WINDOW_USEC;
+    uint32_t length = l.head->getAppendedLength();
+
+    // Disabled.
+    l.waitForGroupCommit(l.head, length);
+    EXPECT_EQ(0u, l.groupCommitWindowCycles);
+
+    // Idle log: the window does not open.
+    l.setGroupCommitOptions(4, 0);
+    l.waitForGroupCommit(l.head, length);
+    EXPECT_EQ("", TestLog::get());
+    EXPECT_EQ(0u, l.groupCommitWindowCycles);
+
+    // Other syncs are queued: open the window and grow it up to the max.
+    l.syncWaiters = 1;
+    l.waitForGroupCommit(l.head, length);
+    EXPECT_EQ("waitForGroupCommit: 0 bytes joined", TestLog::get());
+    EXPECT_EQ(2 * minWindow, l.groupCommitWindowCycles);
+    l.waitForGroupCommit(l.head, length);
+    l.waitForGroupCommit(l.head, length);
+    EXPECT_EQ(4000u, l.groupCommitWindowCycles);
+    EXPECT_NE(0u, l.metrics.totalGroupCommitWaitTicks);
+
+    // No more contention and nobody joined: shrink until closed.
+    l.syncWaiters = 0;
+    l.waitForGroupCommit(l.head, length);
+    EXPECT_EQ(2000u, l.groupCommitWindowCycles);
+    l.waitForGroupCommit(l.head, length);
+    EXPECT_EQ(minWindow, l.groupCommitWindowCycles);
+    l.waitForGroupCommit(l.head, length);
+    EXPECT_EQ(0u, l.groupCommitWindowCycles);
+
+    // Writers joined the round: the window grows even without queued syncs,
+    // and the byte limit cuts a (here, several second) wait short.
+    l.setGroupCommitOptions(20000000, 10);
+    l.groupCommitWindowCycles = 10000000000lu;
+    TestLog::reset();
+    uint64_t start = Cycles::rdtsc();
+    l.waitForGroupCommit(l.head, length - 12);
+    EXPECT_LT(Cycles::rdtsc() - start, 1000000000lu);
+    EXPECT_EQ("waitForGroupCommit: 12 bytes joined", TestLog::get());
+    EXPECT_EQ(20000000000lu, l.groupCommitWindowCycles);
+    Cycles::mockCyclesPerSec = 0;
+}
+
 TEST_F(LogSyncTest, syncTo) {
     TestLog::Enable _(syncFilter);
     l->sync();
@@ -93,6 +93,7 @@ MasterService::MasterService(Context* context, const ServerConfig* config)
     , clientLeaseValidator(context, &clusterClock)
     , unackedRpcResults(context, &objectManager, &clientLeaseValidator)
     , transactionManager(context, objectManager.getLog(), &unackedRpcResults)
+    , runtimeOptions()
     , disableCount(0)
     , initCalled(false)
     , logEverSynced(false)
@@ -101,6 +102,11 @@ MasterService::MasterService(Context* context, const ServerConfig* config)
     , migrationMonitor(this)
 {
     context->services[WireFormat::MASTER_SERVICE] = this;
+    objectManager.getLog()->setGroupCommitOptions(
+            runtimeOptions.getLogGroupCommitWindowMicros(),
+            runtimeOptions.getLogGroupCommitBytes());
+    objectManager.getLog()->setCleanerTargetHeadroom(
+            runtimeOptions.getCleanerTargetHeadroomMillis());
 }
 
 MasterService::~MasterService()
@@ -259,6 +265,40 @@ MasterService::dispatch(WireFormat::Opcode opcode, Rpc* rpc)
     }
 }
 
+/**
+ * Change one of this master's runtime options and apply the new setting.
+ * Invoked for the SET_MASTER_RUNTIME_OPTION server control.
+ *
+ * \param option
+ *      Name of the option to change (see RuntimeOptions).
+ * \param value
+ *      String form of the new value for the option.
+ *
+ * \throw std::out_of_range
+ *      There is no runtime option with the given name.
+ */
+void
+MasterService::setRuntimeOption(const char* option, const char* value)
+{
+    runtimeOptions.set(option, value);
+    LOG(NOTICE, "Runtime option %s set to %s", option,
+        runtimeOptions.get(option).c_str());
+    objectManager.getLog()->setGroupCommitOptions(
+            runtimeOptions.getLogGroupCommitWindowMicros(),
+            runtimeOptions.getLogGroupCommitBytes());
+    objectManager.getLog()->setCleanerTargetHeadroom(
+            runtimeOptions.getCleanerTargetHeadroomMillis());
+
+    std::set<uint64_t> compressedTables = runtimeOptions.getCompressedTables();
+    foreach (uint64_t tableId, compressedTables)
+        masterTableMetadata.findOrCreate(tableId);
+    MasterTableMetadata::scanner sc = masterTableMetadata.getScanner();
+    while (sc.hasNext()) {
+        MasterTableMetadata::Entry* entry = sc.next();
+        entry->compressValues = compressedTables.count(entry->tableId) > 0;
+    }
+}
+
 /**
  * Construct a Disabler object (disable the associated master).
  *
@@ -469,6 +509,8 @@ MasterService::getServerStatistics(
     ProtoBuf::ServerStatistics serverStats;
     tabletManager.getStatistics(&serverStats);
     SpinLock::getStatistics(serverStats.mutable_spin_lock_stats());
+    objectManager.getHashTableStatistics(
+            serverStats.mutable_hash_table_stats());
     respHdr->serverStatsLength = serializeToResponse(
             rpc->replyPayload, &serverStats);
 }
@@ -1304,6 +1346,18 @@ MasterService::multiRead(const WireFormat::MultiOp::Request* reqHdr,
     respHdr->count = numRequests;
     uint32_t oldResponseLength = rpc->replyPayload->size();
 
+    // Requests are parsed a group at a time so that the hash table buckets
+    // and objects for the whole group can be prefetched together (see
+    // ObjectManager::prefetchObjects) before any of them are read. These
+    // hold the parsed requests for the current group, which covers request
+    // indexes [groupStart, groupEnd).
+    const uint32_t maxGroupSize = ObjectManager::PREFETCH_GROUP_SIZE;
+    const WireFormat::MultiOp::Request::ReadPart* groupReqs[maxGroupSize];
+    Tub<Key> groupKeys[maxGroupSize];
+    uint32_t groupStart = 0;
+    uint32_t groupEnd = 0;
+    bool malformedRequest = false;
+
     // Each iteration extracts one request from request rpc, finds the
     // corresponding object, and appends the response to the response rpc.
     for (uint32_t i = 0; ; i++) {
@@ -1326,21 +1380,50 @@ MasterService::multiRead(const WireFormat::MultiOp::Request* reqHdr,
             break;
         }
 
-        const WireFormat::MultiOp::Request::ReadPart *currentReq =
-                rpc->requestPayload->getOffset<
-                WireFormat::MultiOp::Request::ReadPart>(reqOffset);
-        reqOffset += sizeof32(WireFormat::MultiOp::Request::ReadPart);
-
-        const void* stringKey = rpc->requestPayload->getRange(
-                reqOffset, currentReq->keyLength);
-        reqOffset += currentReq->keyLength;
+        if (i == groupEnd) {
+            // Parse the next group of requests and prefetch their objects.
+            // A malformed request ends the group early; the requests before
+            // it are still served.
+            if (malformedRequest) {
+                respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+                break;
+            }
+            KeyHash groupHashes[maxGroupSize];
+            uint32_t groupSize = 0;
+            while (groupSize < maxGroupSize &&
+                    i + groupSize < numRequests) {
+                const WireFormat::MultiOp::Request::ReadPart *req =
+                        rpc->requestPayload->getOffset<
+                        WireFormat::MultiOp::Request::ReadPart>(reqOffset);
+                reqOffset += sizeof32(WireFormat::MultiOp::Request::ReadPart);
+
+                const void* stringKey = rpc->requestPayload->getRange(
+                        reqOffset, req->keyLength);
+                reqOffset += req->keyLength;
+
+                if (stringKey == NULL) {
+                    malformedRequest = true;
+                    break;
+                }
 
-        if (stringKey == NULL) {
-            respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
-            break;
+                groupReqs[groupSize] = req;
+                groupKeys[groupSize].construct(req->tableId, stringKey,
+                        req->keyLength);
+                groupHashes[groupSize] = groupKeys[groupSize]->getHash();
+                groupSize++;
+            }
+            groupStart = i;
+            groupEnd = i + groupSize;
+            if (groupSize == 0) {
+                respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+                break;
+            }
+            objectManager.prefetchObjects(groupHashes, groupSize);
         }
 
-        Key key(currentReq->tableId, stringKey, currentReq->keyLength);
+        const WireFormat::MultiOp::Request::ReadPart *currentReq =
+                groupReqs[i - groupStart];
+        Key& key = *groupKeys[i - groupStart];
 
         WireFormat::MultiOp::Response::ReadPart* currentResp =
                rpc->replyPayload->emplaceAppend<
@@ -30,6 +30,7 @@
 #include "ObjectManager.h"
 #include "ReplicaManager.h"
 #include "RpcResult.h"
+#include "RuntimeOptions.h"
 #include "SegmentIterator.h"
 #include "SegmentManager.h"
 #include "ServerConfig.h"
@@ -63,6 +64,7 @@ class MasterService : public Service {
     virtual ~MasterService();
 
     void dispatch(WireFormat::Opcode opcode, Rpc* rpc);
+    void setRuntimeOption(const char* option, const char* value);
 
     /*
      * The following class is used to temporarily disable the servicing of
@@ -135,6 +137,12 @@ class MasterService : public Service {
      */
     TransactionManager transactionManager;
 
+    /**
+     * Options that tune this master while it is running, such as the log's
+     * group commit window. Changed with setRuntimeOption().
+     */
+    RuntimeOptions runtimeOptions;
+
 #ifdef TESTING
     /// Used to pause the read-increment-write cycle in incrementObject
     /// between the read and the write.  While paused, a second thread can
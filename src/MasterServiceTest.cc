@@ -1470,6 +1470,36 @@ TEST_F(MasterServiceTest, multiRead_bufferSizeExceeded) {
             50));
 }
 
+TEST_F(MasterServiceTest, multiRead_multiplePrefetchGroups) {
+    // Enough objects to span several prefetch groups, including a
+    // partial group at the end.
+    const uint32_t numObjects = 2 * ObjectManager::PREFETCH_GROUP_SIZE + 3;
+    uint64_t tableId1 = ramcloud->createTable("table1");
+    string keys[numObjects];
+    Tub<ObjectBuffer> values[numObjects];
+    Tub<MultiReadObject> objects[numObjects];
+    MultiReadObject* requests[numObjects];
+    for (uint32_t i = 0; i < numObjects; i++) {
+        keys[i] = format("key%u", i);
+        string value = format("value%u", i);
+        ramcloud->write(tableId1, keys[i].c_str(),
+                downCast<uint16_t>(keys[i].length()),
+                value.c_str(), downCast<uint32_t>(value.length()));
+        objects[i].construct(tableId1, keys[i].c_str(),
+                downCast<uint16_t>(keys[i].length()), &values[i]);
+        requests[i] = objects[i].get();
+    }
+    ramcloud->multiRead(requests, numObjects);
+
+    for (uint32_t i = 0; i < numObjects; i++) {
+        EXPECT_EQ(STATUS_OK, objects[i]->status);
+        uint32_t valueLength;
+        const void* value = values[i]->getValue(&valueLength);
+        EXPECT_EQ(format("value%u", i), string(
+                reinterpret_cast<const char*>(value), valueLength));
+    }
+}
+
 TEST_F(MasterServiceTest, multiRead_unknownTable) {
     // Table 99 will be directed to the server, but the server
     // doesn't know about it.
@@ -17,6 +17,7 @@
 #ifndef RAMCLOUD_MASTERTABLEMETADATA_H
 #define RAMCLOUD_MASTERTABLEMETADATA_H
 
+#include <atomic>
 #include <unordered_map>
 #include "Common.h"
 #include "SpinLock.h"
@@ -67,9 +68,15 @@ class MasterTableMetadata {
         uint64_t tableId;
         TableStats::Block stats;
 
+        /// True if values written to this table should be compressed in the
+        /// log (see Object::compressValue()). Set from the compressedTables
+        /// runtime option.
+        std::atomic<bool> compressValues;
+
         explicit Entry(uint64_t tableId)
             : tableId(tableId)
             , stats()
+            , compressValues(false)
         {}
     };
 
@@ -27,7 +27,9 @@ MockDriver::MockDriver()
             , headerToString(0)
             , outputLog()
             , maxPacketSize(1400)
+            , highestPriority(0)
             , sendPacketCount(0)
+            , flushPacketsCount(0)
             , stealCount(0)
             , releaseCount(0)
             , packets()
@@ -47,7 +49,9 @@ MockDriver::MockDriver(HeaderToString headerToString)
             , headerToString(headerToString)
             , outputLog()
             , maxPacketSize(1400)
+            , highestPriority(0)
             , sendPacketCount(0)
+            , flushPacketsCount(0)
             , stealCount(0)
             , releaseCount(0)
             , packets()
@@ -92,13 +96,17 @@ void
 MockDriver::sendPacket(const Address *addr,
                        const void *header,
                        uint32_t headerLen,
-                       Buffer::Iterator *payload)
+                       Buffer::Iterator *payload,
+                       int priority)
 {
     sendPacketCount++;
 
     if (outputLog.length() != 0)
         outputLog.append(" | ");
 
+    if (priority != 0)
+        outputLog += format("priority %d: ", priority);
+
     if (headerToString && header) {
         outputLog += headerToString(header, headerLen);
         if (payload && (payload->size() > 0)) {
@@ -74,12 +74,15 @@ class MockDriver : public Driver {
     virtual ~MockDriver();
     virtual void connect(IncomingPacketHandler* incomingPacketHandler);
     virtual void disconnect();
+    virtual void flushPackets() { flushPacketsCount++; }
     virtual uint32_t getMaxPacketSize() { return maxPacketSize; }
+    virtual int getHighestPacketPriority() { return highestPriority; }
     virtual void release(char *payload);
     virtual void sendPacket(const Address* addr,
                             const void *header,
                             uint32_t headerLen,
-                            Buffer::Iterator *payload);
+                            Buffer::Iterator *payload,
+                            int priority = 0);
     virtual string getServiceLocator();
     void receivePacket(MockReceived *received);
 
@@ -112,9 +115,14 @@ class MockDriver : public Driver {
     // Return value from getMaxPacketSize.
     uint32_t maxPacketSize;
 
+    // Return value from getHighestPacketPriority. Packets sent with a
+    // nonzero priority have it noted in outputLog.
+    int highestPriority;
+
     // The following variables count calls to various methods, for use
     // by tests.
     uint32_t sendPacketCount;
+    uint32_t flushPacketsCount;
     uint32_t stealCount;
     uint32_t releaseCount;
 
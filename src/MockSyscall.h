@@ -40,9 +40,12 @@ class MockSyscall : public Syscall {
                     epollWaitErrno(0), exitCount(0), fcntlErrno(0),
                     futexWaitErrno(0), futexWakeErrno(0), fwriteResult(~0LU),
                     getsocknameErrno(0), ioctlErrno(0),
-                    ioctlRetriesToSuccess(0), listenErrno(0), pipeErrno(0),
+                    ioctlRetriesToSuccess(0), ioUringSetupErrno(0),
+                    listenErrno(0), pipeErrno(0),
                     recvErrno(0), recvEof(false), recvfromErrno(0),
-                    recvfromEof(false), sendmsgErrno(0), sendmsgReturnCount(-1),
+                    recvfromEof(false), recvmmsgErrno(0), recvmsgErrno(0),
+                    sendmmsgErrno(0), sendmmsgReturnCount(-1),
+                    sendmmsgCalls(0), sendmsgErrno(0), sendmsgReturnCount(-1),
                     sendtoErrno(0), sendtoReturnCount(-1), setsockoptErrno(0),
                     socketErrno(0), writeErrno(0) {}
 
@@ -196,6 +199,15 @@ class MockSyscall : public Syscall {
         }
     }
 
+    int ioUringSetupErrno;
+    int ioUringSetup(unsigned int entries, io_uring_params* params) {
+        if (ioUringSetupErrno == 0) {
+            return Syscall::ioUringSetup(entries, params);
+        }
+        errno = ioUringSetupErrno;
+        return -1;
+    }
+
     int listenErrno;
     int listen(int sockfd, int backlog) {
         if (listenErrno == 0) {
@@ -241,6 +253,42 @@ class MockSyscall : public Syscall {
         return -1;
     }
 
+    int recvmmsgErrno;
+    int recvmmsg(int sockfd, mmsghdr *msgvec, unsigned int vlen, int flags,
+                 timespec *timeout) {
+        if (recvmmsgErrno == 0) {
+            return ::recvmmsg(sockfd, msgvec, vlen, flags, timeout);
+        }
+        errno = recvmmsgErrno;
+        return -1;
+    }
+
+    int recvmsgErrno;
+    ssize_t recvmsg(int sockfd, msghdr *msg, int flags) {
+        if (recvmsgErrno == 0) {
+            return ::recvmsg(sockfd, msg, flags);
+        }
+        errno = recvmsgErrno;
+        return -1;
+    }
+
+    int sendmmsgErrno;
+    int sendmmsgReturnCount;
+    int sendmmsgCalls;
+    int sendmmsg(int sockfd, mmsghdr *msgvec, unsigned int vlen, int flags) {
+        sendmmsgCalls++;
+        if (sendmmsgErrno != 0) {
+            errno = sendmmsgErrno;
+            return -1;
+        } else if (sendmmsgReturnCount >= 0) {
+            // Simulates sending only some of the messages.
+            int count = sendmmsgReturnCount;
+            sendmmsgReturnCount = -1;
+            return ::sendmmsg(sockfd, msgvec, count, flags);
+        }
+        return ::sendmmsg(sockfd, msgvec, vlen, flags);
+    }
+
     int sendmsgErrno;
     int sendmsgReturnCount;
     ssize_t sendmsg(int sockfd, const msghdr *msg, int flags) {
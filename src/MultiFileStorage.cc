@@ -54,6 +54,13 @@ enum { MAX_POOLED_BUFFERS = 128 };
  */
 enum { INIT_POOLED_BUFFERS = MAX_POOLED_BUFFERS };
 
+/**
+ * When frames are read and written with io_uring, the maximum number of
+ * frames that can have requests outstanding at once. The IO thread waits
+ * for some of them to finish before issuing more.
+ */
+enum { MAX_FRAMES_PERFORMING_IO = 16 };
+
 // --- MultiFileStorage::Frame ---
 
 bool MultiFileStorage::Frame::testingSkipRealIo = false;
@@ -88,8 +95,21 @@ MultiFileStorage::Frame::Frame(MultiFileStorage* storage, size_t frameIndex)
     , appendedMetadataLength(0)
     , appendedMetadataVersion(0)
     , committedMetadataVersion(0)
+    , consolidatedLength(0)
+    , consolidatedMetadataVersion(0)
+    , consolidationRequested(false)
+    , journalPending(false)
+    , journalSequence(0)
+    , consolidatedSequence(0)
     , loadRequested(false)
     , performingIo(false)
+    , loadingBuffer(NULL, storage->bufferDeleter)
+    , writingLength(0)
+    , writingMetadataVersion(0)
+    , writingJournalSequence(0)
+    , ioRequestsOutstanding(0)
+    , ioBytes(0)
+    , ioStartTime(0)
     , epoch(1)
     , scheduledInEpoch(0)
     , testingHadToWaitForBufferOnLoad(false)
@@ -335,10 +355,10 @@ MultiFileStorage::Frame::append(Buffer& source,
             destinationOffset, length, storage->segmentSize);
         throw BackupSegmentOverflowException(HERE);
     }
-    if (metadataLength > METADATA_SIZE) {
+    if (metadataLength > storage->getMetadataSize()) {
         LOG(ERROR, "Tried to append to a frame with metadata of length %lu "
-            "but storage only allows max length of %d",
-            metadataLength, METADATA_SIZE);
+            "but storage only allows max length of %lu",
+            metadataLength, storage->getMetadataSize());
         throw BackupSegmentOverflowException(HERE);
     }
 
@@ -361,7 +381,9 @@ MultiFileStorage::Frame::append(Buffer& source,
     }
 
     if (!isSynced()) {
-        if (sync) {
+        if (storage->journalSize > 0 && !consolidationRequested) {
+            storage->appendToJournal(lock, this);
+        } else if (sync) {
             performWrite(lock);
         } else {
             schedule(lock, LOW);
@@ -391,7 +413,7 @@ MultiFileStorage::Frame::close()
     isOpen = false;
     isClosed = true;
 
-    if (isSynced()) {
+    if (isConsolidated()) {
         if (buffer) {
             buffer.reset();
             if (isWriteBuffer) {
@@ -403,14 +425,16 @@ MultiFileStorage::Frame::close()
         // This frame was already scheduled for I/O previously, but
         // at low priority. Now that it's closed, raise the priority
         // so it gets to secondary storage quickly and we can free its
-        // buffer in memory.
+        // buffer in memory. With a journal this consolidates the frame.
         schedule(lock, HIGH);
     }
 }
 
 /**
  * Perform outstanding IO for this frame. Frames prioritize writes over loads
- * since loads require writes to finish first.
+ * since loads require writes to finish first. When io_uring is in use, this
+ * only issues the IO; the frame's state is updated by ioCompleted() once
+ * it finishes.
  */
 void
 MultiFileStorage::Frame::performTask()
@@ -418,13 +442,20 @@ MultiFileStorage::Frame::performTask()
     Lock lock(storage->mutex);
     if (epoch != scheduledInEpoch)
         return;
+    if (performingIo) {
+        // An earlier read or write is still outstanding on storage->ring;
+        // ioCompleted() will reschedule this frame if more IO is needed.
+        return;
+    }
+    bool async = storage->ring;
     performingIo = true;
-    if (!isSynced()) {
-        performWrite(lock);
+    if (needsWrite()) {
+        performWrite(lock, async);
     } else if (loadRequested && !buffer) {
-        performRead(lock);
+        performRead(lock, async);
     }
-    performingIo = false;
+    if (ioRequestsOutstanding == 0)
+        performingIo = false;
 }
 
 // - protected -
@@ -460,10 +491,17 @@ MultiFileStorage::Frame::free()
     // appears to be !isSynced().
     appendedLength = 0;
     committedLength = 0;
+    consolidatedLength = 0;
     memset(appendedMetadata.get(), '\0', METADATA_SIZE);
     appendedMetadataLength = 1;
     appendedMetadataVersion = 0;
     committedMetadataVersion = 0;
+    consolidatedMetadataVersion = 0;
+
+    // The journal no longer needs to keep any records for the replica.
+    consolidationRequested = false;
+    journalPending = false;
+    consolidatedSequence = journalSequence;
 
     if (buffer) {
         buffer.reset();
@@ -486,6 +524,7 @@ MultiFileStorage::Frame::reopen(size_t length)
     Lock _(storage->mutex);
     appendedLength = length;
     committedLength = length;
+    consolidatedLength = length;
     isOpen = true;
     isClosed = false;
     loadRequested = false;
@@ -530,10 +569,13 @@ MultiFileStorage::Frame::open(bool sync)
     isWriteBuffer = true;
     appendedLength = 0;
     committedLength = 0;
+    consolidatedLength = 0;
     memset(appendedMetadata.get(), '\0', METADATA_SIZE);
     appendedMetadataLength = 1;
     appendedMetadataVersion = 0;
     committedMetadataVersion = 0;
+    consolidatedMetadataVersion = 0;
+    consolidationRequested = false;
     loadRequested = false;
 }
 
@@ -724,6 +766,236 @@ MultiFileStorage::unlockedWrite(Frame::Lock& lock, void* buf, size_t count,
     lock.lock();
 }
 
+/**
+ * Deliver the completions of requests issued on #ring to their frames. When
+ * all of the requests for a frame have completed, the frame's state is
+ * updated (see Frame::ioCompleted()). Invoked only on the IO thread.
+ *
+ * \param lock
+ *     Lock on the storage mutex which must be held before calling. If
+ *     \a wait is true this lock is released while waiting.
+ * \param wait
+ *     If true, block until at least one request has completed (unless no
+ *     requests are outstanding).
+ */
+void
+MultiFileStorage::reapIoCompletions(Frame::Lock& lock, bool wait)
+{
+    if (wait) {
+        lock.unlock();
+        ring->waitForCompletion();
+        lock.lock();
+    }
+
+    size_t throttledBytes = 0;
+    uint64_t throttledTicks = 0;
+    FileIoUring::Request request;
+    int result;
+    while (ring->getCompletion(&request, &result)) {
+        Frame* frame = &frames[request.tag];
+        bool metadata = request.write &&
+                (request.offset == offsetOfFrameMetadata(frame->frameIndex));
+        if (result < 0) {
+            if (!request.write)
+                DIE("Failed to read replica: %s, "
+                    "reading %lu bytes from backup file %u at offset %lu.",
+                    strerror(-result), request.length, request.fileIndex,
+                    request.offset);
+            else if (metadata)
+                DIE("Failed to write metadata for replica: %s, "
+                    "writing %lu bytes to backup file %u at offset %lu.",
+                    strerror(-result), request.length, request.fileIndex,
+                    request.offset);
+            else
+                DIE("Failed to write replica: %s, "
+                    "writing %lu bytes to backup file %u at offset %lu.",
+                    strerror(-result), request.length, request.fileIndex,
+                    request.offset);
+        } else if (static_cast<size_t>(result) != request.length) {
+            if (!request.write) {
+                if (!usingDevNull)
+                    DIE("Failure performing asynchronous IO (short read: "
+                        "wanted %lu, got %d at offset %lu in file %u)",
+                        request.length, result, request.offset,
+                        request.fileIndex);
+            } else if (metadata) {
+                DIE("Unexpectedly short write to metadata for replica, "
+                    "file %u at offset %lu, "
+                    "expected length %lu, actual write length %d",
+                    request.fileIndex, request.offset, request.length,
+                    result);
+            } else {
+                DIE("Unexpectedly short write to replica, "
+                    "file %u at offset %lu, "
+                    "expected length %lu, actual write length %d",
+                    request.fileIndex, request.offset, request.length,
+                    result);
+            }
+        }
+
+        assert(frame->ioRequestsOutstanding > 0);
+        --frame->ioRequestsOutstanding;
+        if (frame->ioRequestsOutstanding > 0)
+            continue;
+
+        uint64_t now = Cycles::rdtsc();
+        uint64_t elapsed = now - frame->ioStartTime;
+        if (frame->loadingBuffer) {
+            metrics->backup.storageReadTicks += elapsed;
+            --framesReading;
+            if (framesReading == 0) {
+                PerfStats::threadStats.backupReadActiveCycles +=
+                        now - readingSince;
+            }
+        } else {
+            double elapsedSeconds = Cycles::toSeconds(elapsed);
+            if (elapsedSeconds > 0.1) {
+                LOG(WARNING, "Slow write to replica storage: %.1f ms for "
+                        "%lu bytes in frame %lu", elapsedSeconds*1e03,
+                        frame->ioBytes, frame->frameIndex);
+            }
+            metrics->backup.storageWriteTicks += elapsed;
+            --framesWriting;
+            if (framesWriting == 0) {
+                PerfStats::threadStats.backupWriteActiveCycles +=
+                        now - writingSince;
+            }
+            throttledBytes += frame->ioBytes;
+            throttledTicks = std::max(throttledTicks, elapsed);
+        }
+        frame->ioCompleted(lock);
+    }
+
+    // Reduce our bandwidth (if so configured) by delaying further IO.
+    if (throttledBytes > 0) {
+        lock.unlock();
+        sleepToThrottleWrites(throttledBytes, throttledTicks);
+        lock.lock();
+    }
+}
+
+/**
+ * Issue the reads that load a frame's replica data into its #loadingBuffer
+ * on #ring, in a single system call, without waiting for them to complete.
+ * Invoked only on the IO thread.
+ *
+ * \param lock
+ *     Lock on the storage mutex which must be held before calling. It may
+ *     be released while waiting for room on the ring.
+ * \param frame
+ *     Frame to read; its #loadingBuffer must be set.
+ */
+void
+MultiFileStorage::submitRead(Frame::Lock& lock, Frame* frame)
+{
+    uint32_t requests = downCast<uint32_t>(fds.size());
+    waitForIoCapacity(lock, requests);
+    void* buf = frame->loadingBuffer.get();
+    ring->registerBuffer(buf, segmentSize + METADATA_SIZE);
+
+    size_t frameletStart = offsetOfFramelet(frame->frameIndex);
+    for (size_t fileIndex = 0; fileIndex < fds.size(); fileIndex++) {
+        size_t frameletSize = bytesInFramelet(fileIndex);
+        ring->read(frame->frameIndex, downCast<uint32_t>(fileIndex),
+                   static_cast<char*>(buf) + (frameletSize * fileIndex),
+                   frameletSize, frameletStart);
+    }
+    ring->submit();
+
+    frame->ioRequestsOutstanding = requests;
+    frame->ioBytes = segmentSize;
+    frame->ioStartTime = Cycles::rdtsc();
+    if (framesReading == 0)
+        readingSince = frame->ioStartTime;
+    ++framesReading;
+    ioCompletionTask.schedule(PriorityTask::LOW);
+}
+
+/**
+ * Issue the writes for #count bytes of a frame, beginning at #offsetInFrame
+ * bytes, plus its most recently appended metadata block, on #ring in a
+ * single system call, without waiting for them to complete. Invoked only
+ * on the IO thread. Arguments are the same as for unlockedWrite().
+ *
+ * \param lock
+ *     Lock on the storage mutex which must be held before calling. It may
+ *     be released while waiting for room on the ring.
+ * \param frame
+ *     Frame to write; its #buffer must remain set until the writes complete.
+ * \param buf
+ *     Pointer (within the frame's #buffer) to the data to write to disk.
+ * \param count
+ *     Number of bytes to write.
+ * \param offsetInFrame
+ *     Offset into the Frame to write to.
+ * \param metadataBuf
+ *     Pointer (within the frame's #buffer) to the metadata to write to disk.
+ * \param metadataCount
+ *     Number of bytes of metadata to write.
+ */
+void
+MultiFileStorage::submitWrite(Frame::Lock& lock, Frame* frame, void* buf,
+                              size_t count, off_t offsetInFrame,
+                              void* metadataBuf, size_t metadataCount)
+{
+    waitForIoCapacity(lock, downCast<uint32_t>(fds.size() + 1));
+    ring->registerBuffer(frame->buffer.get(), segmentSize + METADATA_SIZE);
+
+    uint32_t requests = 0;
+    size_t remaining = count;
+    off_t frameletStart = offsetOfFramelet(frame->frameIndex);
+    off_t offsetInFramelet = offsetInFrame;
+    for (size_t fileIndex = 0; remaining > 0; fileIndex++) {
+        size_t frameletSize = bytesInFramelet(fileIndex);
+        if (static_cast<size_t>(offsetInFramelet) > frameletSize) {
+            // The offset that we want to write is past this framelet.
+            offsetInFramelet -= frameletSize;
+            continue;
+        }
+
+        size_t bytesToWrite = std::min(frameletSize - offsetInFramelet,
+                                       remaining);
+        ring->write(frame->frameIndex, downCast<uint32_t>(fileIndex), buf,
+                    bytesToWrite, frameletStart + offsetInFramelet);
+        requests++;
+
+        remaining -= bytesToWrite;
+        buf = static_cast<char*>(buf) + bytesToWrite;
+        offsetInFramelet = 0;
+    }
+
+    // Metadata gets its own IO operation.
+    ring->write(frame->frameIndex, 0, metadataBuf, metadataCount,
+                offsetOfFrameMetadata(frame->frameIndex));
+    requests++;
+    ring->submit();
+
+    frame->ioRequestsOutstanding = requests;
+    frame->ioBytes = count + metadataCount;
+    frame->ioStartTime = Cycles::rdtsc();
+    if (framesWriting == 0)
+        writingSince = frame->ioStartTime;
+    ++framesWriting;
+    ioCompletionTask.schedule(PriorityTask::LOW);
+}
+
+/**
+ * Wait, if necessary, until #ring has room for more requests, delivering
+ * completions to frames in the meantime. Invoked only on the IO thread.
+ *
+ * \param lock
+ *     Lock on the storage mutex which must be held before calling. It is
+ *     released while waiting.
+ * \param requests
+ *     Number of requests that are about to be issued.
+ */
+void
+MultiFileStorage::waitForIoCapacity(Frame::Lock& lock, uint32_t requests)
+{
+    while (ring->getAvailableRequests() < requests)
+        reapIoCompletions(lock, true);
+}
+
 namespace {
 /**
  * Round \a offset down to a block boundary.
@@ -753,9 +1025,16 @@ roundUp(size_t length)
  * the #buffer member to a buffer pointing to the replica data.
  * Note: the lock on #mutex is released while actual IO is happening so
  * invariants need to be rechecked after the call to unlockedRead.
+ *
+ * \param lock
+ *      Lock on the storage mutex which must be held before calling.
+ * \param async
+ *      If true, the read is issued on storage->ring and this method returns
+ *      without waiting for it; #buffer is set by ioCompleted() once it
+ *      finishes. Only the IO thread may pass true.
  */
 void
-MultiFileStorage::Frame::performRead(Lock& lock)
+MultiFileStorage::Frame::performRead(Lock& lock, bool async)
 {
     assert(loadRequested);
     BufferPtr buffer = storage->allocateBuffer();
@@ -767,6 +1046,11 @@ MultiFileStorage::Frame::performRead(Lock& lock)
         metrics->backup.storageReadBytes += storage->segmentSize;
         ++PerfStats::threadStats.backupReadOps;
         PerfStats::threadStats.backupReadBytes += storage->segmentSize;
+        if (async) {
+            loadingBuffer = std::move(buffer);
+            storage->submitRead(lock, this);
+            return;
+        }
         // Lock released during this call; assume any field could have changed.
         storage->unlockedRead(lock, buffer.get(), frameIndex,
                               storage->usingDevNull);
@@ -777,20 +1061,28 @@ MultiFileStorage::Frame::performRead(Lock& lock)
 }
 
 /*
- * Flush any appended data and the latest appended metadata to disk.
+ * Flush any appended data and the latest appended metadata to disk (to the
+ * frame's own region of storage, even if there is a journal).
  * Requires #buffer to remain set for the duration of the operation, though
  * data can be appended to it concurrently. Releases the buffer if it won't
  * be needed in the immediate future and reschedules if any additional IO
  * has been requested by the time the method completes.
  * Note: the lock on #mutex is released while actual IO is happening so
  * invariants need to be rechecked after the call to unlockedWrite.
+ *
+ * \param lock
+ *      Lock on the storage mutex which must be held before calling.
+ * \param async
+ *      If true, the write is issued on storage->ring and this method returns
+ *      without waiting for it; the rest of the work described above is done
+ *      by ioCompleted() once it finishes. Only the IO thread may pass true.
  */
 void
-MultiFileStorage::Frame::performWrite(Lock& lock)
+MultiFileStorage::Frame::performWrite(Lock& lock, bool async)
 {
     assert(buffer);
 
-    const size_t startOfFirstDirtyBlock = roundDown(committedLength);
+    const size_t startOfFirstDirtyBlock = roundDown(consolidatedLength);
     const size_t startOfNextCleanBlock = roundUp(appendedLength);
     const size_t dirtyLength = startOfNextCleanBlock - startOfFirstDirtyBlock;
 
@@ -805,6 +1097,13 @@ MultiFileStorage::Frame::performWrite(Lock& lock)
     const size_t appendedLength = this->appendedLength;
     memcpy(metadataBlock, appendedMetadata.get(), appendedMetadataLength);
     const size_t appendedMetadataVersion = this->appendedMetadataVersion;
+    const uint64_t journalSequence = this->journalSequence;
+    if (storage->journalSize > 0) {
+        // Journal records issued before this point hold no data newer than
+        // this write; the stamp tells replayJournal() to skip them.
+        *reinterpret_cast<uint64_t*>(metadataBlock + JOURNAL_STAMP_OFFSET) =
+                storage->nextJournalSequence;
+    }
 
     if (testingSkipRealIo) {
         TEST_LOG("sourceBufferOffset %lu count %lu frameIndex %lu",
@@ -814,21 +1113,61 @@ MultiFileStorage::Frame::performWrite(Lock& lock)
         metrics->backup.storageWriteBytes += dirtyLength;
         ++PerfStats::threadStats.backupWriteOps;
         PerfStats::threadStats.backupWriteBytes += dirtyLength;
+        if (async) {
+            writingLength = appendedLength;
+            writingMetadataVersion = appendedMetadataVersion;
+            writingJournalSequence = journalSequence;
+            storage->submitWrite(lock, this, firstDirtyBlock, dirtyLength,
+                                 startOfFirstDirtyBlock, metadataBlock,
+                                 METADATA_SIZE);
+            return;
+        }
         // Lock released during this call; assume any field could have changed.
         storage->unlockedWrite(lock, firstDirtyBlock, dirtyLength,
                                frameIndex, startOfFirstDirtyBlock,
                                metadataBlock, METADATA_SIZE);
     }
 
+    writeCompleted(lock, appendedLength, appendedMetadataVersion,
+                   journalSequence);
+}
+
+/**
+ * Finish up after a write issued by performWrite(): update the committed
+ * length and metadata version, release the buffer if it won't be used
+ * again, and reschedule if more IO has been requested in the meantime.
+ *
+ * \param lock
+ *      Lock on the storage mutex which must be held before calling.
+ * \param length
+ *      Value of #appendedLength when the write was issued; all of the data
+ *      up to here is now durable.
+ * \param metadataVersion
+ *      Value of #appendedMetadataVersion when the write was issued.
+ * \param journalSequence
+ *      Value of #journalSequence when the write was issued.
+ */
+void
+MultiFileStorage::Frame::writeCompleted(Lock& lock, size_t length,
+                                        uint64_t metadataVersion,
+                                        uint64_t journalSequence)
+{
     assert(buffer);
 
-    // Update committed based on the above snapshots of fields taken
-    // just before the write.
-    committedLength = appendedLength;
-    committedMetadataVersion = appendedMetadataVersion;
+    // Update committed based on the snapshots of fields taken just before
+    // the write. With a journal, later appends may have been committed to
+    // the journal while the write was underway.
+    committedLength = std::max(committedLength, length);
+    committedMetadataVersion = std::max(committedMetadataVersion,
+                                        metadataVersion);
+    consolidatedLength = length;
+    consolidatedMetadataVersion = metadataVersion;
+    consolidatedSequence = std::max(consolidatedSequence, journalSequence);
+    if (isConsolidated())
+        consolidationRequested = false;
 
     // Release the in-memory copy if it won't be used again.
-    if (isClosed && isSynced() && !loadRequested && buffer) {
+    if (isClosed && isConsolidated() && !loadRequested && buffer) {
         buffer.reset();
         assert(isWriteBuffer);
         --storage->writeBuffersInUse;
@@ -837,11 +1176,46 @@ MultiFileStorage::Frame::performWrite(Lock& lock)
 
     if (loadRequested) {
         schedule(lock, NORMAL);
-    } else if (!isSynced()) {
-        schedule(lock, LOW);
+    } else if (needsWrite()) {
+        // If the frame was closed while the write was underway, close()
+        // scheduled it at HIGH priority; keep it there (with io_uring that
+        // invocation found the write still outstanding and did nothing).
+        schedule(lock, isClosed ? HIGH : LOW);
+    }
+}
+
+/**
+ * Invoked (on the IO thread) when all of the requests issued on storage->ring
+ * by performRead() or performWrite() have completed: finishes the operation
+ * and updates the frame's state accordingly.
+ *
+ * \param lock
+ *      Lock on the storage mutex which must be held before calling.
+ */
+void
+MultiFileStorage::Frame::ioCompleted(Lock& lock)
+{
+    performingIo = false;
+    if (loadingBuffer) {
+        assert(!buffer);
+        buffer = std::move(loadingBuffer);
+    } else {
+        writeCompleted(lock, writingLength, writingMetadataVersion,
+                       writingJournalSequence);
     }
 }
 
+/**
+ * Return true if all appended data and metadata have been written to the
+ * frame's own region of storage (not just to the journal).
+ */
+bool
+MultiFileStorage::Frame::isConsolidated() const
+{
+    return (appendedLength == consolidatedLength) &&
+           (appendedMetadataVersion == consolidatedMetadataVersion);
+}
+
 /// Return true if all appended data and metadata have been flushed to storage.
 bool
 MultiFileStorage::Frame::isSynced() const
@@ -850,6 +1224,18 @@ MultiFileStorage::Frame::isSynced() const
            (appendedMetadataVersion == committedMetadataVersion);
 }
 
+/**
+ * Return true if performTask() should write this frame's appended data to
+ * its own region of storage. With a journal, appends to open frames go to
+ * the journal instead unless consolidation has been requested.
+ */
+bool
+MultiFileStorage::Frame::needsWrite() const
+{
+    return !isConsolidated() && (storage->journalSize == 0 || isClosed ||
+                                 consolidationRequested);
+}
+
 // --- MultiFileStorage::BufferDeleter ---
 
 /**
@@ -879,7 +1265,10 @@ void
 MultiFileStorage::BufferDeleter::operator()(void* buffer)
 {
     if (buffer) {
-        if (storage->buffers.size() >= MAX_POOLED_BUFFERS) {
+        // Buffers registered with the ring must outlive it, so they always
+        // go back to the pool.
+        if (storage->buffers.size() >= MAX_POOLED_BUFFERS &&
+                !(storage->ring && storage->ring->isRegistered(buffer))) {
             std::free(buffer);
         } else {
             storage->buffers.push(buffer);
@@ -887,6 +1276,75 @@ MultiFileStorage::BufferDeleter::operator()(void* buffer)
     }
 }
 
+// --- MultiFileStorage::IoCompletionTask ---
+
+/**
+ * Create the task that delivers completions from a storage's #ring.
+ *
+ * \param storage
+ *      MultiFileStorage whose #ioQueue runs this task.
+ */
+MultiFileStorage::IoCompletionTask::IoCompletionTask(MultiFileStorage* storage)
+    : PriorityTask(storage->ioQueue)
+    , storage(storage)
+{
+}
+
+MultiFileStorage::IoCompletionTask::~IoCompletionTask()
+{
+    deschedule();
+}
+
+/**
+ * Deliver whatever completions have arrived, and reschedule this task if
+ * requests remain outstanding. If no other tasks are waiting, this waits
+ * for a completion rather than spinning; a task scheduled in the
+ * meantime only runs after that completion arrives.
+ */
+void
+MultiFileStorage::IoCompletionTask::performTask()
+{
+    Lock lock(storage->mutex);
+    if (!storage->ring)
+        return;
+    storage->reapIoCompletions(lock, taskQueue.isIdle());
+    if (storage->ring->getOutstandingRequests() > 0)
+        schedule(LOW);
+}
+
+// --- MultiFileStorage::JournalTask ---
+
+/**
+ * Create the task that writes appends to a storage's journal.
+ *
+ * \param storage
+ *      MultiFileStorage whose #ioQueue runs this task.
+ */
+MultiFileStorage::JournalTask::JournalTask(MultiFileStorage* storage)
+    : PriorityTask(storage->ioQueue)
+    , storage(storage)
+{
+}
+
+MultiFileStorage::JournalTask::~JournalTask()
+{
+    deschedule();
+}
+
+/**
+ * Write the appends waiting for the journal; if a synchronous append is
+ * already flushing it, try again later.
+ */
+void
+MultiFileStorage::JournalTask::performTask()
+{
+    Lock lock(storage->mutex);
+    if (!storage->flushJournal(lock))
+        schedule(LOW);
+}
+
+const uint64_t MultiFileStorage::JOURNAL_MAGIC;
+
 // --- MultiFileStorage ---
 
 /**
@@ -911,16 +1369,28 @@ MultiFileStorage::BufferDeleter::operator()(void* buffer)
  * \param openFlags
  *      Extra flags for use while opening files in filePathsStr (default to 0,
  *      O_DIRECT may be used to disable the OS buffer cache.
+ * \param ioEngine
+ *      Mechanism used to read and write frames; see IoEngine.
+ * \param journalSize
+ *      If non-zero, appends are written to a journal of this many bytes
+ *      (rounded down to a whole number of blocks) at the end of the first
+ *      file, and only written to their frames when the frames are closed
+ *      or the journal needs the space. This turns the small writes of
+ *      many open replicas into a few large sequential ones. Must be at
+ *      least twice the size of a replica.
  */
 MultiFileStorage::MultiFileStorage(size_t segmentSize,
                                    size_t frameCount,
                                    size_t writeRateLimit,
                                    size_t maxWriteBuffers,
                                    const char* filePathsStr,
-                                   int openFlags)
+                                   int openFlags,
+                                   IoEngine ioEngine,
+                                   size_t journalSize)
     : BackupStorage(segmentSize, Type::DISK, writeRateLimit)
     , mutex()
     , ioQueue()
+    , ioCompletionTask(this)
     , superblock()
     , lastSuperblockFrame(1)
     , frames()
@@ -934,9 +1404,29 @@ MultiFileStorage::MultiFileStorage(size_t segmentSize,
     , maxWriteBuffers(maxWriteBuffers)
     , bufferDeleter(this)
     , buffers()
+    , ring()
+    , framesReading(0)
+    , readingSince(0)
+    , framesWriting(0)
+    , writingSince(0)
+    , journalSize(journalSize / BLOCK_SIZE * BLOCK_SIZE)
+    , journalTask(this)
+    , journalPending()
+    , journalExtents()
+    , journalHead(0)
+    , nextJournalSequence(1)
+    , journalBuffer(NULL, std::free)
+    , journalBufferSize(roundUp(segmentSize) + BLOCK_SIZE + METADATA_SIZE)
+    , journalFlushing(false)
 {
     assert(filePathsStr);
 
+    if (this->journalSize > 0 && this->journalSize < 2 * journalBufferSize) {
+        throw BackupStorageException(HERE,
+            format("Backup journal of %lu bytes is too small; it must hold "
+                   "at least %lu bytes", journalSize, 2 * journalBufferSize));
+    }
+
     freeMap.set();
 
     // If we were given /dev/null (to take disk bandwidth out of the
@@ -1005,11 +1495,32 @@ MultiFileStorage::MultiFileStorage(size_t segmentSize,
     for (size_t frame = 0; frame < frameCount; ++frame)
         frames.emplace_back(this, frame);
 
+    if (this->journalSize > 0) {
+        journalBuffer.reset(Memory::xmemalign(HERE, BUFFER_ALIGNMENT,
+                                              journalBufferSize));
+        replayJournal();
+    }
+
+    if (ioEngine == IO_URING) {
+        try {
+            // Room for the data and metadata requests of
+            // MAX_FRAMES_PERFORMING_IO frames.
+            ring.construct(fds, downCast<uint32_t>(
+                    (fds.size() + 1) * MAX_FRAMES_PERFORMING_IO));
+        } catch (const FatalError& e) {
+            LOG(WARNING, "Couldn't use io_uring for backup storage (%s); "
+                    "using POSIX AIO instead", e.message.c_str());
+        }
+    }
+
     ioQueue.start();
 
     LOG(NOTICE, "Backup storage opened with %lu bytes available; allocated %lu "
-            "frame(s) across %lu file(s) with %lu bytes per frame",
-            frameCount * segmentSize, frameCount, fds.size(), segmentSize);
+            "frame(s) across %lu file(s) with %lu bytes per frame%s%s",
+            frameCount * segmentSize, frameCount, fds.size(), segmentSize,
+            ring ? " (using io_uring)" : "",
+            this->journalSize > 0 ? format("; %lu byte journal",
+                    this->journalSize).c_str() : "");
 }
 
 /// Close the files.
@@ -1017,6 +1528,16 @@ MultiFileStorage::~MultiFileStorage()
 {
     ioQueue.halt();
 
+    // Wait for any IO still outstanding on the ring; its buffers are
+    // about to be freed.
+    if (ring) {
+        Lock lock(mutex);
+        while (ring->getOutstandingRequests() > 0)
+            reapIoCompletions(lock, true);
+        lock.unlock();
+        ring.destroy();
+    }
+
     for (size_t i = 0; i < fds.size(); i++) {
         int r = close(fds[i]);
         if (r == -1)
@@ -1128,6 +1649,8 @@ MultiFileStorage::benchmark(BackupStrategy backupStrategy)
 size_t
 MultiFileStorage::getMetadataSize()
 {
+    if (journalSize > 0)
+        return JOURNAL_STAMP_OFFSET;
     return METADATA_SIZE;
 }
 
@@ -1168,6 +1691,7 @@ MultiFileStorage::loadAllMetadata()
             writeBuffersInUse++;
             frame.appendedLength = metadata->certificate.segmentLength;
             frame.committedLength = metadata->certificate.segmentLength;
+            frame.consolidatedLength = metadata->certificate.segmentLength;
         }
 
         ret.push_back({&frame, BackupStorage::freeFrame});
@@ -1352,6 +1876,8 @@ MultiFileStorage::fry()
     memset(zeroes, 0, sizeof(zeroes));
     foreach (Frame& frame, frames) {
         frame.open(true);
+        // The scribbles must reach the frames themselves, not the journal.
+        frame.consolidationRequested = true;
         frame.append(empty, 0, 0, 0, zeroes, sizeof(zeroes));
         frame.free();
     }
@@ -1359,6 +1885,215 @@ MultiFileStorage::fry()
 
 // - private -
 
+/**
+ * Arrange for the appends to a frame to be written to the journal. For
+ * frames opened with sync this returns only once they are durable; the
+ * thread that flushes the journal writes the appends of every frame
+ * waiting, so concurrent synchronous appends share the cost of a write.
+ *
+ * \param lock
+ *      Lock on #mutex which must be held before calling. It may be
+ *      released while this method waits.
+ * \param frame
+ *      Frame with appends that aren't durable yet.
+ */
+void
+MultiFileStorage::appendToJournal(Frame::Lock& lock, Frame* frame)
+{
+    if (!frame->journalPending) {
+        frame->journalPending = true;
+        journalPending.push_back(frame);
+    }
+    if (!frame->sync) {
+        journalTask.schedule(PriorityTask::LOW);
+        return;
+    }
+    while (!frame->isSynced()) {
+        if (frame->consolidationRequested && !frame->performingIo) {
+            // The journal had no room for the appends; write them to the
+            // frame instead, as if there were no journal.
+            frame->performingIo = true;
+            frame->performWrite(lock);
+            frame->performingIo = false;
+        } else if (frame->consolidationRequested || !flushJournal(lock)) {
+            // Wait for the IO thread or for another thread's flush (which
+            // may well include this frame's appends).
+            lock.unlock();
+            lock.lock();
+        }
+    }
+}
+
+/**
+ * Write as many of the appends waiting in #journalPending as fit in
+ * #journalBuffer to the journal, in a single sequential write. A record is
+ * written for each frame covering the blocks appended to since its last
+ * record (or write), followed by its latest metadata. Frames whose appends
+ * don't fit in the journal are marked for consolidation and written to
+ * their own regions of storage instead.
+ *
+ * \param lock
+ *      Lock on #mutex which must be held before calling. It is released
+ *      during IO.
+ * \return
+ *      False if another thread is already flushing the journal, in which
+ *      case nothing was done; true otherwise.
+ */
+bool
+MultiFileStorage::flushJournal(Frame::Lock& lock)
+{
+    if (journalFlushing)
+        return false;
+    reclaimJournal();
+
+    // State of each frame captured in the batch; it becomes committed
+    // once the batch is durable.
+    struct Snapshot {
+        Frame* frame;
+        uint64_t epoch;
+        size_t appendedLength;
+        uint64_t appendedMetadataVersion;
+        uint64_t sequence;
+        uint64_t start;
+    };
+    std::vector<Snapshot> batch;
+    char* batchBuffer = static_cast<char*>(journalBuffer.get());
+    size_t batchLength = 0;
+    while (!journalPending.empty()) {
+        Frame* frame = journalPending.front();
+        if (!frame->journalPending || frame->isSynced()) {
+            frame->journalPending = false;
+            journalPending.pop_front();
+            continue;
+        }
+
+        const size_t start = roundDown(frame->committedLength);
+        const size_t end = roundUp(frame->appendedLength);
+        const size_t recordLength = BLOCK_SIZE + (end - start) + METADATA_SIZE;
+        if (batchLength + recordLength > journalBufferSize)
+            break;
+
+        // Records don't wrap around the end of the journal; skip to its
+        // start instead (but only at the start of a batch).
+        uint64_t position = journalHead + batchLength;
+        size_t offsetInJournal = position % journalSize;
+        uint64_t skip = 0;
+        if (offsetInJournal + recordLength > journalSize)
+            skip = journalSize - offsetInJournal;
+        if (position + skip + recordLength - getJournalTail() > journalSize) {
+            requestConsolidation(lock, recordLength + skip);
+            frame->journalPending = false;
+            journalPending.pop_front();
+            frame->consolidationRequested = true;
+            frame->schedule(lock, PriorityTask::LOW);
+            continue;
+        }
+        if (skip > 0) {
+            if (batchLength > 0)
+                break;
+            journalHead += skip;
+            position += skip;
+        }
+
+        char* record = batchBuffer + batchLength;
+        memset(record, 0, BLOCK_SIZE);
+        JournalRecordHeader* header =
+                reinterpret_cast<JournalRecordHeader*>(record);
+        header->magic = JOURNAL_MAGIC;
+        header->sequence = nextJournalSequence++;
+        header->frameIndex = frame->frameIndex;
+        header->offsetInFrame = start;
+        header->length = end - start;
+        memcpy(record + BLOCK_SIZE,
+               static_cast<char*>(frame->buffer.get()) + start, end - start);
+        char* metadata = record + BLOCK_SIZE + (end - start);
+        memset(metadata, 0, METADATA_SIZE);
+        memcpy(metadata, frame->appendedMetadata.get(),
+               frame->appendedMetadataLength);
+        Crc32C crc;
+        crc.update(record, recordLength);
+        header->checksum = crc.getResult();
+
+        batch.push_back({frame, frame->epoch, frame->appendedLength,
+                         frame->appendedMetadataVersion, header->sequence,
+                         position});
+        batchLength += recordLength;
+        frame->journalPending = false;
+        journalPending.pop_front();
+    }
+
+    if (batchLength > 0) {
+        const off_t offset = offsetOfJournal() + journalHead % journalSize;
+        journalHead += batchLength;
+        journalFlushing = true;
+        if (Frame::testingSkipRealIo) {
+            TEST_LOG("%lu records, %lu bytes at offset %lu",
+                     batch.size(), batchLength, offset);
+        } else {
+            ++metrics->backup.storageWriteCount;
+            metrics->backup.storageWriteBytes += batchLength;
+            ++PerfStats::threadStats.backupWriteOps;
+            PerfStats::threadStats.backupWriteBytes += batchLength;
+            uint64_t start = Cycles::rdtsc();
+            lock.unlock();
+            ssize_t r = pwrite(fds[0], batchBuffer, batchLength, offset);
+            if (r == -1) {
+                DIE("Failed to write to backup journal: %s, "
+                    "writing %lu bytes to backup file 0 at offset %lu.",
+                    strerror(errno), batchLength, offset);
+            } else if (r != downCast<ssize_t>(batchLength)) {
+                DIE("Unexpectedly short write to backup journal, "
+                    "file 0 at offset %lu, "
+                    "expected length %lu, actual write length %lu",
+                    offset, batchLength, r);
+            }
+            sleepToThrottleWrites(batchLength, Cycles::rdtsc() - start);
+            uint64_t elapsed = Cycles::rdtsc() - start;
+            metrics->backup.storageWriteTicks += elapsed;
+            PerfStats::threadStats.backupWriteActiveCycles += elapsed;
+            lock.lock();
+        }
+        journalFlushing = false;
+
+        foreach (const Snapshot& snapshot, batch) {
+            Frame* frame = snapshot.frame;
+            // Skip frames freed while the write was underway.
+            if (frame->epoch != snapshot.epoch)
+                continue;
+            frame->committedLength = std::max(frame->committedLength,
+                                              snapshot.appendedLength);
+            frame->committedMetadataVersion =
+                    std::max(frame->committedMetadataVersion,
+                             snapshot.appendedMetadataVersion);
+            frame->journalSequence = snapshot.sequence;
+            journalExtents.push_back({snapshot.sequence, snapshot.start,
+                                      frame});
+        }
+
+        // Start consolidating open frames well before the journal fills,
+        // so that appends rarely bypass it.
+        uint64_t used = journalHead - getJournalTail();
+        if (used > journalSize / 2)
+            requestConsolidation(lock, used - journalSize / 2);
+    }
+
+    if (!journalPending.empty())
+        journalTask.schedule(PriorityTask::LOW);
+    return true;
+}
+
+/**
+ * Return the position (see #journalHead) of the oldest record the journal
+ * must retain; the journal may be overwritten up to here.
+ */
+uint64_t
+MultiFileStorage::getJournalTail() const
+{
+    if (journalExtents.empty())
+        return journalHead;
+    return journalExtents.front().start;
+}
+
 /**
  * Returns the number of bytes of data that any framelet of a particular file
  * contains.
@@ -1417,6 +2152,16 @@ MultiFileStorage::offsetOfFrameMetadata(size_t frameIndex) const
     return frameStart + roundUp(segmentSize / fds.size());
 }
 
+/**
+ * Returns the offset into the first file where the journal starts (just
+ * after the last frame).
+ */
+off_t
+MultiFileStorage::offsetOfJournal() const
+{
+    return offsetOfFramelet(frameCount);
+}
+
 /**
  * Returns the offset into the files where a copy of the superblock may
  * be located. See bytesInFramelet() for details on how this data is divided
@@ -1436,6 +2181,162 @@ MultiFileStorage::offsetOfSuperblockFrame(size_t superblockIndex) const
            BLOCK_SIZE;
 }
 
+/**
+ * Forget the oldest journal records whose frames have since been
+ * consolidated (or freed), so their space can be reused.
+ */
+void
+MultiFileStorage::reclaimJournal()
+{
+    while (!journalExtents.empty()) {
+        const JournalExtent& extent = journalExtents.front();
+        if (extent.frame->consolidatedSequence < extent.sequence)
+            break;
+        journalExtents.pop_front();
+    }
+}
+
+/**
+ * Apply the records left in the journal by an earlier instance to their
+ * frames, then invalidate them. Only called from the constructor.
+ *
+ * Each frame's metadata block is stamped with the journal sequence number
+ * current when it was last written (see Frame::performWrite()); a record
+ * older than the stamp on its frame is skipped, since its data is already
+ * in the frame (or belonged to an earlier replica in the frame). The rest
+ * are applied in sequence order.
+ */
+void
+MultiFileStorage::replayJournal()
+{
+    Memory::unique_ptr_free journal(
+            Memory::xmemalign(HERE, BUFFER_ALIGNMENT, journalSize), std::free);
+    char* journalData = static_cast<char*>(journal.get());
+    ssize_t r = pread(fds[0], journalData, journalSize, offsetOfJournal());
+    if (r == -1) {
+        DIE("Failed to read backup journal: %s, "
+            "starting offset %lu, length %lu",
+            strerror(errno), offsetOfJournal(), journalSize);
+    }
+    memset(journalData + r, 0, journalSize - r);
+
+    // Find every intact record.
+    std::vector<JournalRecordHeader*> records;
+    size_t offset = 0;
+    while (offset + BLOCK_SIZE + METADATA_SIZE <= journalSize) {
+        JournalRecordHeader* header =
+                reinterpret_cast<JournalRecordHeader*>(journalData + offset);
+        if (header->magic != JOURNAL_MAGIC ||
+                header->length > segmentSize ||
+                header->length % BLOCK_SIZE != 0 ||
+                header->offsetInFrame > segmentSize - header->length ||
+                header->frameIndex >= frameCount ||
+                offset + BLOCK_SIZE + header->length + METADATA_SIZE >
+                    journalSize) {
+            offset += BLOCK_SIZE;
+            continue;
+        }
+        const size_t recordLength =
+                BLOCK_SIZE + header->length + METADATA_SIZE;
+        const uint32_t checksum = header->checksum;
+        header->checksum = 0;
+        Crc32C crc;
+        crc.update(header, recordLength);
+        header->checksum = checksum;
+        if (crc.getResult() != checksum) {
+            offset += BLOCK_SIZE;
+            continue;
+        }
+        records.push_back(header);
+        offset += recordLength;
+    }
+    std::sort(records.begin(), records.end(),
+              [](const JournalRecordHeader* left,
+                 const JournalRecordHeader* right)
+              { return left->sequence < right->sequence; });
+
+    // Read the stamps of replicas stored in frames. Sequence numbers must
+    // keep increasing across restarts, so new records aren't mistaken for
+    // old ones.
+    std::vector<uint64_t> stamps(frameCount, 0);
+    Memory::unique_ptr_free block(
+            Memory::xmemalign(HERE, BUFFER_ALIGNMENT, METADATA_SIZE),
+            std::free);
+    char* metadataBlock = static_cast<char*>(block.get());
+    for (size_t frameIndex = 0; frameIndex < frameCount; ++frameIndex) {
+        if (pread(fds[0], metadataBlock, METADATA_SIZE,
+                  offsetOfFrameMetadata(frameIndex)) != METADATA_SIZE)
+            continue;
+        const BackupReplicaMetadata* metadata =
+                reinterpret_cast<const BackupReplicaMetadata*>(metadataBlock);
+        if (!metadata->checkIntegrity())
+            continue;
+        stamps[frameIndex] = *reinterpret_cast<uint64_t*>(
+                metadataBlock + JOURNAL_STAMP_OFFSET);
+        nextJournalSequence = std::max(nextJournalSequence,
+                                       stamps[frameIndex]);
+    }
+
+    Lock lock(mutex);
+    size_t replayed = 0;
+    foreach (JournalRecordHeader* header, records) {
+        nextJournalSequence = std::max(nextJournalSequence,
+                                       header->sequence + 1);
+        if (header->sequence < stamps[header->frameIndex])
+            continue;
+        char* data = reinterpret_cast<char*>(header) + BLOCK_SIZE;
+        char* metadata = data + header->length;
+        *reinterpret_cast<uint64_t*>(metadata + JOURNAL_STAMP_OFFSET) =
+                header->sequence + 1;
+        unlockedWrite(lock, data, header->length, header->frameIndex,
+                      header->offsetInFrame, metadata, METADATA_SIZE);
+        ++replayed;
+    }
+
+    // The frames are now up to date; make sure the records are never
+    // replayed again.
+    memset(metadataBlock, 0, BLOCK_SIZE);
+    foreach (JournalRecordHeader* header, records) {
+        off_t recordOffset = offsetOfJournal() +
+                (reinterpret_cast<char*>(header) - journalData);
+        if (pwrite(fds[0], metadataBlock, BLOCK_SIZE, recordOffset) !=
+                BLOCK_SIZE) {
+            DIE("Failed to invalidate backup journal record at offset %lu: "
+                "%s", recordOffset, strerror(errno));
+        }
+    }
+
+    if (!records.empty()) {
+        LOG(NOTICE, "Replayed %lu of %lu record(s) found in the backup "
+            "journal", replayed, records.size());
+    }
+}
+
+/**
+ * Ask the IO thread to consolidate the frames holding the oldest records
+ * in the journal, so that their space can be reused.
+ *
+ * \param lock
+ *      Lock on #mutex which must be held before calling.
+ * \param bytes
+ *      Consolidate enough frames to free up this much of the journal.
+ */
+void
+MultiFileStorage::requestConsolidation(Frame::Lock& lock, uint64_t bytes)
+{
+    const uint64_t tail = getJournalTail();
+    foreach (const JournalExtent& extent, journalExtents) {
+        if (extent.start - tail >= bytes)
+            break;
+        Frame* frame = extent.frame;
+        if (frame->consolidatedSequence >= extent.sequence ||
+                frame->consolidationRequested)
+            continue;
+        frame->consolidationRequested = true;
+        frame->schedule(lock, PriorityTask::HIGH);
+    }
+}
+
 /**
  * Fix the size of the logfile to ensure that the OS doesn't tell us
  * the filesystem is out of space later.
@@ -1447,6 +2348,8 @@ void
 MultiFileStorage::reserveSpace(int fd)
 {
     uint64_t logSpace = offsetOfFramelet(frameCount);
+    if (fd == fds[0])
+        logSpace += journalSize;
 
     LOG(DEBUG, "Reserving %lu bytes of log space", logSpace);
     int r = ftruncate(fd, logSpace);
@@ -20,6 +20,7 @@
 
 #include "Common.h"
 #include "BackupStorage.h"
+#include "FileIoUring.h"
 #include "PriorityTaskQueue.h"
 
 namespace RAMCloud {
@@ -43,6 +44,21 @@ class MultiFileStorage : public BackupStorage {
 
     typedef std::unique_ptr<void, BufferDeleter> BufferPtr;
 
+    /**
+     * Selects the mechanism used to read and write frames.
+     */
+    enum IoEngine {
+        /// POSIX asynchronous IO: the IO thread issues the requests for
+        /// one frame at a time and blocks until they all complete.
+        AIO,
+
+        /// Linux io_uring (see FileIoUring): the IO thread submits the
+        /// requests for each frame in a single system call and moves on to
+        /// other frames; frames advance as their requests complete. Falls
+        /// back to AIO if the kernel doesn't support io_uring.
+        IO_URING
+    };
+
     /**
      * Represents both in-memory and on-disk storage of a replica. After opened,
      * a Frame remains associated with the same replica for the lifetime of that 
@@ -88,10 +104,16 @@ class MultiFileStorage : public BackupStorage {
       PRIVATE:
         void open(bool sync);
 
-        void performRead(Lock& lock);
-        void performWrite(Lock& lock);
+        void ioCompleted(Lock& lock);
+        void performRead(Lock& lock, bool async = false);
+        void performWrite(Lock& lock, bool async = false);
+        void writeCompleted(Lock& lock, size_t length,
+                            uint64_t metadataVersion,
+                            uint64_t journalSequence);
 
+        bool isConsolidated() const;
         bool isSynced() const;
+        bool needsWrite() const;
 
         /// Storage where this frame resides.
         MultiFileStorage* storage;
@@ -177,6 +199,36 @@ class MultiFileStorage : public BackupStorage {
         /// Revision number of metadata block most recently flushed to storage.
         uint64_t committedMetadataVersion;
 
+        /**
+         * Of #committedLength, how much has been written to this frame's own
+         * region of storage (rather than just to the journal), and the
+         * revision number of the metadata written there. Without a journal
+         * these always equal #committedLength and #committedMetadataVersion.
+         */
+        size_t consolidatedLength;
+        uint64_t consolidatedMetadataVersion;
+
+        /**
+         * True if this frame's data should be written to its own region of
+         * storage rather than to the journal, either because the journal
+         * needs the space held by this frame's records or because the
+         * journal was full.
+         */
+        bool consolidationRequested;
+
+        /// True if this frame is waiting in MultiFileStorage::journalPending.
+        bool journalPending;
+
+        /// Sequence number of the most recent journal record for this frame.
+        uint64_t journalSequence;
+
+        /**
+         * Journal records for this frame with sequence numbers up to here
+         * have been consolidated (or belonged to a replica since freed),
+         * so the journal space they occupy can be reused.
+         */
+        uint64_t consolidatedSequence;
+
         /**
          * True if the replica data has been requested. Will cause IO if the
          * replica is no longer in memory.
@@ -186,6 +238,32 @@ class MultiFileStorage : public BackupStorage {
         /// True if a read or write is ongoing (which is done without a lock).
         bool performingIo;
 
+        /**
+         * Buffer that a read outstanding on MultiFileStorage::ring is
+         * filling; moved to #buffer when the read completes.
+         */
+        BufferPtr loadingBuffer;
+
+        /**
+         * Snapshots of #appendedLength and #appendedMetadataVersion taken
+         * when a write outstanding on MultiFileStorage::ring was issued;
+         * they become committed when it completes.
+         */
+        size_t writingLength;
+        uint64_t writingMetadataVersion;
+        uint64_t writingJournalSequence;
+
+        /// Number of requests for this frame outstanding on
+        /// MultiFileStorage::ring.
+        uint32_t ioRequestsOutstanding;
+
+        /// Total bytes of the requests counted in #ioRequestsOutstanding.
+        size_t ioBytes;
+
+        /// Cycles::rdtsc() time when the requests counted in
+        /// #ioRequestsOutstanding were issued.
+        uint64_t ioStartTime;
+
         /**
          * Logical timestamp used to track which lifecycle of the frame io was
          * scheduled during. If a task is scheduled and then freed this can be
@@ -217,7 +295,9 @@ class MultiFileStorage : public BackupStorage {
                      size_t writeRateLimit,
                      size_t maxNonVolatileBuffers,
                      const char* filePaths,
-                     int openFlags = 0);
+                     int openFlags = 0,
+                     IoEngine ioEngine = AIO,
+                     size_t journalSize = 0);
     ~MultiFileStorage();
 
     FrameRef open(bool sync);
@@ -249,6 +329,89 @@ class MultiFileStorage : public BackupStorage {
     enum { METADATA_SIZE = BLOCK_SIZE };
 
   PRIVATE:
+    /**
+     * When io_uring is in use, this task runs on the IO thread whenever
+     * requests are outstanding, to deliver their completions to frames.
+     */
+    class IoCompletionTask : public PriorityTask {
+      public:
+        explicit IoCompletionTask(MultiFileStorage* storage);
+        ~IoCompletionTask();
+        void performTask();
+
+        /// Storage whose #ring this task reaps.
+        MultiFileStorage* storage;
+
+        DISALLOW_COPY_AND_ASSIGN(IoCompletionTask);
+    };
+
+    /**
+     * Runs on the IO thread to write the appends waiting in #journalPending
+     * to the journal.
+     */
+    class JournalTask : public PriorityTask {
+      public:
+        explicit JournalTask(MultiFileStorage* storage);
+        ~JournalTask();
+        void performTask();
+
+        /// Storage whose journal this task writes.
+        MultiFileStorage* storage;
+
+        DISALLOW_COPY_AND_ASSIGN(JournalTask);
+    };
+
+    /**
+     * Starts each record in the journal. It is followed by the record's
+     * data and then by a copy of the frame's metadata block.
+     */
+    struct JournalRecordHeader {
+        /// Always JOURNAL_MAGIC; distinguishes the start of a record.
+        uint64_t magic;
+
+        /// Records are replayed in increasing order of sequence number.
+        uint64_t sequence;
+
+        /// Frame to which the record's data belongs.
+        uint64_t frameIndex;
+
+        /// Offset in the frame of the record's data (block aligned).
+        uint64_t offsetInFrame;
+
+        /// Bytes of data in the record (a multiple of BLOCK_SIZE).
+        uint64_t length;
+
+        /// Crc32C of the whole record, computed with this field zeroed.
+        uint32_t checksum;
+    } __attribute__((packed));
+    static_assert(sizeof(JournalRecordHeader) <= BLOCK_SIZE,
+                  "JournalRecordHeader doesn't fit in a single disk block");
+
+    /// Value of JournalRecordHeader::magic.
+    static const uint64_t JOURNAL_MAGIC = 0x6c6e72756f4a5352UL;
+
+    /**
+     * Offset in each frame's metadata block of the journal sequence stamp
+     * (see writeCompleted()); getMetadataSize() excludes these bytes when
+     * there is a journal.
+     */
+    enum { JOURNAL_STAMP_OFFSET = METADATA_SIZE - sizeof(uint64_t) };
+
+    /**
+     * Describes a record that the journal must retain until the frame it
+     * belongs to has been consolidated.
+     */
+    struct JournalExtent {
+        /// JournalRecordHeader::sequence for the record.
+        uint64_t sequence;
+
+        /// Position of the record (see #journalHead).
+        uint64_t start;
+
+        /// Frame to which the record belongs.
+        Frame* frame;
+    };
+
     size_t bytesInFramelet(size_t fileIndex) const;
     off_t offsetOfFramelet(size_t frameIndex) const;
     off_t offsetOfFrameMetadata(size_t frameIndex) const;
@@ -259,8 +422,21 @@ class MultiFileStorage : public BackupStorage {
                        size_t frameIndex, off_t offsetInFrame,
                        void* metadataBuf, size_t metadataCount);
 
+    void appendToJournal(Frame::Lock& lock, Frame* frame);
+    bool flushJournal(Frame::Lock& lock);
+    uint64_t getJournalTail() const;
+    off_t offsetOfJournal() const;
+    void reapIoCompletions(Frame::Lock& lock, bool wait);
+    void reclaimJournal();
+    void replayJournal();
+    void requestConsolidation(Frame::Lock& lock, uint64_t bytes);
     void reserveSpace(int fd);
+    void submitRead(Frame::Lock& lock, Frame* frame);
+    void submitWrite(Frame::Lock& lock, Frame* frame, void* buf, size_t count,
+                     off_t offsetInFrame, void* metadataBuf,
+                     size_t metadataCount);
     Tub<Superblock> tryLoadSuperblock(uint32_t superblockFrame);
+    void waitForIoCapacity(Frame::Lock& lock, uint32_t requests);
 
     /// Protects concurrent operations on storage and all of its frames.
     std::mutex mutex;
@@ -273,6 +449,9 @@ class MultiFileStorage : public BackupStorage {
      */
     PriorityTaskQueue ioQueue;
 
+    /// Delivers completions from #ring; see IoCompletionTask.
+    IoCompletionTask ioCompletionTask;
+
     /// Holds the most recent image of the superblock.
     Superblock superblock;
 
@@ -348,6 +527,75 @@ class MultiFileStorage : public BackupStorage {
      */
     std::stack<void*, std::vector<void*>> buffers;
 
+    /**
+     * If constructed, frames are read and written through this io_uring
+     * (see IoEngine); otherwise POSIX AIO is used. Only the IO thread
+     * issues requests and waits for completions; other methods are only
+     * invoked with #mutex held.
+     */
+    Tub<FileIoUring> ring;
+
+    /**
+     * Number of frames with reads (or writes) outstanding on #ring, and
+     * the Cycles::rdtsc() time when that number last became nonzero. Used
+     * to compute the time storage was active for PerfStats.
+     */
+    uint32_t framesReading;
+    uint64_t readingSince;
+    uint32_t framesWriting;
+    uint64_t writingSince;
+
+    /**
+     * Bytes in the journal, which occupies the end of the first storage
+     * file, after the frames. If 0, there is no journal and appends are
+     * written to their frames. Otherwise appends to all frames are written
+     * together in large sequential writes to the journal, and each frame's
+     * data is written to the frame itself (consolidated) when the frame is
+     * closed or when the journal needs the space. Any records left in the
+     * journal are replayed when the storage is next opened.
+     */
+    const size_t journalSize;
+
+    /// Writes the appends waiting in #journalPending; see JournalTask.
+    JournalTask journalTask;
+
+    /**
+     * Frames with appends that haven't been written to the journal yet, in
+     * the order they were appended to (see Frame::journalPending; frames
+     * may also appear here after they stop waiting).
+     */
+    std::deque<Frame*> journalPending;
+
+    /// Records written to the journal that are still needed, oldest first.
+    std::deque<JournalExtent> journalExtents;
+
+    /**
+     * Position (a count of bytes written to the journal since it was
+     * opened, including skipped bytes at its end) at which the next record
+     * will be written; the offset in the journal is this modulo
+     * #journalSize.
+     */
+    uint64_t journalHead;
+
+    /// Sequence number for the next journal record.
+    uint64_t nextJournalSequence;
+
+    /**
+     * Records are assembled here before they are written to the journal;
+     * large enough for a record holding a whole replica.
+     */
+    Memory::unique_ptr_free journalBuffer;
+
+    /// Bytes in #journalBuffer.
+    const size_t journalBufferSize;
+
+    /**
+     * True while a thread is writing #journalBuffer to the journal (which
+     * is done without holding #mutex); other threads must not flush the
+     * journal in the meantime.
+     */
+    bool journalFlushing;
+
     DISALLOW_COPY_AND_ASSIGN(MultiFileStorage);
 };
 
@@ -15,6 +15,7 @@
 
 #include "TestUtil.h"
 #include "BackupMasterRecovery.h"
+#include "MockSyscall.h"
 #include "MultiFileStorage.h"
 #include "StringUtil.h"
 
@@ -669,6 +670,66 @@ TEST_F(MultiFileStorageTest, Frame_performRead) {
     EXPECT_TRUE(frame->buffer);
 }
 
+TEST_F(MultiFileStorageTest, Frame_performTaskIoUring) {
+    std::string twoFiles = std::string(filePath21) + "-ring," + filePath22 +
+            "-ring";
+    Tub<MultiFileStorage> storage;
+    storage.construct(segmentSize, segmentFrames, 0, segmentFrames,
+                      twoFiles.c_str(), O_DIRECT | O_SYNC,
+                      MultiFileStorage::IO_URING);
+    ASSERT_TRUE(storage->ring);
+    storage->ioQueue.halt();
+    Frame::testingSkipRealIo = false;
+    BackupStorage::FrameRef frameRef = storage->open(false);
+    Frame* frame = static_cast<Frame*>(frameRef.get());
+    Buffer source;
+    TestUtil::fillLargeBuffer(&source, segmentSize);
+    frame->append(source, 0, segmentSize, 0, test, testLength + 1);
+    frame->deschedule();
+
+    // The write is issued, but the frame isn't updated until it completes.
+    frame->performTask();
+    EXPECT_TRUE(frame->performingIo);
+    EXPECT_EQ(3u, frame->ioRequestsOutstanding);
+    EXPECT_EQ(0lu, frame->committedLength);
+    EXPECT_TRUE(storage->ioCompletionTask.isScheduled());
+    EXPECT_EQ(1u, storage->framesWriting);
+    EXPECT_TRUE(storage->ring->isRegistered(frame->buffer.get()));
+
+    // Nothing happens while the write is outstanding.
+    frame->performTask();
+    EXPECT_EQ(3u, frame->ioRequestsOutstanding);
+
+    while (frame->performingIo)
+        storage->ioCompletionTask.performTask();
+    EXPECT_EQ(0u, frame->ioRequestsOutstanding);
+    EXPECT_TRUE(frame->isSynced());
+    EXPECT_EQ(0u, storage->framesWriting);
+
+    // Force a read from disk.
+    {
+        Frame::Lock lock(storage->mutex);
+        frame->buffer.reset();
+        frame->loadRequested = true;
+    }
+    frame->performTask();
+    EXPECT_TRUE(frame->loadingBuffer);
+    EXPECT_FALSE(frame->buffer);
+    EXPECT_EQ(2u, frame->ioRequestsOutstanding);
+    while (frame->performingIo)
+        storage->ioCompletionTask.performTask();
+    EXPECT_FALSE(frame->loadingBuffer);
+    ASSERT_TRUE(frame->buffer);
+    EXPECT_EQ(0, memcmp(frame->load(), source.getRange(0, segmentSize),
+                        segmentSize));
+    EXPECT_STREQ(test, bytes(const_cast<void*>(frame->getMetadata())));
+
+    frameRef.reset();
+    storage.destroy();
+    unlink((std::string(filePath21) + "-ring").c_str());
+    unlink((std::string(filePath22) + "-ring").c_str());
+}
+
 TEST_F(MultiFileStorageTest, constructor) {
     struct stat s;
     stat(filePath1, &s);
@@ -676,6 +737,275 @@ TEST_F(MultiFileStorageTest, constructor) {
               uint32_t(s.st_size));
 }
 
+TEST_F(MultiFileStorageTest, constructor_ioUringUnavailable) {
+    MockSyscall sys;
+    sys.ioUringSetupErrno = ENOSYS;
+    Syscall* savedSyscall = FileIoUring::sys;
+    FileIoUring::sys = &sys;
+    TestLog::Enable _("MultiFileStorage");
+    MultiFileStorage storage(segmentSize, segmentFrames, 0, segmentFrames,
+                             filePath1, O_DIRECT | O_SYNC,
+                             MultiFileStorage::IO_URING);
+    FileIoUring::sys = savedSyscall;
+    EXPECT_FALSE(storage.ring);
+    EXPECT_TRUE(TestUtil::contains(TestLog::get(),
+            "Couldn't use io_uring for backup storage"));
+}
+
+TEST_F(MultiFileStorageTest, constructor_journalTooSmall) {
+    EXPECT_THROW(MultiFileStorage(segmentSize, segmentFrames, 0,
+                                  segmentFrames, filePath1, O_DIRECT | O_SYNC,
+                                  MultiFileStorage::AIO, segmentSize),
+                 BackupStorageException);
+}
+
+TEST_F(MultiFileStorageTest, appendToJournal_sync) {
+    std::string path = std::string(filePath1) + "-journal";
+    Tub<MultiFileStorage> storage;
+    storage.construct(segmentSize, segmentFrames, 0, segmentFrames,
+                      path.c_str(), O_DIRECT | O_SYNC, MultiFileStorage::AIO,
+                      8 * segmentSize);
+    storage->ioQueue.halt();
+    Frame::testingSkipRealIo = false;
+    BackupStorage::FrameRef frameRef = storage->open(true);
+    Frame* frame = static_cast<Frame*>(frameRef.get());
+
+    // The appending thread writes the journal itself.
+    frame->append(testSource, 0, testLength + 1, 0, test, testLength + 1);
+    EXPECT_TRUE(frame->isSynced());
+    EXPECT_FALSE(frame->isConsolidated());
+    EXPECT_FALSE(storage->journalTask.isScheduled());
+    EXPECT_EQ(3lu * BLOCK_SIZE, storage->journalHead);
+
+    // Frames marked for consolidation bypass the journal.
+    frame->consolidationRequested = true;
+    frame->append(testSource, 0, testLength + 1, BLOCK_SIZE, NULL, 0);
+    EXPECT_TRUE(frame->isConsolidated());
+    EXPECT_FALSE(frame->consolidationRequested);
+    EXPECT_EQ(3lu * BLOCK_SIZE, storage->journalHead);
+
+    frameRef.reset();
+    storage.destroy();
+    unlink(path.c_str());
+}
+
+TEST_F(MultiFileStorageTest, flushJournal) {
+    std::string path = std::string(filePath1) + "-journal";
+    Tub<MultiFileStorage> storage;
+    storage.construct(segmentSize, segmentFrames, 0, segmentFrames,
+                      path.c_str(), O_DIRECT | O_SYNC, MultiFileStorage::AIO,
+                      8 * segmentSize);
+    storage->ioQueue.halt();
+    Frame::testingSkipRealIo = false;
+    EXPECT_EQ(METADATA_SIZE - sizeof(uint64_t), storage->getMetadataSize());
+    struct stat s;
+    stat(path.c_str(), &s);
+    EXPECT_EQ(storage->offsetOfJournal() + 8 * segmentSize,
+              uint64_t(s.st_size));
+
+    BackupStorage::FrameRef frameRef1 = storage->open(false);
+    BackupStorage::FrameRef frameRef2 = storage->open(false);
+    Frame* frame1 = static_cast<Frame*>(frameRef1.get());
+    Frame* frame2 = static_cast<Frame*>(frameRef2.get());
+    frame1->append(testSource, 0, testLength + 1, 0, test, testLength + 1);
+    frame2->append(testSource, 0, testLength + 1, 0, test, testLength + 1);
+    EXPECT_FALSE(frame1->isScheduled());
+    EXPECT_TRUE(storage->journalTask.isScheduled());
+    EXPECT_EQ(2u, storage->journalPending.size());
+
+    // A single write covers both frames.
+    storage->journalTask.performTask();
+    EXPECT_TRUE(frame1->isSynced());
+    EXPECT_TRUE(frame2->isSynced());
+    EXPECT_FALSE(frame1->isConsolidated());
+    EXPECT_EQ(0u, storage->journalPending.size());
+    EXPECT_EQ(6lu * BLOCK_SIZE, storage->journalHead);
+    EXPECT_EQ(2u, storage->journalExtents.size());
+    EXPECT_EQ(2lu, frame2->journalSequence);
+
+    int fd = open(path.c_str(), O_RDONLY);
+    MultiFileStorage::JournalRecordHeader header;
+    EXPECT_EQ(ssize_t(sizeof(header)), pread(fd, &header, sizeof(header),
+            storage->offsetOfJournal() + 3 * BLOCK_SIZE));
+    EXPECT_EQ(MultiFileStorage::JOURNAL_MAGIC, header.magic);
+    EXPECT_EQ(2lu, header.sequence);
+    EXPECT_EQ(frame2->frameIndex, header.frameIndex);
+    EXPECT_EQ(0lu, header.offsetInFrame);
+    EXPECT_EQ(uint64_t(BLOCK_SIZE), header.length);
+
+    // Closing a frame consolidates it, freeing its journal space.
+    frame1->close();
+    EXPECT_TRUE(frame1->isScheduled());
+    frame1->performTask();
+    EXPECT_TRUE(frame1->isConsolidated());
+    EXPECT_FALSE(frame1->buffer);
+    uint64_t stamp = 0;
+    EXPECT_EQ(ssize_t(sizeof(stamp)), pread(fd, &stamp, sizeof(stamp),
+            storage->offsetOfFrameMetadata(frame1->frameIndex) +
+            MultiFileStorage::JOURNAL_STAMP_OFFSET));
+    EXPECT_EQ(3lu, stamp);
+    storage->reclaimJournal();
+    EXPECT_EQ(3lu * BLOCK_SIZE, storage->getJournalTail());
+    close(fd);
+
+    frameRef1.reset();
+    frameRef2.reset();
+    storage.destroy();
+    unlink(path.c_str());
+}
+
+TEST_F(MultiFileStorageTest, flushJournal_full) {
+    std::string path = std::string(filePath1) + "-journal";
+    Tub<MultiFileStorage> storage;
+    storage.construct(segmentSize, segmentFrames, 0, segmentFrames,
+                      path.c_str(), O_DIRECT | O_SYNC, MultiFileStorage::AIO,
+                      12 * BLOCK_SIZE);
+    storage->ioQueue.halt();
+    Frame::testingSkipRealIo = false;
+    Buffer source;
+    TestUtil::fillLargeBuffer(&source, segmentSize);
+    BackupStorage::FrameRef frameRefA = storage->open(false);
+    BackupStorage::FrameRef frameRefB = storage->open(false);
+    BackupStorage::FrameRef frameRefC = storage->open(false);
+    Frame* frameA = static_cast<Frame*>(frameRefA.get());
+    Frame* frameB = static_cast<Frame*>(frameRefB.get());
+    Frame* frameC = static_cast<Frame*>(frameRefC.get());
+
+    // Once the journal is more than half full, the oldest frames are
+    // consolidated.
+    frameA->append(source, 0, segmentSize, 0, test, testLength + 1);
+    storage->journalTask.performTask();
+    EXPECT_FALSE(frameA->consolidationRequested);
+    frameB->append(source, 0, segmentSize, 0, test, testLength + 1);
+    storage->journalTask.performTask();
+    EXPECT_EQ(12lu * BLOCK_SIZE, storage->journalHead);
+    EXPECT_TRUE(frameA->consolidationRequested);
+    EXPECT_TRUE(frameA->isScheduled());
+    EXPECT_FALSE(frameB->consolidationRequested);
+
+    // With no room in the journal, appends are written to the frame.
+    frameC->append(testSource, 0, testLength + 1, 0, test, testLength + 1);
+    storage->journalTask.performTask();
+    EXPECT_EQ(12lu * BLOCK_SIZE, storage->journalHead);
+    EXPECT_FALSE(frameC->isSynced());
+    EXPECT_TRUE(frameC->consolidationRequested);
+    EXPECT_TRUE(frameC->isScheduled());
+    frameC->performTask();
+    EXPECT_TRUE(frameC->isConsolidated());
+    EXPECT_FALSE(frameC->consolidationRequested);
+
+    // Space held by consolidated frames is reused.
+    frameA->performTask();
+    EXPECT_TRUE(frameA->isConsolidated());
+    frameC->append(testSource, 0, testLength + 1, BLOCK_SIZE, NULL, 0);
+    storage->journalTask.performTask();
+    EXPECT_TRUE(frameC->isSynced());
+    EXPECT_FALSE(frameC->isConsolidated());
+    EXPECT_EQ(6lu * BLOCK_SIZE, storage->getJournalTail());
+    EXPECT_EQ(16lu * BLOCK_SIZE, storage->journalHead);
+
+    frameRefA.reset();
+    frameRefB.reset();
+    frameRefC.reset();
+    storage.destroy();
+    unlink(path.c_str());
+}
+
+TEST_F(MultiFileStorageTest, replayJournal) {
+    std::string path = std::string(filePath1) + "-journal";
+    Tub<MultiFileStorage> storage;
+    storage.construct(segmentSize, segmentFrames, 0, segmentFrames,
+                      path.c_str(), O_DIRECT | O_SYNC, MultiFileStorage::AIO,
+                      8 * segmentSize);
+    storage->ioQueue.halt();
+    Frame::testingSkipRealIo = false;
+    BackupStorage::FrameRef frameRef = storage->open(false);
+    size_t frameIndex = static_cast<Frame*>(frameRef.get())->frameIndex;
+    SegmentCertificate certificate;
+    certificate.segmentLength = testLength + 1;
+    BackupReplicaMetadata metadata(certificate, 70, 80, segmentSize, 0,
+                                   false, false);
+    frameRef->append(testSource, 0, testLength + 1, 0, &metadata,
+                     sizeof(metadata));
+    storage->journalTask.performTask();
+    frameRef.reset();
+    storage.destroy();
+
+    TestLog::Enable _("replayJournal");
+    storage.construct(segmentSize, segmentFrames, 0, segmentFrames,
+                      path.c_str(), O_DIRECT | O_SYNC, MultiFileStorage::AIO,
+                      8 * segmentSize);
+    EXPECT_EQ("replayJournal: Replayed 1 of 1 record(s) found in the backup "
+              "journal", TestLog::get());
+    EXPECT_EQ(2lu, storage->nextJournalSequence);
+    std::vector<BackupStorage::FrameRef> frames = storage->loadAllMetadata();
+    const BackupReplicaMetadata* replayedMetadata =
+            static_cast<const BackupReplicaMetadata*>(
+                frames[frameIndex]->getMetadata());
+    EXPECT_TRUE(replayedMetadata->checkIntegrity());
+    EXPECT_EQ(70lu, replayedMetadata->logId);
+    EXPECT_STREQ(test, bytes(frames[frameIndex]->load()));
+    frames.clear();
+
+    // Records are invalidated once replayed.
+    TestLog::reset();
+    storage.destroy();
+    storage.construct(segmentSize, segmentFrames, 0, segmentFrames,
+                      path.c_str(), O_DIRECT | O_SYNC, MultiFileStorage::AIO,
+                      8 * segmentSize);
+    EXPECT_EQ("", TestLog::get());
+    EXPECT_EQ(2lu, storage->nextJournalSequence);
+
+    storage.destroy();
+    unlink(path.c_str());
+}
+
+TEST_F(MultiFileStorageTest, replayJournal_skipsConsolidatedRecords) {
+    std::string path = std::string(filePath1) + "-journal";
+    Tub<MultiFileStorage> storage;
+    storage.construct(segmentSize, segmentFrames, 0, segmentFrames,
+                      path.c_str(), O_DIRECT | O_SYNC, MultiFileStorage::AIO,
+                      8 * segmentSize);
+    storage->ioQueue.halt();
+    Frame::testingSkipRealIo = false;
+    BackupStorage::FrameRef frameRef = storage->open(false);
+    Frame* frame = static_cast<Frame*>(frameRef.get());
+    SegmentCertificate certificate;
+    certificate.segmentLength = testLength + 1;
+    BackupReplicaMetadata metadata(certificate, 70, 80, segmentSize, 0,
+                                   false, false);
+    frame->append(testSource, 0, testLength + 1, 0, &metadata,
+                  sizeof(metadata));
+    storage->journalTask.performTask();
+    frame->close();
+    frame->performTask();
+    EXPECT_TRUE(frame->isConsolidated());
+
+    // Make the data in the frame differ from the record, as if a later
+    // replica had been written to the frame without the journal.
+    int fd = open(path.c_str(), O_WRONLY);
+    EXPECT_EQ(4, pwrite(fd, "XXXX", 4,
+                        storage->offsetOfFramelet(frame->frameIndex)));
+    close(fd);
+    size_t frameIndex = frame->frameIndex;
+    frameRef.reset();
+    storage.destroy();
+
+    TestLog::Enable _("replayJournal");
+    storage.construct(segmentSize, segmentFrames, 0, segmentFrames,
+                      path.c_str(), O_DIRECT | O_SYNC, MultiFileStorage::AIO,
+                      8 * segmentSize);
+    EXPECT_EQ("replayJournal: Replayed 0 of 1 record(s) found in the backup "
+              "journal", TestLog::get());
+    EXPECT_EQ(2lu, storage->nextJournalSequence);
+    std::vector<BackupStorage::FrameRef> frames = storage->loadAllMetadata();
+    EXPECT_EQ("XXXX", string(bytes(frames[frameIndex]->load()), 4));
+    frames.clear();
+
+    storage.destroy();
+    unlink(path.c_str());
+}
+
 TEST_F(MultiFileStorageTest, openFails) {
     TestLog::Enable _;
     EXPECT_THROW(MultiFileStorage(segmentSize,
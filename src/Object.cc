@@ -14,12 +14,27 @@
  */
 
 #include "Common.h"
+#include "Compression.h"
 #include "Crc32C.h"
 #include "Object.h"
 #include "RamCloud.h"
 
 namespace RAMCloud {
 
+const KeyCount Object::VALUE_COMPRESSED;
+const KeyCount Object::MAX_KEY_COUNT;
+const uint32_t Object::MIN_COMPRESSIBLE_VALUE_LENGTH;
+
+/**
+ * Return the number of keys described by a KeyOffsets structure, ignoring
+ * the VALUE_COMPRESSED flag.
+ */
+static inline KeyCount
+countKeys(const KeyOffsets* keyOffsets)
+{
+    return static_cast<KeyCount>(keyOffsets->numKeys & Object::MAX_KEY_COUNT);
+}
+
 /**
  * Construct an Object in preparation for storing it in the log.
  * This form is used when the header information is available in
@@ -60,7 +75,8 @@ Object::Object(uint64_t tableId,
       keysAndValue(),
       keysAndValueBuffer(&keysAndValueBuffer),
       keysAndValueOffset(startDataOffset),
-      keyOffsets(NULL)
+      keyOffsets(NULL),
+      decompressedValue()
 {
     // compute the actual default value
     if (length == 0)
@@ -118,7 +134,8 @@ Object::Object(Key& key,
       // Since we are appending to buffer, the offset where keysAndValue
       // begins wil be the current size of the buffer.
       keysAndValueOffset(buffer.size()),
-      keyOffsets(NULL)
+      keyOffsets(NULL),
+      decompressedValue()
 {
     uint32_t primaryKeyInfoLength = KEY_INFO_LENGTH(1) +
                              key.getStringKeyLength();
@@ -166,7 +183,8 @@ Object::Object(Buffer& buffer, uint32_t offset, uint32_t length)
       keysAndValue(),
       keysAndValueBuffer(&buffer),
       keysAndValueOffset(offset + sizeof32(header)),
-      keyOffsets(NULL)
+      keyOffsets(NULL),
+      decompressedValue()
 {
     // If length is not specified, compute the length of keysAndValue
     if (length == 0)
@@ -199,7 +217,8 @@ Object::Object(const void* buffer, uint32_t length)
                    const uint8_t*>(buffer) + sizeof32(header))),
       keysAndValueBuffer(),
       keysAndValueOffset(0),
-      keyOffsets(NULL)
+      keyOffsets(NULL),
+      decompressedValue()
 {
 }
 
@@ -249,6 +268,18 @@ Object::assembleForLog(void* memBlock)
 void
 Object::appendValueToBuffer(Buffer* buffer)
 {
+    if (isValueCompressed()) {
+        uint32_t compressedLength, valueLength;
+        const void* compressed = getCompressedValue(&compressedLength,
+                                                    &valueLength);
+        void* value = buffer->alloc(valueLength);
+        if (compressed == NULL || !Compression::decompress(compressed,
+                compressedLength, value, valueLength)) {
+            throw FatalError(HERE, "Object has a corrupt compressed value");
+        }
+        return;
+    }
+
     uint32_t valueOffset;
     getValueOffset(&valueOffset);
 
@@ -265,6 +296,106 @@ Object::appendValueToBuffer(Buffer* buffer)
     buffer->append(ptr + valueOffset, getValueLength());
 }
 
+/**
+ * Replace this object's value with a compressed copy, if doing so saves
+ * space. The keys and the compressed value are appended to a buffer, and
+ * the object refers to that copy from then on, so the buffer must live as
+ * long as the object does. The object's checksum is not updated;
+ * assembleForLog() takes care of that.
+ *
+ * \param buffer
+ *      Buffer to which the new keys and value are appended.
+ * \return
+ *      True if the value was compressed. False if the value is already
+ *      compressed, is too short to be worth compressing, or didn't shrink,
+ *      in which case the object is left as it was.
+ */
+bool
+Object::compressValue(Buffer& buffer)
+{
+    if (isValueCompressed())
+        return false;
+
+    uint32_t valueOffset;
+    if (!getValueOffset(&valueOffset))
+        return false;
+    uint32_t valueLength = keysAndValueLength - valueOffset;
+    if (valueLength < MIN_COMPRESSIBLE_VALUE_LENGTH)
+        return false;
+
+    // Only keep the result if it's smaller, length field included.
+    const uint8_t* src = static_cast<const uint8_t*>(getKeysAndValue());
+    uint32_t capacity = valueLength - sizeof32(uint32_t) - 1;
+    uint32_t bufferLength = buffer.size();
+    uint8_t* dst = static_cast<uint8_t*>(buffer.alloc(
+            valueOffset + sizeof32(uint32_t) + capacity));
+    uint32_t compressedLength = Compression::compress(src + valueOffset,
+            valueLength, dst + valueOffset + sizeof32(uint32_t), capacity);
+    if (compressedLength == 0) {
+        buffer.truncate(bufferLength);
+        return false;
+    }
+
+    memcpy(dst, src, valueOffset);
+    dst[0] = static_cast<uint8_t>(dst[0] | VALUE_COMPRESSED);
+    memcpy(dst + valueOffset, &valueLength, sizeof32(uint32_t));
+    keysAndValueLength = valueOffset + sizeof32(uint32_t) + compressedLength;
+    buffer.truncate(bufferLength + keysAndValueLength);
+
+    keysAndValue = dst;
+    keysAndValueBuffer = &buffer;
+    keysAndValueOffset = bufferLength;
+    keyOffsets = NULL;
+    return true;
+}
+
+/**
+ * Undo compressValue(): append the keys and the decompressed value to a
+ * buffer, exactly as they would be for an object that was never compressed,
+ * and make this object refer to that copy. This is used before handing
+ * objects to clients, which don't understand compressed values. The buffer
+ * must live as long as the object does. The object's checksum is not
+ * updated; assembleForLog() takes care of that.
+ *
+ * \param buffer
+ *      Buffer to which the keys and decompressed value are appended.
+ *
+ * \throw FatalError
+ *      The compressed value is corrupt.
+ */
+void
+Object::decompressValue(Buffer& buffer)
+{
+    if (!isValueCompressed()) {
+        appendKeysAndValueToBuffer(buffer);
+        return;
+    }
+
+    uint32_t valueOffset;
+    uint32_t compressedLength, valueLength;
+    getValueOffset(&valueOffset);
+    const void* compressed = getCompressedValue(&compressedLength,
+                                                &valueLength);
+    if (compressed == NULL)
+        throw FatalError(HERE, "Object has a corrupt compressed value");
+    const void* keys = getKeysAndValue();
+
+    uint32_t bufferLength = buffer.size();
+    uint8_t* dst = static_cast<uint8_t*>(buffer.alloc(valueOffset +
+                                                      valueLength));
+    if (!Compression::decompress(compressed, compressedLength,
+                                 dst + valueOffset, valueLength))
+        throw FatalError(HERE, "Object has a corrupt compressed value");
+    memcpy(dst, keys, valueOffset);
+    dst[0] = static_cast<uint8_t>(dst[0] & ~VALUE_COMPRESSED);
+
+    keysAndValue = dst;
+    keysAndValueBuffer = &buffer;
+    keysAndValueOffset = bufferLength;
+    keysAndValueLength = valueOffset + valueLength;
+    keyOffsets = NULL;
+}
+
 /**
  * Append the cumulative key lengths, the keys and the value associated with
  * this object to a provided buffer. This is may be a virtual copy or it may
@@ -460,7 +591,7 @@ Object::fillKeyOffsets()
                                 keysAndValue);
         } else {
             KeyCount numKeys = *(keysAndValueBuffer->getOffset<KeyCount>(
-                                keysAndValueOffset));
+                                keysAndValueOffset)) & MAX_KEY_COUNT;
             keyOffsets = static_cast<const struct KeyOffsets *>(
                                 keysAndValueBuffer->getRange(
                                 keysAndValueOffset, KEY_INFO_LENGTH(numKeys)));
@@ -493,10 +624,10 @@ Object::getKey(KeyIndex keyIndex, KeyLength *keyLength)
     if (!fillKeyOffsets())
         return NULL;
 
-    if (keyIndex >= keyOffsets->numKeys)
+    if (keyIndex >= countKeys(keyOffsets))
         return NULL;
 
-    uint32_t firstKeyPos = KEY_INFO_LENGTH(keyOffsets->numKeys);
+    uint32_t firstKeyPos = KEY_INFO_LENGTH(countKeys(keyOffsets));
 
     uint32_t keyOffset; // 0 corresponds to the starting of keysAndValue
     uint32_t length;
@@ -542,7 +673,7 @@ Object::getKeyLength(KeyIndex keyIndex)
     if (!fillKeyOffsets())
         return 0;
 
-    if (keyIndex >= keyOffsets->numKeys)
+    if (keyIndex >= countKeys(keyOffsets))
         return 0;
 
     const CumulativeKeyLength *cumLengths = keyOffsets->cumulativeLengths;
@@ -589,7 +720,7 @@ Object::getKeyCount()
 {
     if (!fillKeyOffsets())
         return 0;
-    return keyOffsets->numKeys;
+    return countKeys(keyOffsets);
 }
 
 /**
@@ -610,13 +741,28 @@ Object::getValue(uint32_t *valueLength)
     if (!fillKeyOffsets())
         return NULL;
 
+    if (isValueCompressed()) {
+        uint32_t compressedLength, valueLen;
+        const void* compressed = getCompressedValue(&compressedLength,
+                                                    &valueLen);
+        if (compressed == NULL)
+            return NULL;
+        if (valueLength)
+            *valueLength = valueLen;
+        decompressedValue.resize(valueLen);
+        if (!Compression::decompress(compressed, compressedLength,
+                                     decompressedValue.data(), valueLen))
+            return NULL;
+        return decompressedValue.data();
+    }
+
     const CumulativeKeyLength *cumLengths = keyOffsets->cumulativeLengths;
+    KeyCount numKeys = countKeys(keyOffsets);
     // To calculate the starting position of the value, we have to account for
     // the number of keys, all the cumulative length values and total length
     // of all the keys. The total length of all the keys is given by the
     // cumulative length value at the last key position.
-    uint32_t valueOffset = KEY_INFO_LENGTH(keyOffsets->numKeys) +
-                           cumLengths[keyOffsets->numKeys - 1];
+    uint32_t valueOffset = KEY_INFO_LENGTH(numKeys) + cumLengths[numKeys - 1];
     uint32_t valueLen = keysAndValueLength - valueOffset;
 
     if (valueLength)
@@ -649,11 +795,12 @@ Object::getValueOffset(uint32_t *offset)
     if (!fillKeyOffsets())
         return false;
     const CumulativeKeyLength *cumLengths = keyOffsets->cumulativeLengths;
+    KeyCount numKeys = countKeys(keyOffsets);
     // To calculate the starting position of the value, we have to account for
     // the number of keys, all the cumulative length values and total length
-    // of all the keys.
-    uint32_t valueOffset = KEY_INFO_LENGTH(keyOffsets->numKeys) +
-                           cumLengths[keyOffsets->numKeys - 1];
+    // of all the keys. If the value is compressed, this is where its length
+    // field begins.
+    uint32_t valueOffset = KEY_INFO_LENGTH(numKeys) + cumLengths[numKeys - 1];
     // IMPORTANT:
     // here we do not add keysAndValueOffset because getValueOffset()
     // is called only after a readKeysAndValueRpc and it should be relative
@@ -664,17 +811,37 @@ Object::getValueOffset(uint32_t *offset)
 }
 
 /**
- * Obtain the length of the object's value
+ * Obtain the length of the object's value. If the value is compressed, this
+ * is the length it will have once decompressed.
  */
 uint32_t
 Object::getValueLength()
 {
+    if (isValueCompressed()) {
+        uint32_t compressedLength, valueLength;
+        if (getCompressedValue(&compressedLength, &valueLength) == NULL)
+            return 0;
+        return valueLength;
+    }
+
     uint32_t valueOffset;
     if (!getValueOffset(&valueOffset))
         return 0;
     return keysAndValueLength - valueOffset;
 }
 
+/**
+ * Return true if this object's value is stored compressed (see
+ * compressValue()).
+ */
+bool
+Object::isValueCompressed()
+{
+    if (!fillKeyOffsets())
+        return false;
+    return (keyOffsets->numKeys & VALUE_COMPRESSED) != 0;
+}
+
 /**
  * Obtain the length of the keys and the value associated with this object.
  */
@@ -764,6 +931,41 @@ Object::applyChecksum(Crc32C *crc)
     }
 }
 
+/**
+ * Locate the compressed form of this object's value.
+ *
+ * \param[out] compressedLength
+ *      The length of the compressed value, not counting its length field.
+ * \param[out] valueLength
+ *      The length of the value once decompressed.
+ * \return
+ *      A pointer to a contiguous copy of the compressed value, or NULL if the
+ *      object is malformed. The caller must have checked that the value is
+ *      compressed.
+ */
+const void*
+Object::getCompressedValue(uint32_t* compressedLength, uint32_t* valueLength)
+{
+    uint32_t valueOffset;
+    if (!getValueOffset(&valueOffset) ||
+            valueOffset + sizeof32(uint32_t) > keysAndValueLength)
+        return NULL;
+
+    const uint8_t* value;
+    uint32_t length = keysAndValueLength - valueOffset;
+    if (keysAndValue) {
+        value = static_cast<const uint8_t*>(keysAndValue) + valueOffset;
+    } else {
+        value = static_cast<const uint8_t*>(keysAndValueBuffer->getRange(
+                keysAndValueOffset + valueOffset, length));
+        if (value == NULL)
+            return NULL;
+    }
+    memcpy(valueLength, value, sizeof32(uint32_t));
+    *compressedLength = length - sizeof32(uint32_t);
+    return value + sizeof32(uint32_t);
+}
+
 /**
  * Compute the object's checksum and return it.
  */
@@ -78,6 +78,12 @@ struct KeyOffsets
  *
  * If Key_i is not present, CumulativeKeyLength_i = CumulativeKeyLength_i-1.
  * Consequently, Length_i = 0
+ *
+ * Masters may store an object's value compressed (see compressValue()). In
+ * that case the VALUE_COMPRESSED bit is set in "# keys" and the data is the
+ * length of the uncompressed value (32 bits) followed by the output of
+ * Compression::compress(). The methods that return the value decompress it
+ * transparently; compressed objects are never handed to clients.
  */
 class Object {
   public:
@@ -92,6 +98,9 @@ class Object {
     void assembleForLog(Buffer& buffer);
     void assembleForLog(void* buffer);
     void appendValueToBuffer(Buffer* buffer);
+    bool compressValue(Buffer& buffer);
+    void decompressValue(Buffer& buffer);
+    bool isValueCompressed();
     static void appendKeysAndValueToBuffer(
             uint64_t tableId, KeyCount numKeys, KeyInfo *keyList,
             const void* value, uint32_t valueLength, Buffer* request,
@@ -129,6 +138,15 @@ class Object {
     void setVersion(uint64_t version);
     void setTimestamp(uint32_t timestamp);
 
+    /// Set in the key count stored in the log if the object's value is
+    /// compressed. Objects may therefore have at most MAX_KEY_COUNT keys.
+    static const KeyCount VALUE_COMPRESSED = 0x80;
+    static const KeyCount MAX_KEY_COUNT = VALUE_COMPRESSED - 1;
+
+    /// compressValue() doesn't bother with values shorter than this; there
+    /// is too little redundancy in them to pay for the length field.
+    static const uint32_t MIN_COMPRESSIBLE_VALUE_LENGTH = 64;
+
 //  PRIVATE:
     /**
      * This data structure defines the format of an object header stored in a
@@ -186,6 +204,8 @@ class Object {
                                     uint32_t totalLength);
     uint32_t computeChecksum();
     void applyChecksum(Crc32C *crc);
+    const void* getCompressedValue(uint32_t* compressedLength,
+                                   uint32_t* valueLength);
 
 
     /// Copy of the object header that is in, or will be written to, the log.
@@ -214,6 +234,10 @@ class Object {
     /// getValueOffset()
     const KeyOffsets *keyOffsets;
 
+    /// Holds the decompressed value returned by getValue() for objects whose
+    /// value is compressed. Empty otherwise.
+    std::vector<uint8_t> decompressedValue;
+
     DISALLOW_COPY_AND_ASSIGN(Object);
 };
 
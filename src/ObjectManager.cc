@@ -86,20 +86,25 @@ ObjectManager::ObjectManager(Context* context, ServerId* serverId,
     , replicaManager(context, serverId,
                      config->master.numReplicas,
                      config->master.useMinCopysets,
-                     config->master.allowLocalBackup)
+                     config->master.allowLocalBackup,
+                     config->master.compressReplicas)
     , segmentManager(context, config, serverId,
                      allocator, replicaManager, masterTableMetadata)
     , log(context, config, this, &segmentManager, &replicaManager)
     , objectMap(config->master.hashTableBytes / HashTable::bytesPerCacheLine())
+    , writeFrequencies()
     , anyWrites(false)
     , hashTableBucketLocks()
     , lockTable(1000, log)
     , mutex("ObjectManager::mutex")
     , tombstoneRemover(this, &objectMap)
     , tombstoneProtectorCount(0)
+    , hashTableResizer(this, &objectMap)
 {
     for (size_t i = 0; i < arrayLength(hashTableBucketLocks); i++)
         hashTableBucketLocks[i].setName("hashTableBucketLock");
+    if (config->master.cleanerHotColdSegregation)
+        writeFrequencies.construct();
 }
 
 /**
@@ -198,6 +203,22 @@ ObjectManager::readHashes(const uint64_t tableId, uint32_t reqNumHashes,
     for (*respNumHashes = 0; *respNumHashes < reqNumHashes;
             *respNumHashes += 1) {
 
+        // At the start of each group of hashes, prefetch the buckets and
+        // candidate objects for the whole group so that their cache misses
+        // overlap instead of being taken one hash at a time.
+        if (*respNumHashes % PREFETCH_GROUP_SIZE == 0) {
+            KeyHash groupHashes[PREFETCH_GROUP_SIZE];
+            uint32_t groupSize = 0;
+            uint32_t offset = pKHashesOffset;
+            while (groupSize < PREFETCH_GROUP_SIZE &&
+                    *respNumHashes + groupSize < reqNumHashes) {
+                groupHashes[groupSize++] =
+                        *(pKHashes->getOffset<uint64_t>(offset));
+                offset += sizeof32(uint64_t);
+            }
+            prefetchObjects(groupHashes, groupSize);
+        }
+
         pKHash = *(pKHashes->getOffset<uint64_t>(pKHashesOffset));
         pKHashesOffset += sizeof32(pKHash);
 
@@ -205,7 +226,6 @@ ObjectManager::readHashes(const uint64_t tableId, uint32_t reqNumHashes,
         // doing the work here directly, since the abstraction breaks down
         // as multiple objects having the same primary key hash may match
         // the index key range.
-        objectMap.prefetchBucket(pKHash);
         HashTableBucketLock lock(*this, pKHash); // unlocks self on destruct
 
         // If the tablet doesn't exist in the NORMAL state,
@@ -237,17 +257,18 @@ ObjectManager::readHashes(const uint64_t tableId, uint32_t reqNumHashes,
             if (object.getPKHash() == pKHash) {
                 *numObjects += 1;
                 response->emplaceAppend<uint64_t>(object.getVersion());
-                response->emplaceAppend<uint32_t>(
-                        object.getKeysAndValueLength());
-                object.appendKeysAndValueToBuffer(*response);
+                uint32_t* length = response->emplaceAppend<uint32_t>(0);
+                object.decompressValue(*response);
+                *length = object.getKeysAndValueLength();
 
                 tabletManager->incrementReadCount(object.getTableId(),
                         object.getPKHash());
                 ++PerfStats::threadStats.readCount;
-                uint32_t valueLength = object.getValueLength();
-                PerfStats::threadStats.readObjectBytes += valueLength;
-                PerfStats::threadStats.readKeyBytes +=
-                        object.getKeysAndValueLength() - valueLength;
+                uint32_t valueOffset = 0;
+                object.getValueOffset(&valueOffset);
+                PerfStats::threadStats.readObjectBytes +=
+                        object.getValueLength();
+                PerfStats::threadStats.readKeyBytes += valueOffset;
             }
         }
 
@@ -295,6 +316,40 @@ ObjectManager::prefetchHashTableBucket(SegmentIterator* it)
     }
 }
 
+/**
+ * Prefetch the hash table buckets and candidate log entries for a group of
+ * keys that are about to be looked up (e.g. by a multiRead). This is done in
+ * two stages: first all of the buckets are prefetched, then each bucket is
+ * examined and the log entries it references are prefetched. Issuing all of
+ * the prefetches for a stage before waiting on any of them lets the cache
+ * misses for the whole group proceed in parallel, rather than paying two
+ * serialized misses (bucket, then object) per key.
+ *
+ * This is purely a performance hint: it does not change any state, and the
+ * subsequent lookups must still be done normally.
+ *
+ * \param keyHashes
+ *      Hashes of the keys that will be looked up shortly.
+ * \param numKeyHashes
+ *      Number of hashes in keyHashes. Should be no more than
+ *      PREFETCH_GROUP_SIZE; larger groups risk having their prefetched
+ *      lines evicted before they are used.
+ */
+void
+ObjectManager::prefetchObjects(const KeyHash* keyHashes, uint32_t numKeyHashes)
+{
+    for (uint32_t i = 0; i < numKeyHashes; i++)
+        objectMap.prefetchBucket(keyHashes[i]);
+
+    for (uint32_t i = 0; i < numKeyHashes; i++) {
+        uint64_t unused;
+        uint64_t bucket = HashTable::findBucketIndex(
+                objectMap.getNumBuckets(), keyHashes[i], &unused);
+        HashTableBucketLock lock(*this, bucket);
+        objectMap.prefetchCandidates(keyHashes[i]);
+    }
+}
+
 /**
  * Read an object previously written to this ObjectManager.
  *
@@ -349,17 +404,19 @@ ObjectManager::readObject(Key& key, Buffer* outBuffer,
     // Ensure the object being read is replicated durably.
     log.syncTo(reference);
 
+    // Values stored compressed are decompressed on the way out; clients
+    // never see them compressed.
     Object object(buffer);
     if (valueOnly) {
         object.appendValueToBuffer(outBuffer);
     } else {
-        object.appendKeysAndValueToBuffer(*outBuffer);
+        object.decompressValue(*outBuffer);
     }
     ++PerfStats::threadStats.readCount;
-    uint32_t valueLength = object.getValueLength();
-    PerfStats::threadStats.readObjectBytes += valueLength;
-    PerfStats::threadStats.readKeyBytes +=
-            object.getKeysAndValueLength() - valueLength;
+    uint32_t valueOffset = 0;
+    object.getValueOffset(&valueOffset);
+    PerfStats::threadStats.readObjectBytes += object.getValueLength();
+    PerfStats::threadStats.readKeyBytes += valueOffset;
 
     return STATUS_OK;
 }
@@ -483,6 +540,8 @@ ObjectManager::removeObject(Key& key, RejectRules* rejectRules,
     segmentManager.raiseSafeVersion(object.getVersion() + 1);
     log.free(reference);
     remove(lock, key);
+    if (writeFrequencies)
+        writeFrequencies->recordWrite(key.getHash());
     return STATUS_OK;
 }
 
@@ -1117,6 +1176,9 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it,
     metrics->master.tombstoneDiscardCount += tombstoneDiscardCount;
     metrics->master.safeVersionRecoveryCount += safeVersionRecoveryCount;
     metrics->master.safeVersionNonRecoveryCount += safeVersionNonRecoveryCount;
+
+    // Recovery can insert a large number of objects at once.
+    checkHashTableLoad();
 }
 
 /**
@@ -1179,6 +1241,11 @@ ObjectManager::writeObject(Object& newObject, RejectRules* rejectRules,
                 uint64_t* outVersion, Buffer* removedObjBuffer,
                 RpcResult* rpcResult, uint64_t* rpcResultPtr)
 {
+    // The top bit of the key count marks compressed values in the log, so
+    // incoming objects can't use it (see Object::MAX_KEY_COUNT).
+    if (newObject.isValueCompressed())
+        return STATUS_REQUEST_FORMAT_ERROR;
+
     uint16_t keyLength = 0;
     const void *keyString = newObject.getKey(0, &keyLength);
     Key key(newObject.getTableId(), keyString, keyLength);
@@ -1267,6 +1334,14 @@ ObjectManager::writeObject(Object& newObject, RejectRules* rejectRules,
     // record should exist if and only if new object is written.
     Log::AppendVector appends[2 + (rpcResult ? 1 : 0)];
 
+    // Note the sizes of the value and keys for the stats below before the
+    // value is (possibly) compressed.
+    uint32_t valueLength = newObject.getValueLength();
+    uint32_t keyBytes = newObject.getKeysAndValueLength() - valueLength;
+    Buffer compressedKeysAndValue;
+    if (shouldCompressValues(tablet.tableId))
+        newObject.compressValue(compressedKeysAndValue);
+
     newObject.assembleForLog(appends[0].buffer);
     appends[0].type = LOG_ENTRY_TYPE_OBJ;
 
@@ -1301,17 +1376,18 @@ ObjectManager::writeObject(Object& newObject, RejectRules* rejectRules,
         log.free(currentReference);
     } else {
         objectMap.insert(key.getHash(), appends[0].reference.toInteger());
+        checkHashTableLoad();
     }
 
     if (rpcResult && rpcResultPtr)
         *rpcResultPtr = appends[rpcResultIndex].reference.toInteger();
 
     tabletManager->incrementWriteCount(key);
+    if (writeFrequencies)
+        writeFrequencies->recordWrite(key.getHash());
     ++PerfStats::threadStats.writeCount;
-    uint32_t valueLength = newObject.getValueLength();
     PerfStats::threadStats.writeObjectBytes += valueLength;
-    PerfStats::threadStats.writeKeyBytes +=
-            newObject.getKeysAndValueLength() - valueLength;
+    PerfStats::threadStats.writeKeyBytes += keyBytes;
 
     TEST_LOG("object: %u bytes, version %lu",
         appends[0].buffer.size(), newObject.getVersion());
@@ -2166,6 +2242,8 @@ ObjectManager::flushEntriesToLog(Buffer *logBuffer, uint32_t& numEntries)
             }
 
             tabletManager->incrementWriteCount(key);
+            if (writeFrequencies)
+                writeFrequencies->recordWrite(key.getHash());
             TableStats::increment(masterTableMetadata,
                                   tableId,
                                   entryLength, 1);
@@ -2198,6 +2276,8 @@ ObjectManager::flushEntriesToLog(Buffer *logBuffer, uint32_t& numEntries)
             }
 
             tabletManager->incrementWriteCount(key);
+            if (writeFrequencies)
+                writeFrequencies->recordWrite(key.getHash());
             TableStats::increment(masterTableMetadata,
                                   tableId,
                                   entryLength, 1);
@@ -2401,6 +2481,27 @@ ObjectManager::getTimestamp(LogEntryType type, Buffer& buffer)
         return 0;
 }
 
+/**
+ * Tell the log cleaner whether an entry it is about to relocate is likely
+ * to be overwritten soon. Only objects can be hot: an object is hot if its
+ * key has been written frequently of late, according to #writeFrequencies.
+ * All other entry types are considered cold.
+ *
+ * \param type
+ *      Type of the entry being queried.
+ * \param buffer
+ *      Buffer pointing to the entry in the log being queried.
+ */
+bool
+ObjectManager::isHot(LogEntryType type, Buffer& buffer)
+{
+    if (!writeFrequencies || type != LOG_ENTRY_TYPE_OBJ)
+        return false;
+
+    Key key(type, buffer);
+    return writeFrequencies->isHot(key.getHash());
+}
+
 /**
  * Relocate and update metadata for an object, tombstone, etc. that is being
  * cleaned. The cleaner invokes this method for every entry it comes across
@@ -2487,6 +2588,79 @@ ObjectManager::TombstoneRemover::handleTimerEvent()
     start(0);
 }
 
+/**
+ * Construct the background task that grows #objectMap.
+ *
+ * \param objectManager
+ *      The instance of ObjectManager that owns the #objectMap.
+ * \param objectMap
+ *      The HashTable that will be grown.
+ */
+ObjectManager::HashTableResizer::HashTableResizer(
+                ObjectManager* objectManager,
+                HashTable* objectMap)
+    : WorkerTimer(objectManager->context->dispatch)
+    , objectManager(objectManager)
+    , objectMap(objectMap)
+    , requested(0)
+{
+}
+
+/**
+ * Arrange for the hash table to be doubled in size, unless a resize has
+ * already been requested. Cheap enough to call from the write path.
+ */
+void
+ObjectManager::HashTableResizer::requestResize()
+{
+    if (requested.load() != 0 || requested.exchange(1) != 0)
+        return;
+    start(0);
+}
+
+/**
+ * Allocate the larger table (the first time we are invoked for a given
+ * resize), migrate a few buckets into it, and then reschedule ourselves so
+ * we don't lock out other WorkerTimers for a long time. Once all buckets
+ * have moved, briefly take every bucket lock to switch over to the new
+ * table.
+ */
+void
+ObjectManager::HashTableResizer::handleTimerEvent()
+{
+    if (!objectMap->isResizing())
+        objectMap->startResize();
+
+    for (int i = 0; i < 100; i++) {
+        uint64_t bucket = objectMap->getSplitIndex();
+        if (bucket >= objectMap->getNumBuckets()) {
+            UnnamedSpinLock* locks = objectManager->hashTableBucketLocks;
+            uint32_t numLocks =
+                    arrayLength(objectManager->hashTableBucketLocks);
+            for (uint32_t j = 0; j < numLocks; j++)
+                locks[j].lock();
+            objectMap->finishResize();
+            for (uint32_t j = 0; j < numLocks; j++)
+                locks[j].unlock();
+            requested = 0;
+
+            // Inserts during the resize may already have pushed the new
+            // table over the limit.
+            objectManager->checkHashTableLoad();
+            return;
+        }
+
+        HashTableBucketLock lock(*objectManager, bucket);
+        objectMap->migrateBucket(bucket, getKeyHashForReference,
+                                 objectManager);
+    }
+
+    // If we get here, it means that we haven't finished migrating the entire
+    // hash table. Reschedule ourselves to run again, after any other
+    // WorkerTimers that may be ready.
+    start(0);
+}
+
 /**
  * Constructor for TombstoneProtectors. Make sure the tombstone
  * remover isn't running.
@@ -2514,6 +2688,63 @@ ObjectManager::TombstoneProtector::~TombstoneProtector()
     }
 }
 
+/**
+ * Start growing #objectMap in the background if it has become more full
+ * than the configured maximum load factor. Resizing relies on every bucket
+ * of the old table and both buckets it splits into being covered by the
+ * same HashTableBucketLock, so tables with fewer buckets than there are
+ * locks are never grown.
+ */
+void
+ObjectManager::checkHashTableLoad()
+{
+    double maxLoadFactor = config->master.hashTableMaxLoadFactor;
+    if (expect_true(maxLoadFactor <= 0 ||
+                    objectMap.getLoadFactor() <= maxLoadFactor)) {
+        return;
+    }
+    if (objectMap.isResizing() ||
+            objectMap.getNumBuckets() < arrayLength(hashTableBucketLocks)) {
+        return;
+    }
+    hashTableResizer.requestResize();
+}
+
+/**
+ * Fill in statistics about #objectMap for a GET_SERVER_STATISTICS request.
+ *
+ * \param[out] stats
+ *      Protocol buffer to fill in.
+ */
+void
+ObjectManager::getHashTableStatistics(ProtoBuf::HashTableStatistics* stats)
+{
+    objectMap.getStatistics(stats);
+}
+
+/**
+ * HashTable::KeyHashFunction used when migrating buckets during a resize:
+ * recover the full hash of the key for an object or tombstone stored in
+ * the log.
+ *
+ * \param reference
+ *      Log reference stored in #objectMap.
+ * \param cookie
+ *      The ObjectManager that owns the log.
+ * \return
+ *      The KeyHash of the entry's key.
+ */
+KeyHash
+ObjectManager::getKeyHashForReference(uint64_t reference, void* cookie)
+{
+    ObjectManager* objectManager = static_cast<ObjectManager*>(cookie);
+    Buffer buffer;
+    LogEntryType type = objectManager->log.getEntry(
+            Log::Reference(reference), buffer);
+    Key key(type, buffer);
+    return key.getHash();
+}
+
 /**
  * Produce a human-readable description of the contents of a segment.
  * Intended primarily for use in unit tests.
@@ -2953,12 +3184,33 @@ ObjectManager::relocateObject(Buffer& oldBuffer, Log::Reference oldReference,
             continue;
         }
 
+        // Objects that outlive a trip through the cleaner are likely to
+        // stick around, so this is a good time to compress the values of
+        // any that were written uncompressed (e.g. before compression was
+        // turned on for their table, or by a transaction).
+        Buffer compressedKeysAndValue;
+        Buffer compressedObject;
+        Buffer* newBuffer = &oldBuffer;
+        if (shouldCompressValues(key.getTableId())) {
+            Object object(oldBuffer);
+            if (object.compressValue(compressedKeysAndValue)) {
+                object.assembleForLog(compressedObject);
+                newBuffer = &compressedObject;
+            }
+        }
+
         // Try to relocate this live object. If we fail, just return. The
         // cleaner will allocate more memory and retry.
-        if (!relocator.append(LOG_ENTRY_TYPE_OBJ, oldBuffer))
+        if (!relocator.append(LOG_ENTRY_TYPE_OBJ, *newBuffer))
             return;
 
         candidates.setReference(relocator.getNewReference().toInteger());
+        if (newBuffer != &oldBuffer) {
+            TableStats::decrement(masterTableMetadata,
+                                  key.getTableId(),
+                                  oldBuffer.size() - newBuffer->size(),
+                                  0);
+        }
         return;
     }
 
@@ -3294,4 +3546,18 @@ ObjectManager::replace(HashTableBucketLock& lock, Key& key,
     return false;
 }
 
+/**
+ * Return true if values written to the given table should be compressed in
+ * the log (see the compressedTables runtime option).
+ *
+ * \param tableId
+ *      Table whose objects are being written or relocated.
+ */
+bool
+ObjectManager::shouldCompressValues(uint64_t tableId)
+{
+    MasterTableMetadata::Entry* entry = masterTableMetadata->find(tableId);
+    return entry != NULL && entry->compressValues;
+}
+
 } //enamespace RAMCloud
@@ -38,6 +38,7 @@
 #include "MasterTableMetadata.h"
 #include "UnackedRpcResults.h"
 #include "LockTable.h"
+#include "WriteFrequencyTracker.h"
 
 namespace RAMCloud {
 
@@ -57,6 +58,13 @@ namespace RAMCloud {
 class ObjectManager : public LogEntryHandlers,
                       public AbstractLog::ReferenceFreer {
   public:
+    /**
+     * Maximum number of keys whose hash table buckets and log entries are
+     * prefetched together by #prefetchObjects(). Large enough to overlap
+     * many cache misses, yet small enough that the prefetched lines are
+     * still in cache by the time the keys are actually looked up.
+     */
+    static const uint32_t PREFETCH_GROUP_SIZE = 16;
 
     ObjectManager(Context* context, ServerId* serverId,
                 const ServerConfig* config,
@@ -74,6 +82,7 @@ class ObjectManager : public LogEntryHandlers,
                 uint32_t maxLength, Buffer* response, uint32_t* respNumHashes,
                 uint32_t* numObjects);
     void prefetchHashTableBucket(SegmentIterator* it);
+    void prefetchObjects(const KeyHash* keyHashes, uint32_t numKeyHashes);
     Status readObject(Key& key, Buffer* outBuffer,
                 RejectRules* rejectRules, uint64_t* outVersion,
                 bool valueOnly = false);
@@ -115,10 +124,11 @@ class ObjectManager : public LogEntryHandlers,
     Status writeTombstone(Key& key, Buffer *logBuffer);
 
     /**
-     * The following two methods are used by the log cleaner. They aren't
+     * The following three methods are used by the log cleaner. They aren't
      * intended to be called from any other modules.
      */
     uint32_t getTimestamp(LogEntryType type, Buffer& buffer);
+    bool isHot(LogEntryType type, Buffer& buffer);
     void relocate(LogEntryType type, Buffer& oldBuffer,
                 Log::Reference oldReference, LogEntryRelocator& relocator);
 
@@ -133,6 +143,7 @@ class ObjectManager : public LogEntryHandlers,
     Log* getLog() { return &log; }
     ReplicaManager* getReplicaManager() { return &replicaManager; }
     HashTable* getObjectMap() { return &objectMap; }
+    void getHashTableStatistics(ProtoBuf::HashTableStatistics* stats);
 
     /**
      * An object of this class must be held by any activity that places
@@ -274,7 +285,38 @@ class ObjectManager : public LogEntryHandlers,
         DISALLOW_COPY_AND_ASSIGN(TombstoneRemover);
     };
 
+    /**
+     * This object executes in the background (as a WorkerTimer) to double
+     * the size of #objectMap once its load factor exceeds the configured
+     * maximum. Buckets are migrated a few at a time, each under its own
+     * HashTableBucketLock, so normal operations continue while the table
+     * grows.
+     */
+    class HashTableResizer : public WorkerTimer {
+      public:
+        HashTableResizer(ObjectManager* objectManager,
+                         HashTable* objectMap);
+        void handleTimerEvent();
+        void requestResize();
+
+      PRIVATE:
+        /// The ObjectManager that owns the hash table and its bucket locks.
+        ObjectManager* objectManager;
+
+        /// The hash table to be grown.
+        HashTable* objectMap;
+
+        /// Non-zero if a resize has been requested and has not completed
+        /// yet. Used to avoid restarting the timer on every insert while
+        /// the table is above its maximum load factor.
+        Atomic<int> requested;
+
+        DISALLOW_COPY_AND_ASSIGN(HashTableResizer);
+    };
+
+    void checkHashTableLoad();
     static string dumpSegment(Segment* segment);
+    static KeyHash getKeyHashForReference(uint64_t reference, void* cookie);
     uint32_t getObjectTimestamp(Buffer& buffer);
     uint32_t getTombstoneTimestamp(Buffer& buffer);
     uint32_t getTxDecisionRecordTimestamp(Buffer& buffer);
@@ -302,6 +344,7 @@ class ObjectManager : public LogEntryHandlers,
     void relocateTxDecisionRecord(
             Buffer& oldBuffer, LogEntryRelocator& relocator);
     bool replace(HashTableBucketLock& lock, Key& key, Log::Reference reference);
+    bool shouldCompressValues(uint64_t tableId);
 
     /**
      * Shared RAMCloud information.
@@ -378,6 +421,14 @@ class ObjectManager : public LogEntryHandlers,
      */
     HashTable objectMap;
 
+    /**
+     * Approximate recent write counts per key, used to tell the log cleaner
+     * which objects are likely to be overwritten soon so that it can keep
+     * them apart from colder data. Only constructed if the cleaner has been
+     * configured to segregate hot and cold entries.
+     */
+    Tub<WriteFrequencyTracker> writeFrequencies;
+
     /**
      * Used to identify the first write request, so that we can initialize
      * connections to all backups at that time (this is a temporary kludge
@@ -416,6 +467,12 @@ class ObjectManager : public LogEntryHandlers,
      */
     int tombstoneProtectorCount;
 
+    /**
+     * Grows #objectMap in the background when it becomes too full. Only
+     * used if config->master.hashTableMaxLoadFactor is non-zero.
+     */
+    HashTableResizer hashTableResizer;
+
     friend class CleanerCompactionBenchmark;
     friend class ObjectManagerBenchmark;
 
@@ -102,6 +102,78 @@ class ObjectManagerBenchmark {
         (*stopCount)++;
     }
 
+    static void
+    writerThreadEntry(ObjectManager* objectManager,
+                      uint32_t numWrites,
+                      uint64_t firstKey,
+                      uint32_t dataBytes,
+                      std::atomic<uint32_t>* startFlag,
+                      std::atomic<uint32_t>* stopCount)
+    {
+        while (*startFlag == 0) {
+            // wait until master thread releases us
+        }
+
+        char objectData[dataBytes];
+        memset(objectData, 'x', dataBytes);
+        for (uint32_t i = 0; i < numWrites; i++) {
+            uint64_t keyInt = firstKey + i;
+            Key key(0, &keyInt, sizeof(keyInt));
+            Buffer dataBuffer;
+            Object object(key, objectData, dataBytes, 0, 0, dataBuffer);
+            Status status = objectManager->writeObject(object, NULL, NULL);
+            if (status != STATUS_OK) {
+                fprintf(stderr, "Failed to write object! Out of memory?\n");
+                exit(1);
+            }
+        }
+
+        (*stopCount)++;
+    }
+
+    /**
+     * Measure the aggregate rate at which 'numThreads' threads can write
+     * new objects of size 'dataBytes' into the log concurrently. Each thread
+     * writes its own disjoint range of keys, so the only shared state the
+     * threads contend on is the log head (and the hash table buckets).
+     */
+    double
+    runWrites(uint32_t numWrites, uint32_t dataBytes, uint32_t numThreads)
+    {
+        tabletManager.addTablet(0, 0, ~0UL, TabletManager::NORMAL);
+
+        std::atomic<uint32_t> startFlag(0);
+        std::atomic<uint32_t> stopCount(0);
+        std::thread* threads[numThreads];
+        for (uint32_t i = 0; i < numThreads; i++) {
+            threads[i] = new std::thread(writerThreadEntry,
+                                         objectManager,
+                                         numWrites,
+                                         uint64_t(i) * numWrites,
+                                         dataBytes,
+                                         &startFlag,
+                                         &stopCount);
+        }
+
+        usleep(1000);
+
+        uint64_t start = Cycles::rdtsc();
+        startFlag = 1;
+        while (stopCount != numThreads) {
+            // sleep just a wink.
+            usleep(10000);
+        }
+        uint64_t stop = Cycles::rdtsc();
+
+        for (uint32_t i = 0; i < numThreads; i++) {
+            threads[i]->join();
+            delete threads[i];
+        }
+
+        return static_cast<double>(numWrites * numThreads /
+                                   Cycles::toSeconds(stop - start));
+    }
+
     double
     run(uint32_t numSegments, uint32_t dataBytes, uint32_t numThreads)
     {
@@ -167,11 +239,34 @@ class ObjectManagerBenchmark {
 }  // namespace RAMCloud
 
 int
-main()
+main(int argc, char* argv[])
 {
     uint32_t numSegments = 600 / 8; // = 72.
     uint32_t threads[] = { 1, 2, 3, 4, 6, 8, 12, 16, 20, 24, 28, 32, 0 };
 
+    if (argc > 1 && strcmp(argv[1], "write") == 0) {
+        // Each thread writes this many distinct objects; at 32 threads this
+        // comes to roughly 500 MB of log, well within the 2 GB configured.
+        const uint32_t numWrites = 100000;
+
+        printf("========= 100-byte Object Writes ===========\n");
+        double oneThreadRate = 0;
+        for (int i = 0; threads[i] != 0; i++) {
+            RAMCloud::ObjectManagerBenchmark omb("2048", "10%");
+            double writesPerSec = omb.runWrites(numWrites, 100, threads[i]);
+            if (i == 0)
+                oneThreadRate = writesPerSec;
+            printf(" %u thread(s): %.2f writes/s, %.3f us/write, "
+                "ratio: %.2fx (%.2f%% of optimal)\n",
+                threads[i],
+                writesPerSec,
+                1.0e6 / writesPerSec * threads[i],
+                writesPerSec / oneThreadRate,
+                (writesPerSec / oneThreadRate) / threads[i] * 100);
+        }
+        return 0;
+    }
+
     printf("============ 100-byte Objects ==============\n");
     double oneThreadRate = 0;
     for (int i = 0; threads[i] != 0; i++) {
@@ -1639,6 +1639,47 @@ TEST_F(ObjectManagerTest, writeObject) {
     objectManager.getLog()->totalLiveBytes = original;
 }
 
+TEST_F(ObjectManagerTest, writeObject_compressedTable) {
+    tabletManager.addTablet(1, 0, ~0UL, TabletManager::NORMAL);
+    masterTableMetadata.findOrCreate(1)->compressValues = true;
+    Key key(1, "1", 1);
+    string value(1000, 'v');
+    Buffer buffer;
+    Object obj(key, value.data(), 1000, 0, 0, buffer);
+    EXPECT_EQ(STATUS_OK, objectManager.writeObject(obj, 0, 0));
+
+    // The value is compressed in the log...
+    LogEntryType type;
+    Buffer logBuffer;
+    {
+        ObjectManager::HashTableBucketLock lock(objectManager, key);
+        EXPECT_TRUE(objectManager.lookup(lock, key, type, logBuffer, 0, 0));
+    }
+    Object inLog(logBuffer);
+    EXPECT_TRUE(inLog.isValueCompressed());
+    EXPECT_TRUE(inLog.checkIntegrity());
+    EXPECT_LT(logBuffer.size(), 100U);
+
+    // ...but not when it's read.
+    Buffer response;
+    EXPECT_EQ(STATUS_OK, objectManager.readObject(key, &response, 0, 0,
+                                                  true));
+    EXPECT_EQ(value, TestUtil::toString(&response));
+    response.reset();
+    EXPECT_EQ(STATUS_OK, objectManager.readObject(key, &response, 0, 0));
+    Object object(1, 0, 0, response);
+    EXPECT_FALSE(object.isValueCompressed());
+    EXPECT_EQ(1000U, object.getValueLength());
+
+    // Objects can't claim to be compressed already.
+    Buffer buffer2;
+    Object obj2(key, value.data(), 1000, 0, 0, buffer2);
+    Buffer compressed;
+    EXPECT_TRUE(obj2.compressValue(compressed));
+    EXPECT_EQ(STATUS_REQUEST_FORMAT_ERROR,
+              objectManager.writeObject(obj2, 0, 0));
+}
+
 TEST_F(ObjectManagerTest, writeObject_returnRemovedObj) {
     tabletManager.addTablet(1, 0, ~0UL, TabletManager::NORMAL);
     Key key(1, "a", 1);
@@ -2437,6 +2478,41 @@ TEST_F(ObjectManagerTest, getTable) {
     EXPECT_FALSE(tabletManager.getTablet(key2, 0));
 }
 
+TEST_F(ObjectManagerTest, isHot) {
+    Key key(0, "key0", 4);
+    Buffer value;
+    Object obj(key, "item0", 5, 0, 0, value);
+    objectManager.writeObject(obj, NULL, NULL);
+
+    LogEntryType type;
+    Buffer buffer;
+    {
+        ObjectManager::HashTableBucketLock lock(objectManager, key);
+        EXPECT_TRUE(objectManager.lookup(lock, key, type, buffer, 0, 0));
+    }
+
+    // Writes aren't tracked unless hot/cold segregation is enabled.
+    EXPECT_FALSE(objectManager.writeFrequencies);
+    EXPECT_FALSE(objectManager.isHot(type, buffer));
+
+    objectManager.writeFrequencies.construct(1024, 2);
+    objectManager.writeObject(obj, NULL, NULL);
+    EXPECT_FALSE(objectManager.isHot(type, buffer));
+    objectManager.writeObject(obj, NULL, NULL);
+    EXPECT_TRUE(objectManager.isHot(type, buffer));
+
+    // Only objects can be hot.
+    EXPECT_FALSE(objectManager.isHot(LOG_ENTRY_TYPE_OBJTOMB, buffer));
+
+    // Deletes count as writes, too.
+    Key otherKey(0, "key1", 4);
+    Object other(otherKey, "item1", 5, 0, 0, value);
+    objectManager.writeObject(other, NULL, NULL);
+    objectManager.removeObject(otherKey, NULL, NULL);
+    EXPECT_EQ(2U, objectManager.writeFrequencies->getEstimate(
+            otherKey.getHash()));
+}
+
 TEST_F(ObjectManagerTest, relocateObject_objectAlive) {
     Key key(0, "key0", 4);
 
@@ -2501,6 +2577,46 @@ TEST_F(ObjectManagerTest, relocateObject_objectAlive) {
               oldBuffer.getStart<uint8_t>());
 }
 
+TEST_F(ObjectManagerTest, relocateObject_compress) {
+    Key key(0, "key0", 4);
+    string value(1000, 'v');
+    Buffer valueBuffer;
+    Object obj(key, value.data(), 1000, 0, 0, valueBuffer);
+    objectManager.writeObject(obj, NULL, NULL);
+    EXPECT_EQ("found=true tableId=0 byteCount=1031 recordCount=1"
+              , verifyMetadata(0));
+    masterTableMetadata.find(0)->compressValues = true;
+
+    LogEntryType oldType;
+    Buffer oldBuffer;
+    Log::Reference oldReference;
+    {
+        ObjectManager::HashTableBucketLock lock(objectManager, key);
+        EXPECT_TRUE(objectManager.lookup(lock, key, oldType, oldBuffer, 0,
+                                         &oldReference));
+    }
+    EXPECT_FALSE(Object(oldBuffer).isValueCompressed());
+
+    LogEntryRelocator relocator(
+        objectManager.segmentManager.getHeadSegment(), 2000);
+    objectManager.relocate(LOG_ENTRY_TYPE_OBJ, oldBuffer,
+                           oldReference, relocator);
+    EXPECT_TRUE(relocator.didAppend);
+
+    LogEntryType newType;
+    Buffer newBuffer;
+    {
+        ObjectManager::HashTableBucketLock lock(objectManager, key);
+        EXPECT_TRUE(objectManager.lookup(lock, key, newType, newBuffer, 0,
+                                         0));
+    }
+    Object relocated(newBuffer);
+    EXPECT_TRUE(relocated.isValueCompressed());
+    EXPECT_TRUE(relocated.checkIntegrity());
+    EXPECT_EQ(format("found=true tableId=0 byteCount=%u recordCount=1",
+                     newBuffer.size()), verifyMetadata(0));
+}
+
 TEST_F(ObjectManagerTest, relocateObject_objectDeleted) {
     Key key(0, "key0", 4);
 
@@ -482,6 +482,96 @@ TEST_F(ObjectTest, appendValueToBuffer) {
     }
 }
 
+TEST_F(ObjectTest, compressValue) {
+    Key key(57, "key", 3);
+    string value;
+    for (int i = 0; i < 20; i++)
+        value += "compressible ";
+    uint32_t valueLength = downCast<uint32_t>(value.size());
+    Buffer objectBuffer;
+    Object object(key, value.data(), valueLength, 75, 723, objectBuffer);
+    uint32_t originalLength = object.getKeysAndValueLength();
+
+    Buffer compressed;
+    EXPECT_TRUE(object.compressValue(compressed));
+    EXPECT_TRUE(object.isValueCompressed());
+    EXPECT_FALSE(object.compressValue(compressed));
+    EXPECT_LT(object.getKeysAndValueLength(), originalLength);
+    EXPECT_EQ(object.getKeysAndValueLength(), compressed.size());
+
+    // Keys and the value read back as they were.
+    EXPECT_EQ(1U, object.getKeyCount());
+    KeyLength keyLength;
+    const void* keyString = object.getKey(0, &keyLength);
+    EXPECT_EQ("key", string(reinterpret_cast<const char*>(keyString),
+                            keyLength));
+    EXPECT_EQ(valueLength, object.getValueLength());
+    uint32_t length;
+    const void* contents = object.getValue(&length);
+    EXPECT_EQ(value, string(reinterpret_cast<const char*>(contents),
+                            length));
+    Buffer valueBuffer;
+    object.appendValueToBuffer(&valueBuffer);
+    EXPECT_EQ(value, TestUtil::toString(&valueBuffer));
+
+    // The compressed object survives a trip through the log format.
+    Buffer logBuffer;
+    object.assembleForLog(logBuffer);
+    Object fromLog(logBuffer);
+    EXPECT_TRUE(fromLog.checkIntegrity());
+    EXPECT_TRUE(fromLog.isValueCompressed());
+    EXPECT_EQ(valueLength, fromLog.getValueLength());
+}
+
+TEST_F(ObjectTest, compressValue_notWorthIt) {
+    // Too short.
+    Buffer compressed;
+    EXPECT_FALSE(singleKeyObject->compressValue(compressed));
+    EXPECT_FALSE(singleKeyObject->isValueCompressed());
+
+    // Doesn't shrink.
+    Key key(57, "key", 3);
+    string value;
+    for (int i = 0; i < 100; i++)
+        value += static_cast<char>(generateRandom());
+    Buffer objectBuffer;
+    Object object(key, value.data(), 100, 75, 723, objectBuffer);
+    EXPECT_FALSE(object.compressValue(compressed));
+    EXPECT_FALSE(object.isValueCompressed());
+    EXPECT_EQ(0U, compressed.size());
+    EXPECT_EQ(100U, object.getValueLength());
+}
+
+TEST_F(ObjectTest, decompressValue) {
+    Key key(57, "key", 3);
+    string value(200, 'z');
+    Buffer objectBuffer;
+    Object object(key, value.data(), 200, 75, 723, objectBuffer);
+    Buffer expected;
+    object.appendKeysAndValueToBuffer(expected);
+
+    Buffer compressed;
+    EXPECT_TRUE(object.compressValue(compressed));
+    Buffer logBuffer;
+    object.assembleForLog(logBuffer);
+    Object fromLog(logBuffer);
+
+    Buffer decompressed;
+    fromLog.decompressValue(decompressed);
+    EXPECT_FALSE(fromLog.isValueCompressed());
+    EXPECT_EQ(TestUtil::toString(&expected),
+              TestUtil::toString(&decompressed));
+    EXPECT_EQ(200U, fromLog.getValueLength());
+    Buffer reassembled;
+    fromLog.assembleForLog(reassembled);
+    EXPECT_TRUE(Object(reassembled).checkIntegrity());
+
+    // Uncompressed objects are simply copied.
+    Buffer plain;
+    singleKeyObject->decompressValue(plain);
+    EXPECT_EQ(singleKeyObject->getKeysAndValueLength(), plain.size());
+}
+
 TEST_F(ObjectTest, appendKeysAndValueToBuffer) {
     for (uint32_t i = 0; i < arrayLength(objects); i++) {
         Object& object = *objects[i];
@@ -202,6 +202,10 @@ OptionParser::setup(int argc, char* argv[])
              "server connection for listening client requests is dead."
              "0 means use transport-specific default."
              "Negative number means disabling the timer.")
+            ("batchRequests",
+             ProgramOptions::bool_switch(&options.batchRequests),
+             "Combine small requests (such as reads) issued to the same "
+             "server at about the same time into a single message.")
             ("debugOnSegfault",
              ProgramOptions::bool_switch(&debugOnSegfault),
              "Whether or not this application should drop to debugger"
@@ -72,6 +72,7 @@ class OptionParser {
             , sessionTimeout(0)
             , portTimeout(0)
             , clusterName()
+            , batchRequests(false)
         {
         }
 
@@ -135,6 +136,16 @@ class OptionParser {
             return portTimeout;
         }
 
+        /**
+         * Returns true if small requests to the same server should be
+         * combined into BATCH requests (see
+         * TransportManager::setBatchRequests).
+         */
+        bool getBatchRequests() const
+        {
+            return batchRequests;
+        }
+
       private:
         string coordinatorLocator;      ///< See getCoordinatorLocator().
         string localLocator;            ///< See getLocalLocator().
@@ -143,6 +154,7 @@ class OptionParser {
         uint32_t sessionTimeout;        ///< See getSessionTimeout().
         int32_t  portTimeout;           ///< See getSessionTimeout().
         string clusterName;             ///< See getClusterName().
+        bool batchRequests;             ///< See getBatchRequests().
 
         friend class OptionParser;
     };
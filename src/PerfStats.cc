@@ -92,6 +92,8 @@ PerfStats::collectStats(PerfStats* total)
         total->logSyncCycles += stats->logSyncCycles;
         total->segmentUnopenedCycles += stats->segmentUnopenedCycles;
         total->workerActiveCycles += stats->workerActiveCycles;
+        total->inlineRpcs += stats->inlineRpcs;
+        total->inlineRpcCycles += stats->inlineRpcCycles;
         total->btreeNodeReads += stats->btreeNodeReads;
         total->btreeNodeWrites += stats->btreeNodeWrites;
         total->btreeBytesRead += stats->btreeBytesRead;
@@ -115,6 +117,8 @@ PerfStats::collectStats(PerfStats* total)
         total->backupWriteActiveCycles += stats->backupWriteActiveCycles;
         total->networkInputBytes += stats->networkInputBytes;
         total->networkOutputBytes += stats->networkOutputBytes;
+        total->bufferSlabHits += stats->bufferSlabHits;
+        total->bufferSlabMisses += stats->bufferSlabMisses;
         total->temp1 += stats->temp1;
         total->temp2 += stats->temp2;
         total->temp3 += stats->temp3;
@@ -171,6 +175,8 @@ PerfStats::printClusterStats(Buffer* first, Buffer* second)
     result.append(format("%-30s %s\n", "Worker load factor",
             formatMetricRatio(&diff, "workerActiveCycles", "collectionTime",
             " %8.3f").c_str()));
+    result.append(format("%-30s %s\n", "RPCs run by dispatcher (K)",
+            formatMetric(&diff, "inlineRpcs", " %8.1f", 1e-3).c_str()));
 
     result.append("\nReads:\n");
     result.append(format("%-30s %s\n", "  Objects read (K)",
@@ -304,6 +310,14 @@ PerfStats::printClusterStats(Buffer* first, Buffer* second)
     result.append(format("%-30s %s\n", "  Output bytes (MB/s)",
             formatMetricRate(&diff, "networkOutputBytes",
             " %8.2f", 1e-6).c_str()));
+
+    result.append("\nBuffers:\n");
+    result.append(format("%-30s %s\n", "  Pooled allocations (K/s)",
+            formatMetricRate(&diff, "bufferSlabHits",
+            " %8.1f", 1e-3).c_str()));
+    result.append(format("%-30s %s\n", "  Mallocs (K/s)",
+            formatMetricRate(&diff, "bufferSlabMisses",
+            " %8.1f", 1e-3).c_str()));
     return result;
 }
 
@@ -362,6 +376,8 @@ PerfStats::clusterDiff(Buffer* before, Buffer* after,
         ADD_METRIC(writeKeyBytes);
         ADD_METRIC(dispatchActiveCycles);
         ADD_METRIC(workerActiveCycles);
+        ADD_METRIC(inlineRpcs);
+        ADD_METRIC(inlineRpcCycles);
         ADD_METRIC(btreeNodeReads);
         ADD_METRIC(btreeNodeWrites);
         ADD_METRIC(btreeBytesRead);
@@ -389,6 +405,8 @@ PerfStats::clusterDiff(Buffer* before, Buffer* after,
         ADD_METRIC(backupWriteActiveCycles);
         ADD_METRIC(networkInputBytes);
         ADD_METRIC(networkOutputBytes);
+        ADD_METRIC(bufferSlabHits);
+        ADD_METRIC(bufferSlabMisses);
         ADD_METRIC(temp1);
         ADD_METRIC(temp2);
         ADD_METRIC(temp3);
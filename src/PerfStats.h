@@ -89,6 +89,14 @@ struct PerfStats {
     /// as a worker.
     uint64_t workerActiveCycles;
 
+    /// Number of RPCs executed directly by the dispatch thread rather than
+    /// handed off to a worker (see WorkerManager::setInlineShortRpcs).
+    uint64_t inlineRpcs;
+
+    /// Total time (in Cycles::rdtsc ticks) the dispatch thread spent
+    /// executing those RPCs; this is also included in dispatchActiveCycles.
+    uint64_t inlineRpcCycles;
+
     //--------------------------------------------------------------------
     // Statistics for index operations. Only one copy of PerfStats is
     // kept for all indexing structures, so the numbers below are
@@ -215,6 +223,18 @@ struct PerfStats {
     /// Total bytes transmitted on the network by all transports.
     uint64_t networkOutputBytes;
 
+    //--------------------------------------------------------------------
+    // Statistics for Buffer storage follow below.
+    //--------------------------------------------------------------------
+
+    /// Number of times a Buffer needed more storage than it holds
+    /// internally and got it from a pool of free blocks.
+    uint64_t bufferSlabHits;
+
+    /// Number of times a Buffer needed more storage than it holds
+    /// internally and had to call malloc.
+    uint64_t bufferSlabMisses;
+
     //--------------------------------------------------------------------
     // Statistics for space used by log in memory and backups.
     // Note: these are NOT counter based statistics.
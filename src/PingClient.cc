@@ -349,6 +349,37 @@ PingClient::logMessage(Context* context, ServerId serverId,
     rpc.wait();
 }
 
+/**
+ * Change a runtime option on a master (for example, the log's group commit
+ * window; see RuntimeOptions for the available options). This uses the
+ * SET_MASTER_RUNTIME_OPTION server control.
+ *
+ * \param context
+ *      Overall information about this RAMCloud server or client.
+ * \param serverId
+ *      Identifier for the master to be controlled.
+ * \param option
+ *      Name of the runtime option to set (e.g. "logGroupCommitWindowMicros").
+ * \param value
+ *      String form of the new value for the option.
+ *
+ * \throw ObjectDoesntExistException
+ *      The master has no runtime option with the given name.
+ */
+void
+PingClient::setRuntimeOption(Context* context, ServerId serverId,
+        const char* option, const char* value)
+{
+    Buffer toSend;
+    toSend.appendCopy(option, downCast<uint32_t>(strlen(option) + 1));
+    toSend.appendCopy(value, downCast<uint32_t>(strlen(value) + 1));
+
+    ServerControlRpc rpc(context, serverId,
+            WireFormat::SET_MASTER_RUNTIME_OPTION,
+            toSend.getRange(0, toSend.size()), toSend.size());
+    rpc.wait();
+}
+
 /**
  * Retrieves the id of the server at the other end of a given session.
  * This method is used primarily by AbstractServerList when opening a
@@ -40,6 +40,8 @@ class PingClient {
     static void logMessage(Context* context, ServerId serverId,
             LogLevel level, const char* fmt, ...)
         __attribute__ ((format (gnu_printf, 4, 5)));
+    static void setRuntimeOption(Context* context, ServerId serverId,
+            const char* option, const char* value);
     static ServerId getServerId(Context* context,
             Transport::SessionRef session);
 
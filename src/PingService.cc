@@ -25,6 +25,8 @@
 #include "PerfStats.h"
 #include "PingClient.h"
 #include "PingService.h"
+#include "ProtoBuf.h"
+#include "RpcLatencyStats.h"
 #include "ServerList.h"
 #include "TimeTrace.h"
 #include "CacheTrace.h"
@@ -276,6 +278,14 @@ PingService::serverControl(const WireFormat::ServerControl::Request* reqHdr,
             rpc->replyPayload->appendCopy(&stats, respHdr->outputLength);
             break;
         }
+        case WireFormat::GET_RPC_LATENCIES:
+        {
+            ProtoBuf::RpcLatencies latencies;
+            RpcLatencyStats::collectLatencies(&latencies);
+            respHdr->outputLength = ProtoBuf::serializeToResponse(
+                    rpc->replyPayload, &latencies);
+            break;
+        }
         case WireFormat::GET_TIME_TRACE:
         {
             string s = TimeTrace::getTrace();
@@ -330,6 +340,35 @@ PingService::serverControl(const WireFormat::ServerControl::Request* reqHdr,
         case WireFormat::RESET_METRICS:
         {
             TimeTrace::reset();
+            RpcLatencyStats::reset();
+            break;
+        }
+        case WireFormat::SET_MASTER_RUNTIME_OPTION:
+        {
+            // The input holds the option name and its new value, each
+            // terminated by a null character.
+            const char* option = (const char*) inputData;
+            uint32_t optionLength = reqHdr->inputLength;
+            if (optionLength == 0 || option[optionLength - 1] != '\0') {
+                respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+                return;
+            }
+            const char* value = option + strlen(option) + 1;
+            if (value >= option + optionLength) {
+                respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+                return;
+            }
+            MasterService* master = context->getMasterService();
+            if (master == NULL) {
+                respHdr->common.status = STATUS_UNIMPLEMENTED_REQUEST;
+                return;
+            }
+            try {
+                master->setRuntimeOption(option, value);
+            } catch (const std::out_of_range& e) {
+                respHdr->common.status = STATUS_OBJECT_DOESNT_EXIST;
+                return;
+            }
             break;
         }
         case WireFormat::START_PERF_COUNTERS:
@@ -30,6 +30,7 @@
 #include "Tablets.pb.h"
 #include "Tub.h"
 #include "RamCloud.h"
+#include "RpcLatencyStats.h"
 #include "TimeTrace.h"
 #include "CacheTrace.h"
 
@@ -613,6 +614,59 @@ TEST_F(PingServiceTest, serverControl_addLogMessage_bad) {
                 &output), ClientException);
 }
 
+TEST_F(PingServiceTest, serverControl_setRuntimeOption) {
+    Buffer output;
+
+    // No master service on this server.
+    EXPECT_THROW(PingClient::setRuntimeOption(&context, serverId,
+            "logGroupCommitWindowMicros", "20"), UnimplementedRequestError);
+
+    addMasterService();
+    Log* log = context.getMasterService()->objectManager.getLog();
+    EXPECT_EQ(0u, log->groupCommitMaxWindowCycles);
+    EXPECT_EQ(32768u, log->groupCommitMaxBytes);
+
+    PingClient::setRuntimeOption(&context, serverId,
+            "logGroupCommitWindowMicros", "20");
+    PingClient::setRuntimeOption(&context, serverId,
+            "logGroupCommitBytes", "1000");
+    EXPECT_EQ(Cycles::fromMicroseconds(20), log->groupCommitMaxWindowCycles);
+    EXPECT_EQ(1000u, log->groupCommitMaxBytes);
+
+    EXPECT_THROW(PingClient::setRuntimeOption(&context, serverId,
+            "noSuchOption", "1"), ObjectDoesntExistException);
+
+    // Missing value.
+    EXPECT_THROW(PingClient::serverControl(&context, serverId,
+            WireFormat::SET_MASTER_RUNTIME_OPTION, "logGroupCommitBytes", 20,
+            &output), RequestFormatError);
+
+    // Missing terminating null character.
+    EXPECT_THROW(PingClient::serverControl(&context, serverId,
+            WireFormat::SET_MASTER_RUNTIME_OPTION, "logGroupCommitBytes", 19,
+            &output), RequestFormatError);
+}
+
+TEST_F(PingServiceTest, serverControl_getRpcLatencies) {
+    Buffer output;
+
+    RpcLatencyStats::reset();
+    RpcLatencyStats::recordRpc(WireFormat::READ, 100, 2000);
+    PingClient::serverControl(&context, serverId,
+            WireFormat::GET_RPC_LATENCIES, "", 0, &output);
+    ProtoBuf::RpcLatencies latencies;
+    ProtoBuf::parseFromResponse(&output, 0, output.size(), &latencies);
+    bool found = false;
+    foreach (const ProtoBuf::RpcLatencies::Opcode& entry,
+            latencies.opcode()) {
+        if (entry.opcode() == WireFormat::READ) {
+            EXPECT_EQ(1u, Histogram(entry.service_time()).getTotalSamples());
+            found = true;
+        }
+    }
+    EXPECT_TRUE(found);
+}
+
 TEST_F(PingServiceTest, serverControl_resetMetrics) {
     Buffer output;
 
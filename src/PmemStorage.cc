@@ -0,0 +1,791 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <emmintrin.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "PmemStorage.h"
+#include "BackupMasterRecovery.h"
+#include "ClientException.h"
+#include "Buffer.h"
+#include "Crc32C.h"
+#include "CycleCounter.h"
+#include "PerfStats.h"
+#include "RawMetrics.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+namespace {
+
+/**
+ * Layout of each of the superblock images at the start of the file.
+ */
+struct SuperblockImage {
+    explicit SuperblockImage(const BackupStorage::Superblock& newSuperblock)
+        : superblock(newSuperblock)
+        , checksum()
+    {
+        checksum = computeChecksum();
+    }
+
+    /// Return the checksum of #superblock.
+    Crc32C::ResultType
+    computeChecksum() const
+    {
+        Crc32C crc;
+        crc.update(&superblock, sizeof(superblock));
+        return crc.getResult();
+    }
+
+    BackupStorage::Superblock superblock;
+    Crc32C::ResultType checksum;
+} __attribute__((packed));
+
+/**
+ * Round \a offset up to a multiple of the page size, so the replica data
+ * can be mapped with huge pages if the filesystem supports them.
+ */
+size_t
+roundUpToPage(size_t offset)
+{
+    const size_t pageSize = 4096;
+    return (offset + pageSize - 1) / pageSize * pageSize;
+}
+
+}
+
+// --- PmemStorage::Frame ---
+
+/**
+ * Create a Frame associated with a chunk of the mapped file that may hold a
+ * replica.
+ */
+PmemStorage::Frame::Frame(PmemStorage* storage, size_t frameIndex)
+    : storage(storage)
+    , frameIndex(frameIndex)
+    , isOpen()
+    , isClosed()
+    , sync()
+    , appendedToByCurrentProcess()
+    , loadRequested()
+    , metadata(new char[METADATA_SIZE])
+{
+    memset(metadata.get(), '\0', METADATA_SIZE);
+}
+
+// See BackupStorage::Frame::wasAppendedToByCurrentProcess().
+bool
+PmemStorage::Frame::wasAppendedToByCurrentProcess()
+{
+    return appendedToByCurrentProcess;
+}
+
+/**
+ * Copy the metadata stored for this frame into memory; only used when
+ * restarting a backup from storage. After this call returns getMetadata()
+ * will return the metadata as found on storage up until the first call to
+ * open() on this frame.
+ */
+void
+PmemStorage::Frame::loadMetadata()
+{
+    const FrameMetadata* stored = storage->metadataOf(frameIndex);
+    memcpy(metadata.get(), stored->slots[stored->activeSlot & 1],
+           METADATA_SIZE);
+}
+
+/**
+ * Return a pointer to the most recently appended metadata for this frame.
+ * Warning: Concurrent calls to append modify the metadata that the return
+ * of this method points to. In practice it should only be called when the
+ * frame isn't accepting appends (either it was just constructed or one of
+ * close, load, or free has already been called on it). Used only during
+ * backup restart and master recovery to extract details about the replica
+ * in this frame without loading the frame.
+ */
+const void*
+PmemStorage::Frame::getMetadata()
+{
+    return metadata.get();
+}
+
+/**
+ * Doesn't do much for PmemStorage, since replicas are read in place;
+ * prevents any further append() calls from being accepted.
+ */
+void
+PmemStorage::Frame::startLoading()
+{
+    Lock lock(storage->mutex);
+    loadRequested = true;
+}
+
+/**
+ * Returns true if calling load() would not block, which it never does
+ * for PmemStorage.
+ */
+bool
+PmemStorage::Frame::isLoaded()
+{
+    return true;
+}
+
+/**
+ * Return a pointer to the replica data for recovery; it points directly
+ * into persistent memory, so load() never copies or blocks. Prevents any
+ * further append() calls from being accepted.
+ */
+void*
+PmemStorage::Frame::load()
+{
+    startLoading();
+    return storage->dataOf(frameIndex);
+}
+
+/**
+ * Has no effect for PmemStorage.
+ */
+void
+PmemStorage::Frame::unload()
+{
+}
+
+/**
+ * Append data to frame and update metadata. The data is copied to
+ * persistent memory and made durable before the metadata, and both are
+ * durable when this returns (unless the storage isn't mapped with MAP_SYNC
+ * and the frame wasn't opened with sync).
+ *
+ * Idempotence: the caller must guarantee duplicated calls provide identical
+ * arguments.
+ *
+ * append() after a load() or a close() throws an exception to
+ * the master performing the append since it is either an error by the master
+ * or the master has crashed.
+ *
+ * \param source
+ *      Buffer contained the data to be copied into the frame.
+ * \param sourceOffset
+ *      Offset into \a source where data should be copied from.
+ * \param length
+ *      Bytes to copy to the frame starting at \a sourceOffset in \a source.
+ * \param destinationOffset
+ *      Offset into the frame where the source data should be copied.
+ * \param metadata
+ *      Metadata which should be written to storage immediately after the data
+ *      appended is written. May be NULL if there is no updated metadata to
+ *      commit to storage along with this data.
+ * \param metadataLength
+ *      Bytes of metadata pointed to by \a metadata. Ignored if \a metadata
+ *      is NULL.
+ */
+void
+PmemStorage::Frame::append(Buffer& source,
+                           size_t sourceOffset,
+                           size_t length,
+                           size_t destinationOffset,
+                           const void* metadata,
+                           size_t metadataLength)
+{
+    Lock lock(storage->mutex);
+    CycleCounter<uint64_t> ticks;
+    if (!isOpen) {
+        LOG(ERROR, "Tried to append to a frame but it wasn't"
+            "open on this backup");
+        throw BackupBadSegmentIdException(HERE);
+    }
+    if (loadRequested) {
+        LOG(NOTICE, "Tried to append to a frame but it was already enqueued "
+            "for load for recovery; calling master is probabaly already dead");
+        throw BackupBadSegmentIdException(HERE);
+    }
+    // Three conditions because overflow is possible on addition.
+    if (length > storage->segmentSize ||
+        destinationOffset > storage->segmentSize ||
+        length + destinationOffset > storage->segmentSize)
+    {
+        LOG(ERROR, "Out-of-bounds appended attempted on storage frame: "
+            "offset %lu, length %lu, segmentSize %lu ",
+            destinationOffset, length, storage->segmentSize);
+        throw BackupSegmentOverflowException(HERE);
+    }
+    if (metadata && metadataLength > METADATA_SIZE) {
+        LOG(ERROR, "Tried to append to a frame with metadata of length %lu "
+            "but storage only allows max length of %d",
+            metadataLength, METADATA_SIZE);
+        throw BackupSegmentOverflowException(HERE);
+    }
+
+    appendedToByCurrentProcess = true;
+    char* destination = storage->dataOf(frameIndex) + destinationOffset;
+    char* next = destination;
+    for (Buffer::Iterator it(&source, downCast<uint32_t>(sourceOffset),
+                             downCast<uint32_t>(length));
+         !it.isDone(); it.next()) {
+        copyAndFlush(next, it.getData(), it.getLength());
+        next += it.getLength();
+    }
+    // The data must be durable before the metadata that covers it.
+    storage->persist(destination, length, sync);
+
+    if (metadata) {
+        memcpy(this->metadata.get(), metadata, metadataLength);
+        FrameMetadata* stored = storage->metadataOf(frameIndex);
+        const uint64_t slot = (stored->activeSlot & 1) ^ 1;
+        copyAndFlush(stored->slots[slot], this->metadata.get(),
+                     METADATA_SIZE);
+        storage->persist(stored->slots[slot], METADATA_SIZE, sync);
+        stored->activeSlot = slot;
+        _mm_clflush(&stored->activeSlot);
+        storage->persist(&stored->activeSlot, sizeof(stored->activeSlot),
+                         sync);
+    }
+
+    uint64_t elapsed = ticks.stop();
+    ++metrics->backup.storageWriteCount;
+    metrics->backup.storageWriteBytes += length;
+    metrics->backup.storageWriteTicks += elapsed;
+    PerfStats::threadStats.backupWriteActiveCycles += elapsed;
+    storage->sleepToThrottleWrites(length + metadataLength, elapsed);
+}
+
+/**
+ * Mark this frame as closed. Calls to close after a call to load() throw
+ * BackupBadSegmentIdException which should kill the calling master; in this
+ * case recovery has already started for them so they are likely already dead.
+ */
+void
+PmemStorage::Frame::close()
+{
+    Lock lock(storage->mutex);
+    if (isClosed)
+        return;
+    if (loadRequested) {
+        LOG(NOTICE, "Tried to close a frame but it was already enqueued "
+            "for load for recovery; calling master is probably already dead");
+        throw BackupBadSegmentIdException(HERE);
+    }
+    isOpen = false;
+    isClosed = true;
+}
+
+// See BackupStorage.h for documentation.
+void
+PmemStorage::Frame::reopen(size_t length)
+{
+    // The replica's data is already in place, whether or not it was
+    // closed before the crash.
+    Lock _(storage->mutex);
+    isOpen = true;
+    isClosed = false;
+    loadRequested = false;
+}
+
+/**
+ * Do not call; see BackupStorage::freeFrame().
+ * Make this frame available for reuse; data previously stored in this frame
+ * may or may not be part of future recoveries.
+ */
+void
+PmemStorage::Frame::free()
+{
+    Lock lock(storage->mutex);
+    isOpen = false;
+    isClosed = false;
+    loadRequested = false;
+    memset(metadata.get(), '\0', METADATA_SIZE);
+    storage->freeMap[frameIndex] = 1;
+}
+
+// - private -
+
+/**
+ * Open the frame, resetting its state to accept appends for a new replica.
+ * Open is not synchronous itself. Even after return from open() if this
+ * backup crashes it may find the replica which was formerly stored in this
+ * frame or metadata for the former replica and data for the newly open replica.
+ * Recovery is expected to address these consistency issues with the checksums.
+ *
+ * Idempotence: Duplicate calls to open() are ignored until the frame is freed.
+ * Calling open() after the frame is freed will reset this frame for reuse
+ * with an new replica.
+ *
+ * \param sync
+ *      Only return from append() calls when all appended data and the most
+ *      recently appended metadata are durable on storage.
+ */
+void
+PmemStorage::Frame::open(bool sync)
+{
+    Lock _(storage->mutex);
+    if (isOpen || isClosed)
+        return;
+    isOpen = true;
+    isClosed = false;
+    this->sync = sync;
+    memset(metadata.get(), '\0', METADATA_SIZE);
+    loadRequested = false;
+}
+
+// --- PmemStorage ---
+
+/**
+ * Create a PmemStorage, mapping (and creating or extending, if needed) the
+ * file where replicas are stored.
+ *
+ * \param segmentSize
+ *      The size in bytes of the segments this storage will deal with.
+ * \param frameCount
+ *      The number of segments this storage can store simultaneously.
+ * \param writeRateLimit
+ *      When specified, writes to this storage instance should be
+ *      limited to at most the given rate (in megabytes per second).
+ *      The special value 0 turns off throttling.
+ * \param filePath
+ *      File to map; it should be on a filesystem mounted with DAX on
+ *      persistent memory.
+ * \throw BackupStorageException
+ *      If the file can't be opened, extended, or mapped.
+ */
+PmemStorage::PmemStorage(size_t segmentSize,
+                         size_t frameCount,
+                         size_t writeRateLimit,
+                         const char* filePath)
+    : BackupStorage(segmentSize, Type::PMEM, writeRateLimit)
+    , mutex()
+    , frames()
+    , frameCount(frameCount)
+    , freeMap(frameCount)
+    , lastAllocatedFrame(FreeMap::npos)
+    , metadataStart(2 * SUPERBLOCK_SIZE)
+    , dataStart(roundUpToPage(metadataStart +
+                              frameCount * sizeof(FrameMetadata)))
+    , fileSize(dataStart + frameCount * segmentSize)
+    , fd(-1)
+    , base(NULL)
+    , dax(false)
+    , superblock()
+    , lastSuperblockFrame(1)
+{
+    fd = ::open(filePath, O_CREAT | O_RDWR, 0666);
+    if (fd == -1) {
+        throw BackupStorageException(HERE,
+                format("Failed to open backup storage file %s", filePath),
+                errno);
+    }
+
+    // Allocate all of the space up front, rather than when the pages are
+    // first touched, to keep page faults off the append path.
+    struct stat st;
+    int r = fstat(fd, &st);
+    if (r == 0 && uint64_t(st.st_size) < fileSize)
+        r = posix_fallocate(fd, 0, fileSize);
+    else if (r == -1)
+        r = errno;
+    if (r != 0) {
+        ::close(fd);
+        throw BackupStorageException(HERE,
+                "Couldn't reserve storage space for backup", r);
+    }
+
+    void* mapping = mmap(NULL, fileSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED_VALIDATE | MAP_SYNC, fd, 0);
+    if (mapping != MAP_FAILED) {
+        dax = true;
+    } else if (errno == EOPNOTSUPP || errno == EINVAL) {
+        LOG(WARNING, "%s isn't on a DAX filesystem; backup will use msync "
+            "to make replicas durable", filePath);
+        mapping = mmap(NULL, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       fd, 0);
+    }
+    if (mapping == MAP_FAILED) {
+        int e = errno;
+        ::close(fd);
+        throw BackupStorageException(HERE,
+                format("Failed to map backup storage file %s", filePath), e);
+    }
+    base = static_cast<char*>(mapping);
+
+    for (size_t frame = 0; frame < frameCount; ++frame)
+        frames.emplace_back(this, frame);
+    freeMap.set();
+
+    LOG(NOTICE, "Backup storage mapped from %s (%s): %lu frames of %lu bytes",
+        filePath, dax ? "DAX" : "not DAX", frameCount, segmentSize);
+}
+
+/**
+ * Unmap and close the file where replicas are stored.
+ */
+PmemStorage::~PmemStorage()
+{
+    munmap(base, fileSize);
+    ::close(fd);
+}
+
+/**
+ * Allocate a frame on storage, resetting its state to accept appends for a new
+ * replica. Open is not synchronous itself. Even after return from open() if
+ * this backup crashes it may find the replica which was formerly stored in
+ * this frame or metadata for the former replica and data for the newly open
+ * replica. Recovery is expected to address these consistency issues with the
+ * checksums.
+ *
+ * This call is NOT idempotent since it allocates and return resources to
+ * the caller. The caller must take care not to lose frames. Any returned
+ * frame which is not freed may be leaked until the backup (or the creating
+ * master crashes).
+ *
+ * \param sync
+ *      Only return from append() calls when all appended data and the most
+ *      recently appended metadata are durable on storage. Appends are always
+ *      durable on return if the storage is mapped with MAP_SYNC.
+ * \return
+ *      Reference to a frame through which handles all IO for a single
+ *      replica. Maintains a reference count; when destroyed if the
+ *      reference count drops to zero the frame will be freed for reuse with
+ *      another replica.
+ */
+BackupStorage::FrameRef
+PmemStorage::open(bool sync)
+{
+    Lock lock(mutex);
+    FreeMap::size_type next = freeMap.find_next(lastAllocatedFrame);
+    if (next == FreeMap::npos) {
+        next = freeMap.find_first();
+        if (next == FreeMap::npos) {
+            RAMCLOUD_CLOG(NOTICE, "Rejecting open: no free storage frames");
+            throw BackupOpenRejectedException(HERE);
+        }
+    }
+    lastAllocatedFrame = next;
+    size_t frameIndex = next;
+    assert(freeMap[frameIndex] == 1);
+    freeMap[frameIndex] = 0;
+    Frame* frame = &frames[frameIndex];
+    lock.unlock();
+    frame->open(sync);
+    return {frame, BackupStorage::freeFrame};
+}
+
+/**
+ * Returns the maximum number of bytes of metadata that can be stored
+ * which each append(). Also, how many bytes of getMetadata() are safe
+ * for access after getMetadata() calls, though returned data may or may
+ * not contain valid or meaningful (or even consistent with the
+ * replica) metadata.
+ */
+size_t
+PmemStorage::getMetadataSize()
+{
+    return METADATA_SIZE;
+}
+
+/**
+ * Marks ALL storage frames as allocated, initializes frame state based on
+ * metadata if its metadata is valid, and blows away any in-memory copies of
+ * metadata. This should only be performed at backup startup. The caller is
+ * reponsible for freeing the frames if the metadata indicates the replica data
+ * stored there isn't useful.
+ *
+ * \return
+ *      Pointer to every frame which has various uses depending on the
+ *      metadata that is found in that frame. BackupService code is expected
+ *      to examine the metadata and either free the frame or take note of the
+ *      metadata in the frame for potential use in future recoveries.
+ */
+std::vector<BackupStorage::FrameRef>
+PmemStorage::loadAllMetadata()
+{
+    std::vector<FrameRef> ret;
+    ret.reserve(frames.size());
+    foreach (Frame& frame, frames) {
+        frame.loadMetadata();
+        assert(freeMap[frame.frameIndex] == 1);
+        freeMap[frame.frameIndex] = 0;
+
+        const BackupReplicaMetadata* metadata =
+                static_cast<const BackupReplicaMetadata*>(frame.getMetadata());
+        if (metadata->checkIntegrity()) {
+            frame.isClosed = metadata->closed;
+            frame.isOpen = !metadata->closed;
+        }
+        ret.push_back({&frame, BackupStorage::freeFrame});
+    }
+    return ret;
+}
+
+/**
+ * Overwrite the superblock with new information that future backups reusing
+ * this storage will need (in the case of this backup's demise). There are
+ * two superblock images, and the older one is overwritten first, so a failure
+ * in the middle of the update will leave either the old superblock or the new.
+ * See BackupStorage::resetSuperblock() for the parameters.
+ */
+void
+PmemStorage::resetSuperblock(ServerId serverId,
+                             const string& clusterName,
+                             const uint32_t frameSkipMask)
+{
+    Superblock newSuperblock =
+        Superblock(superblock.version + 1, serverId, clusterName.c_str());
+    SuperblockImage image(newSuperblock);
+
+    for (uint32_t i = 0; i < 2; ++i) {
+        const uint32_t nextFrame = (lastSuperblockFrame + 1) % 2;
+        if (!((frameSkipMask >> nextFrame) & 0x01)) {
+            char* destination = base + nextFrame * SUPERBLOCK_SIZE;
+            copyAndFlush(destination, &image, sizeof(image));
+            persist(destination, sizeof(image), true);
+            LOG(DEBUG, "Superblock frame %u written", nextFrame);
+        }
+        lastSuperblockFrame = nextFrame;
+    }
+
+    superblock = newSuperblock;
+}
+
+/**
+ * Read both superblock images and return the most up-to-date and complete
+ * superblock since the last resetSuperblock().
+ *
+ * \return
+ *      The most up-to-date complete superblock found on storage.  If no
+ *      superblock can be found a default superblock is returned which
+ *      indicates no prior backup instance left behind intelligible
+ *      traces of life on storage.
+ */
+BackupStorage::Superblock
+PmemStorage::loadSuperblock()
+{
+    Tub<Superblock> left = tryLoadSuperblock(0);
+    Tub<Superblock> right = tryLoadSuperblock(1);
+
+    bool chooseLeft = false;
+    if (left && right) {
+        chooseLeft = left->version >= right->version;
+    } else if (!left && !right) {
+        LOG(WARNING,
+            "Backup couldn't find existing superblock; "
+            "starting as fresh backup.");
+        right.construct();
+        chooseLeft = false;
+    } else {
+        chooseLeft = left;
+    }
+
+    if (chooseLeft) {
+        superblock = *left;
+        lastSuperblockFrame = 0;
+    } else {
+        superblock = *right;
+        lastSuperblockFrame = 1;
+    }
+
+    LOG(DEBUG,
+        "Reloading backup superblock (version %lu, superblockFrame %u) "
+        "from previous run", superblock.version, lastSuperblockFrame);
+    LOG(DEBUG, "Prior backup had ServerId %s",
+        ServerId(superblock.serverId).toString().c_str());
+    LOG(DEBUG, "Prior backup had cluster name '%s'", superblock.clusterName);
+
+    return superblock;
+}
+
+/**
+ * Return only after all data appended to all Frames prior to this call
+ * is durable. Appends are durable when they return if the storage is mapped
+ * with MAP_SYNC; otherwise the whole mapping is flushed with msync.
+ */
+void
+PmemStorage::quiesce()
+{
+    if (dax)
+        return;
+    if (msync(base, fileSize, MS_SYNC) == -1)
+        DIE("Failed to flush backup storage: %s", strerror(errno));
+}
+
+/**
+ * Scribble on all the metadata of all the storage frames to prevent
+ * what is already on storage from being reused in future runs.
+ * Only safe immedately after this class is instantiated, before it is used
+ * to allocate or perform operations on frames.
+ * Called whenever the cluster name changes from what is stored in
+ * the superblock to prevent replicas already on storage from getting
+ * confused for ones written by the starting up backup process.
+ */
+void
+PmemStorage::fry()
+{
+    char zeroes[METADATA_SIZE];
+    memset(zeroes, 0, sizeof(zeroes));
+    foreach (Frame& frame, frames) {
+        FrameMetadata* stored = metadataOf(frame.frameIndex);
+        copyAndFlush(stored->slots[0], zeroes, sizeof(zeroes));
+        copyAndFlush(stored->slots[1], zeroes, sizeof(zeroes));
+    }
+    persist(base + metadataStart, frameCount * sizeof(FrameMetadata), true);
+}
+
+// - private -
+
+/**
+ * Copy data into persistent memory and start flushing it out of the CPU's
+ * caches. The bulk of the data is copied with non-temporal stores, which
+ * bypass the caches (and don't pollute them with replica data that won't be
+ * read again); bytes at the ends that aren't aligned for those are copied
+ * normally and their cache lines are flushed. The copy isn't guaranteed to
+ * be durable until a store fence (see #persist).
+ *
+ * \param destination
+ *      Where to copy the data; somewhere in the mapped file.
+ * \param source
+ *      Data to copy.
+ * \param length
+ *      Number of bytes to copy.
+ */
+void
+PmemStorage::copyAndFlush(void* destination, const void* source,
+                          size_t length)
+{
+    char* dst = static_cast<char*>(destination);
+    const char* src = static_cast<const char*>(source);
+    const size_t alignment = sizeof(__m128i);
+
+    size_t head = (alignment - reinterpret_cast<uintptr_t>(dst) % alignment) %
+            alignment;
+    head = std::min(head, length);
+    size_t tail = (length - head) % alignment;
+    if (head > 0) {
+        memcpy(dst, src, head);
+        _mm_clflush(dst);
+        dst += head;
+        src += head;
+        length -= head;
+    }
+
+    length -= tail;
+    while (length >= CACHE_LINE_SIZE) {
+        const __m128i* in = reinterpret_cast<const __m128i*>(src);
+        __m128i* out = reinterpret_cast<__m128i*>(dst);
+        __m128i a = _mm_loadu_si128(in);
+        __m128i b = _mm_loadu_si128(in + 1);
+        __m128i c = _mm_loadu_si128(in + 2);
+        __m128i d = _mm_loadu_si128(in + 3);
+        _mm_stream_si128(out, a);
+        _mm_stream_si128(out + 1, b);
+        _mm_stream_si128(out + 2, c);
+        _mm_stream_si128(out + 3, d);
+        dst += CACHE_LINE_SIZE;
+        src += CACHE_LINE_SIZE;
+        length -= CACHE_LINE_SIZE;
+    }
+    while (length > 0) {
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+        dst += alignment;
+        src += alignment;
+        length -= alignment;
+    }
+
+    if (tail > 0) {
+        memcpy(dst, src, tail);
+        _mm_clflush(dst);
+    }
+}
+
+/**
+ * Return a pointer to the replica data of a frame in the mapped file.
+ */
+char*
+PmemStorage::dataOf(size_t frameIndex)
+{
+    return base + dataStart + frameIndex * segmentSize;
+}
+
+/**
+ * Return a pointer to the metadata of a frame in the mapped file.
+ */
+PmemStorage::FrameMetadata*
+PmemStorage::metadataOf(size_t frameIndex)
+{
+    return reinterpret_cast<FrameMetadata*>(
+            base + metadataStart + frameIndex * sizeof(FrameMetadata));
+}
+
+/**
+ * Wait until everything stored with copyAndFlush (or flushed with clflush)
+ * is durable. With MAP_SYNC this is just a store fence; otherwise the
+ * pages holding a range of the mapping are written back with msync too,
+ * but only if \a sync is set.
+ *
+ * \param start
+ *      First byte of the range of the mapping that must be durable.
+ * \param length
+ *      Number of bytes in the range.
+ * \param sync
+ *      If false and the storage isn't mapped with MAP_SYNC, leave it to the
+ *      kernel to write the range back eventually.
+ */
+void
+PmemStorage::persist(const void* start, size_t length, bool sync)
+{
+    _mm_sfence();
+    if (dax || !sync || length == 0)
+        return;
+    const uintptr_t pageSize = 4096;
+    uintptr_t first = reinterpret_cast<uintptr_t>(start) & ~(pageSize - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(start) + length;
+    if (msync(reinterpret_cast<void*>(first), end - first, MS_SYNC) == -1)
+        DIE("Failed to flush backup storage: %s", strerror(errno));
+}
+
+/**
+ * Try to read one of the superblock images.
+ *
+ * \param superblockFrame
+ *      Which of the two superblock images to read.
+ * \return
+ *      The superblock stored at \a superblockFrame if its checksum was
+ *      correct; otherwise empty.
+ */
+Tub<BackupStorage::Superblock>
+PmemStorage::tryLoadSuperblock(uint32_t superblockFrame)
+{
+    const SuperblockImage* image = reinterpret_cast<const SuperblockImage*>(
+            base + superblockFrame * SUPERBLOCK_SIZE);
+    Crc32C::ResultType checksum = image->computeChecksum();
+    if (image->checksum != checksum) {
+        LOG(NOTICE, "Stored superblock had a bad checksum: "
+            "stored checksum was %x, but stored data had checksum %x",
+            image->checksum, checksum);
+        return {};
+    }
+    Superblock superblock = image->superblock;
+    char& endOfName =
+        superblock.clusterName[sizeof(superblock.clusterName) - 1];
+    if (endOfName != '\0')
+        DIE("Stored superblock's cluster name should end in \\0; "
+            "this should never happen unless there is a software bug");
+
+    return { superblock };
+}
+
+} // namespace RAMCloud
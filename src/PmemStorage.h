@@ -0,0 +1,248 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_PMEMSTORAGE_H
+#define RAMCLOUD_PMEMSTORAGE_H
+
+#include <deque>
+
+#include "Common.h"
+#include "BackupStorage.h"
+#include "MultiFileStorage.h"
+
+namespace RAMCloud {
+
+/**
+ * A BackupStorage backend which stores replicas in byte-addressable
+ * persistent memory (such as NVDIMMs). A file on a DAX-capable filesystem is
+ * mapped into the address space with MAP_SYNC, so stores to the mapping reach
+ * the memory directly without going through the page cache; appends copy
+ * replica data into the mapping with non-temporal stores and cache-line
+ * flushes, and become durable once a store fence completes. No system calls
+ * are made on the append path, and recovery reads replicas in place.
+ *
+ * If the file can't be mapped with MAP_SYNC (for example, it is on tmpfs or
+ * an ordinary disk-backed filesystem) it is mapped normally instead and
+ * appends to frames opened with sync call msync; this is much slower than
+ * real persistent memory, but is handy for testing.
+ *
+ * The file holds two superblock images, followed by metadata for each
+ * frame and finally the replica data for each frame. Each frame has two
+ * metadata slots which are written alternately, so a crash in the middle
+ * of an update leaves the previous metadata intact.
+ */
+class PmemStorage : public BackupStorage {
+  public:
+    /**
+     * Represents a chunk of persistent memory which holds a single replica.
+     * PmemStorage keeps exactly one frame for each space in the mapped file
+     * where it holds (or could hold) a replica.
+     * Frames get reused for different replicas making a frame something of a
+     * state machine.
+     *
+     * Backups open() frames, append() data, and then close() them. When the
+     * replica is no longer needed free() releases the frame for reuse by
+     * another replica, for which, the same cycle will be repeated.
+     * See PmemStorage::open() to allocate and open a Frame.
+     */
+    class Frame : public BackupStorage::Frame {
+      PUBLIC:
+        typedef std::unique_lock<std::mutex> Lock;
+
+        Frame(PmemStorage* storage, size_t frameIndex);
+
+        bool wasAppendedToByCurrentProcess();
+
+        void loadMetadata();
+        const void* getMetadata();
+
+        void startLoading();
+        bool isLoaded();
+        bool currentlyOpen() {return isOpen;}
+        void* load();
+        void unload();
+
+        void append(Buffer& source,
+                    size_t sourceOffset,
+                    size_t length,
+                    size_t destinationOffset,
+                    const void* metadata,
+                    size_t metadataLength);
+        void close();
+        void reopen(size_t length);
+        void free();
+
+      PRIVATE:
+        void open(bool sync);
+
+        /// Storage where this frame resides.
+        PmemStorage* storage;
+
+        /// Index of the frame in #storage.frames. Used to mark the frame free.
+        const size_t frameIndex;
+
+        /**
+         * Tracks whether a replica has been opened (either initially or
+         * since the time of the last free). False if #isClosed.
+         */
+        bool isOpen;
+
+        /**
+         * Tracks whether a replica has been closed (either initially or
+         * since the time of the last free). False if #isOpen.
+         */
+        bool isClosed;
+
+        /**
+         * If true, append() must not return until the appended data and
+         * metadata are durable. Only matters if the storage isn't mapped
+         * with MAP_SYNC: otherwise every append is durable on return.
+         */
+        bool sync;
+
+        /**
+         * Tracks whether append has been called on this frame during the
+         * life of this process. This includes across free()/open() cycles.
+         * See wasAppendedToByCurrentProcess().
+         */
+        bool appendedToByCurrentProcess;
+
+        /**
+         * True if the replica data has been requested. Used to reject
+         * appends after load requests.
+         */
+        bool loadRequested;
+
+        /**
+         * Metadata given on the most recent call to append (or loaded from
+         * storage by loadMetadata()). Starts zeroed on construction.
+         */
+        std::unique_ptr<char[]> metadata;
+
+        // ONLY for open(); please try not to touch other
+        // details of frames in PmemStorage (or elsewhere).
+        friend class PmemStorage;
+        DISALLOW_COPY_AND_ASSIGN(Frame);
+    };
+
+    PmemStorage(size_t segmentSize,
+                size_t frameCount,
+                size_t writeRateLimit,
+                const char* filePath);
+    ~PmemStorage();
+
+    FrameRef open(bool sync);
+    size_t getMetadataSize();
+    std::vector<FrameRef> loadAllMetadata();
+    void resetSuperblock(ServerId serverId,
+                         const string& clusterName,
+                         uint32_t frameSkipMask = 0);
+    Superblock loadSuperblock();
+    void quiesce();
+    void fry();
+
+  PRIVATE:
+    /// Maximum size of metadata for each frame.
+    enum { METADATA_SIZE = MultiFileStorage::METADATA_SIZE };
+
+    /// Size of each of the two superblock images at the start of the file.
+    enum { SUPERBLOCK_SIZE = 4096 };
+
+    /**
+     * Layout of the metadata for each frame in the mapped file. The
+     * metadata given to an append is written to the slot that isn't
+     * active, and then #activeSlot is switched to it with a single
+     * (atomic) 8-byte store.
+     */
+    struct FrameMetadata {
+        /// Index of the slot in #slots holding the current metadata.
+        uint64_t activeSlot;
+
+        /// Pads #slots to a cache line boundary.
+        char padding[CACHE_LINE_SIZE - sizeof(uint64_t)];
+
+        /// The two copies of the frame's metadata.
+        char slots[2][METADATA_SIZE];
+    } __attribute__((packed));
+    static_assert(sizeof(FrameMetadata) % CACHE_LINE_SIZE == 0,
+                  "FrameMetadata must be a multiple of the cache line size");
+
+    static void copyAndFlush(void* destination, const void* source,
+                             size_t length);
+    char* dataOf(size_t frameIndex);
+    FrameMetadata* metadataOf(size_t frameIndex);
+    void persist(const void* start, size_t length, bool sync);
+    Tub<Superblock> tryLoadSuperblock(uint32_t superblockFrame);
+
+    /// Protects concurrent operations on storage and all of its frames.
+    std::mutex mutex;
+    typedef std::unique_lock<std::mutex> Lock;
+
+    /**
+     * Frame for each chunk of the mapped file which can hold a replica.
+     * Frames get reused for different replicas making a frame something of a
+     * state machine, but are all created and destroyed along with the
+     * storage instance.
+     */
+    std::deque<Frame> frames;
+
+    /// The number of replicas this storage can store simultaneously.
+    const size_t frameCount;
+
+    /// Type of the freeMap.  A bitmap.
+    typedef boost::dynamic_bitset<> FreeMap;
+    /// Keeps a bit set for each frame in frames indicating if it is free.
+    FreeMap freeMap;
+
+    /**
+     * Track the last used segment frame so they can be used in FIFO.
+     * This gives recovery dump tools a much better chance at recovering
+     * data since old data is destroyed from storage first rather than new.
+     */
+    FreeMap::size_type lastAllocatedFrame;
+
+    /// Offset in the mapped file of the metadata of the first frame.
+    const size_t metadataStart;
+
+    /// Offset in the mapped file of the replica data of the first frame.
+    const size_t dataStart;
+
+    /// Size in bytes of the mapped file.
+    const size_t fileSize;
+
+    /// File descriptor of the mapped file.
+    int fd;
+
+    /// Start of the mapping of the file.
+    char* base;
+
+    /**
+     * True if the file is mapped with MAP_SYNC, so data is durable once it
+     * is flushed from the CPU's caches. If false, msync is needed too.
+     */
+    bool dax;
+
+    /// The most recent superblock written or read, see #resetSuperblock.
+    Superblock superblock;
+
+    /// Which of the two superblock images holds #superblock.
+    uint32_t lastSuperblockFrame;
+
+    DISALLOW_COPY_AND_ASSIGN(PmemStorage);
+};
+
+} // namespace RAMCloud
+
+#endif
@@ -0,0 +1,284 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/stat.h>
+
+#include "TestUtil.h"
+#include "BackupMasterRecovery.h"
+#include "ClientException.h"
+#include "PmemStorage.h"
+#include "StringUtil.h"
+
+namespace RAMCloud {
+
+class PmemStorageTest : public ::testing::Test {
+  public:
+    typedef char* bytes;
+    enum { METADATA_SIZE = PmemStorage::METADATA_SIZE };
+    typedef PmemStorage::Frame Frame;
+
+    const char* path;
+    const char* test;
+    uint32_t testLength;
+    Buffer testSource;
+    uint32_t segmentFrames;
+    uint32_t segmentSize;
+    Tub<PmemStorage> storage;
+
+    PmemStorageTest()
+        : path("/tmp/ramcloud-pmem-storage-test-delete-this")
+        , test("test")
+        , testLength(downCast<uint32_t>(strlen(test)))
+        , testSource()
+        , segmentFrames(4)
+        , segmentSize(4 * 1024)
+        , storage()
+    {
+        unlink(path);
+        testSource.appendExternal(test, testLength + 1);
+        storage.construct(segmentSize, segmentFrames, 0, path);
+    }
+
+    ~PmemStorageTest()
+    {
+        storage.destroy();
+        unlink(path);
+    }
+
+    // Write a valid replica into a frame, with the given metadata fields.
+    void
+    writeReplica(Frame* frame, uint64_t logId, bool closed)
+    {
+        SegmentCertificate certificate;
+        certificate.segmentLength = testLength + 1;
+        BackupReplicaMetadata metadata(certificate, logId, 88, segmentSize,
+                                       0, closed, false);
+        frame->append(testSource, 0, testLength + 1, 0, &metadata,
+                      sizeof(metadata));
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(PmemStorageTest);
+};
+
+TEST_F(PmemStorageTest, Frame_loadMetadata) {
+    BackupStorage::FrameRef frameRef = storage->open(true);
+    Frame* frame = static_cast<Frame*>(frameRef.get());
+    Buffer empty;
+    frame->append(empty, 0, 0, 0, "old", 4);
+    frame->append(empty, 0, 0, 0, "new", 4);
+    frame->loadMetadata();
+    EXPECT_STREQ("new", static_cast<const char*>(frame->getMetadata()));
+
+    // A crash before the active slot was switched leaves the old metadata.
+    storage->metadataOf(frame->frameIndex)->activeSlot ^= 1;
+    frame->loadMetadata();
+    EXPECT_STREQ("old", static_cast<const char*>(frame->getMetadata()));
+}
+
+TEST_F(PmemStorageTest, Frame_load) {
+    BackupStorage::FrameRef frameRef = storage->open(false);
+    Frame* frame = static_cast<Frame*>(frameRef.get());
+    frame->append(testSource, 0, testLength + 1, 10, NULL, 0);
+    char* replica = bytes(frame->load());
+    EXPECT_EQ(storage->dataOf(frame->frameIndex), replica);
+    EXPECT_STREQ(test, replica + 10);
+    EXPECT_TRUE(frame->isLoaded());
+    EXPECT_THROW(frame->append(testSource, 0, 1, 0, NULL, 0),
+                 BackupBadSegmentIdException);
+}
+
+TEST_F(PmemStorageTest, Frame_append) {
+    BackupStorage::FrameRef frameRef = storage->open(false);
+    Frame* frame = static_cast<Frame*>(frameRef.get());
+    Buffer source;
+    source.appendExternal("abc", 3);
+    source.appendExternal("defgh", 6);
+    frame->append(source, 1, 8, 100, test, testLength + 1);
+    EXPECT_TRUE(frame->wasAppendedToByCurrentProcess());
+    EXPECT_STREQ(test, static_cast<const char*>(frame->getMetadata()));
+
+    // The data and metadata are in the file.
+    int fd = open(path, O_RDONLY);
+    char data[8];
+    EXPECT_EQ(8, pread(fd, data, sizeof(data),
+            storage->dataStart + frame->frameIndex * segmentSize + 100));
+    EXPECT_STREQ("bcdefgh", data);
+    PmemStorage::FrameMetadata metadata;
+    EXPECT_EQ(ssize_t(sizeof(metadata)), pread(fd, &metadata,
+            sizeof(metadata), storage->metadataStart +
+            frame->frameIndex * sizeof(metadata)));
+    EXPECT_EQ(1lu, metadata.activeSlot);
+    EXPECT_STREQ(test, metadata.slots[1]);
+    close(fd);
+
+    // Appends without metadata leave it alone.
+    frame->append(source, 0, 3, 0, NULL, 0);
+    EXPECT_EQ(1lu, storage->metadataOf(frame->frameIndex)->activeSlot);
+    frame->append(source, 0, 3, 0, "x", 2);
+    EXPECT_EQ(0lu, storage->metadataOf(frame->frameIndex)->activeSlot);
+}
+
+TEST_F(PmemStorageTest, Frame_appendErrors) {
+    BackupStorage::FrameRef frameRef = storage->open(false);
+    Frame* frame = static_cast<Frame*>(frameRef.get());
+    EXPECT_THROW(frame->append(testSource, 0, 1, segmentSize, NULL, 0),
+                 BackupSegmentOverflowException);
+    char metadata[METADATA_SIZE + 1];
+    EXPECT_THROW(frame->append(testSource, 0, 1, 0, metadata,
+                               sizeof(metadata)),
+                 BackupSegmentOverflowException);
+    frame->close();
+    EXPECT_THROW(frame->append(testSource, 0, 1, 0, NULL, 0),
+                 BackupBadSegmentIdException);
+}
+
+TEST_F(PmemStorageTest, Frame_reopen) {
+    BackupStorage::FrameRef frameRef = storage->open(false);
+    Frame* frame = static_cast<Frame*>(frameRef.get());
+    frame->close();
+    frame->reopen(5);
+    EXPECT_TRUE(frame->currentlyOpen());
+    frame->append(testSource, 0, testLength + 1, 5, NULL, 0);
+    EXPECT_STREQ(test, bytes(frame->load()) + 5);
+}
+
+TEST_F(PmemStorageTest, constructor) {
+    struct stat st;
+    EXPECT_EQ(0, stat(path, &st));
+    EXPECT_EQ(storage->fileSize, uint64_t(st.st_size));
+    EXPECT_EQ(storage->dataStart + segmentFrames * segmentSize,
+              storage->fileSize);
+    EXPECT_EQ(0lu, storage->dataStart % 4096);
+    EXPECT_EQ(segmentFrames, storage->frames.size());
+    EXPECT_EQ(BackupStorage::Type::PMEM, storage->storageType);
+}
+
+TEST_F(PmemStorageTest, constructor_openFails) {
+    EXPECT_THROW(PmemStorage(segmentSize, segmentFrames, 0,
+                             "/nonexistent/directory/file"),
+                 BackupStorageException);
+}
+
+TEST_F(PmemStorageTest, open) {
+    std::vector<BackupStorage::FrameRef> frames;
+    for (uint32_t i = 0; i < segmentFrames; i++)
+        frames.push_back(storage->open(false));
+    EXPECT_EQ(0u, static_cast<Frame*>(frames[0].get())->frameIndex);
+    EXPECT_EQ(3u, static_cast<Frame*>(frames[3].get())->frameIndex);
+    EXPECT_TRUE(frames[3]->currentlyOpen());
+    EXPECT_THROW(storage->open(false), BackupOpenRejectedException);
+    frames.pop_back();
+    EXPECT_EQ(3u, static_cast<Frame*>(storage->open(false).get())->frameIndex);
+}
+
+TEST_F(PmemStorageTest, loadAllMetadata) {
+    {
+        BackupStorage::FrameRef frame0 = storage->open(true);
+        BackupStorage::FrameRef frame1 = storage->open(true);
+        writeReplica(static_cast<Frame*>(frame0.get()), 70, false);
+        writeReplica(static_cast<Frame*>(frame1.get()), 71, true);
+    }
+    storage.destroy();
+
+    // Replicas survive a restart.
+    storage.construct(segmentSize, segmentFrames, 0, path);
+    std::vector<BackupStorage::FrameRef> frames = storage->loadAllMetadata();
+    ASSERT_EQ(segmentFrames, frames.size());
+    const BackupReplicaMetadata* metadata =
+            static_cast<const BackupReplicaMetadata*>(frames[0]->getMetadata());
+    EXPECT_TRUE(metadata->checkIntegrity());
+    EXPECT_EQ(70lu, metadata->logId);
+    EXPECT_TRUE(frames[0]->currentlyOpen());
+    EXPECT_FALSE(frames[1]->currentlyOpen());
+    EXPECT_TRUE(static_cast<Frame*>(frames[1].get())->isClosed);
+    EXPECT_FALSE(frames[2]->currentlyOpen());
+    EXPECT_FALSE(static_cast<Frame*>(frames[2].get())->isClosed);
+    EXPECT_STREQ(test, bytes(frames[1]->load()));
+}
+
+TEST_F(PmemStorageTest, resetSuperblock) {
+    for (uint32_t expectedVersion = 1; expectedVersion < 3; ++expectedVersion) {
+        storage->resetSuperblock({9999, expectedVersion}, "hasso");
+        for (uint32_t frame = 0; frame < 2; ++frame) {
+            auto superblock = storage->tryLoadSuperblock(frame);
+            ASSERT_TRUE(superblock);
+            EXPECT_EQ(ServerId(9999, expectedVersion),
+                      superblock->getServerId());
+            EXPECT_STREQ("hasso", superblock->getClusterName());
+            EXPECT_EQ(expectedVersion, superblock->version);
+            EXPECT_EQ(1u, storage->lastSuperblockFrame);
+        }
+    }
+}
+
+TEST_F(PmemStorageTest, loadSuperblock) {
+    // "0x1" means skip writing superblock frame 0.
+    storage->resetSuperblock({9997, 2}, "fruuuu", 0x1);
+    // "0x2" means skip writing superblock frame 1.
+    storage->resetSuperblock({9997, 1}, "gruuuu", 0x2);
+    storage.destroy();
+    storage.construct(segmentSize, segmentFrames, 0, path);
+    auto superblock = storage->loadSuperblock();
+    EXPECT_EQ(ServerId(9997, 1), superblock.getServerId());
+    EXPECT_STREQ("gruuuu", superblock.getClusterName());
+    EXPECT_EQ(2u, superblock.version);
+    EXPECT_EQ(0u, storage->lastSuperblockFrame);
+}
+
+TEST_F(PmemStorageTest, loadSuperblock_noneFound) {
+    TestLog::Enable _("loadSuperblock");
+    auto superblock = storage->loadSuperblock();
+    EXPECT_TRUE(StringUtil::startsWith(TestLog::get(),
+                "loadSuperblock: Backup couldn't find existing superblock;"));
+    EXPECT_STREQ("__unnamed__", superblock.getClusterName());
+    EXPECT_EQ(0u, superblock.version);
+    EXPECT_EQ(1u, storage->lastSuperblockFrame);
+}
+
+TEST_F(PmemStorageTest, fry) {
+    {
+        BackupStorage::FrameRef frameRef = storage->open(true);
+        writeReplica(static_cast<Frame*>(frameRef.get()), 70, true);
+    }
+    storage->fry();
+    std::vector<BackupStorage::FrameRef> frames = storage->loadAllMetadata();
+    const BackupReplicaMetadata* metadata =
+            static_cast<const BackupReplicaMetadata*>(frames[0]->getMetadata());
+    EXPECT_FALSE(metadata->checkIntegrity());
+    EXPECT_FALSE(static_cast<Frame*>(frames[0].get())->isClosed);
+}
+
+TEST_F(PmemStorageTest, copyAndFlush) {
+    char source[300];
+    for (uint32_t i = 0; i < sizeof(source); i++)
+        source[i] = static_cast<char>(i);
+    char* base = storage->dataOf(0);
+    uint32_t offsets[] = {0, 1, 15, 16, 63};
+    uint32_t lengths[] = {0, 1, 15, 16, 17, 64, 100, 257};
+    foreach (uint32_t offset, offsets) {
+        foreach (uint32_t length, lengths) {
+            memset(base, 'x', 512);
+            PmemStorage::copyAndFlush(base + offset, source, length);
+            EXPECT_EQ(0, memcmp(base + offset, source, length))
+                << "offset " << offset << " length " << length;
+            EXPECT_EQ('x', base[offset + length]);
+            if (offset > 0) {
+                EXPECT_EQ('x', base[offset - 1]);
+            }
+        }
+    }
+}
+
+} // namespace RAMCloud
@@ -299,6 +299,18 @@ PriorityTaskQueue::deschedule(Lock& lock, PriorityTask* task)
     ++doneCount;
 }
 
+/**
+ * Return true if no tasks are waiting to be performed; a task that is
+ * currently executing doesn't count. Since tasks may be scheduled at any
+ * time, the result is only a hint.
+ */
+bool
+PriorityTaskQueue::isIdle()
+{
+    Lock _(mutex);
+    return tasks.empty();
+}
+
 /**
  * Wait until tasks have completed; NOTICE this call DOES NOT block out new
  * operations and is prone to being starved out. Used primarily by high-level
@@ -159,6 +159,7 @@ class PriorityTaskQueue {
     void start();
     void halt();
 
+    bool isIdle();
     void quiesce();
 
   PRIVATE:
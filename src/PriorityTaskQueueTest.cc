@@ -210,6 +210,14 @@ TEST_F(PriorityTaskQueueTest, deschedule)
     EXPECT_EQ(1lu, taskQueue.doneCount);
 }
 
+TEST_F(PriorityTaskQueueTest, isIdle) {
+    EXPECT_TRUE(taskQueue.isIdle());
+    task1.schedule(PriorityTask::LOW);
+    EXPECT_FALSE(taskQueue.isIdle());
+    taskQueue.performTask();
+    EXPECT_TRUE(taskQueue.isIdle());
+}
+
 TEST_F(PriorityTaskQueueTest, quiesce) {
     task1.schedule(PriorityTask::NORMAL);
 
@@ -201,6 +201,56 @@ RecoverySegmentBuilder::build(const void* buffer, uint32_t length,
     }
 }
 
+/**
+ * Construct recovery segments for a replica which was stored as erasure-coded
+ * fragments, rather than in full. The replica is rebuilt from the fragments
+ * available and then split up exactly as build() does.
+ *
+ * \param code
+ *      The code with which the replica was split into fragments.
+ * \param fragments
+ *      The code.getFragmentCount() fragments of the replica, in order; NULL
+ *      for those that are unavailable (for example, because the backups
+ *      storing them have crashed).
+ * \param length
+ *      Bytes of replica data that were encoded into the fragments.
+ * \param certificate
+ *      Certificate to use to iterate the rebuilt replica; see build().
+ * \param numPartitions
+ *      Total number of partitions that the replica data will be divided
+ *      among.
+ * \param partitions
+ *      Describes how the replica data is to be split up; see build().
+ * \param recoverySegments
+ *      Array of numPartitions Segments to which objects will be appended to
+ *      construct recovery segments.
+ * \throw SegmentIteratorException
+ *      If the metadata of the rebuilt replica doesn't match up with the
+ *      certificate.
+ * \throw SegmentRecoveryFailedException
+ *      If fewer than code.getDataFragments() fragments are available, or if
+ *      one of the recovery segments couldn't be appended to.
+ */
+void
+RecoverySegmentBuilder::buildFromFragments(
+                                const ErasureCode& code,
+                                const std::vector<const void*>& fragments,
+                                uint32_t length,
+                                const SegmentCertificate& certificate,
+                                int numPartitions,
+                                const ProtoBuf::RecoveryPartition& partitions,
+                                Segment* recoverySegments)
+{
+    std::unique_ptr<char[]> replica(new char[length]);
+    if (!code.decode(fragments, length, replica.get())) {
+        LOG(WARNING, "Too few fragments available to rebuild a replica; "
+            "%u are needed", code.getDataFragments());
+        throw SegmentRecoveryFailedException(HERE);
+    }
+    build(replica.get(), length, certificate, numPartitions, partitions,
+          recoverySegments);
+}
+
 /**
  * Scan \a buffer for a LogDigest and a TableStats::Digest.  If either exists,
  * replace the contents of \a digestBuffer with it.
@@ -15,6 +15,7 @@
 
 #include "Common.h"
 #include "Buffer.h"
+#include "ErasureCode.h"
 #include "Key.h"
 #include "Log.h"
 #include "Segment.h"
@@ -46,6 +47,13 @@ class RecoverySegmentBuilder {
                       int numPartitions,
                       const ProtoBuf::RecoveryPartition& partitions,
                       Segment* recoverySegments);
+    static void buildFromFragments(const ErasureCode& code,
+                                   const std::vector<const void*>& fragments,
+                                   uint32_t length,
+                                   const SegmentCertificate& certificate,
+                                   int numPartitions,
+                                   const ProtoBuf::RecoveryPartition& partitions,
+                                   Segment* recoverySegments);
     static bool extractDigest(const void* buffer, uint32_t length,
                               const SegmentCertificate& certificate,
                               Buffer* digestBuffer, Buffer* tableStatsBuffer);
@@ -303,6 +303,58 @@ TEST_F(RecoverySegmentBuilderTest, build_safeVersionEntries) {
             ObjectManager::dumpSegment(&recoverySegments[2]));
 }
 
+TEST_F(RecoverySegmentBuilderTest, buildFromFragments) {
+    LogSegment* segment = segmentManager.allocHeadSegment();
+    for (int i = 0; i < 20; i++) {
+        Key key(1, format("%d", i % 2 + 1).c_str(),
+                downCast<uint16_t>(format("%d", i % 2 + 1).size()));
+        Buffer dataBuffer;
+        Object object(key, "hello", 6, 0, 0, dataBuffer);
+        Buffer buffer;
+        object.assembleForLog(buffer);
+        ASSERT_TRUE(segment->append(LOG_ENTRY_TYPE_OBJ, buffer));
+    }
+    SegmentCertificate certificate;
+    uint32_t length = segment->getAppendedLength(&certificate);
+    char buf[serverConfig.segmentSize];
+    ASSERT_TRUE(segment->copyOut(0, buf, length));
+
+    std::unique_ptr<Segment[]> expected(new Segment[2]);
+    RecoverySegmentBuilder::build(buf, length, certificate, 2, partitions,
+                                  expected.get());
+
+    ErasureCode code(3, 2);
+    uint32_t fragmentLength = code.getFragmentLength(length);
+    std::vector<std::vector<char>> storage(5,
+            std::vector<char>(fragmentLength));
+    std::vector<void*> fragments;
+    for (auto& fragment : storage)
+        fragments.push_back(fragment.data());
+    code.encode(buf, length, fragments);
+
+    // Lose two fragments, including a data fragment.
+    std::vector<const void*> available = {storage[0].data(), NULL,
+                                          storage[2].data(), NULL,
+                                          storage[4].data()};
+    std::unique_ptr<Segment[]> recoverySegments(new Segment[2]);
+    RecoverySegmentBuilder::buildFromFragments(code, available, length,
+            certificate, 2, partitions, recoverySegments.get());
+    EXPECT_EQ(ObjectManager::dumpSegment(&expected[0]),
+              ObjectManager::dumpSegment(&recoverySegments[0]));
+    EXPECT_EQ(ObjectManager::dumpSegment(&expected[1]),
+              ObjectManager::dumpSegment(&recoverySegments[1]));
+    EXPECT_TRUE(StringUtil::contains(
+            ObjectManager::dumpSegment(&recoverySegments[1]),
+            "key '1'"));
+
+    // Lose a third.
+    available[0] = NULL;
+    recoverySegments.reset(new Segment[2]);
+    EXPECT_THROW(RecoverySegmentBuilder::buildFromFragments(code, available,
+            length, certificate, 2, partitions, recoverySegments.get()),
+            SegmentRecoveryFailedException);
+}
+
 TEST_F(RecoverySegmentBuilderTest, build_participantList) {
     auto build = RecoverySegmentBuilder::build;
 
@@ -41,12 +41,16 @@ namespace RAMCloud {
  *      replication.
  * \param allowLocalBackup
  *      Specifies whether to allow replication to the local backup.
+ * \param compressReplicas
+ *      Specifies whether to compress the data of closed segments before
+ *      sending it to backups.
  */
 ReplicaManager::ReplicaManager(Context* context,
                                const ServerId* masterId,
                                uint32_t numReplicas,
                                bool useMinCopysets,
-                               bool allowLocalBackup)
+                               bool allowLocalBackup,
+                               bool compressReplicas)
     : context(context)
     , numReplicas(numReplicas)
     , backupSelector()
@@ -62,6 +66,7 @@ ReplicaManager::ReplicaManager(Context* context,
     , replicationCounter()
     , useMinCopysets(useMinCopysets)
     , allowLocalBackup(allowLocalBackup)
+    , compressReplicas(compressReplicas)
 {
     if (useMinCopysets) {
         backupSelector.reset(new MinCopysetsBackupSelector(context, masterId,
@@ -422,7 +427,7 @@ ReplicaManager::allocateSegment(const Lock& lock,
                                  *replicationEpoch,
                                  dataMutex, segmentId, segment,
                                  isLogHead, *masterId, numReplicas,
-                                 &replicationCounter);
+                                 compressReplicas, &replicationCounter);
     replicatedSegmentList.push_back(*replicatedSegment);
 
     // ReplicatedSegment's constructor has scheduled the open.
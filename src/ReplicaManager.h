@@ -68,7 +68,8 @@ class ReplicaManager
                    const ServerId* masterId,
                    uint32_t numReplicas,
                    bool useMinCopysets,
-                   bool allowLocalBackup);
+                   bool allowLocalBackup,
+                   bool compressReplicas = false);
     ~ReplicaManager();
 
     bool isIdle();
@@ -200,6 +201,12 @@ class ReplicaManager
      */
     bool allowLocalBackup;
 
+    /**
+     * Specifies whether to compress the data of closed segments sent to
+     * backups. See ReplicatedSegment::compressReplicas.
+     */
+    bool compressReplicas;
+
   PUBLIC:
     // Only used by BackupFailureMonitor.
     void handleBackupFailure(ServerId failedId);
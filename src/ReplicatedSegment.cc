@@ -73,6 +73,8 @@ enum { OBEY_SAFETY_CONSTRAINTS = true };
  *      The server id of the master whose log this segment belongs to.
  * \param numReplicas
  *      Number of replicas of this segment that must be maintained.
+ * \param compressReplicas
+ *      If true, compress data sent to backups once the segment is closed.
  * \param replicationCounter
  *      Used to measure time when backup write rpcs are active.
  *      Shared among ReplicatedSegments.
@@ -94,6 +96,7 @@ ReplicatedSegment::ReplicatedSegment(Context* context,
                                      bool normalLogSegment,
                                      ServerId masterId,
                                      uint32_t numReplicas,
+                                     bool compressReplicas,
                                      Tub<CycleCounter<RawMetric>>*
                                                              replicationCounter,
                                      uint32_t maxBytesPerWriteRpc)
@@ -111,6 +114,7 @@ ReplicatedSegment::ReplicatedSegment(Context* context,
     , masterId(masterId)
     , segmentId(segmentId)
     , maxBytesPerWriteRpc(maxBytesPerWriteRpc)
+    , compressReplicas(compressReplicas)
     , queued(true, 0, 0, false)
     , queuedCertificate()
     , openLen(0)
@@ -941,7 +945,8 @@ ReplicatedSegment::performWrite(Replica& replica)
                                        segment, offset, length,
                                        certificateToSend,
                                        false, sendClose,
-                                       replicaIsPrimary(replica));
+                                       replicaIsPrimary(replica),
+                                       compressReplicas && queued.close);
             if (replicaIsPrimary(replica)) {
                 PerfStats::threadStats.replicationRpcs++;
             }
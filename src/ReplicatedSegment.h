@@ -382,6 +382,7 @@ class ReplicatedSegment : public Task {
                       bool normalLogSegment,
                       ServerId masterId,
                       uint32_t numReplicas,
+                      bool compressReplicas,
                       Tub<CycleCounter<RawMetric>>* replicationCounter = NULL,
                       uint32_t maxBytesPerWriteRpc = 1024 * 1024);
     ~ReplicatedSegment();
@@ -498,6 +499,14 @@ class ReplicatedSegment : public Task {
      */
     const uint32_t maxBytesPerWriteRpc;
 
+    /**
+     * If true, data written after the segment has been closed is
+     * compressed before it is sent to backups; it can't change any more,
+     * and it is often most of the segment (for example, for survivor
+     * segments written by the cleaner, or when a lost replica is recreated).
+     */
+    const bool compressReplicas;
+
     /**
      * Tracks how much of a segment the log module has made available for
      * replication.
@@ -17,6 +17,7 @@
 
 #include "TestUtil.h"
 #include "BackupSelector.h"
+#include "Compression.h"
 #include "Memory.h"
 #include "PerfStats.h"
 #include "ReplicatedSegment.h"
@@ -99,7 +100,8 @@ struct ReplicatedSegmentTest : public ::testing::Test {
         CreateSegment(ReplicatedSegmentTest* test,
                       ReplicatedSegment* precedingSegment,
                       uint64_t segmentId,
-                      uint32_t numReplicas)
+                      uint32_t numReplicas,
+                      bool compressReplicas = false)
             : logSegment(test->data, DATA_LEN)
             , segment()
         {
@@ -120,6 +122,7 @@ struct ReplicatedSegmentTest : public ::testing::Test {
                                               true,
                                               test->masterId,
                                               numReplicas,
+                                              compressReplicas,
                                               NULL,
                                               MAX_BYTES_PER_WRITE));
             // Set up ordering constraints between this new segment and the
@@ -1545,6 +1548,66 @@ TEST_F(ReplicatedSegmentTest, performWriteDataLargerThanLimit) {
     reset();
 }
 
+TEST_F(ReplicatedSegmentTest, performWriteCompressesClosedSegment) {
+    reset();
+    delete createSegment;
+    memset(data, 'a', DATA_LEN);
+    createSegment = new CreateSegment(this, NULL, segmentId, numReplicas,
+                                      true);
+    segment = createSegment->segment.get();
+
+    transport.setInput("0 0"); // open
+    transport.setInput("0 0"); // open
+    transport.setInput("0 0"); // write
+    transport.setInput("0 0"); // write
+    createSegment->logSegment.head = openLen + 15;
+    segment->close();
+    taskQueue.performTask(); // send open
+    taskQueue.performTask(); // reap opens
+    transport.clearOutput();
+    taskQueue.performTask(); // send closing writes
+
+    ASSERT_EQ(2u, transport.output.size());
+    Buffer& request = transport.output[0].second;
+    auto* reqHdr = request.getStart<WrReq>();
+    EXPECT_EQ(10u, reqHdr->offset);
+    EXPECT_EQ(15u, reqHdr->length);
+    EXPECT_TRUE(reqHdr->close);
+    EXPECT_LT(0u, reqHdr->compressedLength);
+    EXPECT_GT(15u, reqHdr->compressedLength);
+    ASSERT_EQ(sizeof32(WrReq) + reqHdr->compressedLength, request.size());
+    char decompressed[15];
+    EXPECT_TRUE(Compression::decompress(
+            request.getRange(sizeof32(WrReq), reqHdr->compressedLength),
+            reqHdr->compressedLength, decompressed, 15));
+    EXPECT_EQ(string(15, 'a'), string(decompressed, 15));
+    reset();
+}
+
+TEST_F(ReplicatedSegmentTest, performWriteNoCompressionBeforeClose) {
+    reset();
+    delete createSegment;
+    memset(data, 'a', DATA_LEN);
+    createSegment = new CreateSegment(this, NULL, segmentId, numReplicas,
+                                      true);
+    segment = createSegment->segment.get();
+
+    transport.setInput("0 0"); // open
+    transport.setInput("0 0"); // open
+    transport.setInput("0 0"); // write
+    transport.setInput("0 0"); // write
+    createSegment->logSegment.head = openLen + 15;
+    segment->sync(openLen + 15);
+
+    ASSERT_LE(2u, transport.output.size());
+    Buffer& request = transport.output.back().second;
+    auto* reqHdr = request.getStart<WrReq>();
+    EXPECT_EQ(15u, reqHdr->length);
+    EXPECT_FALSE(reqHdr->close);
+    EXPECT_EQ(0u, reqHdr->compressedLength);
+    reset();
+}
+
 TEST_F(ReplicatedSegmentTest, performWriteClosedButLongerThanMaxTxLimit) {
     SegmentCertificate emptyCertificate;
     transport.setInput("0 0"); // open/write
@@ -0,0 +1,238 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "Cycles.h"
+#include "ProtoBuf.h"
+#include "RpcLatencyStats.h"
+#include "ServerId.h"
+
+namespace RAMCloud {
+
+const uint64_t RpcLatencyStats::NUM_BUCKETS;
+const uint64_t RpcLatencyStats::BUCKET_WIDTH;
+SpinLock RpcLatencyStats::mutex("RpcLatencyStats");
+std::vector<RpcLatencyStats::ThreadLatencies*>
+        RpcLatencyStats::registeredLatencies;
+__thread RpcLatencyStats::ThreadLatencies*
+        RpcLatencyStats::threadLatencies = NULL;
+
+/**
+ * Format one percentile of a latency histogram, in microseconds, for
+ * printClusterLatencies.
+ *
+ * \param histogram
+ *      Histogram whose samples are in nanoseconds.
+ * \param percentile
+ *      Which percentile to print (between 0 and 100).
+ */
+static string
+formatPercentile(const Histogram& histogram, double percentile)
+{
+    uint64_t nanoseconds = histogram.getPercentile(percentile);
+    if (nanoseconds == ~0UL) {
+        return format(" %8s", "outlier");
+    }
+    return format(" %8.1f", static_cast<double>(nanoseconds) * 1e-3);
+}
+
+/**
+ * Merge the latency histograms from all of the threads that have recorded
+ * RPCs.
+ *
+ * \param[out] latencies
+ *      Filled in with one entry for each opcode that has been recorded by
+ *      any thread; any existing contents are overwritten.
+ */
+void
+RpcLatencyStats::collectLatencies(ProtoBuf::RpcLatencies* latencies)
+{
+    latencies->Clear();
+    std::lock_guard<SpinLock> lock(mutex);
+    for (uint32_t opcode = 0; opcode < WireFormat::ILLEGAL_RPC_TYPE;
+            opcode++) {
+        Tub<Histogram> queueingTime, serviceTime;
+        foreach (ThreadLatencies* thread, registeredLatencies) {
+            if (!thread->serviceTime[opcode]) {
+                continue;
+            }
+            if (!serviceTime) {
+                queueingTime.construct(NUM_BUCKETS, BUCKET_WIDTH);
+                serviceTime.construct(NUM_BUCKETS, BUCKET_WIDTH);
+            }
+            queueingTime->merge(*thread->queueingTime[opcode]);
+            serviceTime->merge(*thread->serviceTime[opcode]);
+        }
+        if (!serviceTime) {
+            continue;
+        }
+        ProtoBuf::RpcLatencies::Opcode& entry(*latencies->add_opcode());
+        entry.set_opcode(opcode);
+        queueingTime->serialize(*entry.mutable_queueing_time());
+        serviceTime->serialize(*entry.mutable_service_time());
+    }
+}
+
+/**
+ * Given two collections of cluster-wide RPC latencies, computes the
+ * distribution of the RPCs executed between them and formats it for
+ * printing.
+ *
+ * \param first
+ *      Contains the response buffer from a call to
+ *      CoordinatorClient::serverControlAll for GET_RPC_LATENCIES.
+ * \param second
+ *      Contains the response buffer from a later call to
+ *      CoordinatorClient::serverControlAll for GET_RPC_LATENCIES.
+ *
+ * \return
+ *      A multi-line string with one line for each server and opcode that
+ *      executed RPCs between the two readings, giving latency percentiles
+ *      in microseconds. The string ends in a newline character.
+ */
+string
+RpcLatencyStats::printClusterLatencies(Buffer* first, Buffer* second)
+{
+    std::vector<ProtoBuf::RpcLatencies> firstLatencies, secondLatencies;
+    parseLatencies(first, &firstLatencies);
+    parseLatencies(second, &secondLatencies);
+
+    string result;
+    result.append(format("%6s %-28s %10s %8s %8s %8s %8s %8s %8s\n",
+            "Server", "Opcode", "Count", "Queue50", "Queue99", "Svc50",
+            "Svc90", "Svc99", "Svc99.9"));
+    for (size_t i = 0; i < secondLatencies.size(); i++) {
+        foreach (const ProtoBuf::RpcLatencies::Opcode& entry,
+                secondLatencies[i].opcode()) {
+            Histogram queueingTime(entry.queueing_time());
+            Histogram serviceTime(entry.service_time());
+            if (i < firstLatencies.size()) {
+                foreach (const ProtoBuf::RpcLatencies::Opcode& earlier,
+                        firstLatencies[i].opcode()) {
+                    if (earlier.opcode() == entry.opcode()) {
+                        queueingTime.subtract(
+                                Histogram(earlier.queueing_time()));
+                        serviceTime.subtract(
+                                Histogram(earlier.service_time()));
+                        break;
+                    }
+                }
+            }
+            uint64_t count = serviceTime.getTotalSamples();
+            if (count == 0) {
+                continue;
+            }
+            result.append(format("%6lu %-28s %10lu", i,
+                    WireFormat::opcodeSymbol(entry.opcode()), count));
+            result.append(formatPercentile(queueingTime, 50));
+            result.append(formatPercentile(queueingTime, 99));
+            result.append(formatPercentile(serviceTime, 50));
+            result.append(formatPercentile(serviceTime, 90));
+            result.append(formatPercentile(serviceTime, 99));
+            result.append(formatPercentile(serviceTime, 99.9));
+            result.append("\n");
+        }
+    }
+    return result;
+}
+
+/**
+ * Given the raw response returned by CoordinatorClient::serverControlAll
+ * for GET_RPC_LATENCIES, divide it up into the latencies for each server.
+ *
+ * \param rawData
+ *      Response buffer from a call to CoordinatorClient::serverControlAll.
+ * \param[out] results
+ *      Filled in (possibly sparsely) with contents parsed from rawData.
+ *      Entry i will contain the latencies for the server whose ServerId has
+ *      indexNumber i. Empty entries have no opcodes.
+ */
+void
+RpcLatencyStats::parseLatencies(Buffer* rawData,
+        std::vector<ProtoBuf::RpcLatencies>* results)
+{
+    results->clear();
+    uint32_t offset = sizeof(WireFormat::ServerControlAll::Response);
+    while (offset < rawData->size()) {
+        WireFormat::ServerControl::Response* header =
+                rawData->getOffset<WireFormat::ServerControl::Response>(offset);
+        offset += sizeof32(*header);
+        if ((header == NULL) ||
+                ((offset + header->outputLength) > rawData->size())) {
+            break;
+        }
+        uint32_t i = ServerId(header->serverId).indexNumber();
+        if (i >= results->size()) {
+            results->resize(i+1);
+        }
+        if (header->outputLength > 0) {
+            ProtoBuf::parseFromResponse(rawData, offset, header->outputLength,
+                    &results->at(i));
+        }
+        offset += header->outputLength;
+    }
+}
+
+/**
+ * Record the latencies of an RPC executed by the current thread.
+ *
+ * \param opcode
+ *      The RPC's opcode.
+ * \param queueingCycles
+ *      Time, in Cycles::rdtsc ticks, from when the WorkerManager received
+ *      the request until a thread started executing it.
+ * \param serviceCycles
+ *      Time, in Cycles::rdtsc ticks, spent executing the request.
+ */
+void
+RpcLatencyStats::recordRpc(WireFormat::Opcode opcode, uint64_t queueingCycles,
+        uint64_t serviceCycles)
+{
+    ThreadLatencies* latencies = threadLatencies;
+    if (latencies == NULL || !latencies->serviceTime[opcode]) {
+        std::lock_guard<SpinLock> lock(mutex);
+        if (latencies == NULL) {
+            latencies = new ThreadLatencies;
+            registeredLatencies.push_back(latencies);
+            threadLatencies = latencies;
+        }
+        latencies->queueingTime[opcode].construct(NUM_BUCKETS, BUCKET_WIDTH);
+        latencies->serviceTime[opcode].construct(NUM_BUCKETS, BUCKET_WIDTH);
+    }
+    latencies->queueingTime[opcode]->storeSample(
+            Cycles::toNanoseconds(queueingCycles));
+    latencies->serviceTime[opcode]->storeSample(
+            Cycles::toNanoseconds(serviceCycles));
+}
+
+/**
+ * Discard all of the samples recorded so far. Samples recorded concurrently
+ * by other threads may be lost.
+ */
+void
+RpcLatencyStats::reset()
+{
+    std::lock_guard<SpinLock> lock(mutex);
+    foreach (ThreadLatencies* thread, registeredLatencies) {
+        for (uint32_t opcode = 0; opcode < WireFormat::ILLEGAL_RPC_TYPE;
+                opcode++) {
+            if (thread->serviceTime[opcode]) {
+                thread->queueingTime[opcode]->reset();
+                thread->serviceTime[opcode]->reset();
+            }
+        }
+    }
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,94 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_RPCLATENCYSTATS_H
+#define RAMCLOUD_RPCLATENCYSTATS_H
+
+#include <vector>
+#include "Buffer.h"
+#include "Histogram.h"
+#include "SpinLock.h"
+#include "Tub.h"
+#include "WireFormat.h"
+
+#include "RpcLatencies.pb.h"
+
+namespace RAMCloud {
+
+/**
+ * This class keeps track of the distribution of latencies for each kind of
+ * RPC a server executes. For each opcode it records how long requests
+ * waited before a thread started executing them (queueing time) and how
+ * long they took to execute (service time).
+ *
+ * As with PerfStats, each thread records samples in private histograms, so
+ * recording requires no synchronization; collectLatencies merges the
+ * histograms from all threads on demand (e.g. for the GET_RPC_LATENCIES
+ * server control). The histograms for an opcode are allocated the first
+ * time a thread executes an RPC with that opcode.
+ */
+class RpcLatencyStats {
+  public:
+    static void collectLatencies(ProtoBuf::RpcLatencies* latencies);
+    static string printClusterLatencies(Buffer* first, Buffer* second);
+    static void recordRpc(WireFormat::Opcode opcode, uint64_t queueingCycles,
+            uint64_t serviceCycles);
+    static void reset();
+
+    /// Number of buckets in each histogram. Together with BUCKET_WIDTH,
+    /// this covers latencies up to 1 ms; longer ones count as outliers.
+    static const uint64_t NUM_BUCKETS = 10000;
+
+    /// Width of each histogram bucket, in nanoseconds.
+    static const uint64_t BUCKET_WIDTH = 100;
+
+  PRIVATE:
+    /**
+     * The histograms for a single thread. Entries for an opcode are
+     * constructed (with #mutex held) the first time the thread executes an
+     * RPC with that opcode; after that only the owning thread modifies them.
+     */
+    struct ThreadLatencies {
+        ThreadLatencies()
+            : queueingTime()
+            , serviceTime()
+        {}
+
+        /// Queueing time histograms, indexed by opcode.
+        Tub<Histogram> queueingTime[WireFormat::ILLEGAL_RPC_TYPE];
+
+        /// Service time histograms, indexed by opcode.
+        Tub<Histogram> serviceTime[WireFormat::ILLEGAL_RPC_TYPE];
+    };
+
+    static void parseLatencies(Buffer* rawData,
+            std::vector<ProtoBuf::RpcLatencies>* results);
+
+    /// Used in a monitor-style fashion for mutual exclusion.
+    static SpinLock mutex;
+
+    /// Histograms for all of the threads that have recorded RPCs. Entries
+    /// are never freed, so samples from threads that have exited still
+    /// count.
+    static std::vector<ThreadLatencies*> registeredLatencies;
+
+    /// The histograms for the current thread; NULL until the thread records
+    /// its first RPC.
+    static __thread ThreadLatencies* threadLatencies;
+};
+
+} // end RAMCloud
+
+#endif  // RAMCLOUD_RPCLATENCYSTATS_H
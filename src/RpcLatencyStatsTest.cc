@@ -0,0 +1,181 @@
+/* Copyright (c) 2016 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <thread>
+
+#include "TestUtil.h"
+#include "Cycles.h"
+#include "ProtoBuf.h"
+#include "RpcLatencyStats.h"
+#include "ServerId.h"
+
+namespace RAMCloud {
+
+class RpcLatencyStatsTest : public ::testing::Test {
+  public:
+    RpcLatencyStatsTest()
+    {
+        Cycles::mockCyclesPerSec = 1e09;
+        RpcLatencyStats::registeredLatencies.clear();
+        RpcLatencyStats::threadLatencies = NULL;
+    }
+
+    ~RpcLatencyStatsTest()
+    {
+        Cycles::mockCyclesPerSec = 0;
+        RpcLatencyStats::registeredLatencies.clear();
+        RpcLatencyStats::threadLatencies = NULL;
+    }
+
+    /**
+     * Append the current latencies to a Buffer in the format of
+     * serverControlAll(GET_RPC_LATENCIES), as if they came from the
+     * server with the given id.
+     */
+    void
+    appendLatencies(Buffer* buffer, uint64_t serverId)
+    {
+        if (buffer->size() == 0) {
+            WireFormat::ServerControlAll::Response* header = buffer->
+                    emplaceAppend<WireFormat::ServerControlAll::Response>();
+            header->common.status = STATUS_OK;
+            header->serverCount = 0;
+            header->respCount = 0;
+            header->totalRespLength = 0;
+        }
+        WireFormat::ServerControl::Response* subHead = buffer->
+                emplaceAppend<WireFormat::ServerControl::Response>();
+        subHead->common.status = STATUS_OK;
+        subHead->serverId = serverId;
+        ProtoBuf::RpcLatencies latencies;
+        RpcLatencyStats::collectLatencies(&latencies);
+        subHead->outputLength = ProtoBuf::serializeToResponse(buffer,
+                &latencies);
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(RpcLatencyStatsTest);
+};
+
+// Helper function for the following test.
+static void recordInOtherThread() {
+    RpcLatencyStats::recordRpc(WireFormat::READ, 500, 3000);
+}
+
+TEST_F(RpcLatencyStatsTest, collectLatencies) {
+    RpcLatencyStats::recordRpc(WireFormat::READ, 100, 2000);
+    RpcLatencyStats::recordRpc(WireFormat::WRITE, 200, 5000);
+    std::thread thread(recordInOtherThread);
+    thread.join();
+    EXPECT_EQ(2u, RpcLatencyStats::registeredLatencies.size());
+
+    ProtoBuf::RpcLatencies latencies;
+    RpcLatencyStats::collectLatencies(&latencies);
+    ASSERT_EQ(2, latencies.opcode_size());
+    EXPECT_EQ(WireFormat::READ, latencies.opcode(0).opcode());
+    Histogram queueingTime(latencies.opcode(0).queueing_time());
+    Histogram serviceTime(latencies.opcode(0).service_time());
+    EXPECT_EQ(2u, serviceTime.getTotalSamples());
+    EXPECT_EQ(100u, queueingTime.getMin());
+    EXPECT_EQ(500u, queueingTime.getMax());
+    EXPECT_EQ(2000u, serviceTime.getMin());
+    EXPECT_EQ(3000u, serviceTime.getMax());
+    EXPECT_EQ(WireFormat::WRITE, latencies.opcode(1).opcode());
+    EXPECT_EQ(1u, Histogram(latencies.opcode(1).service_time())
+            .getTotalSamples());
+}
+
+TEST_F(RpcLatencyStatsTest, printClusterLatencies) {
+    Buffer before, after;
+    RpcLatencyStats::recordRpc(WireFormat::READ, 100, 2000);
+    appendLatencies(&before, ServerId(1, 0).getId());
+    for (int i = 0; i < 99; i++) {
+        RpcLatencyStats::recordRpc(WireFormat::READ, 200, 5000);
+    }
+    RpcLatencyStats::recordRpc(WireFormat::READ, 2000000, 12000);
+    appendLatencies(&after, ServerId(1, 0).getId());
+    RpcLatencyStats::recordRpc(WireFormat::WRITE, 300, 8000);
+    appendLatencies(&after, ServerId(2, 0).getId());
+
+    EXPECT_EQ(
+        "Server Opcode                            Count  Queue50  Queue99"
+        "    Svc50    Svc90    Svc99  Svc99.9\n"
+        "     1 READ                                100      0.2      0.2"
+        "      5.0      5.0      5.0     12.0\n"
+        "     2 READ                                101      0.2      0.2"
+        "      5.0      5.0      5.0     12.0\n"
+        "     2 WRITE                                 1      0.3      0.3"
+        "      8.0      8.0      8.0      8.0\n",
+        RpcLatencyStats::printClusterLatencies(&before, &after));
+
+    // Queueing times beyond the last bucket.
+    before.reset();
+    after.reset();
+    RpcLatencyStats::reset();
+    appendLatencies(&before, ServerId(1, 0).getId());
+    RpcLatencyStats::recordRpc(WireFormat::READ, 2000000, 2000);
+    appendLatencies(&after, ServerId(1, 0).getId());
+    EXPECT_EQ(
+        "Server Opcode                            Count  Queue50  Queue99"
+        "    Svc50    Svc90    Svc99  Svc99.9\n"
+        "     1 READ                                  1  outlier  outlier"
+        "      2.0      2.0      2.0      2.0\n",
+        RpcLatencyStats::printClusterLatencies(&before, &after));
+}
+
+TEST_F(RpcLatencyStatsTest, parseLatencies) {
+    Buffer buffer;
+    RpcLatencyStats::recordRpc(WireFormat::READ, 100, 2000);
+    appendLatencies(&buffer, ServerId(3, 0).getId());
+    std::vector<ProtoBuf::RpcLatencies> results;
+    RpcLatencyStats::parseLatencies(&buffer, &results);
+    ASSERT_EQ(4u, results.size());
+    EXPECT_EQ(0, results[1].opcode_size());
+    EXPECT_EQ(1, results[3].opcode_size());
+
+    // Truncated response.
+    buffer.truncate(buffer.size() - 1);
+    RpcLatencyStats::parseLatencies(&buffer, &results);
+    EXPECT_EQ(0u, results.size());
+}
+
+TEST_F(RpcLatencyStatsTest, recordRpc) {
+    RpcLatencyStats::recordRpc(WireFormat::READ, 100, 2000);
+    RpcLatencyStats::ThreadLatencies* latencies =
+            RpcLatencyStats::threadLatencies;
+    ASSERT_TRUE(latencies != NULL);
+    EXPECT_EQ(1u, RpcLatencyStats::registeredLatencies.size());
+    EXPECT_TRUE(latencies->serviceTime[WireFormat::READ]);
+    EXPECT_FALSE(latencies->serviceTime[WireFormat::WRITE]);
+
+    RpcLatencyStats::recordRpc(WireFormat::READ, 300, 2160);
+    EXPECT_EQ(latencies, RpcLatencyStats::threadLatencies);
+    EXPECT_EQ(1u, RpcLatencyStats::registeredLatencies.size());
+    Histogram* queueingTime = latencies->queueingTime[WireFormat::READ].get();
+    Histogram* serviceTime = latencies->serviceTime[WireFormat::READ].get();
+    EXPECT_EQ(2u, serviceTime->getTotalSamples());
+    EXPECT_EQ(200u, queueingTime->getAverage());
+    EXPECT_EQ(2080u, serviceTime->getAverage());
+    EXPECT_EQ(2200u, serviceTime->getPercentile(100));
+}
+
+TEST_F(RpcLatencyStatsTest, reset) {
+    RpcLatencyStats::recordRpc(WireFormat::READ, 100, 2000);
+    RpcLatencyStats::reset();
+    Histogram* serviceTime = RpcLatencyStats::threadLatencies->
+            serviceTime[WireFormat::READ].get();
+    EXPECT_EQ(0u, serviceTime->getTotalSamples());
+}
+
+}  // namespace RAMCloud
@@ -69,6 +69,62 @@ struct Parser<std::queue<T>> : public RuntimeOptions::Parseable {
 
 };
 
+/**
+ * Specialization which parses strings of form "a b c" to std::set<T>, in
+ * the same way as the std::queue<T> specialization above.
+ */
+template <typename T>
+struct Parser<std::set<T>> : public RuntimeOptions::Parseable {
+    explicit Parser(std::set<T>& target)
+        : target(target), optionValue("")
+    {}
+
+    void
+    parse(const char* value)
+    {
+        target.clear();
+        std::istringstream iss(value);
+        auto begin = std::istream_iterator<T>(iss);
+        auto end = std::istream_iterator<T>();
+        target.insert(begin, end);
+        optionValue = value;
+    }
+    std::string
+    getValue() {
+        return optionValue;
+    }
+    // target holds a parsed copy of value for the option.
+    std::set<T>& target;
+    // A copy of the value string is saved in optionValue.
+    std::string optionValue;
+};
+
+/**
+ * Specialization which parses a single unsigned integer, such as "10".
+ * Strings that don't start with a number parse as 0.
+ */
+template <>
+struct Parser<uint32_t> : public RuntimeOptions::Parseable {
+    explicit Parser(uint32_t& target)
+        : target(target), optionValue(std::to_string(target))
+    {}
+
+    void
+    parse(const char* value)
+    {
+        target = static_cast<uint32_t>(strtoul(value, NULL, 0));
+        optionValue = std::to_string(target);
+    }
+    std::string
+    getValue() {
+        return optionValue;
+    }
+    // target holds the parsed value of the option.
+    uint32_t& target;
+    // The parsed value, as a string, for the get method.
+    std::string optionValue;
+};
+
 /**
  * Parser for coordinator crash point run time options.
  * An option is just a string in this case and currently,
@@ -130,9 +186,17 @@ RuntimeOptions::RuntimeOptions()
     , mutex()
     , failRecoveryMasters()
     , crashCoordinator()
+    , logGroupCommitWindowMicros(0)
+    , logGroupCommitBytes(32768)
+    , cleanerTargetHeadroomMillis(100)
+    , compressedTables()
 {
 #define REGISTER(field) registerOption(#field, newParser(field))
     REGISTER(failRecoveryMasters);
+    REGISTER(logGroupCommitWindowMicros);
+    REGISTER(logGroupCommitBytes);
+    REGISTER(cleanerTargetHeadroomMillis);
+    REGISTER(compressedTables);
 #undef REGISTER
     registerOption("crashCoordinator",
             newcrashCoordParser(crashCoordinator));
@@ -218,6 +282,38 @@ RuntimeOptions::checkAndCrashCoordinator(const char *crashPoint)
     }
 }
 
+/// Return the current value of #logGroupCommitWindowMicros.
+uint32_t
+RuntimeOptions::getLogGroupCommitWindowMicros()
+{
+    Lock _(mutex);
+    return logGroupCommitWindowMicros;
+}
+
+/// Return the current value of #logGroupCommitBytes.
+uint32_t
+RuntimeOptions::getLogGroupCommitBytes()
+{
+    Lock _(mutex);
+    return logGroupCommitBytes;
+}
+
+/// Return the current value of #cleanerTargetHeadroomMillis.
+uint32_t
+RuntimeOptions::getCleanerTargetHeadroomMillis()
+{
+    Lock _(mutex);
+    return cleanerTargetHeadroomMillis;
+}
+
+/// Return a copy of the current value of #compressedTables.
+std::set<uint64_t>
+RuntimeOptions::getCompressedTables()
+{
+    Lock _(mutex);
+    return compressedTables;
+}
+
 // - private -
 
 /**
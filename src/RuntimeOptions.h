@@ -18,6 +18,7 @@
 
 #include <mutex>
 #include <queue>
+#include <set>
 #include <unordered_map>
 #include <string>
 #include "Common.h"
@@ -26,7 +27,9 @@ namespace RAMCloud {
 
 /**
  * Contains coordinator configuration options which can be modified while the
- * cluster is running. Allows the coordinator fast access to configuration
+ * cluster is running. Masters also keep an instance for the few options that
+ * tune them at runtime (set through the SET_MASTER_RUNTIME_OPTION server
+ * control). Allows the coordinator fast access to configuration
  * options without any kind of lookup while allowing clients to set
  * configuration options by a string name. This makes it easy to add
  * configuration options without adding rpc types. Since configuration
@@ -45,6 +48,10 @@ class RuntimeOptions {
         std::string get(const char* option);
         uint32_t popFailRecoveryMasters();
         void checkAndCrashCoordinator(const char *crashPoint);
+        uint32_t getLogGroupCommitWindowMicros();
+        uint32_t getLogGroupCommitBytes();
+        uint32_t getCleanerTargetHeadroomMillis();
+        std::set<uint64_t> getCompressedTables();
 
     PRIVATE:
         /**
@@ -94,6 +101,38 @@ class RuntimeOptions {
          */
         std::string crashCoordinator;
 
+        /**
+         * Master option: the longest time, in microseconds, Log::sync() may
+         * delay replication so that concurrent writes can join the same
+         * replication round (group commit). The window actually used adapts
+         * to load up to this value. 0 disables group commit. See
+         * Log::setGroupCommitOptions().
+         */
+        uint32_t logGroupCommitWindowMicros;
+
+        /**
+         * Master option: a group commit stops waiting for more writers once
+         * this many bytes have been appended to the log. 0 means no limit.
+         */
+        uint32_t logGroupCommitBytes;
+
+        /**
+         * Master option: the log cleaner starts working before memory
+         * utilization thresholds are reached if the free memory left would
+         * last less than this many milliseconds at the current write rate.
+         * 0 disables pacing. See LogCleaner::setTargetHeadroom().
+         */
+        uint32_t cleanerTargetHeadroomMillis;
+
+        /**
+         * Master option: ids of the tables whose object values this master
+         * compresses in its log, e.g. "1 7". Objects written while their
+         * table is listed are compressed immediately; others are compressed
+         * when the cleaner relocates them. Tables that are dropped from the
+         * list are not decompressed. See Object::compressValue().
+         */
+        std::set<uint64_t> compressedTables;
+
     DISALLOW_COPY_AND_ASSIGN(RuntimeOptions);
 };
 
@@ -70,5 +70,45 @@ TEST_F(RuntimeOptionsTest, popFailRecoveryMasters) {
     EXPECT_EQ(0u, options.popFailRecoveryMasters());
 }
 
+TEST_F(RuntimeOptionsTest, logGroupCommitOptions) {
+    EXPECT_EQ(0u, options.getLogGroupCommitWindowMicros());
+    EXPECT_EQ("0", options.get("logGroupCommitWindowMicros"));
+    EXPECT_EQ(32768u, options.getLogGroupCommitBytes());
+    EXPECT_EQ("32768", options.get("logGroupCommitBytes"));
+
+    options.set("logGroupCommitWindowMicros", "25");
+    options.set("logGroupCommitBytes", "4096");
+    EXPECT_EQ(25u, options.getLogGroupCommitWindowMicros());
+    EXPECT_EQ("25", options.get("logGroupCommitWindowMicros"));
+    EXPECT_EQ(4096u, options.getLogGroupCommitBytes());
+
+    options.set("logGroupCommitWindowMicros", "junk");
+    EXPECT_EQ(0u, options.getLogGroupCommitWindowMicros());
+    EXPECT_EQ("0", options.get("logGroupCommitWindowMicros"));
+}
+
+TEST_F(RuntimeOptionsTest, cleanerTargetHeadroomMillis) {
+    EXPECT_EQ(100u, options.getCleanerTargetHeadroomMillis());
+    EXPECT_EQ("100", options.get("cleanerTargetHeadroomMillis"));
+
+    options.set("cleanerTargetHeadroomMillis", "0");
+    EXPECT_EQ(0u, options.getCleanerTargetHeadroomMillis());
+    EXPECT_EQ("0", options.get("cleanerTargetHeadroomMillis"));
+}
+
+TEST_F(RuntimeOptionsTest, compressedTables) {
+    EXPECT_TRUE(options.getCompressedTables().empty());
+
+    options.set("compressedTables", "7 1 7");
+    std::set<uint64_t> tables = options.getCompressedTables();
+    EXPECT_EQ(2u, tables.size());
+    EXPECT_EQ(1u, tables.count(1));
+    EXPECT_EQ(1u, tables.count(7));
+    EXPECT_EQ("7 1 7", options.get("compressedTables"));
+
+    options.set("compressedTables", "");
+    EXPECT_TRUE(options.getCompressedTables().empty());
+}
+
 
 }  // namespace RAMCloud
@@ -13,6 +13,10 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <fstream>
+
 #include "Common.h"
 #include "BitOps.h"
 #include "LogSegment.h"
@@ -23,6 +27,9 @@
 
 namespace RAMCloud {
 
+uint32_t SegletAllocator::mockNumaNodeCount = 0;
+int SegletAllocator::mockCurrentNumaNode = -1;
+
 /**
  * Construct a new SegmentAllocator by allocating a large chunk of memory
  * and chopping it up into individual seglets of the specified size. All
@@ -41,16 +48,32 @@ SegletAllocator::SegletAllocator(const ServerConfig* config)
       emergencyHeadPoolReserve(0),
       cleanerPool(),
       cleanerPoolReserve(0),
-      defaultPool(),
+      defaultPools(),
+      segletsPerNumaNode(0),
       segletToSegmentTable(),
       block(config->master.logBytes)
 {
     assert(BitOps::isPowerOfTwo(segletSize));
+
+    uint32_t numNodes = 1;
+    if (config->master.numaAwareSeglets) {
+        uint32_t systemNodes = getSystemNumaNodeCount();
+        if (systemNodes > 1 && getTotalCount() >= systemNodes &&
+                bindToNumaNodes(systemNodes)) {
+            numNodes = systemNodes;
+        } else {
+            LOG(NOTICE, "Not splitting log memory across NUMA nodes "
+                "(%u node(s) available)", systemNodes);
+        }
+    }
+    defaultPools.resize(numNodes);
+    segletsPerNumaNode = (getTotalCount() + numNodes - 1) / numNodes;
+
     uint8_t* segletBlock = block.get();
-    for (size_t i = 0; i < (block.length / segletSize); i++) {
+    for (size_t i = 0; i < getTotalCount(); i++) {
         Seglet* seglet = new Seglet(*this, segletBlock, segletSize);
         segletToSegmentTable.push_back(NULL);
-        defaultPool.push_back(seglet);
+        defaultPools[i / segletsPerNumaNode].push_back(seglet);
         segletBlock += segletSize;
     }
 }
@@ -63,7 +86,7 @@ SegletAllocator::~SegletAllocator()
 {
     size_t totalFree = emergencyHeadPool.size() +
                        cleanerPool.size() +
-                       defaultPool.size();
+                       getDefaultPoolsSize();
     size_t expectedFree = block.length / segletSize;
 
     if (totalFree != expectedFree)
@@ -73,8 +96,10 @@ SegletAllocator::~SegletAllocator()
         delete s;
     foreach (Seglet* s, cleanerPool)
         delete s;
-    foreach (Seglet* s, defaultPool)
-        delete s;
+    foreach (vector<Seglet*>& pool, defaultPools) {
+        foreach (Seglet* s, pool)
+            delete s;
+    }
 }
 
 /**
@@ -95,7 +120,10 @@ SegletAllocator::getMetrics(ProtoBuf::LogMetrics_SegletMetrics& m)
     m.set_emergency_head_pool_count(emergencyHeadPool.size());
     m.set_cleaner_pool_reserve(cleanerPoolReserve);
     m.set_cleaner_pool_count(cleanerPool.size());
-    m.set_default_pool_count(defaultPool.size());
+    m.set_default_pool_count(getDefaultPoolsSize());
+    m.clear_default_pool_count_per_numa_node();
+    foreach (vector<Seglet*>& pool, defaultPools)
+        m.add_default_pool_count_per_numa_node(pool.size());
 }
 
 /**
@@ -124,7 +152,7 @@ SegletAllocator::alloc(AllocationType type,
     if (type == CLEANER)
         return allocFromPool(cleanerPool, count, outSeglets);
 
-    return allocFromPool(defaultPool, count, outSeglets);
+    return allocFromDefaultPools(getCurrentNumaNode(), count, outSeglets);
 }
 
 /**
@@ -148,7 +176,8 @@ SegletAllocator::initializeEmergencyHeadReserve(uint32_t numSeglets)
     if (emergencyHeadPoolReserve != 0)
         return false;
 
-    if (!allocFromPool(defaultPool, numSeglets, emergencyHeadPool))
+    if (!allocFromDefaultPools(getCurrentNumaNode(), numSeglets,
+                               emergencyHeadPool))
         return false;
 
     foreach (Seglet* seglet, emergencyHeadPool)
@@ -158,8 +187,8 @@ SegletAllocator::initializeEmergencyHeadReserve(uint32_t numSeglets)
         "%lu seglets (%lu MB) left in default pool.",
         numSeglets,
         static_cast<uint64_t>(numSeglets) * segletSize / 1024 / 1024,
-        defaultPool.size(),
-        defaultPool.size() * segletSize / 1024 / 1024);
+        getDefaultPoolsSize(),
+        getDefaultPoolsSize() * segletSize / 1024 / 1024);
 
     emergencyHeadPoolReserve = numSeglets;
     return true;
@@ -186,15 +215,15 @@ SegletAllocator::initializeCleanerReserve(uint32_t numSeglets)
     if (cleanerPoolReserve != 0)
         return false;
 
-    if (!allocFromPool(defaultPool, numSeglets, cleanerPool))
+    if (!allocFromDefaultPools(getCurrentNumaNode(), numSeglets, cleanerPool))
         return false;
 
     LOG(NOTICE, "Reserved %u seglets for the cleaner (%lu MB). %lu seglets "
         "(%lu MB) left in default pool.",
         numSeglets,
         static_cast<uint64_t>(numSeglets) * segletSize / 1024 / 1024,
-        defaultPool.size(),
-        defaultPool.size() * segletSize / 1024 / 1024);
+        getDefaultPoolsSize(),
+        getDefaultPoolsSize() * segletSize / 1024 / 1024);
 
     cleanerPoolReserve = numSeglets;
     return true;
@@ -240,7 +269,7 @@ SegletAllocator::free(Seglet* seglet)
     // If we're making forward progress, any excess clean seglets accumulate in
     // the default pool. New log heads can allocate from this to service new
     // log appends.
-    defaultPool.push_back(seglet);
+    defaultPools[getNumaNode(seglet)].push_back(seglet);
 }
 
 /**
@@ -267,7 +296,7 @@ SegletAllocator::getFreeCount(AllocationType type)
     if (type == CLEANER)
         return cleanerPool.size();
     assert(type == DEFAULT);
-    return defaultPool.size();
+    return getDefaultPoolsSize();
 }
 
 size_t
@@ -324,10 +353,69 @@ SegletAllocator::getMemoryUtilization()
     size_t maxDefaultPoolSize = getTotalCount() -
                                 emergencyHeadPoolReserve -
                                 cleanerPoolReserve;
-    return downCast<int>(100 * (maxDefaultPoolSize - defaultPool.size()) /
+    return downCast<int>(100 * (maxDefaultPoolSize - getDefaultPoolsSize()) /
                          maxDefaultPoolSize);
 }
 
+/**
+ * Return the number of NUMA nodes the log's memory is split across. This is
+ * 1 unless the master was configured with numaAwareSeglets and runs on a
+ * multi-node machine.
+ */
+uint32_t
+SegletAllocator::getNumaNodeCount()
+{
+    return downCast<uint32_t>(defaultPools.size());
+}
+
+/**
+ * Return the NUMA node that the given seglet's memory is bound to (0 if the
+ * log isn't split across nodes).
+ */
+uint32_t
+SegletAllocator::getNumaNode(const Seglet* seglet)
+{
+    return downCast<uint32_t>(getSegletIndex(seglet->get()) /
+                              segletsPerNumaNode);
+}
+
+/**
+ * Return the number of NUMA nodes in this machine, as reported by sysfs
+ * (1 if that information isn't available).
+ */
+uint32_t
+SegletAllocator::getSystemNumaNodeCount()
+{
+    if (mockNumaNodeCount != 0)
+        return mockNumaNodeCount;
+
+    // The file contains a list of ranges such as "0-1" or "0,2-3"; node ids
+    // are dense in practice, so the last id in the list is all we need.
+    std::ifstream online("/sys/devices/system/node/online");
+    string nodes;
+    if (!(online >> nodes) || nodes.empty())
+        return 1;
+    size_t lastStart = nodes.find_last_of(",-");
+    lastStart = (lastStart == string::npos) ? 0 : lastStart + 1;
+    return downCast<uint32_t>(
+            strtoul(nodes.c_str() + lastStart, NULL, 10)) + 1;
+}
+
+/**
+ * Return the NUMA node of the core the calling thread is running on.
+ */
+uint32_t
+SegletAllocator::getCurrentNumaNode()
+{
+    if (mockCurrentNumaNode >= 0)
+        return mockCurrentNumaNode;
+
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0)
+        return 0;
+    return node;
+}
+
 /**
  * XXX
  */
@@ -400,4 +488,102 @@ SegletAllocator::allocFromPool(vector<Seglet*>& pool,
     return true;
 }
 
+/**
+ * Allocate the exact number of requested seglets from the default pools.
+ * Seglets are taken from the preferred NUMA node's pool if it has enough of
+ * them, otherwise from the first other node that does, so that a segment's
+ * seglets all live on one node whenever possible. Only if no single node can
+ * satisfy the request are seglets gathered from several nodes. If the full
+ * allocation cannot be met, allocate nothing and return false.
+ *
+ * This must be called with the monitor lock held.
+ *
+ * \param preferredNode
+ *      The NUMA node to allocate from if possible (typically that of the
+ *      calling thread). Taken modulo the number of default pools.
+ * \param count
+ *      The number of seglets to allocate.
+ * \param outSeglets
+ *      Vector to return allocated seglets in.
+ * \return
+ *      True if the full allocation succeeded, otherwise false.
+ */
+bool
+SegletAllocator::allocFromDefaultPools(uint32_t preferredNode,
+                                       uint32_t count,
+                                       vector<Seglet*>& outSeglets)
+{
+    uint32_t numNodes = getNumaNodeCount();
+    for (uint32_t i = 0; i < numNodes; i++) {
+        uint32_t node = (preferredNode + i) % numNodes;
+        if (allocFromPool(defaultPools[node], count, outSeglets))
+            return true;
+    }
+
+    if (getDefaultPoolsSize() < count)
+        return false;
+
+    for (uint32_t i = 0; i < numNodes && count > 0; i++) {
+        vector<Seglet*>& pool = defaultPools[(preferredNode + i) % numNodes];
+        uint32_t n = downCast<uint32_t>(std::min<size_t>(count, pool.size()));
+        allocFromPool(pool, n, outSeglets);
+        count -= n;
+    }
+    return true;
+}
+
+/**
+ * Return the total number of seglets in all of the default pools.
+ *
+ * This must be called with the monitor lock held.
+ */
+size_t
+SegletAllocator::getDefaultPoolsSize()
+{
+    size_t total = 0;
+    foreach (vector<Seglet*>& pool, defaultPools)
+        total += pool.size();
+    return total;
+}
+
+/**
+ * Split #block into equal, seglet-aligned ranges and bind the memory of each
+ * one to a different NUMA node, migrating any pages that have already been
+ * faulted in. Called once from the constructor.
+ *
+ * \param numNodes
+ *      Number of NUMA nodes to spread the memory across.
+ * \return
+ *      True if every range was bound, false if the kernel refused. In that
+ *      case earlier ranges may already have been bound, but the log should
+ *      be treated as a single node.
+ */
+bool
+SegletAllocator::bindToNumaNodes(uint32_t numNodes)
+{
+    if (mockNumaNodeCount != 0)
+        return true;
+
+    size_t segletsPerNode = (getTotalCount() + numNodes - 1) / numNodes;
+    size_t bytesPerNode = segletsPerNode * segletSize;
+    const unsigned long maxNode = 8 * sizeof(unsigned long); // NOLINT
+    for (uint32_t node = 0; node < numNodes; node++) {
+        size_t offset = node * bytesPerNode;
+        if (offset >= block.length)
+            break;
+        size_t length = std::min(bytesPerNode, block.length - offset);
+        unsigned long nodeMask = 1UL << node; // NOLINT
+        if (node >= maxNode || syscall(SYS_mbind, block.get() + offset,
+                length, MPOL_BIND, &nodeMask, maxNode, MPOL_MF_MOVE) != 0) {
+            LOG(WARNING, "Couldn't bind seglet memory to NUMA node %u: %s",
+                node, strerror(errno));
+            return false;
+        }
+    }
+
+    LOG(NOTICE, "Split %lu MB of seglets across %u NUMA nodes",
+        block.length / 1024 / 1024, numNodes);
+    return true;
+}
+
 } // end RAMCloud
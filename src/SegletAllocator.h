@@ -89,11 +89,32 @@ class SegletAllocator {
     LogSegment* getOwnerSegment(const void* p);
     void setOwnerSegment(Seglet* seglet, LogSegment* segment);
 
+    uint32_t getNumaNodeCount();
+    uint32_t getNumaNode(const Seglet* seglet);
+
+    static uint32_t getSystemNumaNodeCount();
+    static uint32_t getCurrentNumaNode();
+
+    /// If non-zero, getSystemNumaNodeCount() returns this value instead of
+    /// querying the system, and seglet memory is not actually bound to any
+    /// node. Used in unit tests.
+    static uint32_t mockNumaNodeCount;
+
+    /// If non-negative, getCurrentNumaNode() returns this value instead of
+    /// asking the kernel which node the calling thread is running on. Used
+    /// in unit tests.
+    static int mockCurrentNumaNode;
+
   PRIVATE:
     size_t getSegletIndex(const void* p);
     bool allocFromPool(vector<Seglet*>& pool,
                        uint32_t count,
                        vector<Seglet*>& outSeglets);
+    bool allocFromDefaultPools(uint32_t preferredNode,
+                               uint32_t count,
+                               vector<Seglet*>& outSeglets);
+    size_t getDefaultPoolsSize();
+    bool bindToNumaNodes(uint32_t numNodes);
 
     /// Size of each seglet in bytes.
     const uint32_t segletSize;
@@ -137,8 +158,17 @@ class SegletAllocator {
     /// Maximum number of seglets to reserve in the cleanerPool.
     uint32_t cleanerPoolReserve;
 
-    /// Pool holding all other seglets not otherwise reserved.
-    vector<Seglet*> defaultPool;
+    /// Pools holding all other seglets not otherwise reserved. There is one
+    /// pool per NUMA node the log memory is spread across (just one unless
+    /// the master was configured with numaAwareSeglets). Each seglet always
+    /// returns to the pool for the node its memory lives on, and DEFAULT
+    /// allocations are served from the calling thread's node when possible,
+    /// so that new head segments are local to the threads filling them.
+    vector<vector<Seglet*>> defaultPools;
+
+    /// Number of consecutive seglets in #block whose memory is bound to each
+    /// NUMA node. Seglet i lives on node i / segletsPerNumaNode.
+    size_t segletsPerNumaNode;
 
     /// Table mapping blocks of memory backing Seglets to their owner LogSegment
     /// objects. This allows getOwnerSegment() to look up a LogSegment object
@@ -44,7 +44,28 @@ TEST_F(SegletAllocatorTest, constructor) {
     EXPECT_EQ(0U, allocator.cleanerPoolReserve);
     EXPECT_EQ(0U, allocator.cleanerPool.size());
     EXPECT_EQ(serverConfig.master.logBytes / serverConfig.segletSize,
-        allocator.defaultPool.size());
+        allocator.defaultPools[0].size());
+}
+
+TEST_F(SegletAllocatorTest, constructor_numaAware) {
+    SegletAllocator::mockNumaNodeCount = 2;
+    serverConfig.master.numaAwareSeglets = true;
+    SegletAllocator numaAllocator(&serverConfig);
+    SegletAllocator::mockNumaNodeCount = 0;
+
+    size_t total = serverConfig.master.logBytes / serverConfig.segletSize;
+    EXPECT_EQ(2U, numaAllocator.getNumaNodeCount());
+    EXPECT_EQ(total / 2, numaAllocator.defaultPools[0].size());
+    EXPECT_EQ(total / 2, numaAllocator.defaultPools[1].size());
+    foreach (Seglet* s, numaAllocator.defaultPools[1])
+        EXPECT_EQ(1U, numaAllocator.getNumaNode(s));
+
+    // A single-node machine gets a single pool, even if requested.
+    SegletAllocator::mockNumaNodeCount = 1;
+    SegletAllocator singleAllocator(&serverConfig);
+    SegletAllocator::mockNumaNodeCount = 0;
+    EXPECT_EQ(1U, singleAllocator.getNumaNodeCount());
+    EXPECT_EQ(total, singleAllocator.defaultPools[0].size());
 }
 
 TEST_F(SegletAllocatorTest, destructor) {
@@ -74,7 +95,7 @@ TEST_F(SegletAllocatorTest, alloc) {
     EXPECT_EQ(0U, allocator.cleanerPool.size());
     EXPECT_FALSE(allocator.alloc(SegletAllocator::CLEANER, 1, seglets));
 
-    EXPECT_EQ(318U, allocator.defaultPool.size());
+    EXPECT_EQ(318U, allocator.defaultPools[0].size());
     EXPECT_TRUE(allocator.alloc(SegletAllocator::DEFAULT, 254, seglets));
     EXPECT_EQ(0U, allocator.cleanerPool.size());
 
@@ -82,13 +103,70 @@ TEST_F(SegletAllocatorTest, alloc) {
         s->free();
 }
 
+TEST_F(SegletAllocatorTest, alloc_numaAware) {
+    SegletAllocator::mockNumaNodeCount = 2;
+    serverConfig.master.numaAwareSeglets = true;
+    SegletAllocator numaAllocator(&serverConfig);
+    SegletAllocator::mockNumaNodeCount = 0;
+    uint32_t perNode = downCast<uint32_t>(numaAllocator.defaultPools[1].size());
+    vector<Seglet*> local, remote, mixed;
+
+    // Allocations come from the calling thread's node.
+    SegletAllocator::mockCurrentNumaNode = 1;
+    EXPECT_TRUE(numaAllocator.alloc(SegletAllocator::DEFAULT, 4, local));
+    foreach (Seglet* s, local)
+        EXPECT_EQ(1U, numaAllocator.getNumaNode(s));
+    EXPECT_EQ(perNode - 4, numaAllocator.defaultPools[1].size());
+
+    // ... unless it doesn't have enough, in which case another node is used.
+    EXPECT_TRUE(numaAllocator.alloc(SegletAllocator::DEFAULT, perNode - 2,
+                                    remote));
+    foreach (Seglet* s, remote)
+        EXPECT_EQ(0U, numaAllocator.getNumaNode(s));
+    EXPECT_EQ(2U, numaAllocator.defaultPools[0].size());
+
+    // If no single node has enough, seglets are gathered from several.
+    EXPECT_TRUE(numaAllocator.alloc(SegletAllocator::DEFAULT, perNode - 2,
+                                    mixed));
+    EXPECT_EQ(0U, numaAllocator.getFreeCount(SegletAllocator::DEFAULT));
+    EXPECT_FALSE(numaAllocator.alloc(SegletAllocator::DEFAULT, 1, mixed));
+    EXPECT_EQ(perNode - 2, mixed.size());
+    SegletAllocator::mockCurrentNumaNode = -1;
+
+    // Freed seglets go back to their own node's pool.
+    foreach (Seglet* s, mixed)
+        s->free();
+    EXPECT_EQ(2U, numaAllocator.defaultPools[0].size());
+    EXPECT_EQ(perNode - 4, numaAllocator.defaultPools[1].size());
+
+    ProtoBuf::LogMetrics_SegletMetrics m;
+    numaAllocator.getMetrics(m);
+    EXPECT_EQ(perNode - 2, m.default_pool_count());
+    EXPECT_EQ(2, m.default_pool_count_per_numa_node_size());
+    EXPECT_EQ(2U, m.default_pool_count_per_numa_node(0));
+
+    foreach (Seglet* s, local)
+        s->free();
+    foreach (Seglet* s, remote)
+        s->free();
+    EXPECT_EQ(perNode, numaAllocator.defaultPools[0].size());
+    EXPECT_EQ(perNode, numaAllocator.defaultPools[1].size());
+}
+
+TEST_F(SegletAllocatorTest, getSystemNumaNodeCount) {
+    EXPECT_LE(1U, SegletAllocator::getSystemNumaNodeCount());
+    SegletAllocator::mockNumaNodeCount = 4;
+    EXPECT_EQ(4U, SegletAllocator::getSystemNumaNodeCount());
+    SegletAllocator::mockNumaNodeCount = 0;
+}
+
 TEST_F(SegletAllocatorTest, initializeEmergencyHeadReserve) {
     allocator.emergencyHeadPoolReserve = 1;
     EXPECT_FALSE(allocator.initializeEmergencyHeadReserve(1));
     EXPECT_EQ(0U, allocator.emergencyHeadPool.size());
     allocator.emergencyHeadPoolReserve = 0;
 
-    uint32_t maxSeglets = downCast<uint32_t>(allocator.defaultPool.size());
+    uint32_t maxSeglets = downCast<uint32_t>(allocator.defaultPools[0].size());
     EXPECT_FALSE(allocator.initializeEmergencyHeadReserve(maxSeglets + 1));
     EXPECT_EQ(0U, allocator.emergencyHeadPool.size());
 
@@ -104,7 +182,7 @@ TEST_F(SegletAllocatorTest, initializeCleanerReserve) {
     EXPECT_EQ(0U, allocator.cleanerPool.size());
     allocator.cleanerPoolReserve = 0;
 
-    uint32_t maxSeglets = downCast<uint32_t>(allocator.defaultPool.size());
+    uint32_t maxSeglets = downCast<uint32_t>(allocator.defaultPools[0].size());
     EXPECT_FALSE(allocator.initializeCleanerReserve(maxSeglets + 1));
     EXPECT_EQ(0U, allocator.cleanerPool.size());
 
@@ -132,13 +210,13 @@ TEST_F(SegletAllocatorTest, free) {
     allocator.free(seglets[0]);
     EXPECT_EQ(1U, allocator.cleanerPool.size());
 
-    uint32_t defaultSeglets = downCast<uint32_t>(allocator.defaultPool.size());
+    uint32_t defaultSeglets = downCast<uint32_t>(allocator.defaultPools[0].size());
     allocator.free(seglets[1]);
-    EXPECT_EQ(defaultSeglets + 1, allocator.defaultPool.size());
+    EXPECT_EQ(defaultSeglets + 1, allocator.defaultPools[0].size());
 }
 
 TEST_F(SegletAllocatorTest, getFreeCount) {
-    size_t defaultSeglets = allocator.defaultPool.size();
+    size_t defaultSeglets = allocator.defaultPools[0].size();
 
     EXPECT_EQ(0U, allocator.getFreeCount(SegletAllocator::EMERGENCY_HEAD));
     allocator.initializeEmergencyHeadReserve(2);
@@ -184,22 +262,22 @@ TEST_F(SegletAllocatorTest, getMemoryUtilization) {
 
 TEST_F(SegletAllocatorTest, allocFromPool) {
     vector<Seglet*> seglets;
-    uint32_t maxSeglets = downCast<uint32_t>(allocator.defaultPool.size());
+    uint32_t maxSeglets = downCast<uint32_t>(allocator.defaultPools[0].size());
 
-    EXPECT_FALSE(allocator.allocFromPool(allocator.defaultPool,
+    EXPECT_FALSE(allocator.allocFromPool(allocator.defaultPools[0],
                                          maxSeglets + 1,
                                          seglets));
 
-    EXPECT_EQ(maxSeglets, allocator.defaultPool.size());
+    EXPECT_EQ(maxSeglets, allocator.defaultPools[0].size());
     EXPECT_EQ(0U, seglets.size());
-    EXPECT_TRUE(allocator.allocFromPool(allocator.defaultPool,
+    EXPECT_TRUE(allocator.allocFromPool(allocator.defaultPools[0],
                                         maxSeglets,
                                         seglets));
-    EXPECT_EQ(0U, allocator.defaultPool.size());
+    EXPECT_EQ(0U, allocator.defaultPools[0].size());
     EXPECT_EQ(maxSeglets, seglets.size());
 
     // return to allocator
-    allocator.allocFromPool(seglets, maxSeglets, allocator.defaultPool);
+    allocator.allocFromPool(seglets, maxSeglets, allocator.defaultPools[0]);
 }
 
 } // namespace RAMCloud
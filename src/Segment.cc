@@ -199,6 +199,73 @@ Segment::append(LogEntryType type,
                 const void* buffer,
                 uint32_t length,
                 Reference* outReference)
+{
+    uint32_t dataOffset;
+    if (!reserve(type, length, &dataOffset, outReference))
+        return false;
+
+    copyIn(dataOffset, buffer, length);
+    return true;
+}
+
+/**
+ * Append a typed entry to this segment. Entries are binary blobs. The segment
+ * records metadata identifying their type and length.
+ *
+ * \param type
+ *      Type of the entry. See LogEntryTypes.h.
+ * \param buffer
+ *      Buffer object describing the entry to be appended.
+ * \param[out] outReference
+ *      If the append was successful, a Segment::Reference pointing to the new
+ *      entry is returned here. This is used to later access the entry within
+ *      segment (see getEntry).
+ * \return
+ *      True if the append succeeded, false if there was insufficient space to
+ *      complete the operation.
+ */
+bool
+Segment::append(LogEntryType type,
+                Buffer& buffer,
+                Reference* outReference)
+{
+    uint32_t length = buffer.size();
+    return append(type, buffer.getRange(0, length), length, outReference);
+}
+
+/**
+ * Reserve space for a typed entry at the end of this segment without copying
+ * in its contents. The entry's header and length are written (and covered by
+ * the segment checksum) and the segment's appended length is advanced past
+ * the entry, so the next append or reservation lands after it. The caller
+ * must fill in the contents later with copyInReserved().
+ *
+ * This lets the log serialize only the cheap metadata update among
+ * concurrent writers while each of them copies its (potentially large) entry
+ * contents in parallel. Until the contents are copied in, the bytes between
+ * the returned offset and the end of the entry are undefined, so the caller
+ * is responsible for not exposing the appended length (for example, to
+ * backups) before then.
+ *
+ * \param type
+ *      Type of the entry. See LogEntryTypes.h.
+ * \param length
+ *      Number of bytes of entry contents to reserve space for.
+ * \param[out] outDataOffset
+ *      If the reservation was successful, the segment offset at which the
+ *      entry's contents must be copied in is returned here.
+ * \param[out] outReference
+ *      If the reservation was successful, a Segment::Reference pointing to the
+ *      new entry is returned here.
+ * \return
+ *      True if the reservation succeeded, false if there was insufficient
+ *      space to complete the operation.
+ */
+bool
+Segment::reserve(LogEntryType type,
+                 uint32_t length,
+                 uint32_t* outDataOffset,
+                 Reference* outReference)
 {
     EntryHeader entryHeader(type, length);
 
@@ -218,7 +285,7 @@ Segment::append(LogEntryType type,
     checksum.update(&length, entryHeader.getLengthBytes());
     head += entryHeader.getLengthBytes();
 
-    copyIn(head, buffer, length);
+    *outDataOffset = head;
     head += length;
 
     if (outReference != NULL)
@@ -228,28 +295,20 @@ Segment::append(LogEntryType type,
 }
 
 /**
- * Append a typed entry to this segment. Entries are binary blobs. The segment
- * records metadata identifying their type and length.
+ * Copy the contents of an entry into space previously set aside for it by
+ * reserve(). This does not touch any segment metadata, so it may be invoked
+ * concurrently with other reservations and copies into the same segment.
  *
- * \param type
- *      Type of the entry. See LogEntryTypes.h.
+ * \param dataOffset
+ *      Offset returned by the reserve() call for this entry.
  * \param buffer
- *      Buffer object describing the entry to be appended.
- * \param[out] outReference
- *      If the append was successful, a Segment::Reference pointing to the new
- *      entry is returned here. This is used to later access the entry within
- *      segment (see getEntry).
- * \return
- *      True if the append succeeded, false if there was insufficient space to
- *      complete the operation.
+ *      Buffer containing the entry's contents. Its size must be exactly the
+ *      length passed to reserve().
  */
-bool
-Segment::append(LogEntryType type,
-                Buffer& buffer,
-                Reference* outReference)
+void
+Segment::copyInReserved(uint32_t dataOffset, Buffer& buffer)
 {
-    uint32_t length = buffer.size();
-    return append(type, buffer.getRange(0, length), length, outReference);
+    copyInFromBuffer(dataOffset, buffer, 0, buffer.size());
 }
 
 /**
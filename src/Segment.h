@@ -283,6 +283,11 @@ class Segment {
                 uint32_t* entryDataLength = NULL,
                 LogEntryType *type = NULL,
                 Reference* outReference = NULL);
+    bool reserve(LogEntryType type,
+                 uint32_t length,
+                 uint32_t* outDataOffset,
+                 Reference* outReference = NULL);
+    void copyInReserved(uint32_t dataOffset, Buffer& buffer);
     static void appendLogHeader(LogEntryType type,
                                 uint32_t objectSize,
                                 Buffer *logBuffer);
@@ -79,6 +79,7 @@ SegmentManager::SegmentManager(Context* context,
       segmentsByState(),
       lock("SegmentManager::lock"),
       segmentsOnDisk(0),
+      totalHeadBytesAllocated(0),
       segmentsOnDiskHistogram(maxSegments, 1),
       safeVersion(1),
       oldestRpcEpoch(0),
@@ -221,6 +222,8 @@ SegmentManager::allocHeadSegment(uint32_t flags)
     }
 
     nextSegmentId++;
+    totalHeadBytesAllocated += newHead->getSegletsAllocated() *
+                               allocator.getSegletSize();
 
     writeHeader(newHead);
     if (prevHead != NULL && !prevHead->isEmergencyHead)
@@ -643,29 +646,34 @@ SegmentManager::getMemoryUtilization()
         return mockMemoryUtilization;
 #endif
 
-    size_t freeSeglets = allocator.getFreeCount(SegletAllocator::DEFAULT);
+    size_t freeSeglets = getFreeSegletCount();
     size_t totalSeglets = allocator.getTotalCount(SegletAllocator::DEFAULT);
+    return downCast<int>(100 * (totalSeglets - freeSeglets) / totalSeglets);
+}
 
-    // Count seglets that will soon be freed as free. This is important when
-    // the server is run with a small amount of memory and these segments are
-    // a non-trivial percentage of total space. If we don't include them in
-    // such cases, we may run the cleaner earlier than we otherwise should and
-    // can clean at substantially higher utilizations (and consequently with
-    // much higher overhead).
-    //
-    // It's perfectly reasonable to count these as free, since they'll be
-    // available shortly after the next head segment is created. The more the
-    // system needs the memory, the faster the log head will roll.
-    State freeableStates[2] = {
-        FREEABLE_PENDING_DIGEST_AND_REFERENCES,
-        FREEABLE_PENDING_REFERENCES
-    };
-    foreach (State state, freeableStates) {
-        foreach (LogSegment& s, segmentsByState[state])
-            freeSeglets += s.getSegletsAllocated();
-    }
+/**
+ * Return the number of bytes of memory available for new log segments. Like
+ * getMemoryUtilization(), this counts seglets that will be freed once the log
+ * head next rolls over as free, but with the precision of a single seglet
+ * rather than a whole percent of the log.
+ */
+uint64_t
+SegmentManager::getFreeMemoryBytes()
+{
+    SpinLock::Guard _(lock);
+    return getFreeSegletCount() * allocator.getSegletSize();
+}
 
-    return downCast<int>(100 * (totalSeglets - freeSeglets) / totalSeglets);
+/**
+ * Return the total number of bytes of memory ever allocated to head segments.
+ * Sampling this periodically gives the rate at which incoming writes consume
+ * memory, regardless of what the cleaner is doing.
+ */
+uint64_t
+SegmentManager::getTotalHeadBytesAllocated()
+{
+    SpinLock::Guard _(lock);
+    return totalHeadBytesAllocated;
 }
 
 /**
@@ -1193,4 +1201,36 @@ SegmentManager::freeUnreferencedSegments()
     }
 }
 
+/**
+ * Return the number of seglets available for new log segments, counting those
+ * in segments that will soon be freed as free. This is important when the
+ * server is run with a small amount of memory and these segments are a
+ * non-trivial percentage of total space. If we don't include them in such
+ * cases, we may run the cleaner earlier than we otherwise should and can clean
+ * at substantially higher utilizations (and consequently with much higher
+ * overhead).
+ *
+ * It's perfectly reasonable to count these as free, since they'll be available
+ * shortly after the next head segment is created. The more the system needs
+ * the memory, the faster the log head will roll.
+ *
+ * The caller must hold the monitor lock.
+ */
+size_t
+SegmentManager::getFreeSegletCount()
+{
+    size_t freeSeglets = allocator.getFreeCount(SegletAllocator::DEFAULT);
+
+    State freeableStates[2] = {
+        FREEABLE_PENDING_DIGEST_AND_REFERENCES,
+        FREEABLE_PENDING_REFERENCES
+    };
+    foreach (State state, freeableStates) {
+        foreach (LogSegment& s, segmentsByState[state])
+            freeSeglets += s.getSegletsAllocated();
+    }
+
+    return freeSeglets;
+}
+
 } // namespace
@@ -134,6 +134,8 @@ class SegmentManager {
     uint64_t allocateVersion();
     bool raiseSafeVersion(uint64_t minimum);
     int getMemoryUtilization();
+    uint64_t getFreeMemoryBytes();
+    uint64_t getTotalHeadBytesAllocated();
 
 #ifdef TESTING
     /// Used to mock the return value of getSegmentUtilization() when set to
@@ -273,6 +275,7 @@ class SegmentManager {
     void freeSlot(SegmentSlot slot, bool wasEmergencyHead);
     void free(LogSegment* s);
     void freeUnreferencedSegments();
+    size_t getFreeSegletCount();
 
     /// The pervasive RAMCloud context.
     Context* context;
@@ -362,6 +365,12 @@ class SegmentManager {
     /// of ReplicatedSegments that exist.
     uint32_t segmentsOnDisk;
 
+    /// Total number of bytes of memory (in whole seglets) ever allocated to
+    /// head segments, including emergency heads. Since the log only consumes
+    /// memory through new heads, the rate at which this grows is the rate at
+    /// which incoming writes use up free memory.
+    uint64_t totalHeadBytesAllocated;
+
     /// Histogram used to track the number of segments present on disk so that
     /// disk utilization of masters can be monitored. This is updated every
     /// time a segment is allocated or freed.
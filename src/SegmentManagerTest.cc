@@ -341,6 +341,35 @@ TEST_F(SegmentManagerTest, initializeSurvivorSegmentReserve) {
     EXPECT_NE(nullSeg, s);
 }
 
+TEST_F(SegmentManagerTest, getFreeMemoryBytes) {
+    uint32_t segletSize = serverConfig.segletSize;
+    EXPECT_EQ(318U * segletSize, segmentManager.getFreeMemoryBytes());
+
+    LogSegment* freeable = segmentManager.allocHeadSegment();
+    segmentManager.allocHeadSegment();
+    EXPECT_EQ(316U * segletSize, segmentManager.getFreeMemoryBytes());
+
+    // Segments that will be freed soon count as free memory.
+    segmentManager.changeState(*freeable,
+        SegmentManager::FREEABLE_PENDING_DIGEST_AND_REFERENCES);
+    EXPECT_EQ(317U * segletSize, segmentManager.getFreeMemoryBytes());
+}
+
+TEST_F(SegmentManagerTest, getTotalHeadBytesAllocated) {
+    EXPECT_EQ(0U, segmentManager.getTotalHeadBytesAllocated());
+    LogSegment* head = segmentManager.allocHeadSegment();
+    uint64_t headBytes = head->getSegletsAllocated() * serverConfig.segletSize;
+    EXPECT_EQ(headBytes, segmentManager.getTotalHeadBytesAllocated());
+
+    // Side segments don't count; only writes consume memory through heads.
+    EXPECT_TRUE(segmentManager.initializeSurvivorReserve(1));
+    segmentManager.allocSideSegment(SegmentManager::FOR_CLEANING);
+    EXPECT_EQ(headBytes, segmentManager.getTotalHeadBytesAllocated());
+
+    segmentManager.allocHeadSegment();
+    EXPECT_EQ(2 * headBytes, segmentManager.getTotalHeadBytesAllocated());
+}
+
 TEST_F(SegmentManagerTest, indexOperator) {
     for (uint32_t i = 0; i < segmentManager.maxSegments + 5; i++)
         EXPECT_THROW(segmentManager[i], SegmentManagerException);
@@ -232,6 +232,61 @@ TEST_P(SegmentTest, append_differentLengthBytes) {
     }
 }
 
+TEST_P(SegmentTest, reserve) {
+    SegmentAndAllocator segAndAlloc(GetParam());
+    Segment& s = *segAndAlloc.segment;
+
+    Segment::Reference ref;
+    uint32_t dataOffset = 0;
+    EXPECT_TRUE(s.reserve(LOG_ENTRY_TYPE_OBJ, 2, &dataOffset, &ref));
+    EXPECT_EQ(2U, dataOffset);
+    EXPECT_EQ(s.segletBlocks[0], reinterpret_cast<const void*>(ref.reference));
+
+    // The certificate must match what a plain append would have produced,
+    // even though the contents have not been copied in yet.
+    SegmentCertificate certificate;
+    EXPECT_EQ(4U, s.getAppendedLength(&certificate));
+    EXPECT_EQ(4u, certificate.segmentLength);
+    EXPECT_EQ(0x87a632e2u, certificate.checksum);
+
+    Buffer data;
+    data.appendExternal("hi", 2);
+    s.copyInReserved(dataOffset, data);
+
+    Buffer buffer;
+    EXPECT_EQ(LOG_ENTRY_TYPE_OBJ, s.getEntry(ref, &buffer));
+    EXPECT_EQ("hi", TestUtil::toString(&buffer));
+
+    char buf[107];
+    while (s.reserve(LOG_ENTRY_TYPE_OBJ, sizeof(buf), &dataOffset)) {
+    }
+    EXPECT_FALSE(s.reserve(LOG_ENTRY_TYPE_OBJ, sizeof(buf), &dataOffset));
+}
+
+TEST_P(SegmentTest, copyInReserved_outOfOrder) {
+    SegmentAndAllocator segAndAlloc(GetParam());
+    Segment& s = *segAndAlloc.segment;
+
+    Segment::Reference refs[2];
+    uint32_t dataOffsets[2];
+    EXPECT_TRUE(s.reserve(LOG_ENTRY_TYPE_OBJ, 3, &dataOffsets[0], &refs[0]));
+    EXPECT_TRUE(s.reserve(LOG_ENTRY_TYPE_OBJTOMB, 4, &dataOffsets[1],
+                          &refs[1]));
+
+    Buffer second, first;
+    second.appendExternal("abcd", 4);
+    first.appendExternal("xyz", 3);
+    s.copyInReserved(dataOffsets[1], second);
+    s.copyInReserved(dataOffsets[0], first);
+
+    Buffer buffer;
+    EXPECT_EQ(LOG_ENTRY_TYPE_OBJ, s.getEntry(refs[0], &buffer));
+    EXPECT_EQ("xyz", TestUtil::toString(&buffer));
+    buffer.reset();
+    EXPECT_EQ(LOG_ENTRY_TYPE_OBJTOMB, s.getEntry(refs[1], &buffer));
+    EXPECT_EQ("abcd", TestUtil::toString(&buffer));
+}
+
 TEST_F(SegmentTest, appendLogHeader) {
     Buffer buffer;
     // Range of values for the entry length
@@ -44,10 +44,12 @@ Server::Server(Context* context, const ServerConfig* config)
     , membership()
     , ping()
     , enlistTimer()
+    , dispatchShards()
 {
     context->coordinatorSession->setLocation(
             config->coordinatorLocator.c_str(), config->clusterName.c_str());
-    context->workerManager = new WorkerManager(context, config->maxCores-1);
+    context->workerManager = new WorkerManager(context, workerCores());
+    context->workerManager->setInlineShortRpcs(config->inlineShortRpcs);
 }
 
 /**
@@ -114,11 +116,34 @@ Server::run()
     // servicing requests.
     enlistTimer.construct(this, formerServerId);
 
+    for (uint32_t i = 1; i < config.dispatchThreads; i++) {
+        dispatchShards.emplace_back(new DispatchShard(context,
+                config.localLocator, workerCores()));
+    }
+    if (config.dispatchThreads > 1) {
+        LOG(NOTICE, "Serving requests with %u dispatch threads",
+            config.dispatchThreads);
+    }
+
     dispatch.run();
 }
 
 // - private -
 
+/**
+ * Return the number of worker threads each dispatch thread's WorkerManager
+ * may keep busy: what's left of config.maxCores once every dispatch thread
+ * has a core, split evenly between them.
+ */
+uint32_t
+Server::workerCores()
+{
+    uint32_t dispatchThreads = std::max(config.dispatchThreads, 1u);
+    if (config.maxCores <= dispatchThreads)
+        return 0;
+    return (config.maxCores - dispatchThreads) / dispatchThreads;
+}
+
 /**
  * Create each of the services which are marked as active in config.services,
  * configure them according to #config, and register them.
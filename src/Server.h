@@ -19,6 +19,7 @@
 #include "BackupService.h"
 #include "CoordinatorClient.h"
 #include "CoordinatorSession.h"
+#include "DispatchShard.h"
 #include "FailureDetector.h"
 #include "MasterService.h"
 #include "MembershipService.h"
@@ -52,6 +53,7 @@ class Server {
   PRIVATE:
     ServerId createAndRegisterServices();
     void enlist(ServerId replacingId);
+    uint32_t workerCores();
 
     /**
      * Shared RAMCloud information.
@@ -138,6 +140,14 @@ class Server {
     };
     Tub<EnlistTimer> enlistTimer;
 
+    /**
+     * Dispatch threads that serve incoming requests alongside the main
+     * one; config.dispatchThreads - 1 of them are started by run(). This
+     * is declared last so the shards stop before the services they use
+     * are destroyed.
+     */
+    std::vector<std::unique_ptr<DispatchShard>> dispatchShards;
+
     DISALLOW_COPY_AND_ASSIGN(Server);
 };
 
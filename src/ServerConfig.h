@@ -64,6 +64,8 @@ struct ServerConfig {
         , maxObjectDataSize(segmentSize / 4)
         , maxObjectKeySize((64 * 1024) - 1)
         , maxCores(2)
+        , dispatchThreads(1)
+        , inlineShortRpcs(false)
         , master(testing)
         , backup(testing)
     {}
@@ -88,6 +90,8 @@ struct ServerConfig {
         , maxObjectDataSize(segmentSize / 8)
         , maxObjectKeySize((64 * 1024) - 1)
         , maxCores(2)
+        , dispatchThreads(1)
+        , inlineShortRpcs(false)
         , master()
         , backup()
     {}
@@ -137,6 +141,8 @@ struct ServerConfig {
         config.set_max_object_data_size(maxObjectDataSize);
         config.set_max_object_key_size(maxObjectKeySize);
         config.set_max_cores(maxCores);
+        config.set_dispatch_threads(dispatchThreads);
+        config.set_inline_short_rpcs(inlineShortRpcs);
 
         if (services.has(WireFormat::MASTER_SERVICE))
             master.serialize(*config.mutable_master());
@@ -217,6 +223,20 @@ struct ServerConfig {
      */
     uint32_t maxCores;
 
+    /**
+     * Number of threads that poll the network for incoming requests. Each
+     * one after the first runs as a DispatchShard listening on the same
+     * locators, and gets an equal share of the worker cores in #maxCores.
+     */
+    uint32_t dispatchThreads;
+
+    /**
+     * If true, short RPCs such as small reads are executed directly by a
+     * dispatch thread when no worker is busy, instead of being handed off
+     * to a worker thread. See WorkerManager::setInlineShortRpcs.
+     */
+    bool inlineShortRpcs;
+
     /**
      * Configuration details specific to the MasterService on a server,
      * if any.  If !config.has(MASTER_SERVICE) then this field is ignored.
@@ -229,15 +249,19 @@ struct ServerConfig {
         Master(Testing) // NOLINT
             : logBytes(40 * 1024 * 1024)
             , hashTableBytes(1 * 1024 * 1024)
+            , hashTableMaxLoadFactor(0)
+            , numaAwareSeglets(false)
             , disableLogCleaner(true)
             , disableInMemoryCleaning(true)
             , diskExpansionFactor(1.0)
             , cleanerBalancer("tombstoneRatio:0.40")
             , cleanerWriteCostThreshold(0)
             , cleanerThreadCount(1)
+            , cleanerHotColdSegregation(false)
             , numReplicas(0)
             , useMinCopysets(false)
             , allowLocalBackup(false)
+            , compressReplicas(false)
         {}
 
         /**
@@ -248,15 +272,19 @@ struct ServerConfig {
         Master()
             : logBytes()
             , hashTableBytes()
+            , hashTableMaxLoadFactor()
+            , numaAwareSeglets()
             , disableLogCleaner()
             , disableInMemoryCleaning()
             , diskExpansionFactor()
             , cleanerBalancer()
             , cleanerWriteCostThreshold()
             , cleanerThreadCount()
+            , cleanerHotColdSegregation()
             , numReplicas()
             , useMinCopysets()
             , allowLocalBackup()
+            , compressReplicas()
         {}
 
         /**
@@ -267,15 +295,19 @@ struct ServerConfig {
         {
             config.set_log_bytes(logBytes);
             config.set_hash_table_bytes(hashTableBytes);
+            config.set_hash_table_max_load_factor(hashTableMaxLoadFactor);
+            config.set_numa_aware_seglets(numaAwareSeglets);
             config.set_disable_log_cleaner(disableLogCleaner);
             config.set_disable_in_memory_cleaning(disableInMemoryCleaning);
             config.set_backup_disk_expansion_factor(diskExpansionFactor);
             config.set_cleaner_balancer(cleanerBalancer);
             config.set_cleaner_write_cost_threshold(cleanerWriteCostThreshold);
             config.set_cleaner_thread_count(cleanerThreadCount);
+            config.set_cleaner_hot_cold_segregation(cleanerHotColdSegregation);
             config.set_num_replicas(numReplicas);
             config.set_use_mincopysets(useMinCopysets);
             config.set_use_local_backup(allowLocalBackup);
+            config.set_compress_replicas(compressReplicas);
         }
 
         /**
@@ -287,23 +319,37 @@ struct ServerConfig {
         {
             logBytes = config.log_bytes();
             hashTableBytes = config.hash_table_bytes();
+            hashTableMaxLoadFactor = config.hash_table_max_load_factor();
+            numaAwareSeglets = config.numa_aware_seglets();
             disableLogCleaner = config.disable_log_cleaner();
             disableInMemoryCleaning = config.disable_in_memory_cleaning();
             diskExpansionFactor = config.backup_disk_expansion_factor();
             cleanerBalancer = config.cleaner_balancer();
             cleanerWriteCostThreshold = config.cleaner_write_cost_threshold();
             cleanerThreadCount = config.cleaner_thread_count();
+            cleanerHotColdSegregation = config.cleaner_hot_cold_segregation();
             numReplicas = config.num_replicas();
             useMinCopysets = config.use_mincopysets();
             allowLocalBackup = config.use_local_backup();
+            compressReplicas = config.compress_replicas();
         }
 
         /// Total number bytes to use for the in-memory Log.
         uint64_t logBytes;
 
-        /// Total number of bytes to use for the HashTable.
+        /// Total number of bytes to use for the HashTable initially.
         uint64_t hashTableBytes;
 
+        /// If non-zero, the HashTable is doubled in size (incrementally, in
+        /// the background) whenever its load factor exceeds this value. See
+        /// HashTable::getLoadFactor(). 0 means the table never grows.
+        double hashTableMaxLoadFactor;
+
+        /// If true, split the log's seglets evenly across the machine's NUMA
+        /// nodes and allocate new segments from the node of the thread that
+        /// requests them. See SegletAllocator.
+        bool numaAwareSeglets;
+
         /// If true, disable the log cleaner entirely.
         bool disableLogCleaner;
 
@@ -330,6 +376,11 @@ struct ServerConfig {
         /// at the expense of CPU cycles.
         uint32_t cleanerThreadCount;
 
+        /// If true, the cleaner relocates live objects whose keys have been
+        /// written frequently of late into different survivor segments from
+        /// the rest of the live data. See WriteFrequencyTracker.
+        bool cleanerHotColdSegregation;
+
         /// Number of replicas to keep per segment stored on backups.
         uint32_t numReplicas;
 
@@ -339,6 +390,11 @@ struct ServerConfig {
 
         /// If true, allow replication to local backup.
         bool allowLocalBackup;
+
+        /// If true, compress the data of closed segments (such as the
+        /// survivor segments written by the cleaner) before sending it to
+        /// backups, which decompress it on arrival. See ReplicaManager.
+        bool compressReplicas;
     } master;
 
     /**
@@ -353,6 +409,9 @@ struct ServerConfig {
         Backup(Testing) // NOLINT
             : gc(false)
             , inMemory(true)
+            , ioUring(false)
+            , journalSegments(0)
+            , pmem(false)
             , sync(false)
             , numSegmentFrames(4)
             , maxNonVolatileBuffers(0)
@@ -370,6 +429,9 @@ struct ServerConfig {
         Backup()
             : gc(true)
             , inMemory(false)
+            , ioUring(false)
+            , journalSegments(0)
+            , pmem(false)
             , sync(false)
             , numSegmentFrames(512)
             , maxNonVolatileBuffers(0)
@@ -425,6 +487,29 @@ struct ServerConfig {
         /// Whether the BackupService should store replicas in RAM or on disk.
         bool inMemory;
 
+        /**
+         * If true, disk-based storage issues its IO through io_uring rather
+         * than POSIX AIO (falling back to AIO if the kernel doesn't support
+         * io_uring).
+         */
+        bool ioUring;
+
+        /**
+         * If non-zero, disk-based storage sets aside this many segments'
+         * worth of space for a journal, which collects the appends to all
+         * open replicas into large sequential writes (see MultiFileStorage).
+         * Must be at least 3.
+         */
+        uint32_t journalSegments;
+
+        /**
+         * If true (and inMemory is false), #file is mapped into memory and
+         * replicas are stored in it with CPU stores rather than block IO
+         * (see PmemStorage). The file should be on a DAX filesystem backed
+         * by persistent memory.
+         */
+        bool pmem;
+
         /**
          * If true backups block until data from calls to writeSegment have
          * been written to storage. Setting this to false is only safe if
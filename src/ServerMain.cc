@@ -112,6 +112,22 @@ main(int argc, char *argv[])
             ("backupInMemory,m",
              ProgramOptions::bool_switch(&config.backup.inMemory),
              "Backup will store segment replicas in memory")
+            ("backupJournalSegments",
+             ProgramOptions::value<uint32_t>(
+                &config.backup.journalSegments)->default_value(0),
+             "If non-0, the backup writes incoming replica data to a journal "
+             "of this many segments (at least 3) with large sequential "
+             "writes, and moves it to the replicas' own storage when they "
+             "close.")
+            ("backupIoUring",
+             ProgramOptions::bool_switch(&config.backup.ioUring),
+             "Backup will issue disk IO through io_uring instead of POSIX "
+             "AIO, if the kernel supports it")
+            ("backupPmem",
+             ProgramOptions::bool_switch(&config.backup.pmem),
+             "Backup will map its file (which should be on a DAX filesystem "
+             "backed by persistent memory) and store segment replicas in it "
+             "with CPU stores")
             ("backupOnly,B",
              ProgramOptions::bool_switch(&backupOnly),
              "The server should run the backup service only (no master)")
@@ -136,6 +152,19 @@ main(int argc, char *argv[])
              "default value. Currently the only other option is \"fixed:X\", "
              "where 0 <= X <= 100 represents the percentage of CPU time the "
              "disk cleaner will be limited to (the rest is for compaction).")
+            ("cleanerHotColdSegregation",
+             ProgramOptions::bool_switch(
+                &config.master.cleanerHotColdSegregation),
+             "Track how often each key is written and have the disk cleaner "
+             "write frequently overwritten objects to different survivor "
+             "segments than the rest of the live data. This reduces cleaning "
+             "costs under skewed update workloads, at the cost of about 1 MB "
+             "of memory and a little work on each write.")
+            ("compressReplicas",
+             ProgramOptions::bool_switch(&config.master.compressReplicas),
+             "Compress the data of closed segments before sending it to "
+             "backups. This saves replication bandwidth when objects "
+             "compress well, at the cost of some master CPU time.")
             ("detectFailures",
              ProgramOptions::value<bool>(&config.detectFailures)->
                 default_value(true),
@@ -158,6 +187,14 @@ main(int argc, char *argv[])
              "the master has memory for 100 full segments and the expansion "
              "factor is 2.0, it will place up to 200 segments (each replicated "
              "R times) on backups.")
+            ("dispatchThreads",
+             ProgramOptions::value<uint32_t>(&config.dispatchThreads)->
+                default_value(1),
+             "Number of threads polling the network for incoming requests. "
+             "Each one listens on the same locators, and the kernel spreads "
+             "clients across them; this only works with the tcp and "
+             "basic+udp transports. The cores allowed by maxCores are split "
+             "evenly between the dispatch threads and their workers.")
             ("file,f",
              ProgramOptions::value<string>(&config.backup.file)->
                 default_value("/var/tmp/backup.log"),
@@ -167,6 +204,20 @@ main(int argc, char *argv[])
                 default_value("10%"),
              "Percentage or megabytes of master memory allocated to "
              "the hash table")
+            ("hashTableMaxLoadFactor",
+             ProgramOptions::value<double>(
+                &config.master.hashTableMaxLoadFactor)->default_value(0),
+             "If non-zero, double the size of the hash table in the "
+             "background whenever the fraction of its entries in use "
+             "exceeds this value (0.5 is a reasonable choice). The "
+             "hashTableMemory option then only determines the initial "
+             "size. If 0, the hash table never grows.")
+            ("inlineShortRpcs",
+             ProgramOptions::bool_switch(&config.inlineShortRpcs),
+             "Execute short RPCs, such as reads of small objects, directly in "
+             "the dispatch thread when no worker thread is busy. This saves "
+             "a handoff to a worker and back, at the cost of delaying the "
+             "dispatch thread's other work.")
             ("logCleanerThreads",
              ProgramOptions::value<uint32_t>(
                 &config.master.cleanerThreadCount)->default_value(1),
@@ -192,6 +243,12 @@ main(int argc, char *argv[])
              "value 0 is special: it tells the server to set the "
              "limit equal to the \"segmentFrames\" value, effectively making "
              "buffering unlimited.")
+            ("numaAwareSeglets",
+             ProgramOptions::bool_switch(&config.master.numaAwareSeglets),
+             "Split the master's log memory evenly across the machine's NUMA "
+             "nodes and allocate new log segments from the node of the "
+             "thread that needs them, reducing cross-socket memory traffic. "
+             "Has no effect on single-node machines.")
             ("preferredIndex",
              ProgramOptions::value<uint32_t>(
                 &config.preferredIndex)->default_value(0),
@@ -277,6 +334,8 @@ main(int argc, char *argv[])
 #endif
         context.transportManager->setSessionTimeout(
                 optionParser.options.getSessionTimeout());
+        if (config.dispatchThreads > 1)
+            context.transportManager->setShareListeningPorts(true);
         context.transportManager->initialize(localLocator.c_str());
         // Transports may augment the local locator somewhat.
         // Make sure the server is aware of that augmented locator.
@@ -98,6 +98,7 @@ SideLog::commit()
 
     // The last segment will still be open. Close it and begin replication.
     LogSegment* lastSegmentAllocated = segments.back();
+    lastSegmentAllocated->waitForUnfinishedAppends();
     lastSegmentAllocated->close();
     lastSegmentAllocated->replicatedSegment->close();
 
@@ -164,6 +165,7 @@ SideLog::allocNextSegment(bool mustNotFail)
         // immediately. Hopefully the replication will overlap with the
         // future appends on the new segment.
         LogSegment* lastSegmentAllocated = segments.back();
+        lastSegmentAllocated->waitForUnfinishedAppends();
         lastSegmentAllocated->close();
         lastSegmentAllocated->replicatedSegment->close();
     }
@@ -411,7 +411,8 @@ void
 SolarFlareDriver::sendPacket(const Driver::Address* recipient,
                              const void* header,
                              const uint32_t headerLen,
-                             Buffer::Iterator *payload)
+                             Buffer::Iterator *payload,
+                             int priority)
 {
 
     uint32_t udpPayloadLen = downCast<uint32_t>(headerLen
@@ -55,7 +55,8 @@ class SolarFlareDriver : public Driver {
     virtual void sendPacket(const Driver::Address* recipient,
                             const void* header,
                             const uint32_t headerLen,
-                            Buffer::Iterator *payload);
+                            Buffer::Iterator *payload,
+                            int priority = 0);
     virtual string getServiceLocator();
     virtual Driver::Address* newAddress(const ServiceLocator& serviceLocator);
 
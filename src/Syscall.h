@@ -27,6 +27,8 @@
 
 #include "Common.h"
 
+struct io_uring_params;
+
 namespace RAMCloud {
 
 /**
@@ -83,6 +85,23 @@ class Syscall {
         return ::ioctl(fd, reqType, request);
     }
     VIRTUAL_FOR_TESTING
+    int ioUringEnter(int fd, unsigned int toSubmit, unsigned int minComplete,
+                     unsigned int flags) {
+        return static_cast<int>(::syscall(SYS_io_uring_enter, fd, toSubmit,
+                minComplete, flags, NULL, 0));
+    }
+    VIRTUAL_FOR_TESTING
+    int ioUringRegister(int fd, unsigned int opcode, void* arg,
+                        unsigned int nrArgs) {
+        return static_cast<int>(::syscall(SYS_io_uring_register, fd, opcode,
+                arg, nrArgs));
+    }
+    VIRTUAL_FOR_TESTING
+    int ioUringSetup(unsigned int entries, io_uring_params* params) {
+        return static_cast<int>(::syscall(SYS_io_uring_setup, entries,
+                params));
+    }
+    VIRTUAL_FOR_TESTING
     int fcntl(int fd, int cmd, int arg1) {
         return ::fcntl(fd, cmd, arg1);
     }
@@ -130,6 +149,15 @@ class Syscall {
         return ::recvfrom(sockfd, buf, len, flags, from, fromLen);
     }
     VIRTUAL_FOR_TESTING
+    int recvmmsg(int sockfd, mmsghdr *msgvec, unsigned int vlen, int flags,
+                 timespec *timeout) {
+        return ::recvmmsg(sockfd, msgvec, vlen, flags, timeout);
+    }
+    VIRTUAL_FOR_TESTING
+    ssize_t recvmsg(int sockfd, msghdr *msg, int flags) {
+        return ::recvmsg(sockfd, msg, flags);
+    }
+    VIRTUAL_FOR_TESTING
     int select(int nfds, fd_set *readfds, fd_set *writefds,
            fd_set *errorfds, struct timeval *timeout)
     {
@@ -140,6 +168,10 @@ class Syscall {
         return ::sendmsg(sockfd, msg, flags);
     }
     VIRTUAL_FOR_TESTING
+    int sendmmsg(int sockfd, mmsghdr *msgvec, unsigned int vlen, int flags) {
+        return ::sendmmsg(sockfd, msgvec, vlen, flags);
+    }
+    VIRTUAL_FOR_TESTING
     ssize_t sendto(int socket, const void *buffer, size_t length, int flags,
            const struct sockaddr *destAddr, socklen_t destLen)
     {
@@ -17,11 +17,13 @@
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
+#include <linux/errqueue.h>
 
 #include "Common.h"
 #include "PerfStats.h"
 #include "ShortMacros.h"
 #include "TcpTransport.h"
+#include "TransportManager.h"
 #include "WorkerManager.h"
 
 namespace RAMCloud {
@@ -40,6 +42,27 @@ static Syscall defaultSyscall;
  */
 Syscall* TcpTransport::sys = &defaultSyscall;
 
+/**
+ * Returns true if an error from accept is transient: according to the man
+ * page for accept, you're supposed to treat these as retry on Linux.
+ */
+static bool
+acceptErrorIsTransient(int error)
+{
+    switch (error) {
+        case EHOSTDOWN:
+        case EHOSTUNREACH:
+        case ENETDOWN:
+        case ENETUNREACH:
+        case ENONET:
+        case ENOPROTOOPT:
+        case EOPNOTSUPP:
+        case EPROTO:
+            return true;
+    }
+    return false;
+}
+
 /**
  * Construct a TcpTransport instance.
  *
@@ -59,6 +82,9 @@ TcpTransport::TcpTransport(Context* context,
     : context(context)
     , locatorString()
     , listenSocket(-1)
+    , ring()
+    , ringFailed(false)
+    , zeroCopy(false)
     , acceptHandler()
     , sockets()
     , nextSocketId(100)
@@ -99,6 +125,19 @@ TcpTransport::TcpTransport(Context* context,
                 errno);
     }
 
+    // Other dispatch threads may listen on the same port; the kernel then
+    // spreads incoming connections across the listen sockets.
+    if (context->transportManager->getShareListeningPorts() &&
+            sys->setsockopt(listenSocket, SOL_SOCKET, SO_REUSEPORT, &optval,
+                            sizeof(optval)) != 0) {
+        sys->close(listenSocket);
+        LOG(WARNING, "TcpTransport couldn't set SO_REUSEPORT on "
+                "listen socket: %s", strerror(errno));
+        throw TransportException(HERE,
+                "TcpTransport couldn't set SO_REUSEPORT on listen socket",
+                errno);
+    }
+
     if (sys->bind(listenSocket, &address.address,
             sizeof(address.address)) == -1) {
         sys->close(listenSocket);
@@ -116,6 +155,11 @@ TcpTransport::TcpTransport(Context* context,
                 "TcpTransport couldn't listen on socket", errno);
     }
 
+    if (serviceLocator->getOption<bool>("uring", false)) {
+        startRing();
+    }
+    zeroCopy = serviceLocator->getOption<bool>("zerocopy", false);
+
     // Arrange to be notified whenever anyone connects to listenSocket.
     acceptHandler.construct(listenSocket, this);
 }
@@ -137,6 +181,36 @@ TcpTransport::~TcpTransport()
     }
 }
 
+/**
+ * This private method is invoked when a client has connected to the
+ * server; it creates the state needed to receive RPCs on the new
+ * connection.
+ *
+ * \param fd
+ *      File descriptor for the new connection.
+ * \param sin
+ *      Address of the client.
+ */
+void
+TcpTransport::addSocket(int fd, sockaddr_in& sin)
+{
+    // Disable the hideous Nagle algorithm, which will delay sending small
+    // messages in some situations (before adding this code in 5/2015, we
+    // observed occasional 40ms delays when a server responded to a batch
+    // of requests from the same client).
+    int flag = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+    if (sockets.size() <= static_cast<unsigned int>(fd)) {
+        sockets.resize(fd + 1);
+    }
+    sockets[fd] = new Socket(fd, this, sin);
+    if (zeroCopy && (sys->setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &flag,
+            sizeof(flag)) == 0)) {
+        sockets[fd]->zeroCopy = true;
+    }
+}
+
 /**
  * This private method is invoked to close the server's end of a
  * connection to a client and cleanup any related state.
@@ -145,11 +219,242 @@ TcpTransport::~TcpTransport()
  */
 void
 TcpTransport::closeSocket(int fd) {
-    delete sockets[fd];
+    Socket* socket = sockets[fd];
+    if ((socket != NULL) &&
+            (socket->nextZeroCopySend != socket->zeroCopySendsCompleted)) {
+        // The kernel may still be transmitting from the memory of replies
+        // that are about to be destroyed; reset the connection rather
+        // than closing it gracefully, so that nothing more gets sent.
+        struct linger linger;
+        linger.l_onoff = 1;
+        linger.l_linger = 0;
+        sys->setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+    }
+    delete socket;
     sockets[fd] = NULL;
     sys->close(fd);
 }
 
+/**
+ * Collect the kernel's notifications that it has finished with the memory
+ * of zero-copy sends on a server socket, and destroy the RPCs that were
+ * kept alive only for those sends.
+ *
+ * \param socket
+ *      Socket that has zero-copy sends outstanding.
+ * \param fd
+ *      File descriptor for socket.
+ */
+void
+TcpTransport::reapZeroCopyCompletions(Socket* socket, int fd)
+{
+    while (true) {
+        char control[100];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (sys->recvmsg(fd, &msg, MSG_ERRQUEUE|MSG_DONTWAIT) < 0) {
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+                LOG(WARNING, "TcpTransport couldn't read socket error "
+                        "queue: %s", strerror(errno));
+            }
+            break;
+        }
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+                cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if ((cmsg->cmsg_level != SOL_IP) ||
+                    (cmsg->cmsg_type != IP_RECVERR)) {
+                continue;
+            }
+            sock_extended_err* err =
+                    reinterpret_cast<sock_extended_err*>(CMSG_DATA(cmsg));
+            if ((err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) ||
+                    (err->ee_errno != 0)) {
+                continue;
+            }
+            if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                // The kernel had to copy the data after all (this always
+                // happens on loopback connections, for example), so
+                // zero-copy sends only add overhead on this socket.
+                socket->zeroCopy = false;
+            }
+            zeroCopyCompleted(socket, err->ee_info, err->ee_data);
+        }
+    }
+    if (ring) {
+        socket->ioHandler.setEvents(serverEvents(socket));
+    }
+}
+
+/**
+ * This method is invoked once the whole response for an RPC has been
+ * passed to the kernel. It destroys the RPC, unless the response was
+ * sent with MSG_ZEROCOPY and the kernel may still need its memory; in
+ * that case the RPC is retained until reapZeroCopyCompletions finds that
+ * the kernel is done with it.
+ *
+ * \param socket
+ *      Socket on which the response was sent.
+ * \param rpc
+ *      The RPC whose response was sent.
+ */
+void
+TcpTransport::replySent(Socket* socket, TcpServerRpc* rpc)
+{
+    if ((rpc->zeroCopySends > 0) && (static_cast<int32_t>(
+            rpc->lastZeroCopySend - socket->zeroCopySendsCompleted) >= 0)) {
+        socket->rpcsWaitingForZeroCopy.push_back(*rpc);
+        if (ring) {
+            socket->ioHandler.setEvents(serverEvents(socket));
+        }
+        return;
+    }
+    serverRpcPool.destroy(rpc);
+}
+
+/**
+ * Returns the Dispatch::File events that a server socket's handler must
+ * wait for, given the socket's current state.
+ *
+ * \param socket
+ *      Socket whose handler is to be updated.
+ */
+int
+TcpTransport::serverEvents(Socket* socket)
+{
+    int events = idleEvents();
+
+    // Zero-copy completions are signaled as READABLE (see
+    // reapZeroCopyCompletions).
+    if (socket->nextZeroCopySend != socket->zeroCopySendsCompleted) {
+        events |= Dispatch::FileEvent::READABLE;
+    }
+    if (!socket->rpcsWaitingToReply.empty()) {
+        events |= Dispatch::FileEvent::WRITABLE;
+    }
+    return events;
+}
+
+/**
+ * Arrange for this transport's sockets to be read through an IoUring
+ * instead of Dispatch::File, if the kernel allows it. Sockets that are
+ * already open are unaffected. The caller must hold a Dispatch::Lock
+ * (or be running in the dispatch thread).
+ */
+void
+TcpTransport::startRing()
+{
+    if (ring || ringFailed) {
+        return;
+    }
+    try {
+        ring.construct(context->dispatch);
+    } catch (FatalError& e) {
+        LOG(WARNING, "TcpTransport couldn't use io_uring, falling back "
+                "to epoll: %s", e.message.c_str());
+        ringFailed = true;
+    }
+}
+
+/**
+ * Transmit as much as possible of the response to an RPC on a server
+ * socket. This is a wrapper around sendMessage that uses MSG_ZEROCOPY for
+ * responses that have been selected for it, and keeps track of the kernel's
+ * identifiers for zero-copy sends.
+ *
+ * \param socket
+ *      Socket on which to send the response.
+ * \param rpc
+ *      RPC whose response is to be sent.
+ * \param bytesToSend
+ *      Same as for sendMessage.
+ * \return
+ *      Same as for sendMessage.
+ *
+ * \throw TransportException
+ *      An I/O error occurred.
+ */
+int
+TcpTransport::transmitReply(Socket* socket, TcpServerRpc* rpc,
+        int bytesToSend)
+{
+    if (!rpc->zeroCopy) {
+        return sendMessage(rpc->fd, rpc->message.header.nonce,
+                &rpc->replyPayload, bytesToSend);
+    }
+    uint32_t sends = rpc->zeroCopySends;
+    int result = sendMessage(rpc->fd, rpc->message.header.nonce,
+            &rpc->replyPayload, bytesToSend, rpc);
+    if (rpc->zeroCopySends != sends) {
+        rpc->lastZeroCopySend = socket->nextZeroCopySend;
+        socket->nextZeroCopySend++;
+    }
+    return result;
+}
+
+/**
+ * Returns true if a message is worth sending with MSG_ZEROCOPY: that is,
+ * if at least one of its chunks contains ZERO_COPY_THRESHOLD bytes or more.
+ *
+ * \param payload
+ *      Message to check.
+ */
+bool
+TcpTransport::wantsZeroCopy(Buffer* payload)
+{
+    if (payload->size() < ZERO_COPY_THRESHOLD) {
+        return false;
+    }
+    for (Buffer::Iterator it(payload); !it.isDone(); it.next()) {
+        if (it.getLength() >= ZERO_COPY_THRESHOLD) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Record that the kernel has finished with the memory for a range of
+ * zero-copy sends on a socket, and destroy the RPCs that were waiting
+ * only for those sends.
+ *
+ * \param socket
+ *      Socket on which the sends were made.
+ * \param first
+ *      Kernel identifier for the first send in the range.
+ * \param last
+ *      Kernel identifier for the last send in the range.
+ */
+void
+TcpTransport::zeroCopyCompleted(Socket* socket, uint32_t first,
+        uint32_t last)
+{
+    // Completions almost always arrive in order, but the kernel doesn't
+    // guarantee it; hold on to any that arrive early.
+    if (first != socket->zeroCopySendsCompleted) {
+        socket->zeroCopyRanges[first] = last;
+        return;
+    }
+    socket->zeroCopySendsCompleted = last + 1;
+    std::map<uint32_t, uint32_t>::iterator it;
+    while ((it = socket->zeroCopyRanges.find(socket->zeroCopySendsCompleted))
+            != socket->zeroCopyRanges.end()) {
+        socket->zeroCopySendsCompleted = it->second + 1;
+        socket->zeroCopyRanges.erase(it);
+    }
+
+    while (!socket->rpcsWaitingForZeroCopy.empty()) {
+        TcpServerRpc& rpc = socket->rpcsWaitingForZeroCopy.front();
+        if (static_cast<int32_t>(rpc.lastZeroCopySend -
+                socket->zeroCopySendsCompleted) >= 0) {
+            break;
+        }
+        socket->rpcsWaitingForZeroCopy.pop_front();
+        serverRpcPool.destroy(&rpc);
+    }
+}
+
 /**
  * Constructor for Sockets.
  */
@@ -160,6 +465,11 @@ TcpTransport::Socket::Socket(int fd, TcpTransport* transport, sockaddr_in& sin)
     , ioHandler(fd, transport, this)
     , rpcsWaitingToReply()
     , bytesLeftToSend(0)
+    , zeroCopy(false)
+    , nextZeroCopySend(0)
+    , zeroCopySendsCompleted(0)
+    , zeroCopyRanges()
+    , rpcsWaitingForZeroCopy()
     , sin(sin)
 {
     transport->nextSocketId++;
@@ -177,6 +487,11 @@ TcpTransport::Socket::~Socket() {
         rpcsWaitingToReply.pop_front();
         transport->serverRpcPool.destroy(&rpc);
     }
+    while (!rpcsWaitingForZeroCopy.empty()) {
+        TcpServerRpc& rpc = rpcsWaitingForZeroCopy.front();
+        rpcsWaitingForZeroCopy.pop_front();
+        transport->serverRpcPool.destroy(&rpc);
+    }
 }
 
 
@@ -191,10 +506,13 @@ TcpTransport::Socket::~Socket() {
  */
 TcpTransport::AcceptHandler::AcceptHandler(int fd, TcpTransport* transport)
     : Dispatch::File(transport->context->dispatch, fd,
-            Dispatch::FileEvent::READABLE)
+            transport->idleEvents())
+    , IoUring::Handler(transport->ring.get())
     , transport(transport)
 {
-    // Empty constructor body.
+    if (ring != NULL) {
+        ring->accept(this, fd);
+    }
 }
 
 /**
@@ -216,19 +534,10 @@ TcpTransport::AcceptHandler::handleFileEvent(int events)
                                  reinterpret_cast<sockaddr*>(&sin),
                                  &socklen);
     if (acceptedFd < 0) {
+        if (acceptErrorIsTransient(errno)) {
+            return;
+        }
         switch (errno) {
-            // According to the man page for accept, you're supposed to
-            // treat these as retry on Linux.
-            case EHOSTDOWN:
-            case EHOSTUNREACH:
-            case ENETDOWN:
-            case ENETUNREACH:
-            case ENONET:
-            case ENOPROTOOPT:
-            case EOPNOTSUPP:
-            case EPROTO:
-                return;
-
             // No incoming connections are currently available.
             case EAGAIN:
 #if EAGAIN != EWOULDBLOCK
@@ -248,23 +557,44 @@ TcpTransport::AcceptHandler::handleFileEvent(int events)
         return;
     }
 
-    // Disable the hideous Nagle algorithm, which will delay sending small
-    // messages in some situations (before adding this code in 5/2015, we
-    // observed occasional 40ms delays when a server responded to a batch
-    // of requests from the same client).
-    int flag = 1;
-    setsockopt(acceptedFd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
-
     // At this point we have successfully opened a client connection.
-    // Save information about it and create a handler for incoming
-    // requests.
-    if (transport->sockets.size() <=
-            static_cast<unsigned int>(acceptedFd)) {
-        transport->sockets.resize(acceptedFd + 1);
-    }
-    transport->sockets[acceptedFd] = new Socket(acceptedFd, transport, sin);
+    transport->addSocket(acceptedFd, sin);
 }
 
+/**
+ * This method is invoked by the transport's IoUring when a connection has
+ * been accepted on the listening socket (or accepting failed).
+ *
+ * \param result
+ *      File descriptor for the new connection, or a negated errno value.
+ * \param data
+ *      Not used.
+ */
+void
+TcpTransport::AcceptHandler::handleCompletion(int result, char* data)
+{
+    if (result < 0) {
+        if (acceptErrorIsTransient(-result)) {
+            ring->accept(this, transport->listenSocket);
+            return;
+        }
+        LOG(ERROR, "error in TcpTransport::AcceptHandler accepting "
+                "connection for '%s': %s",
+                transport->locatorString.c_str(), strerror(-result));
+        sys->close(transport->listenSocket);
+        transport->listenSocket = -1;
+        return;
+    }
+
+    // Multishot accepts can't return the client's address, so ask for it.
+    struct sockaddr_in sin;
+    socklen_t socklen = sizeof(sin);
+    if (getpeername(result, reinterpret_cast<sockaddr*>(&sin),
+            &socklen) != 0) {
+        memset(&sin, 0, sizeof(sin));
+    }
+    transport->addSocket(result, sin);
+}
 /**
  * Constructor for ServerSocketHandlers.
  *
@@ -279,12 +609,15 @@ TcpTransport::ServerSocketHandler::ServerSocketHandler(int fd,
                                                        TcpTransport* transport,
                                                        Socket* socket)
     : Dispatch::File(transport->context->dispatch, fd,
-                     Dispatch::FileEvent::READABLE)
+                     transport->idleEvents())
+    , IoUring::Handler(transport->ring.get())
     , fd(fd)
     , transport(transport)
     , socket(socket)
 {
-    // Empty constructor body.
+    if (ring != NULL) {
+        ring->receive(this, fd);
+    }
 }
 
 /**
@@ -309,15 +642,24 @@ TcpTransport::ServerSocketHandler::handleFileEvent(int events)
     assert(socket != NULL);
     try {
         if (events & Dispatch::FileEvent::READABLE) {
-            if (socket->rpc == NULL) {
-                socket->rpc = transport->serverRpcPool.construct(socket,
-                                                                 fd, transport);
+            if (socket->nextZeroCopySend != socket->zeroCopySendsCompleted) {
+                transport->reapZeroCopyCompletions(socket, fd);
             }
-            if (socket->rpc->message.readMessage(fd)) {
-                // The incoming request is complete; pass it off for servicing.
-                TcpServerRpc *rpc = socket->rpc;
-                socket->rpc = NULL;
-                transport->context->workerManager->handleRpc(rpc);
+
+            // If the socket is read through an IoUring, requests arrive
+            // in handleCompletion instead.
+            if (!transport->ring) {
+                if (socket->rpc == NULL) {
+                    socket->rpc = transport->serverRpcPool.construct(socket,
+                            fd, transport);
+                }
+                if (socket->rpc->message.readMessage(fd)) {
+                    // The incoming request is complete; pass it off for
+                    // servicing.
+                    TcpServerRpc *rpc = socket->rpc;
+                    socket->rpc = NULL;
+                    transport->context->workerManager->handleRpc(rpc);
+                }
             }
         }
         // Check to see if this socket got closed due to an error in the
@@ -331,20 +673,19 @@ TcpTransport::ServerSocketHandler::handleFileEvent(int events)
         if (events & Dispatch::FileEvent::WRITABLE) {
             while (true) {
                 if (socket->rpcsWaitingToReply.empty()) {
-                    setEvents(Dispatch::FileEvent::READABLE);
+                    setEvents(transport->serverEvents(socket));
                     break;
                 }
                 TcpServerRpc& rpc = socket->rpcsWaitingToReply.front();
-                socket->bytesLeftToSend = TcpTransport::sendMessage(fd,
-                        rpc.message.header.nonce, &rpc.replyPayload,
-                        socket->bytesLeftToSend);
+                socket->bytesLeftToSend = transport->transmitReply(socket,
+                        &rpc, socket->bytesLeftToSend);
                 if (socket->bytesLeftToSend != 0) {
                     break;
                 }
                 // The current reply is finished; start the next one, if
                 // there is one.
                 socket->rpcsWaitingToReply.pop_front();
-                transport->serverRpcPool.destroy(&rpc);
+                transport->replySent(socket, &rpc);
                 socket->bytesLeftToSend = -1;
             }
         }
@@ -353,6 +694,60 @@ TcpTransport::ServerSocketHandler::handleFileEvent(int events)
     }
 }
 
+/**
+ * This method is invoked by the transport's IoUring when data has arrived
+ * from a client. It assembles the data into requests and passes each
+ * complete request off for servicing.
+ *
+ * \param result
+ *      Number of bytes received; 0 means the client closed the connection
+ *      and a negative value is a negated errno value.
+ * \param data
+ *      The bytes received.
+ */
+void
+TcpTransport::ServerSocketHandler::handleCompletion(int result, char* data)
+{
+    // The following variables are copies of data from this object;
+    // they are needed to safely detect socket closure below.
+    TcpTransport* transport = this->transport;
+    int socketFd = fd;
+    Socket* socket = this->socket;
+    if (result <= 0) {
+        if (result < 0) {
+            LOG(WARNING, "TcpTransport recv error: %s", strerror(-result));
+        }
+        transport->closeSocket(socketFd);
+        return;
+    }
+    PerfStats::threadStats.networkInputBytes += result;
+
+    // Several requests may have arrived together.
+    uint32_t length = result;
+    while (length > 0) {
+        if (socket->rpc == NULL) {
+            socket->rpc = transport->serverRpcPool.construct(socket,
+                    socketFd, transport);
+        }
+        uint32_t bytesUsed;
+        bool complete = socket->rpc->message.addData(data, length,
+                &bytesUsed);
+        data += bytesUsed;
+        length -= bytesUsed;
+        if (complete) {
+            TcpServerRpc *rpc = socket->rpc;
+            socket->rpc = NULL;
+            transport->context->workerManager->handleRpc(rpc);
+
+            // The request may have been executed (and the socket closed)
+            // by handleRpc.
+            if (socket != transport->sockets[socketFd]) {
+                return;
+            }
+        }
+    }
+}
+
 /**
  * Transmit an RPC request or response on a socket.  This method uses
  * a nonblocking approach: if the entire message cannot be transmitted,
@@ -371,6 +766,13 @@ TcpTransport::ServerSocketHandler::handleFileEvent(int events)
  *      Anything else means that part of the message was transmitted
  *      in a previous call, and the value of this parameter is the
  *      result returned by that call (always greater than 0).
+ * \param zeroCopyRpc
+ *      If non-NULL, payload is the response for this RPC and is sent with
+ *      MSG_ZEROCOPY: the kernel transmits directly from payload (and
+ *      from the RPC's replyHeader) after this method returns, so neither
+ *      may change until the kernel signals completion. The RPC's
+ *      zeroCopySends is incremented if the kernel will signal completion
+ *      for this call.
  *
  * \return
  *      The number of (trailing) bytes that could not be transmitted.
@@ -381,11 +783,13 @@ TcpTransport::ServerSocketHandler::handleFileEvent(int events)
  */
 int
 TcpTransport::sendMessage(int fd, uint64_t nonce, Buffer* payload,
-        int bytesToSend)
+        int bytesToSend, TcpServerRpc* zeroCopyRpc)
 {
     assert(fd >= 0);
 
-    Header header;
+    Header localHeader;
+    Header& header = (zeroCopyRpc != NULL) ? zeroCopyRpc->replyHeader
+            : localHeader;
     header.nonce = nonce;
     header.len = payload->size();
     int totalLength = downCast<int>(sizeof(header) + header.len);
@@ -397,10 +801,16 @@ TcpTransport::sendMessage(int fd, uint64_t nonce, Buffer* payload,
     // Use an iovec to send everything in one kernel call: one iov
     // for header, the rest for payload.  Skip parts that have
     // already been sent.
-    uint32_t iovecs = 1 + payload->getNumberChunks();
-    struct iovec iov[iovecs];
+    //
+    // There's an upper limit on the permissible number of iovecs in
+    // one outgoing message. Unfortunately, this limit does not appear
+    // to be defined publicly, so we make a guess here. If we hit the
+    // limit, stop accumulating chunks for this message: the remaining
+    // chunks will get tried in a future invocation of this method.
+    static const uint32_t MAX_IOVECS = 100;
+    struct iovec iov[MAX_IOVECS];
     int offset;
-    int iovecIndex;
+    uint32_t iovecIndex;
     if (alreadySent < downCast<int>(sizeof(header))) {
         iov[0].iov_base = reinterpret_cast<char*>(&header) + alreadySent;
         iov[0].iov_len = sizeof(header) - alreadySent;
@@ -411,29 +821,27 @@ TcpTransport::sendMessage(int fd, uint64_t nonce, Buffer* payload,
         offset = alreadySent - downCast<int>(sizeof(header));
     }
     Buffer::Iterator iter(payload, offset, header.len - offset);
-    while (!iter.isDone()) {
-        iov[iovecIndex].iov_base = const_cast<void*>(iter.getData());
-        iov[iovecIndex].iov_len = iter.getLength();
-        ++iovecIndex;
-
-        // There's an upper limit on the permissible number of iovecs in
-        // one outgoing message. Unfortunately, this limit does not appear
-        // to be defined publicly, so we make a guess here. If we hit the
-        // limit, stop accumulating chunks for this message: the remaining
-        // chunks will get tried in a future invocation of this method.
-        if (iovecIndex >= 100) {
-            break;
-        }
-        iter.next();
-    }
+    iovecIndex += iter.fillIovecs(&iov[iovecIndex], MAX_IOVECS - iovecIndex);
 
     struct msghdr msg;
     memset(&msg, 0, sizeof(msg));
     msg.msg_iov = iov;
     msg.msg_iovlen = iovecIndex;
 
-    int r = downCast<int>(sys->sendmsg(fd, &msg,
-            MSG_NOSIGNAL|MSG_DONTWAIT));
+    int flags = MSG_NOSIGNAL|MSG_DONTWAIT;
+    if (zeroCopyRpc != NULL) {
+        flags |= MSG_ZEROCOPY;
+    }
+    int r = downCast<int>(sys->sendmsg(fd, &msg, flags));
+    if ((r == -1) && (errno == ENOBUFS) && (zeroCopyRpc != NULL)) {
+        // The kernel limits the memory used to track zero-copy sends
+        // (net.core.optmem_max); if that runs out, copy instead.
+        flags &= ~MSG_ZEROCOPY;
+        r = downCast<int>(sys->sendmsg(fd, &msg, flags));
+    }
+    if ((r > 0) && (flags & MSG_ZEROCOPY)) {
+        zeroCopyRpc->zeroCopySends++;
+    }
     if (r == bytesToSend) {
         PerfStats::threadStats.networkOutputBytes += r;
         return 0;
@@ -549,20 +957,7 @@ TcpTransport::IncomingMessage::readMessage(int fd) {
         if (headerBytesReceived < sizeof(Header))
             return false;
 
-        // Header is complete; check for various errors and set up for
-        // reading the body.
-        messageLength = header.len;
-        if (header.len > MAX_RPC_LEN) {
-            LOG(WARNING, "TcpTransport received oversize message (%d bytes); "
-                    "discarding extra bytes", header.len);
-            messageLength = MAX_RPC_LEN;
-        }
-
-        if ((buffer == NULL) && (session != NULL)) {
-            buffer = session->findRpc(&header);
-        }
-        if (buffer == NULL)
-            messageLength = 0;
+        headerComplete();
     }
 
     // We have the header; now receive the message body (it may take several
@@ -596,6 +991,90 @@ TcpTransport::IncomingMessage::readMessage(int fd) {
     return true;
 }
 
+/**
+ * Consume message bytes that have already been read from the socket (this
+ * method is used instead of readMessage when sockets are read through an
+ * IoUring).
+ *
+ * \param data
+ *      Bytes received from the socket.
+ * \param length
+ *      Number of bytes at data.
+ * \param[out] bytesUsed
+ *      Set to the number of bytes at data that belong to this message;
+ *      any that remain belong to the messages that follow it.
+ * \return
+ *      True means the message is complete; false means we still need
+ *      more data (in which case all of data has been used).
+ */
+bool
+TcpTransport::IncomingMessage::addData(const char* data, uint32_t length,
+        uint32_t* bytesUsed)
+{
+    *bytesUsed = 0;
+    if (headerBytesReceived < sizeof(Header)) {
+        uint32_t count = std::min(length,
+                sizeof32(Header) - headerBytesReceived);
+        memcpy(reinterpret_cast<char*>(&header) + headerBytesReceived,
+                data, count);
+        headerBytesReceived += count;
+        *bytesUsed += count;
+        if (headerBytesReceived < sizeof(Header))
+            return false;
+        headerComplete();
+    }
+
+    if (messageBytesReceived < messageLength) {
+        if (*bytesUsed == length)
+            return false;
+        void *dest;
+        if (buffer->size() == 0) {
+            dest = buffer->alloc(messageLength);
+        } else {
+            buffer->peek(messageBytesReceived, &dest);
+        }
+        uint32_t count = std::min(length - *bytesUsed,
+                messageLength - messageBytesReceived);
+        memcpy(dest, data + *bytesUsed, count);
+        messageBytesReceived += count;
+        *bytesUsed += count;
+        if (messageBytesReceived < messageLength)
+            return false;
+    }
+
+    // Discard any extraneous bytes.
+    if (messageBytesReceived < header.len) {
+        uint32_t count = std::min(length - *bytesUsed,
+                header.len - messageBytesReceived);
+        messageBytesReceived += count;
+        *bytesUsed += count;
+        if (messageBytesReceived < header.len)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * This method is invoked once the header of a message has been received;
+ * it checks for various errors and sets up for receiving the body.
+ */
+void
+TcpTransport::IncomingMessage::headerComplete()
+{
+    messageLength = header.len;
+    if (header.len > MAX_RPC_LEN) {
+        LOG(WARNING, "TcpTransport received oversize message (%d bytes); "
+                "discarding extra bytes", header.len);
+        messageLength = MAX_RPC_LEN;
+    }
+
+    if ((buffer == NULL) && (session != NULL)) {
+        buffer = session->findRpc(&header);
+    }
+    if (buffer == NULL)
+        messageLength = 0;
+}
+
 /**
  * Construct a TcpSession object for communication with a given server.
  *
@@ -682,6 +1161,9 @@ TcpTransport::TcpSession::TcpSession(TcpTransport* transport,
 
     /// Arrange for notification whenever the server sends us data.
     Dispatch::Lock lock(transport->context->dispatch);
+    if (serviceLocator->getOption<bool>("uring", false)) {
+        transport->startRing();
+    }
     clientIoHandler.construct(fd, this);
     message.construct(static_cast<Buffer*>(NULL), this);
 }
@@ -847,7 +1329,7 @@ TcpTransport::TcpSession::sendRequest(Buffer* request, Buffer* response,
         rpc->sent = true;
     } else {
         rpcsWaitingToSend.push_back(*rpc);
-        clientIoHandler->setEvents(Dispatch::FileEvent::READABLE |
+        clientIoHandler->setEvents(transport->idleEvents() |
                 Dispatch::FileEvent::WRITABLE);
     }
 }
@@ -864,11 +1346,14 @@ TcpTransport::TcpSession::sendRequest(Buffer* request, Buffer* response,
 TcpTransport::ClientSocketHandler::ClientSocketHandler(int fd,
         TcpSession* session)
     : Dispatch::File(session->transport->context->dispatch, fd,
-                     Dispatch::FileEvent::READABLE)
+                     session->transport->idleEvents())
+    , IoUring::Handler(session->transport->ring.get())
     , fd(fd)
     , session(session)
 {
-    // Empty constructor body.
+    if (ring != NULL) {
+        ring->receive(this, fd);
+    }
 }
 
 /**
@@ -886,17 +1371,7 @@ TcpTransport::ClientSocketHandler::handleFileEvent(int events)
     try {
         if (events & Dispatch::FileEvent::READABLE) {
             if (session->message->readMessage(fd)) {
-                // This RPC is finished.
-                if (session->current != NULL) {
-                    session->rpcsWaitingForResponse.erase(
-                            session->rpcsWaitingForResponse.iterator_to(
-                            *session->current));
-                    session->alarm.rpcFinished();
-                    session->current->notifier->completed();
-                    session->transport->clientRpcPool.destroy(session->current);
-                    session->current = NULL;
-                }
-                session->message.construct(static_cast<Buffer*>(NULL), session);
+                session->replyComplete();
             }
         }
         if (events & Dispatch::FileEvent::WRITABLE) {
@@ -915,13 +1390,67 @@ TcpTransport::ClientSocketHandler::handleFileEvent(int events)
                 rpc.sent = true;
                 session->bytesLeftToSend = -1;
             }
-            setEvents(Dispatch::FileEvent::READABLE);
+            setEvents(session->transport->idleEvents());
         }
     } catch (TransportException& e) {
         session->abort();
     }
 }
 
+/**
+ * This method is invoked by the transport's IoUring when data has arrived
+ * from the server.
+ *
+ * \param result
+ *      Number of bytes received; 0 means the server closed the connection
+ *      and a negative value is a negated errno value.
+ * \param data
+ *      The bytes received.
+ */
+void
+TcpTransport::ClientSocketHandler::handleCompletion(int result, char* data)
+{
+    if (result <= 0) {
+        if (result < 0) {
+            LOG(WARNING, "TcpTransport recv error: %s", strerror(-result));
+        }
+        session->abort();
+        return;
+    }
+    PerfStats::threadStats.networkInputBytes += result;
+
+    // Several responses may have arrived together.
+    uint32_t length = result;
+    while (length > 0) {
+        uint32_t bytesUsed;
+        bool complete = session->message->addData(data, length, &bytesUsed);
+        data += bytesUsed;
+        length -= bytesUsed;
+        if (complete) {
+            session->replyComplete();
+        }
+    }
+}
+
+/**
+ * This method is invoked when the response for an RPC has been completely
+ * received: it notifies the RPC's owner and prepares to receive the next
+ * response.
+ */
+void
+TcpTransport::TcpSession::replyComplete()
+{
+    if (current != NULL) {
+        rpcsWaitingForResponse.erase(
+                rpcsWaitingForResponse.iterator_to(*current));
+        alarm.rpcFinished();
+        current->notifier->completed();
+        transport->clientRpcPool.destroy(current);
+        current = NULL;
+    }
+    message.construct(static_cast<Buffer*>(NULL), this);
+}
+
 // See Transport::ServerRpc::sendReply for documentation.
 void
 TcpTransport::TcpServerRpc::sendReply()
@@ -933,6 +1462,8 @@ TcpTransport::TcpServerRpc::sendReply()
         // new connection); if so, just discard the RPC without sending
         // a response.
         if ((socket != NULL) && (socket->id == socketId)) {
+            zeroCopy = socket->zeroCopy &&
+                    TcpTransport::wantsZeroCopy(&replyPayload);
             if (!socket->rpcsWaitingToReply.empty()) {
                 // Can't transmit the response yet; the socket is backed up.
                 socket->rpcsWaitingToReply.push_back(*this);
@@ -940,21 +1471,24 @@ TcpTransport::TcpServerRpc::sendReply()
             }
 
             // Try to transmit the response.
-            socket->bytesLeftToSend = TcpTransport::sendMessage(fd,
-                    message.header.nonce, &replyPayload, -1);
+            socket->bytesLeftToSend = transport->transmitReply(socket, this,
+                    -1);
             if (socket->bytesLeftToSend > 0) {
                 socket->rpcsWaitingToReply.push_back(*this);
-                socket->ioHandler.setEvents(Dispatch::FileEvent::READABLE |
-                        Dispatch::FileEvent::WRITABLE);
+                socket->ioHandler.setEvents(transport->serverEvents(socket));
                 return;
             }
+
+            // The whole response was sent immediately (this should be the
+            // common case).
+            transport->replySent(socket, this);
+            return;
         }
     } catch (TransportException& e) {
         transport->closeSocket(fd);
     }
 
-    // The whole response was sent immediately (this should be the
-    // common case).  Recycle the RPC object.
+    // The response can't be sent; recycle the RPC object.
     transport->serverRpcPool.destroy(this);
 }
 
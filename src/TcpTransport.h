@@ -16,10 +16,12 @@
 #ifndef RAMCLOUD_TCPTRANSPORT_H
 #define RAMCLOUD_TCPTRANSPORT_H
 
+#include <map>
 #include <queue>
 
 #include "BoostIntrusive.h"
 #include "Dispatch.h"
+#include "IoUring.h"
 #include "IpAddress.h"
 #include "Tub.h"
 #include "ServerRpcPool.h"
@@ -35,6 +37,23 @@ namespace RAMCloud {
  * this class will be used primarily for development and as a baseline
  * for testing.  The goal is to provide an implementation that is about as
  * fast as possible, given its use of kernel-based TCP/IP.
+ *
+ * By default sockets are read using Dispatch::File (epoll). If a service
+ * locator passed to the constructor or to getSession has the option
+ * "uring=1", the transport reads its sockets through an IoUring instead,
+ * which avoids most of the system calls on the receive path; once enabled,
+ * the IoUring is used for all of the transport's sockets. A server's
+ * locator carries the option to its clients, so they use io_uring for
+ * their sessions with that server too. If the kernel doesn't support
+ * io_uring, the transport falls back to epoll.
+ *
+ * If a server's locator has the option "zerocopy=1", replies containing
+ * large chunks (such as object values referenced directly from the log)
+ * are sent with MSG_ZEROCOPY, so the kernel transmits them without first
+ * copying them. The kernel keeps using the memory until it posts a
+ * completion on the socket's error queue, so such a reply's TcpServerRpc
+ * (and with it the RPC's LogProtector epoch, which keeps the log cleaner
+ * from freeing the memory) is retained until then.
  */
 class TcpTransport : public Transport {
   public:
@@ -83,11 +102,15 @@ class TcpTransport : public Transport {
     class IncomingMessage {
         friend class ServerSocketHandler;
         friend class TcpServerRpc;
+        friend class TcpTransport;
       public:
         IncomingMessage(Buffer* buffer, TcpSession* session);
+        bool addData(const char* data, uint32_t length, uint32_t* bytesUsed);
         void cancel();
         bool readMessage(int fd);
       PRIVATE:
+        void headerComplete();
+
         Header header;
 
         /// The number of bytes of header that have been successfully
@@ -136,7 +159,8 @@ class TcpTransport : public Transport {
       PRIVATE:
         TcpServerRpc(Socket* socket, int fd, TcpTransport* transport)
             : fd(fd), socketId(socket->id), message(&requestPayload, NULL),
-            queueEntries(), transport(transport) { }
+            queueEntries(), transport(transport), zeroCopy(false),
+            replyHeader(), zeroCopySends(0), lastZeroCopySend(0) { }
 
         int fd;                   /// File descriptor of the socket on
                                   /// which the request was received.
@@ -150,6 +174,17 @@ class TcpTransport : public Transport {
                                   /// Used to link this RPC onto the
                                   /// rpcsWaitingToReply list of the Socket.
         TcpTransport* transport;  /// The parent TcpTransport object.
+        bool zeroCopy;            /// True means the response is being sent
+                                  /// with MSG_ZEROCOPY.
+        Header replyHeader;       /// Header for the response, if zeroCopy
+                                  /// (the kernel may read it after sendmsg
+                                  /// returns, so it can't be on the stack).
+        uint32_t zeroCopySends;   /// Number of zero-copy sendmsg calls that
+                                  /// have carried part of the response.
+        uint32_t lastZeroCopySend;
+                                  /// The kernel's identifier for the last of
+                                  /// those calls (see Socket::
+                                  /// nextZeroCopySend).
 
         DISALLOW_COPY_AND_ASSIGN(TcpServerRpc);
     };
@@ -189,18 +224,44 @@ class TcpTransport : public Transport {
     };
 
   PRIVATE:
+    void addSocket(int fd, sockaddr_in& sin);
     void closeSocket(int fd);
+    void reapZeroCopyCompletions(Socket* socket, int fd);
+    void replySent(Socket* socket, TcpServerRpc* rpc);
+    int serverEvents(Socket* socket);
+    void startRing();
+    int transmitReply(Socket* socket, TcpServerRpc* rpc, int bytesToSend);
+    static bool wantsZeroCopy(Buffer* payload);
+    void zeroCopyCompleted(Socket* socket, uint32_t first, uint32_t last);
+
+    /**
+     * Returns the Dispatch::File events that socket handlers should wait
+     * for when they have nothing to send: none if sockets are read through
+     * #ring, otherwise READABLE.
+     */
+    int
+    idleEvents()
+    {
+        return ring ? 0 : Dispatch::FileEvent::READABLE;
+    }
     static ssize_t recvCarefully(int fd, void* buffer, size_t length);
     static int sendMessage(int fd, uint64_t nonce, Buffer* payload,
-            int bytesToSend);
+            int bytesToSend, TcpServerRpc* zeroCopyRpc = NULL);
+
+    /// Replies are sent with MSG_ZEROCOPY (if enabled) only if they contain
+    /// a chunk of at least this many bytes: for smaller transmissions the
+    /// cost of pinning pages and handling the completion exceeds the cost
+    /// of copying.
+    static const uint32_t ZERO_COPY_THRESHOLD = 16384;
 
     /**
      * An event handler that will accept connections on a socket.
      */
-    class AcceptHandler : public Dispatch::File {
+    class AcceptHandler : public Dispatch::File, public IoUring::Handler {
       public:
         AcceptHandler(int fd, TcpTransport* transport);
         virtual void handleFileEvent(int events);
+        virtual void handleCompletion(int result, char* data);
       PRIVATE:
         // Transport that manages this socket.
         TcpTransport* transport;
@@ -210,10 +271,12 @@ class TcpTransport : public Transport {
     /**
      * An event handler that moves bytes to and from a server's socket.
      */
-    class ServerSocketHandler : public Dispatch::File {
+    class ServerSocketHandler : public Dispatch::File,
+                                public IoUring::Handler {
       public:
         ServerSocketHandler(int fd, TcpTransport* transport, Socket* socket);
         virtual void handleFileEvent(int events);
+        virtual void handleCompletion(int result, char* data);
       PRIVATE:
         // The following variables are just copies of constructor arguments.
         int fd;
@@ -225,10 +288,12 @@ class TcpTransport : public Transport {
     /**
      * An event handler that moves bytes to and from a client-side sockes.
      */
-    class ClientSocketHandler : public Dispatch::File {
+    class ClientSocketHandler : public Dispatch::File,
+                                public IoUring::Handler {
       public:
         ClientSocketHandler(int fd, TcpSession* session);
         virtual void handleFileEvent(int events);
+        virtual void handleCompletion(int result, char* data);
       PRIVATE:
         // The following variables are just copies of constructor arguments.
         int fd;
@@ -265,6 +330,7 @@ class TcpTransport : public Transport {
             alarm(transport->context->sessionAlarmTimer, this, 0) { }
 #endif
         void close();
+        void replyComplete();
         static void tryReadReply(int fd, int16_t event, void *arg);
 
         TcpTransport* transport;  /// Transport that owns this session.
@@ -316,6 +382,18 @@ class TcpTransport : public Transport {
     /// clients.  -1 means this instance is not a server.
     int listenSocket;
 
+    /// If constructed, sockets are read through this instead of
+    /// Dispatch::File (see #startRing). Must be declared before the
+    /// handlers that use it.
+    Tub<IoUring> ring;
+
+    /// True means #startRing failed to create #ring, so don't try again.
+    bool ringFailed;
+
+    /// True means SO_ZEROCOPY is enabled on accepted sockets, so that large
+    /// replies can be sent with MSG_ZEROCOPY.
+    bool zeroCopy;
+
     /// Used to wait for listenSocket to become readable.
     Tub<AcceptHandler> acceptHandler;
 
@@ -344,6 +422,29 @@ class TcpTransport : public Transport {
                                   /// need to be transmitted, once fd becomes
                                   /// writable again.  -1 or 0 means there are
                                   /// no RPCs waiting.
+        bool zeroCopy;            /// True means large replies on this socket
+                                  /// are sent with MSG_ZEROCOPY; cleared if
+                                  /// the kernel reports that it had to copy
+                                  /// the data anyway.
+        uint32_t nextZeroCopySend;
+                                  /// The kernel numbers successful zero-copy
+                                  /// sendmsg calls on a socket 0, 1, 2, ...;
+                                  /// this is the number it will assign next.
+        uint32_t zeroCopySendsCompleted;
+                                  /// The kernel has finished with the memory
+                                  /// of all zero-copy sends numbered below
+                                  /// this.  Equal to nextZeroCopySend if none
+                                  /// is outstanding.
+        std::map<uint32_t, uint32_t> zeroCopyRanges;
+                                  /// Completions that arrived out of order:
+                                  /// each entry maps the first of a range of
+                                  /// completed sends to the last, for ranges
+                                  /// above zeroCopySendsCompleted.
+        ServerRpcList rpcsWaitingForZeroCopy;
+                                  /// RPCs whose responses have been sent
+                                  /// with MSG_ZEROCOPY, but whose memory the
+                                  /// kernel may still be using, in the order
+                                  /// they were sent.
         struct sockaddr_in sin;   /// sockaddr_in of the client host on the
                                   /// other end of the socket. Used to
                                   /// implement #getClientServiceLocator().
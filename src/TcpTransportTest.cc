@@ -146,6 +146,34 @@ TEST_F(TcpTransportTest, sanityCheck) {
     EXPECT_STREQ("completed: 1, failed: 0", rpc2.getState());
 }
 
+TEST_F(TcpTransportTest, sanityCheck_uring) {
+    ServiceLocator uringLocator("tcp+ip:host=localhost,port=11001,uring=1");
+    TcpTransport uringServer(&context, &uringLocator);
+    EXPECT_TRUE(uringServer.ring);
+    Transport::SessionRef session = client.getSession(&uringLocator);
+    EXPECT_TRUE(client.ring);
+
+    MockWrapper rpc1("request1");
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    MockWrapper rpc2("request2");
+    session->sendRequest(&rpc2.request, &rpc2.response, &rpc2);
+    Transport::ServerRpc* serverRpc1 = workerManager->waitForRpc(1.0);
+    ASSERT_TRUE(serverRpc1 != NULL);
+    EXPECT_EQ("request1", TestUtil::toString(&serverRpc1->requestPayload));
+    Transport::ServerRpc* serverRpc2 = workerManager->waitForRpc(1.0);
+    ASSERT_TRUE(serverRpc2 != NULL);
+    EXPECT_EQ("request2", TestUtil::toString(&serverRpc2->requestPayload));
+
+    serverRpc2->replyPayload.fillFromString("response2");
+    serverRpc2->sendReply();
+    serverRpc1->replyPayload.fillFromString("response1");
+    serverRpc1->sendReply();
+    EXPECT_TRUE(TestUtil::waitForRpc(&context, rpc1));
+    EXPECT_TRUE(TestUtil::waitForRpc(&context, rpc2));
+    EXPECT_EQ("response1/0", TestUtil::toString(&rpc1.response));
+    EXPECT_EQ("response2/0", TestUtil::toString(&rpc2.response));
+}
+
 TEST_F(TcpTransportTest, constructor_clientSideOnly) {
     sys->socketErrno = EPERM;
 }
@@ -194,6 +222,24 @@ TEST_F(TcpTransportTest, constructor_listenError) {
         "Operation not permitted", TestLog::get());
 }
 
+TEST_F(TcpTransportTest, constructor_uringUnavailable) {
+    MockSyscall ringSys;
+    ringSys.ioUringSetupErrno = ENOSYS;
+    Syscall* savedRingSyscall = IoUring::sys;
+    IoUring::sys = &ringSys;
+    TestLog::Enable filter("startRing");
+    ServiceLocator uringLocator("tcp+ip:host=localhost,port=11001,uring=1");
+    TcpTransport uringServer(&context, &uringLocator);
+    IoUring::sys = savedRingSyscall;
+    EXPECT_FALSE(uringServer.ring);
+    EXPECT_TRUE(uringServer.ringFailed);
+    EXPECT_EQ("startRing: TcpTransport couldn't use io_uring, falling back "
+            "to epoll: io_uring_setup failed: Function not implemented",
+            TestLog::get());
+    EXPECT_EQ(Dispatch::FileEvent::READABLE,
+            uringServer.acceptHandler->events);
+}
+
 TEST_F(TcpTransportTest, destructor) {
     // Connect 2 clients to 1 server, then delete them all and make
     // sure that all of the sockets get closed.
@@ -403,6 +449,49 @@ TEST_F(TcpTransportTest, ServerSocketHandler_handleFileEvent_error) {
     close(fd);
 }
 
+TEST_F(TcpTransportTest, ServerSocketHandler_handleCompletion_severalRequests) {
+    int fd = connectToServer(&locator);
+    server.acceptHandler->handleFileEvent(Dispatch::FileEvent::READABLE);
+    int serverFd = downCast<unsigned>(server.sockets.size()) - 1;
+
+    // Two complete requests and the start of a third.
+    TcpTransport::Header header;
+    header.nonce = 1;
+    header.len = 3;
+    string data(reinterpret_cast<char*>(&header), sizeof(header));
+    data += "abc";
+    data += data;
+    data += "xy";
+    server.sockets[serverFd]->ioHandler.handleCompletion(
+            downCast<int>(data.size()), &data[0]);
+    EXPECT_EQ(2, countWaitingRequests(&server));
+    EXPECT_TRUE(server.sockets[serverFd]->rpc != NULL);
+    EXPECT_EQ(2U, server.sockets[serverFd]->rpc->message.headerBytesReceived);
+
+    close(fd);
+}
+
+TEST_F(TcpTransportTest, ServerSocketHandler_handleCompletion_eof) {
+    int fd = connectToServer(&locator);
+    server.acceptHandler->handleFileEvent(Dispatch::FileEvent::READABLE);
+    int serverFd = downCast<unsigned>(server.sockets.size()) - 1;
+    server.sockets[serverFd]->ioHandler.handleCompletion(0, NULL);
+    EXPECT_TRUE(server.sockets[serverFd] == NULL);
+    EXPECT_EQ("", TestLog::get());
+    close(fd);
+}
+
+TEST_F(TcpTransportTest, ServerSocketHandler_handleCompletion_error) {
+    int fd = connectToServer(&locator);
+    server.acceptHandler->handleFileEvent(Dispatch::FileEvent::READABLE);
+    int serverFd = downCast<unsigned>(server.sockets.size()) - 1;
+    server.sockets[serverFd]->ioHandler.handleCompletion(-EPERM, NULL);
+    EXPECT_TRUE(server.sockets[serverFd] == NULL);
+    EXPECT_EQ("handleCompletion: TcpTransport recv error: "
+            "Operation not permitted", TestLog::get());
+    close(fd);
+}
+
 // Most of the functionality of sendMessage was already tested by
 // ServerSocketHandler_handleFileEvent_writes above.
 
@@ -585,7 +674,7 @@ TEST_F(TcpTransportTest, IncomingMessage_readMessage_receiveHeaderInPieces) {
 }
 
 TEST_F(TcpTransportTest, IncomingMessage_readMessage_messageTooLong) {
-    TestLog::Enable filter("readMessage");
+    TestLog::Enable filter("headerComplete");
     int fd = connectToServer(&locator);
     server.acceptHandler->handleFileEvent(Dispatch::FileEvent::READABLE);
     int serverFd = downCast<unsigned>(server.sockets.size()) - 1;
@@ -595,7 +684,7 @@ TEST_F(TcpTransportTest, IncomingMessage_readMessage_messageTooLong) {
     header.len = 999999999;
     write(fd, &header, sizeof(header));
     EXPECT_FALSE(incoming.readMessage(serverFd));
-    EXPECT_EQ("readMessage: TcpTransport received oversize message "
+    EXPECT_EQ("headerComplete: TcpTransport received oversize message "
             "(999999999 bytes); discarding extra bytes",
             TestLog::get());
     EXPECT_EQ(8388808U, incoming.messageLength);
@@ -710,6 +799,48 @@ TEST_F(TcpTransportTest, IncomingMessage_readMessage_discardExtraneousBytes) {
     close(fd);
 }
 
+TEST_F(TcpTransportTest, IncomingMessage_addData) {
+    Buffer buffer;
+    TcpTransport::IncomingMessage incoming(&buffer, NULL);
+    TcpTransport::Header header;
+    header.nonce = 1;
+    header.len = 11;
+    uint32_t bytesUsed;
+
+    // Header in pieces.
+    EXPECT_FALSE(incoming.addData(reinterpret_cast<char*>(&header), 3,
+            &bytesUsed));
+    EXPECT_EQ(3U, bytesUsed);
+    EXPECT_FALSE(incoming.addData(reinterpret_cast<char*>(&header) + 3,
+            sizeof32(header) - 3, &bytesUsed));
+    EXPECT_EQ(9U, bytesUsed);
+    EXPECT_EQ(11U, incoming.messageLength);
+
+    // Body in pieces, followed by the start of the next message.
+    EXPECT_FALSE(incoming.addData("abcde", 5, &bytesUsed));
+    EXPECT_EQ(5U, bytesUsed);
+    EXPECT_TRUE(incoming.addData("0123456789", 10, &bytesUsed));
+    EXPECT_EQ(6U, bytesUsed);
+    EXPECT_EQ("abcde012345", TestUtil::toString(&buffer));
+}
+
+TEST_F(TcpTransportTest, IncomingMessage_addData_discardExtraneousBytes) {
+    Buffer buffer;
+    TcpTransport::IncomingMessage incoming(&buffer, NULL);
+    TcpTransport::Header header;
+    header.nonce = 1;
+    header.len = 10;
+    uint32_t bytesUsed;
+    EXPECT_FALSE(incoming.addData(reinterpret_cast<char*>(&header),
+            sizeof32(header), &bytesUsed));
+    incoming.messageLength = 3;
+    EXPECT_FALSE(incoming.addData("abcdefg", 7, &bytesUsed));
+    EXPECT_EQ(7U, bytesUsed);
+    EXPECT_TRUE(incoming.addData("hijXYZ", 6, &bytesUsed));
+    EXPECT_EQ(3U, bytesUsed);
+    EXPECT_EQ("abc", TestUtil::toString(&buffer));
+}
+
 TEST_F(TcpTransportTest, sessionConstructor_socketError) {
     sys->socketErrno = EPERM;
     string message("");
@@ -1122,6 +1253,38 @@ TEST_F(TcpTransportTest, ClientSocketHandler_ioError) {
     EXPECT_STREQ("completed: 0, failed: 1", rpc1.getState());
 }
 
+TEST_F(TcpTransportTest, ClientSocketHandler_handleCompletion_readResponse) {
+    Transport::SessionRef session = client.getSession(&locator);
+    TcpTransport::TcpSession* rawSession =
+            reinterpret_cast<TcpTransport::TcpSession*>(session.get());
+    MockWrapper rpc1("request1");
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    ASSERT_EQ(1U, rawSession->rpcsWaitingForResponse.size());
+
+    TcpTransport::Header header;
+    header.nonce = rawSession->rpcsWaitingForResponse.front().nonce;
+    header.len = 9;
+    string data(reinterpret_cast<char*>(&header), sizeof(header));
+    data += "response1";
+    rawSession->clientIoHandler->handleCompletion(downCast<int>(data.size()),
+            &data[0]);
+    EXPECT_STREQ("completed: 1, failed: 0", rpc1.getState());
+    EXPECT_EQ("response1", TestUtil::toString(&rpc1.response));
+    EXPECT_EQ(0U, rawSession->rpcsWaitingForResponse.size());
+    EXPECT_TRUE(rawSession->message->buffer == NULL);
+}
+
+TEST_F(TcpTransportTest, ClientSocketHandler_handleCompletion_eof) {
+    Transport::SessionRef session = client.getSession(&locator);
+    MockWrapper rpc1("xxx");
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    TcpTransport::TcpSession* rawSession =
+            reinterpret_cast<TcpTransport::TcpSession*>(session.get());
+    rawSession->clientIoHandler->handleCompletion(0, NULL);
+    EXPECT_EQ(-1, rawSession->fd);
+    EXPECT_STREQ("completed: 0, failed: 1", rpc1.getState());
+}
+
 TEST_F(TcpTransportTest, sendReply_fdClosed) {
     // Create a situation where the server shuts down a socket before
     // an RPC response is sent.
@@ -1242,6 +1405,132 @@ TEST_F(TcpTransportTest, sendReply_error) {
     EXPECT_TRUE(transport->sockets[fd] == NULL);
 }
 
+TEST_F(TcpTransportTest, sendReply_zeroCopy) {
+    ServiceLocator zeroCopyLocator(
+            "tcp+ip:host=localhost,port=11002,zerocopy=1");
+    TcpTransport zeroCopyServer(&context, &zeroCopyLocator);
+    Transport::SessionRef session = client.getSession(&zeroCopyLocator);
+    MockWrapper rpc1("request1");
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    Transport::ServerRpc* serverRpc = workerManager->waitForRpc(1.0);
+    ASSERT_TRUE(serverRpc != NULL);
+    TcpTransport::Socket* socket = zeroCopyServer.sockets.back();
+    EXPECT_TRUE(socket->zeroCopy);
+
+    // The RPC must outlive sendReply, until the kernel is done with the
+    // value's memory.
+    static char value[TcpTransport::ZERO_COPY_THRESHOLD];
+    memset(value, 'v', sizeof(value));
+    serverRpc->replyPayload.appendExternal(value, sizeof(value));
+    TestLog::reset();
+    serverRpc->sendReply();
+    EXPECT_EQ(1U, socket->nextZeroCopySend);
+    EXPECT_EQ(1U, socket->rpcsWaitingForZeroCopy.size());
+    EXPECT_EQ("", TestLog::get());
+
+    EXPECT_TRUE(TestUtil::waitForRpc(&context, rpc1));
+    EXPECT_EQ(sizeof(value), rpc1.response.size());
+    for (int i = 0; i < 1000; i++) {
+        context.dispatch->poll();
+        if (socket->rpcsWaitingForZeroCopy.empty())
+            break;
+        usleep(1000);
+    }
+    EXPECT_EQ(0U, socket->rpcsWaitingForZeroCopy.size());
+    EXPECT_EQ(1U, socket->zeroCopySendsCompleted);
+    EXPECT_EQ("~TcpServerRpc: deleted", TestLog::get());
+
+    // The kernel has to copy on loopback connections, so zero-copy
+    // gets turned off.
+    EXPECT_FALSE(socket->zeroCopy);
+}
+
+TEST_F(TcpTransportTest, sendReply_zeroCopySmallChunks) {
+    ServiceLocator zeroCopyLocator(
+            "tcp+ip:host=localhost,port=11002,zerocopy=1");
+    TcpTransport zeroCopyServer(&context, &zeroCopyLocator);
+    Transport::SessionRef session = client.getSession(&zeroCopyLocator);
+    MockWrapper rpc1("request1");
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    Transport::ServerRpc* serverRpc = workerManager->waitForRpc(1.0);
+    ASSERT_TRUE(serverRpc != NULL);
+    TcpTransport::Socket* socket = zeroCopyServer.sockets.back();
+    serverRpc->replyPayload.fillFromString("response1");
+    TestLog::reset();
+    serverRpc->sendReply();
+    EXPECT_EQ(0U, socket->nextZeroCopySend);
+    EXPECT_EQ("~TcpServerRpc: deleted", TestLog::get());
+    EXPECT_TRUE(TestUtil::waitForRpc(&context, rpc1));
+}
+
+TEST_F(TcpTransportTest, wantsZeroCopy) {
+    static char data[2*TcpTransport::ZERO_COPY_THRESHOLD];
+    Buffer buffer;
+    buffer.appendExternal(data, TcpTransport::ZERO_COPY_THRESHOLD - 1);
+    EXPECT_FALSE(TcpTransport::wantsZeroCopy(&buffer));
+    buffer.appendExternal(data, TcpTransport::ZERO_COPY_THRESHOLD - 1);
+    EXPECT_FALSE(TcpTransport::wantsZeroCopy(&buffer));
+    buffer.appendExternal(data, TcpTransport::ZERO_COPY_THRESHOLD);
+    EXPECT_TRUE(TcpTransport::wantsZeroCopy(&buffer));
+}
+
+TEST_F(TcpTransportTest, zeroCopyCompleted) {
+    int fd = connectToServer(&locator);
+    server.acceptHandler->handleFileEvent(Dispatch::FileEvent::READABLE);
+    int serverFd = downCast<unsigned>(server.sockets.size()) - 1;
+    TcpTransport::Socket* socket = server.sockets[serverFd];
+    for (uint32_t i = 0; i < 3; i++) {
+        TcpTransport::TcpServerRpc* rpc = server.serverRpcPool.construct(
+                socket, serverFd, &server);
+        rpc->zeroCopySends = 1;
+        rpc->lastZeroCopySend = i;
+        socket->rpcsWaitingForZeroCopy.push_back(*rpc);
+    }
+    socket->nextZeroCopySend = 3;
+    TestLog::reset();
+
+    // Completions that arrive out of order are held until the gap fills.
+    server.zeroCopyCompleted(socket, 1, 1);
+    EXPECT_EQ(0U, socket->zeroCopySendsCompleted);
+    EXPECT_EQ(1U, socket->zeroCopyRanges.size());
+    EXPECT_EQ(3U, socket->rpcsWaitingForZeroCopy.size());
+    server.zeroCopyCompleted(socket, 0, 0);
+    EXPECT_EQ(2U, socket->zeroCopySendsCompleted);
+    EXPECT_EQ(0U, socket->zeroCopyRanges.size());
+    EXPECT_EQ(1U, socket->rpcsWaitingForZeroCopy.size());
+    EXPECT_EQ("~TcpServerRpc: deleted | ~TcpServerRpc: deleted",
+            TestLog::get());
+    server.zeroCopyCompleted(socket, 2, 2);
+    EXPECT_EQ(0U, socket->rpcsWaitingForZeroCopy.size());
+    close(fd);
+}
+
+TEST_F(TcpTransportTest, closeSocket_zeroCopyPending) {
+    int fd = connectToServer(&locator);
+    server.acceptHandler->handleFileEvent(Dispatch::FileEvent::READABLE);
+    int serverFd = downCast<unsigned>(server.sockets.size()) - 1;
+    TcpTransport::Socket* socket = server.sockets[serverFd];
+    TcpTransport::TcpServerRpc* rpc = server.serverRpcPool.construct(
+            socket, serverFd, &server);
+    rpc->zeroCopySends = 1;
+    socket->rpcsWaitingForZeroCopy.push_back(*rpc);
+    socket->nextZeroCopySend = 1;
+
+    // Keep the file descriptor open so its options can be checked.
+    sys->closeErrno = EPERM;
+    TestLog::reset();
+    server.closeSocket(serverFd);
+    EXPECT_EQ("~TcpServerRpc: deleted", TestLog::get());
+    struct linger linger;
+    socklen_t length = sizeof(linger);
+    EXPECT_EQ(0, getsockopt(serverFd, SOL_SOCKET, SO_LINGER, &linger,
+            &length));
+    EXPECT_EQ(1, linger.l_onoff);
+    EXPECT_EQ(0, linger.l_linger);
+    close(serverFd);
+    close(fd);
+}
+
 TEST_F(TcpTransportTest, sessionAlarm) {
     TestLog::Enable _;
     TcpTransport::TcpSession* session = new TcpTransport::TcpSession(
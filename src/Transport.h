@@ -74,6 +74,7 @@ class Transport {
             , replyPayload()
             , epoch(0)
             , activities(~0)
+            , arrivalTime(0)
             , outstandingRpcListHook()
         {}
 
@@ -152,6 +153,13 @@ class Transport {
         static const int READ_ACTIVITY = 1;
         static const int APPEND_ACTIVITY = 2;
 
+        /**
+         * Cycles::rdtsc time when the WorkerManager received this RPC. Used
+         * to measure how long the RPC waited before it started executing
+         * (see RpcLatencyStats).
+         */
+        uint64_t arrivalTime;
+
         /**
          * Hook for the list of active server RPCs that the ServerRpcPool class
          * maintains. RPCs are added when ServerRpc-derived classes are
@@ -26,9 +26,19 @@ using std::cerr;
 using std::endl;
 using namespace RAMCloud;
 
+/**
+ * Return the object key used for the \a i'th benchmark object; these match
+ * the keys that RamCloud::testingFill generates.
+ */
+string
+keyFor(uint64_t i)
+{
+    return format("%lu", i);
+}
+
 void
 bench(RamCloud& client,
-      const uint32_t table,
+      const uint64_t table,
       const bool mcp,
       const uint64_t count,
       const uint64_t size,
@@ -37,6 +47,8 @@ bench(RamCloud& client,
     char buf[size];
     const uint64_t targetSize = 1 * 1024 * 1024 * 1024;
     const uint64_t insCount = uncached ? ((targetSize + size - 1) / size) : 1;
+    const string firstKey = keyFor(0);
+    const uint16_t firstKeyLength = downCast<uint16_t>(firstKey.length());
 
     if (mcp) {
         cerr << "Master Control Program writing test value "
@@ -45,14 +57,21 @@ bench(RamCloud& client,
              << " objects to store of " << size << " bytes"
              << endl;
         if (uncached) {
-            master.fillWithTestData(0, "abc", 3, downCast<uint32_t>(insCount),
-                                    downCast<uint32_t>(size));
+            client.testingFill(table, "abc", 3, downCast<uint32_t>(insCount),
+                               downCast<uint32_t>(size));
         }
         // make sure to write 0 last to trigger master metrics
-        client.write(table, 0,
+        client.write(table, firstKey.c_str(), firstKeyLength,
                      &buf[0], downCast<uint32_t>(size));
     }
 
+    // Small RPCs are mostly limited by the server's dispatch threads, so
+    // report how many it runs along with the results.
+    ProtoBuf::ServerConfig serverConfig;
+    client.getServerConfig(client.testingGetServiceLocator(table,
+            firstKey.c_str(), firstKeyLength).c_str(), serverConfig);
+    uint32_t dispatchThreads = serverConfig.dispatch_threads();
+
     cerr << "Reading " << count
          <<" objects of " << size << " bytes each" << endl;
     uint64_t readCount = 0;
@@ -61,7 +80,7 @@ bench(RamCloud& client,
     for (;;) {
         try {
             // warm up caches and sync metrics on drones
-            client.read(table, 0, &response);
+            client.read(table, firstKey.c_str(), firstKeyLength, &response);
             break;
         } catch (ObjectDoesntExistException& e) {
         }
@@ -70,8 +89,9 @@ bench(RamCloud& client,
     CycleCounter<> counter;
     for (uint64_t i = 0; !mcp || i < count; ++i) {
         try {
-            uint64_t k = generateRandom() % insCount;
-            client.read(table, k, &response);
+            string key = keyFor(generateRandom() % insCount);
+            client.read(table, key.c_str(), downCast<uint16_t>(key.length()),
+                        &response);
             ++readCount;
         } catch (ObjectDoesntExistException& e) {
             if (mcp)
@@ -83,24 +103,26 @@ bench(RamCloud& client,
 
     // stop metrics for all other clients
     if (mcp) {
-        RejectRules rr;
-        rr.exists = false;
-        uint64_t version = 0;
-        client.remove(table, 0, &rr, &version);
+        client.remove(table, firstKey.c_str(), firstKeyLength);
     }
 
     uint64_t ns = Cycles::toNanoseconds(recoveryTicks);
+    double readsPerSecond = double(readCount) * 1e09 / double(ns);
     cerr << "Took " << (ns / 1000000) << " ms"  << endl;
     cerr << "Throughput: "
          << double(readCount * size * 1000000000l) / double(ns * (1 << 20))
          << " MB/s" << endl;
+    cerr << "Rate: " << readsPerSecond / 1e03 << " kreads/s with "
+         << dispatchThreads << " server dispatch thread(s)" << endl;
     cerr << "Latency: "
          << double(ns / 1000) / double(readCount)
          << " us/read"  << endl;
 
     cerr << "METRICS: "
           << "{'ns': " << ns << ", 'count': " << count << ","
-          << " 'size': " << size << "}"
+          << " 'size': " << size << ","
+          << " 'readsPerSecond': " << readsPerSecond << ","
+          << " 'dispatchThreads': " << dispatchThreads << "}"
           << endl;
 }
 
@@ -139,7 +161,6 @@ try
 
     client.createTable("TransportBench");
     auto table = client.getTableId("TransportBench");
-    assert(table == 0);
 
     bench(client, table, mcp, count, size, uncached);
 } catch (ClientException& e) {
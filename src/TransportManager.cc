@@ -120,6 +120,9 @@ TransportManager::TransportManager(Context* context)
     , registeredSizes()
     , mutex("TransportManager::mutex")
     , sessionTimeoutMs(0)
+    , shareListeningPorts(false)
+    , batchRequests(false)
+    , batchingFlusher()
     , mockRegistrations(0)
 {
     transportFactories.push_back(&tcpTransportFactory);
@@ -189,11 +192,13 @@ TransportManager::initialize(const char* localServiceLocator)
                     transport->registerMemory(registeredBases[j],
                                               registeredSizes[j]);
                 }
-                if (transports[i] == NULL) {
+                if (transports[i] == NULL && !shareListeningPorts) {
                     transports[i] = transport;
                 } else {
                     // If we get here, it means we've already created at
-                    // least one transport for this factory.
+                    // least one transport for this factory, or that
+                    // listening transports mustn't be used for outgoing
+                    // requests (see #shareListeningPorts).
                     transports.push_back(transport);
                 }
                 // Ask the transport for its service locator. This might be
@@ -380,6 +385,10 @@ TransportManager::openSessionInternal(const string& serviceLocator)
             try {
                 Transport::SessionRef session = transports[i]->getSession(
                         &locator, sessionTimeoutMs);
+                if (batchRequests) {
+                    session = new BatchingSession(batchingFlusher.get(),
+                            session);
+                }
                 if (isServer) {
                     return new WorkerSession(context, session);
                 }
@@ -445,6 +454,58 @@ uint32_t TransportManager::getSessionTimeout() const
     return sessionTimeoutMs;
 }
 
+/**
+ * Arrange for the listening transports created by #initialize to share
+ * their ports with other listeners in this process; see
+ * #shareListeningPorts. Must be invoked before #initialize.
+ *
+ * \param share
+ *      True means listening ports are shared.
+ */
+void TransportManager::setShareListeningPorts(bool share)
+{
+    this->shareListeningPorts = share;
+}
+
+/**
+ * Return true if listening transports should share their ports with other
+ * listeners in this process (see #setShareListeningPorts).
+ */
+bool TransportManager::getShareListeningPorts() const
+{
+    return shareListeningPorts;
+}
+
+/**
+ * Specify whether sessions opened from now on should combine small
+ * requests to the same server into BATCH requests (see BatchingSession).
+ * This reduces the per-message costs on both client and server when a
+ * client issues many small requests at once, such as multiple async reads.
+ * Sessions that are already open (including those cached by #getSession)
+ * are not affected.
+ *
+ * \param batch
+ *      True means batch requests; false means send each request on its
+ *      own (the default).
+ */
+void TransportManager::setBatchRequests(bool batch)
+{
+    if (batch && !batchingFlusher) {
+        Dispatch::Lock lock(context->dispatch);
+        batchingFlusher.construct(context->dispatch);
+    }
+    this->batchRequests = batch;
+}
+
+/**
+ * Return true if sessions opened from now on batch small requests (see
+ * #setBatchRequests).
+ */
+bool TransportManager::getBatchRequests() const
+{
+    return batchRequests;
+}
+
 /**
  * Calls dumpStats() on all existing transports.
  */
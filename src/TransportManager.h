@@ -20,6 +20,7 @@
 #include <map>
 #include <set>
 
+#include "BatchingSession.h"
 #include "Common.h"
 #include "MockTransport.h"
 #include "MockTransportFactory.h"
@@ -27,6 +28,7 @@
 #include "ServerList.h"
 #include "SpinLock.h"
 #include "Transport.h"
+#include "Tub.h"
 
 namespace RAMCloud {
 
@@ -56,6 +58,10 @@ class TransportManager {
     void dumpTransportFactories();
     void setSessionTimeout(uint32_t timeoutMs);
     uint32_t getSessionTimeout() const;
+    void setShareListeningPorts(bool share);
+    bool getShareListeningPorts() const;
+    void setBatchRequests(bool batch);
+    bool getBatchRequests() const;
 
 #if TESTING
     /**
@@ -167,6 +173,28 @@ class TransportManager {
      */
     uint32_t sessionTimeoutMs;
 
+    /**
+     * True means several TransportManagers in this process (one per
+     * dispatch thread, see DispatchShard) listen on the same service
+     * locators: listening transports ask the kernel to share their ports
+     * (SO_REUSEPORT), and are used only for incoming requests. Outgoing
+     * RPCs use separate transports, so that their responses can't be
+     * delivered to another dispatch thread's socket.
+     */
+    bool shareListeningPorts;
+
+    /**
+     * True means sessions opened from now on combine small requests into
+     * BATCH requests (see BatchingSession).
+     */
+    bool batchRequests;
+
+    /**
+     * Sends the requests held by BatchingSessions; constructed the first
+     * time batchRequests is set.
+     */
+    Tub<BatchingSession::Flusher> batchingFlusher;
+
     /**
      * Counts the number of calls to registerMock (minus the number of calls
      * to unregisterMock), so we can clean up automatically in the destructor.
@@ -65,6 +65,19 @@ TEST_F(TransportManagerTest, initialize) {
     EXPECT_EQ("mock:x=14", t->getServiceLocator());
 }
 
+TEST_F(TransportManagerTest, initialize_shareListeningPorts) {
+    MockTransportFactory mockTransportFactory(&context, NULL, "mock");
+    manager.transportFactories.clear();  /* Speeds up initialization. */
+    manager.transportFactories.push_back(&mockTransportFactory);
+    manager.transports.resize(1, NULL);
+    manager.setShareListeningPorts(true);
+    manager.initialize("mock:");
+    EXPECT_EQ("mock:", manager.listeningLocators);
+    EXPECT_EQ(2U, manager.transports.size());
+    EXPECT_TRUE(manager.transports[0] == NULL);
+    EXPECT_EQ("mock:", manager.transports[1]->getServiceLocator());
+}
+
 TEST_F(TransportManagerTest, initialize_emptyLocator) {
     EXPECT_THROW(manager.initialize(""), Exception);
     EXPECT_THROW(manager.initialize("  "), Exception);
@@ -167,6 +180,20 @@ TEST_F(TransportManagerTest, getSession_createWorkerSession) {
     EXPECT_EQ("WorkerSession: created", TestLog::get());
 }
 
+TEST_F(TransportManagerTest, getSession_createBatchingSession) {
+    manager.registerMock(NULL);
+    Transport::SessionRef session(manager.getSession("mock:"));
+    EXPECT_TRUE(dynamic_cast<BatchingSession*>(session.get()) == NULL);
+    EXPECT_FALSE(manager.batchingFlusher);
+
+    manager.sessionCache.clear();
+    manager.setBatchRequests(true);
+    EXPECT_TRUE(manager.batchingFlusher);
+    Transport::SessionRef session2(manager.getSession("mock:"));
+    EXPECT_TRUE(dynamic_cast<BatchingSession*>(session2.get()) != NULL);
+    EXPECT_EQ("mock:", session2->getServiceLocator());
+}
+
 TEST_F(TransportManagerTest, getSession_openSessionFailure) {
     TestLog::Enable _;
     manager.registerMock(NULL);
@@ -16,6 +16,8 @@
 #ifndef RAMCLOUD_UDPDRIVER_H
 #define RAMCLOUD_UDPDRIVER_H
 
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <vector>
 
 #include "Dispatch.h"
@@ -36,18 +38,40 @@ class UdpDriver : public Driver {
     /// The maximum number bytes we can stuff in a UDP packet payload.
     static const uint32_t MAX_PAYLOAD_SIZE = 1400;
 
+    /// The most packets read from the socket by one recvmmsg call.
+    static const uint32_t MAX_RECEIVE_BATCH = 16;
+
+    /// The most outgoing packets queued before they must be sent; also the
+    /// most sent by one sendmmsg call.
+    static const uint32_t MAX_SEND_BATCH = 32;
+
+    /// With GSO enabled, the most packets combined into one message for
+    /// the kernel to segment.
+    static const uint32_t MAX_GSO_SEGMENTS = 32;
+
+    /// The most separate ranges of memory in one outgoing packet; payload
+    /// chunks beyond this are copied.
+    static const uint32_t MAX_PACKET_IOVECS = 8;
+
+    /// Payload chunks shorter than this (in bytes) are copied into the
+    /// outgoing packet rather than referred to in place.
+    static const uint32_t MIN_ZERO_COPY_LENGTH = 128;
+
     explicit UdpDriver(Context* context,
                        const ServiceLocator* localServiceLocator = NULL);
     virtual ~UdpDriver();
     void close();
     virtual void connect(IncomingPacketHandler* incomingPacketHandler);
     virtual void disconnect();
+    virtual void flushPackets();
+    int flushSendQueue();
     virtual uint32_t getMaxPacketSize();
     virtual void release(char *payload);
     virtual void sendPacket(const Address *addr,
                             const void *header,
                             uint32_t headerLen,
-                            Buffer::Iterator *payload);
+                            Buffer::Iterator *payload,
+                            int priority = 0);
     virtual string getServiceLocator();
 
     virtual Address* newAddress(const ServiceLocator* serviceLocator) {
@@ -94,6 +118,67 @@ class UdpDriver : public Driver {
     };
     Tub<ReadHandler> readHandler;
 
+    /**
+     * Buffers that the next recvmmsg call reads into. An entry is set to
+     * NULL when its packet is passed to #incomingPacketHandler, and
+     * refilled from #packetBufPool before the next call.
+     */
+    PacketBuf* receiveBufs[MAX_RECEIVE_BATCH];
+
+    /// Arguments for recvmmsg that describe #receiveBufs.
+    mmsghdr receiveHeaders[MAX_RECEIVE_BATCH];
+    iovec receiveIovecs[MAX_RECEIVE_BATCH];
+
+    /**
+     * An outgoing packet waiting in #sendQueue. The header is copied into
+     * #data, since the caller may reuse it as soon as sendPacket returns.
+     * Payload chunks are referred to in place (the caller must preserve
+     * them until #flushPackets), except for short chunks, which are cheaper
+     * to copy than to describe to the kernel separately.
+     */
+    struct OutgoingPacket {
+        sockaddr address;                      /// Where to send the packet.
+        uint32_t length;                       /// Total bytes in the packet.
+        uint32_t dataLength;                   /// Bytes used in #data.
+        uint32_t iovecs;                       /// Entries used in #iov.
+        iovec iov[MAX_PACKET_IOVECS];          /// The packet's contents:
+                                               /// ranges of #data and of
+                                               /// the caller's payload.
+        char data[MAX_PAYLOAD_SIZE];           /// Header and copied payload.
+    };
+
+    /// Packets passed to sendPacket but not yet given to the kernel; the
+    /// first #sendQueueLength entries are valid.
+    OutgoingPacket sendQueue[MAX_SEND_BATCH];
+    uint32_t sendQueueLength;
+
+    /// Arguments for sendmmsg that describe #sendQueue.
+    mmsghdr sendHeaders[MAX_SEND_BATCH];
+    iovec sendIovecs[MAX_SEND_BATCH * MAX_PACKET_IOVECS];
+
+    /**
+     * Flushes #sendQueue once per pass through the dispatcher's polling
+     * loop, so that packets sent together reach the kernel together.
+     */
+    class SendQueueFlusher : public Dispatch::Poller {
+      public:
+        explicit SendQueueFlusher(UdpDriver* driver)
+            : Dispatch::Poller(driver->context->dispatch, "UdpDriver")
+            , driver(driver)
+        { }
+        virtual int poll();
+      private:
+        // Driver that owns this poller.
+        UdpDriver* driver;
+        DISALLOW_COPY_AND_ASSIGN(SendQueueFlusher);
+    };
+    SendQueueFlusher sendQueueFlusher;
+
+    /// True means the socket has UDP generic segmentation offload enabled,
+    /// so runs of full-sized packets to the same address can be passed to
+    /// the kernel as one message ("gso" service locator option).
+    bool gso;
+
     /// Holds packet buffers that are no longer in use, for use in future
     /// requests; saves the overhead of calling malloc/free for each request.
     ObjectPool<PacketBuf> packetBufPool;
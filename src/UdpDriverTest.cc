@@ -115,6 +115,23 @@ TEST_F(UdpDriverTest, constructor_socketInUse) {
             exceptionMessage);
 }
 
+TEST_F(UdpDriverTest, constructor_gso) {
+    ServiceLocator locator("udp: host=localhost, port=8102, gso=1");
+    UdpDriver driver(&context, &locator);
+    EXPECT_TRUE(driver.gso);
+    EXPECT_FALSE(server.gso);
+}
+
+TEST_F(UdpDriverTest, constructor_gsoNotSupported) {
+    sys->setsockoptErrno = ENOPROTOOPT;
+    ServiceLocator locator("udp: host=localhost, port=8102, gso=1");
+    UdpDriver driver(&context, &locator);
+    EXPECT_FALSE(driver.gso);
+    EXPECT_EQ("UdpDriver: UdpDriver couldn't enable GSO on "
+            "'udp: host=localhost, port=8102, gso=1' (Protocol not "
+            "available); sending packets individually", TestLog::get());
+}
+
 TEST_F(UdpDriverTest, destructor_closeSocket) {
     // If the socket isn't closed, we won't be able to create another
     // UdpDriver that binds to the same socket.
@@ -185,18 +202,151 @@ TEST_F(UdpDriverTest, sendPacket_multipleChunks) {
             serverHandler->receivePacket(&context));
 }
 
-TEST_F(UdpDriverTest, sendPacket_errorInSend) {
-    sys->sendmsgErrno = EPERM;
+TEST_F(UdpDriverTest, sendPacket_queued) {
+    sendMessage(&client, &serverAddress, "header:", "xyzzy");
+    EXPECT_EQ(1U, client.sendQueueLength);
+    EXPECT_EQ(12U, client.sendQueue[0].length);
+    EXPECT_EQ("header:xyzzy", string(client.sendQueue[0].data, 12));
+    EXPECT_EQ(0, sys->sendmmsgCalls);
+    EXPECT_STREQ("header:xyzzy", serverHandler->receivePacket(&context));
+    EXPECT_EQ(0U, client.sendQueueLength);
+}
+
+TEST_F(UdpDriverTest, sendPacket_zeroCopy) {
+    string longChunk(UdpDriver::MIN_ZERO_COPY_LENGTH, 'x');
     Buffer message;
-    message.appendExternal("xyzzy", 5);
+    message.appendExternal("abc", 3);
+    message.appendExternal(longChunk.c_str(), UdpDriver::MIN_ZERO_COPY_LENGTH);
+    message.appendExternal("de", 2);
+    message.appendExternal("fg", 2);
     Buffer::Iterator iterator(&message);
-    client.sendPacket(&serverAddress, "header:", 7, &iterator);
-    EXPECT_EQ("sendPacket: UdpDriver error sending to socket: "
+    client.sendPacket(&serverAddress, "h:", 2, &iterator);
+
+    // Short chunks are copied after the header; the long one is
+    // referred to in place.
+    UdpDriver::OutgoingPacket* packet = &client.sendQueue[0];
+    EXPECT_EQ(137U, packet->length);
+    EXPECT_EQ("h:abcdefg", string(packet->data, packet->dataLength));
+    EXPECT_EQ(3U, packet->iovecs);
+    EXPECT_EQ(5U, packet->iov[0].iov_len);
+    EXPECT_EQ(longChunk.c_str(),
+            static_cast<const char*>(packet->iov[1].iov_base));
+    EXPECT_EQ(packet->data + 5, packet->iov[2].iov_base);
+    EXPECT_EQ(4U, packet->iov[2].iov_len);
+    EXPECT_STREQ(("h:abc" + longChunk + "defg").c_str(),
+            serverHandler->receivePacket(&context));
+}
+
+TEST_F(UdpDriverTest, sendPacket_tooManyChunks) {
+    string longChunk(UdpDriver::MIN_ZERO_COPY_LENGTH, 'x');
+    Buffer message;
+    for (uint32_t i = 0; i < UdpDriver::MAX_PACKET_IOVECS; i++) {
+        message.appendExternal(longChunk.c_str(),
+                UdpDriver::MIN_ZERO_COPY_LENGTH);
+    }
+    Buffer::Iterator iterator(&message);
+    client.sendPacket(&serverAddress, "h:", 2, &iterator);
+
+    // All but the last iovec refer to chunks in place; the remaining
+    // chunks are copied.
+    UdpDriver::OutgoingPacket* packet = &client.sendQueue[0];
+    EXPECT_EQ(8U, packet->iovecs);
+    EXPECT_EQ(2 + 2*UdpDriver::MIN_ZERO_COPY_LENGTH, packet->dataLength);
+    EXPECT_EQ(packet->data + 2,
+            packet->iov[UdpDriver::MAX_PACKET_IOVECS - 1].iov_base);
+    string expected("h:");
+    for (uint32_t i = 0; i < UdpDriver::MAX_PACKET_IOVECS; i++) {
+        expected += longChunk;
+    }
+    EXPECT_STREQ(expected.c_str(), serverHandler->receivePacket(&context));
+}
+
+TEST_F(UdpDriverTest, sendPacket_queueFull) {
+    for (uint32_t i = 0; i <= UdpDriver::MAX_SEND_BATCH; i++)
+        sendMessage(&client, &serverAddress, "header:", "xyzzy");
+    EXPECT_EQ(1, sys->sendmmsgCalls);
+    EXPECT_EQ(1U, client.sendQueueLength);
+}
+
+TEST_F(UdpDriverTest, flushPackets) {
+    sendMessage(&client, &serverAddress, "header:", "xyzzy");
+    client.flushPackets();
+    EXPECT_EQ(1, sys->sendmmsgCalls);
+    EXPECT_EQ(0U, client.sendQueueLength);
+}
+
+TEST_F(UdpDriverTest, flushSendQueue_empty) {
+    EXPECT_EQ(0, client.flushSendQueue());
+    EXPECT_EQ(0, sys->sendmmsgCalls);
+}
+
+TEST_F(UdpDriverTest, flushSendQueue_batch) {
+    sendMessage(&client, &serverAddress, "header:", "first");
+    sendMessage(&client, &serverAddress, "header:", "second");
+    sendMessage(&client, &serverAddress, "header:", "third");
+    EXPECT_EQ(3, client.flushSendQueue());
+    EXPECT_EQ(1, sys->sendmmsgCalls);
+    EXPECT_STREQ("header:first, header:second, header:third",
+            serverHandler->receivePacket(&context));
+}
+
+TEST_F(UdpDriverTest, flushSendQueue_partialSend) {
+    sendMessage(&client, &serverAddress, "header:", "first");
+    sendMessage(&client, &serverAddress, "header:", "second");
+    sendMessage(&client, &serverAddress, "header:", "third");
+    sys->sendmmsgReturnCount = 1;
+    client.flushSendQueue();
+    EXPECT_EQ(2, sys->sendmmsgCalls);
+    EXPECT_STREQ("header:first, header:second, header:third",
+            serverHandler->receivePacket(&context));
+}
+
+TEST_F(UdpDriverTest, flushSendQueue_errorInSend) {
+    sys->sendmmsgErrno = EPERM;
+    sendMessage(&client, &serverAddress, "header:", "xyzzy");
+    client.flushSendQueue();
+    EXPECT_EQ("flushSendQueue: UdpDriver error sending to socket: "
             "Operation not permitted", TestLog::get());
+    EXPECT_EQ(0U, client.sendQueueLength);
+}
+
+TEST_F(UdpDriverTest, flushSendQueue_gsoGrouping) {
+    string full(UdpDriver::MAX_PAYLOAD_SIZE - 2, 'x');
+    ServiceLocator otherLocator("udp: host=localhost, port=8103");
+    IpAddress otherAddress(&otherLocator);
+    client.gso = true;
+    sys->sendmmsgErrno = EPERM;
+
+    // Full-sized packets to one address are combined with the packet
+    // after them; a short packet or a new address starts a new message.
+    sendMessage(&client, &serverAddress, "h:", full.c_str());
+    sendMessage(&client, &serverAddress, "h:", full.c_str());
+    sendMessage(&client, &serverAddress, "h:", "short");
+    sendMessage(&client, &serverAddress, "h:", full.c_str());
+    sendMessage(&client, &otherAddress, "h:", full.c_str());
+    client.flushSendQueue();
+    EXPECT_EQ(5U, client.sendHeaders[0].msg_hdr.msg_iovlen);
+    EXPECT_EQ(2U, client.sendHeaders[1].msg_hdr.msg_iovlen);
+    EXPECT_EQ(2U, client.sendHeaders[2].msg_hdr.msg_iovlen);
+    EXPECT_EQ(&client.sendIovecs[5], client.sendHeaders[1].msg_hdr.msg_iov);
+}
+
+TEST_F(UdpDriverTest, flushSendQueue_gso) {
+    ServiceLocator locator("udp: host=localhost, port=8102, gso=1");
+    UdpDriver driver(&context, &locator);
+    ASSERT_TRUE(driver.gso);
+    string full(UdpDriver::MAX_PAYLOAD_SIZE - 2, 'x');
+    sendMessage(&driver, &serverAddress, "h:", full.c_str());
+    sendMessage(&driver, &serverAddress, "h:", "end");
+    driver.flushSendQueue();
+
+    // The kernel splits the message back into the original packets.
+    serverHandler->receivePacket(&context);
+    EXPECT_EQ("h:" + full + ", h:end", serverHandler->packetData);
 }
 
 TEST_F(UdpDriverTest, ReadHandler_errorInRecv) {
-    sys->recvfromErrno = EPERM;
+    sys->recvmmsgErrno = EPERM;
     Driver::Received received;
     server.readHandler->handleFileEvent(
             Dispatch::FileEvent::READABLE);
@@ -219,4 +369,22 @@ TEST_F(UdpDriverTest, ReadHandler_multiplePackets) {
     EXPECT_STREQ("no packet arrived", serverHandler->receivePacket(&context));
 }
 
+TEST_F(UdpDriverTest, ReadHandler_moreThanOneBatch) {
+    uint32_t count = UdpDriver::MAX_RECEIVE_BATCH + 2;
+    for (uint32_t i = 0; i < count; i++)
+        sendMessage(&client, &serverAddress, "", "x");
+    client.flushSendQueue();
+    server.readHandler->handleFileEvent(Dispatch::FileEvent::READABLE);
+    EXPECT_EQ(3 * count - 2, serverHandler->packetData.size());
+    EXPECT_EQ(0, server.packetBufsUtilized);
+}
+
+TEST_F(UdpDriverTest, close_releaseReceiveBufs) {
+    server.readHandler->handleFileEvent(Dispatch::FileEvent::READABLE);
+    EXPECT_TRUE(server.receiveBufs[0] != NULL);
+    server.close();
+    EXPECT_TRUE(server.receiveBufs[0] == NULL);
+    EXPECT_EQ(0, server.packetBufPool.outstandingObjects);
+}
+
 }  // namespace RAMCloud
@@ -130,7 +130,8 @@ enum Opcode {
     TX_PREPARE                  = 77,
     TX_REQUEST_ABORT            = 78,
     TX_HINT_FAILED              = 79,
-    ILLEGAL_RPC_TYPE            = 80, // 1 + the highest legitimate Opcode
+    BATCH                       = 80,
+    ILLEGAL_RPC_TYPE            = 81, // 1 + the highest legitimate Opcode
 };
 
 /**
@@ -153,6 +154,8 @@ enum ControlOp {
     RESET_METRICS               = 1011,
     QUIESCE                     = 1012,
     LOG_BASIC_TRANSPORT_ISSUES  = 1013,
+    SET_MASTER_RUNTIME_OPTION   = 1014,
+    GET_RPC_LATENCIES           = 1015,
 };
 
 /**
@@ -395,6 +398,7 @@ struct BackupWrite {
             , primary()
             , certificateIncluded()
             , certificate()
+            , compressedLength()
         {}
         Request(const RequestCommonWithId& common,
                 uint64_t masterId,
@@ -406,7 +410,8 @@ struct BackupWrite {
                 bool close,
                 bool primary,
                 bool certificateIncluded,
-                const SegmentCertificate& certificate)
+                const SegmentCertificate& certificate,
+                uint32_t compressedLength = 0)
             : common(common)
             , masterId(masterId)
             , segmentId(segmentId)
@@ -418,6 +423,7 @@ struct BackupWrite {
             , primary(primary)
             , certificateIncluded(certificateIncluded)
             , certificate(certificate)
+            , compressedLength(compressedLength)
         {}
         RequestCommonWithId common;
         uint64_t masterId;        ///< Server from whom the request is coming.
@@ -441,6 +447,11 @@ struct BackupWrite {
                                         ///< written to storage
                                         ///< following the data included
                                         ///< in this rpc.
+        uint32_t compressedLength;      ///< If 0, the data follows as is;
+                                        ///< otherwise it was compressed
+                                        ///< (see Compression) to this many
+                                        ///< bytes, and decompresses to
+                                        ///< #length bytes.
         // Opaque byte string follows with data to write.
     } __attribute__((packed));
     struct Response {
@@ -448,6 +459,40 @@ struct BackupWrite {
     } __attribute__((packed));
 };
 
+/**
+ * A BATCH request carries several small requests for the same server in
+ * one message (see BatchingSession). It is not handled by any service:
+ * WorkerManager splits it up and services each of the requests like an
+ * RPC of its own, then returns all of their responses in one message.
+ */
+struct Batch {
+    static const Opcode opcode = BATCH;
+    static const ServiceType service = PING_SERVICE; // Not used.
+
+    /// The maximum number of requests in one BATCH request.
+    static const uint32_t MAX_REQUESTS = 64;
+
+    /// Used in place of a response length in a BATCH response to mean that
+    /// the response didn't fit in the BATCH response; the client must
+    /// send that request again on its own.
+    static const uint32_t RESEND = ~0u;
+
+    struct Request {
+        RequestCommon common;
+        uint32_t count;             // Number of requests in the batch.
+        // In buffer: for each request, a uint32_t length followed by
+        // that many bytes of request (starting with a RequestCommon).
+    } __attribute__((packed));
+    struct Response {
+        ResponseCommon common;
+        uint32_t count;             // Number of responses in the batch;
+                                    // same as count in the request.
+        // In buffer: for each request, in the same order as in the
+        // request, a uint32_t length followed by that many bytes of
+        // response (the length may also be RESEND, with no bytes).
+    } __attribute__((packed));
+};
+
 struct CoordSplitAndMigrateIndexlet {
     static const Opcode opcode = COORD_SPLIT_AND_MIGRATE_INDEXLET;
     static const ServiceType service = COORDINATOR_SERVICE;
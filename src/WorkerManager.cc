@@ -22,6 +22,7 @@
 #include "LogProtector.h"
 #include "PerfStats.h"
 #include "RawMetrics.h"
+#include "RpcLatencyStats.h"
 #include "RpcLevel.h"
 #include "ShortMacros.h"
 #include "ServerRpcPool.h"
@@ -86,8 +87,11 @@ WorkerManager::WorkerManager(Context* context, uint32_t maxCores)
     , idleThreads()
     , maxCores(maxCores)
     , rpcsWaiting(0)
+    , inlineShortRpcs(false)
+    , inlineWorker(new Worker(context))
     , testingSaveRpcs(0)
     , testRpcs()
+    , batchedRpcPool()
 {
     levels.resize(RpcLevel::maxLevel() + 1);
 
@@ -123,6 +127,55 @@ WorkerManager::~WorkerManager()
         worker->exit();
         delete worker;
     }
+    delete inlineWorker;
+}
+
+/**
+ * This method is invoked once all of the requests in a BATCH request have
+ * replied; it sends the BATCH response.
+ *
+ * \param batch
+ *      The batch that is finished; it is deleted by this method.
+ */
+void
+WorkerManager::finishBatch(Batch* batch)
+{
+    Transport::ServerRpc* rpc = batch->rpc;
+    WireFormat::Batch::Response* header =
+            rpc->replyPayload.emplaceAppend<WireFormat::Batch::Response>();
+    header->common.status = STATUS_OK;
+    header->count = downCast<uint32_t>(batch->requests.size());
+
+    // The replies must be copied: they may refer to log memory, which is
+    // only protected until their BatchedRpcs are destroyed.
+    uint64_t totalLength = rpc->replyPayload.size();
+    foreach (BatchedRpc* request, batch->requests) {
+        uint32_t length = request->replyPayload.size();
+        totalLength += sizeof(length) + length;
+        if (totalLength > Transport::MAX_RPC_LEN) {
+            // The client will send this request again on its own.
+            totalLength -= length;
+            rpc->replyPayload.emplaceAppend<uint32_t>(
+                    static_cast<uint32_t>(WireFormat::Batch::RESEND));
+        } else {
+            rpc->replyPayload.emplaceAppend<uint32_t>(length);
+            request->replyPayload.copy(0, length,
+                    rpc->replyPayload.alloc(length));
+        }
+        batchedRpcPool.destroy(request);
+    }
+    delete batch;
+    rpc->sendReply();
+}
+
+/**
+ * Returns true if short RPCs are executed in the dispatch thread; see
+ * setInlineShortRpcs.
+ */
+bool
+WorkerManager::getInlineShortRpcs()
+{
+    return inlineShortRpcs;
 }
 
 /**
@@ -163,6 +216,11 @@ WorkerManager::handleRpc(Transport::ServerRpc* rpc)
         rpc->sendReply();
         return;
     }
+    if (header->opcode == WireFormat::BATCH) {
+        handleBatch(rpc);
+        return;
+    }
+    rpc->arrivalTime = Cycles::rdtsc();
     int level = RpcLevel::getLevel(WireFormat::Opcode(header->opcode));
 #ifdef LOG_RPCS
     LOG(NOTICE, "Received %s RPC at %lu with %u bytes",
@@ -191,16 +249,17 @@ WorkerManager::handleRpc(Transport::ServerRpc* rpc)
         }
     }
 
-    // Temporary code to test how much faster things would be without threads.
-#if 0
-    if ((header->opcode == WireFormat::READ) &&
-            (header->service == WireFormat::MASTER_SERVICE)) {
-        Service::Rpc serviceRpc(NULL, &rpc->requestPayload, &rpc->replyPayload);
-        services[WireFormat::MASTER_SERVICE]->service.handleRpc(&serviceRpc);
-        rpc->sendReply();
+    // Handing a request off to a worker costs a cache miss in each
+    // direction, which is a large fraction of the service time for small
+    // reads. If no worker is busy, short requests are cheaper to execute
+    // right here. We only do this when no worker is busy: otherwise a
+    // worker could be holding a lock the request needs while it waits for
+    // the dispatch thread (e.g. to replicate a new log head).
+    if (inlineShortRpcs && busyThreads.empty()
+            && isShortRpc(header, &rpc->requestPayload)) {
+        runInline(rpc, level);
         return;
     }
-#endif
 
     levels[level].requestsRunning++;
 
@@ -215,6 +274,115 @@ WorkerManager::handleRpc(Transport::ServerRpc* rpc)
     busyThreads.push_back(worker);
 }
 
+/**
+ * This method is invoked by handleRpc for BATCH requests. It splits the
+ * batch into its individual requests and passes each of them to handleRpc;
+ * the BATCH response is sent by finishBatch once they have all replied.
+ *
+ * \param rpc
+ *      A BATCH request.
+ */
+void
+WorkerManager::handleBatch(Transport::ServerRpc* rpc)
+{
+    Buffer* request = &rpc->requestPayload;
+    const WireFormat::Batch::Request* header =
+            request->getStart<WireFormat::Batch::Request>();
+    if (header == NULL) {
+        Service::prepareErrorResponse(&rpc->replyPayload,
+                STATUS_MESSAGE_TOO_SHORT);
+        rpc->sendReply();
+        return;
+    }
+
+    // Check the whole batch before starting any of its requests, so that
+    // we never have to abandon requests that are already executing.
+    bool malformed = (header->count > WireFormat::Batch::MAX_REQUESTS);
+    uint32_t offset = sizeof32(*header);
+    for (uint32_t i = 0; !malformed && (i < header->count); i++) {
+        const uint32_t* length = request->getOffset<uint32_t>(offset);
+        if ((length == NULL)
+                || (*length > request->size() - offset - sizeof(*length))) {
+            malformed = true;
+            break;
+        }
+        offset += sizeof32(*length) + *length;
+    }
+    if (malformed) {
+        LOG(WARNING, "Incoming BATCH request is malformed (message "
+                "length %u, %u requests)", request->size(), header->count);
+        Service::prepareErrorResponse(&rpc->replyPayload,
+                STATUS_REQUEST_FORMAT_ERROR);
+        rpc->sendReply();
+        return;
+    }
+
+    Batch* batch = new Batch(rpc);
+    offset = sizeof32(*header);
+    for (uint32_t i = 0; i < header->count; i++) {
+        uint32_t length = *request->getOffset<uint32_t>(offset);
+        offset += sizeof32(length);
+        BatchedRpc* batchedRpc = batchedRpcPool.construct(this, batch);
+        batchedRpc->requestPayload.appendExternal(request, offset, length);
+        batch->requests.push_back(batchedRpc);
+        offset += length;
+    }
+
+    // Some requests may reply before handleRpc returns; the extra count
+    // keeps the batch from finishing until all of them have been started.
+    batch->outstanding = downCast<uint32_t>(batch->requests.size()) + 1;
+    foreach (BatchedRpc* batchedRpc, batch->requests) {
+        const WireFormat::RequestCommon* requestHeader =
+                batchedRpc->requestPayload.getStart<
+                WireFormat::RequestCommon>();
+        if ((requestHeader != NULL)
+                && (requestHeader->opcode == WireFormat::BATCH)) {
+            Service::prepareErrorResponse(&batchedRpc->replyPayload,
+                    STATUS_REQUEST_FORMAT_ERROR);
+            batchedRpc->sendReply();
+            continue;
+        }
+        handleRpc(batchedRpc);
+    }
+    batch->outstanding--;
+    if (batch->outstanding == 0) {
+        finishBatch(batch);
+    }
+}
+
+/**
+ * Returns true if the given request is short enough to execute in the
+ * dispatch thread: it must finish in a few microseconds, never block, and
+ * never wait for the dispatch thread (for example to send an RPC of its own
+ * or to replicate log data). Anything that modifies objects is excluded,
+ * since it has to wait for replication.
+ *
+ * \param header
+ *      Header of the request.
+ * \param request
+ *      The complete request.
+ */
+bool
+WorkerManager::isShortRpc(const WireFormat::RequestCommon* header,
+        Buffer* request)
+{
+    switch (header->opcode) {
+        case WireFormat::PING:
+        case WireFormat::READ:
+        case WireFormat::READ_HASHES:
+        case WireFormat::READ_KEYS_AND_VALUE:
+            return true;
+        case WireFormat::MULTI_OP: {
+            const WireFormat::MultiOp::Request* multiOp =
+                    request->getStart<WireFormat::MultiOp::Request>();
+            return (multiOp != NULL) &&
+                    (multiOp->type == WireFormat::MultiOp::READ);
+        }
+        default:
+            return false;
+    }
+}
+
 /**
  * Returns true if there are currently no RPCs being serviced, false
  * if at least one RPC is currently being executed by a worker.  If true
@@ -329,6 +497,81 @@ WorkerManager::poll()
     return foundWork;
 }
 
+/**
+ * Execute an RPC in the dispatch thread and send its reply. Used for short
+ * RPCs when no worker is busy (see handleRpc).
+ *
+ * \param rpc
+ *      RPC to execute.
+ * \param level
+ *      RpcLevel of the RPC.
+ */
+void
+WorkerManager::runInline(Transport::ServerRpc* rpc, int level)
+{
+    const WireFormat::RequestCommon* header =
+            rpc->requestPayload.getStart<WireFormat::RequestCommon>();
+    uint64_t start = Cycles::rdtsc();
+    WireFormat::Opcode opcode = WireFormat::Opcode(header->opcode);
+    inlineWorker->opcode = opcode;
+    inlineWorker->level = level;
+    inlineWorker->rpc = rpc;
+    inlineWorker->state.store(Worker::WORKING);
+
+    rpc->epoch = LogProtector::getCurrentEpoch();
+    Service::Rpc serviceRpc(inlineWorker, &rpc->requestPayload,
+            &rpc->replyPayload);
+    Service::handleRpc(context, &serviceRpc);
+
+    inlineWorker->rpc = NULL;
+    inlineWorker->state.store(Worker::POLLING);
+    uint64_t serviceCycles = Cycles::rdtsc() - start;
+    PerfStats::threadStats.inlineRpcs++;
+    PerfStats::threadStats.inlineRpcCycles += serviceCycles;
+    RpcLatencyStats::recordRpc(opcode, start - rpc->arrivalTime,
+            serviceCycles);
+    rpc->sendReply();
+}
+
+/**
+ * Specify whether short RPCs, such as reads of small objects, should be
+ * executed directly in the dispatch thread when no worker is busy. This
+ * saves the cost of handing them to a worker thread and back, but delays
+ * the dispatch thread's other work while they run.
+ *
+ * \param inlineShortRpcs
+ *      True means execute short RPCs in the dispatch thread when possible;
+ *      false means always hand RPCs to workers (the default).
+ */
+void
+WorkerManager::setInlineShortRpcs(bool inlineShortRpcs)
+{
+    this->inlineShortRpcs = inlineShortRpcs;
+}
+
+/**
+ * Invoked (in the dispatch thread) once a request from a BATCH request
+ * has been serviced. Its reply is saved until all the requests in the
+ * batch have replied.
+ */
+void
+WorkerManager::BatchedRpc::sendReply()
+{
+    batch->outstanding--;
+    if (batch->outstanding == 0) {
+        manager->finishBatch(batch);
+    }
+}
+
+/**
+ * Returns the service locator of the client that sent the BATCH request.
+ */
+string
+WorkerManager::BatchedRpc::getClientServiceLocator()
+{
+    return batch->rpc->getClientServiceLocator();
+}
+
 /**
  * Wait for an RPC request to appear in the testRpcs queue, but give up if
  * it takes too long.  This method is intended only for testing (it only
@@ -427,10 +670,21 @@ WorkerManager::workerMain(Worker* worker)
                     TimeTraceUtil::RequestStatus::WORKER_START));
 #endif
 
+            // Once handleRpc returns (or sends an early reply), the
+            // ServerRpc may already be gone, so grab what RpcLatencyStats
+            // needs now.
+            uint64_t start = Cycles::rdtsc();
+            uint64_t queueingCycles = start - worker->rpc->arrivalTime;
+            WireFormat::Opcode opcode = WireFormat::Opcode(
+                    worker->rpc->requestPayload.getStart<
+                    WireFormat::RequestCommon>()->opcode);
+
             worker->rpc->epoch = LogProtector::getCurrentEpoch();
             Service::Rpc rpc(worker, &worker->rpc->requestPayload,
                     &worker->rpc->replyPayload);
             Service::handleRpc(worker->context, &rpc);
+            RpcLatencyStats::recordRpc(opcode, queueingCycles,
+                    Cycles::rdtsc() - start);
 
             // Pass the RPC back to the dispatch thread for completion.
             Fence::leave();
@@ -19,6 +19,7 @@
 #include <queue>
 
 #include "Dispatch.h"
+#include "ServerRpcPool.h"
 #include "Service.h"
 #include "Transport.h"
 #include "WireFormat.h"
@@ -40,10 +41,12 @@ class WorkerManager : Dispatch::Poller {
     ~WorkerManager();
 
     void exitWorker();
+    bool getInlineShortRpcs();
     void handleRpc(Transport::ServerRpc* rpc);
     bool idle();
     static void init();
     int poll();
+    void setInlineShortRpcs(bool inlineShortRpcs);
     void setServerId(ServerId serverId);
     Transport::ServerRpc* waitForRpc(double timeoutSeconds);
 
@@ -94,6 +97,15 @@ class WorkerManager : Dispatch::Poller {
     // Total number of RPCs (across all Levels) in waitingRpcs queues.
     int rpcsWaiting;
 
+    // True means short RPCs (see isShortRpc) are executed directly in the
+    // dispatch thread whenever no worker is busy, rather than handed off.
+    bool inlineShortRpcs;
+
+    // Stands in for a worker thread when an RPC executes in the dispatch
+    // thread, so that services can use Service::Rpc::worker as usual. It
+    // has no thread of its own.
+    Worker* inlineWorker;
+
     // Nonzero means save incoming RPCs rather than executing them.
     // Intended for use in unit tests only.
     int testingSaveRpcs;
@@ -102,6 +114,65 @@ class WorkerManager : Dispatch::Poller {
     // queued here, not sent to workers.
     std::queue<Transport::ServerRpc*> testRpcs;
 
+    struct Batch;
+
+    /**
+     * One of the requests carried by a BATCH request (see
+     * WireFormat::Batch). Each is serviced like an RPC of its own; the
+     * BATCH response is sent once all of them have replied.
+     */
+    class BatchedRpc : public Transport::ServerRpc {
+      public:
+        BatchedRpc(WorkerManager* manager, Batch* batch)
+            : manager(manager)
+            , batch(batch)
+        {}
+        void sendReply();
+        string getClientServiceLocator();
+
+        /// The WorkerManager that is servicing this request.
+        WorkerManager* manager;
+
+        /// The batch that this request arrived in.
+        Batch* batch;
+
+      PRIVATE:
+        DISALLOW_COPY_AND_ASSIGN(BatchedRpc);
+    };
+
+    /**
+     * Keeps track of the requests from one BATCH request until they have
+     * all replied.
+     */
+    struct Batch {
+        explicit Batch(Transport::ServerRpc* rpc)
+            : rpc(rpc)
+            , requests()
+            , outstanding(0)
+        {}
+
+        /// The BATCH RPC.
+        Transport::ServerRpc* rpc;
+
+        /// One entry for each of the requests in the batch, in order.
+        std::vector<BatchedRpc*> requests;
+
+        /// Number of requests in the batch that haven't replied yet.
+        uint32_t outstanding;
+
+        DISALLOW_COPY_AND_ASSIGN(Batch);
+    };
+
+    // BatchedRpcs are allocated from here. The pool keeps track of their
+    // epochs, so that log memory referenced by their replies isn't freed
+    // before the BATCH response has been assembled.
+    ServerRpcPool<BatchedRpc> batchedRpcPool;
+
+    void finishBatch(Batch* batch);
+    void handleBatch(Transport::ServerRpc* rpc);
+    static bool isShortRpc(const WireFormat::RequestCommon* header,
+            Buffer* request);
+    void runInline(Transport::ServerRpc* rpc, int level);
     static void workerMain(Worker* worker);
     static Syscall *sys;
 
@@ -18,6 +18,7 @@
 #include "MockService.h"
 #include "MockSyscall.h"
 #include "MockTransport.h"
+#include "RpcLatencyStats.h"
 #include "RpcLevel.h"
 #include "Tub.h"
 #include "WorkerManager.h"
@@ -159,6 +160,32 @@ TEST_F(WorkerManagerTest, handleRpc_badOpcode) {
             statusToSymbol(transport.status));
 }
 
+TEST_F(WorkerManagerTest, handleRpc_batch) {
+    MockTransport::MockServerRpc* rpc = new MockTransport::MockServerRpc(
+            &transport, NULL);
+    WireFormat::Batch::Request* header =
+            rpc->requestPayload.emplaceAppend<WireFormat::Batch::Request>();
+    header->common.opcode = WireFormat::BATCH;
+    header->common.service = WireFormat::Batch::service;
+    header->count = 2;
+    rpc->requestPayload.emplaceAppend<uint32_t>(12);
+    rpc->requestPayload.fillFromString("0x10000 3 4");
+    rpc->requestPayload.emplaceAppend<uint32_t>(8);
+    rpc->requestPayload.fillFromString("0x10000 5");
+    manager->handleRpc(rpc);
+
+    // Wait for the batch to be processed (but don't wait forever).
+    for (int i = 0; i < 1000; i++) {
+        context.dispatch->poll();
+        if (!transport.outputLog.empty())
+            break;
+        usleep(1000);
+    }
+    EXPECT_EQ("serverReply: 0 2 12 0x10001 4 5 8 0x10001 6",
+            transport.outputLog);
+    EXPECT_EQ(0U, manager->batchedRpcPool.outstandingAllocations);
+}
+
 TEST_F(WorkerManagerTest, handleRpc_deferRpc) {
     // Create 2 RPCs that can be scheduled.
     MockTransport::MockServerRpc* rpc1 = new MockTransport::MockServerRpc(
@@ -200,6 +227,165 @@ TEST_F(WorkerManagerTest, handleRpc_handoffToWorker) {
     EXPECT_EQ(5U, manager->idleThreads.size());
 }
 
+TEST_F(WorkerManagerTest, handleRpc_inlineShortRpc) {
+    RpcLevel::levelsPtr = RpcLevel::levels;
+    manager->setInlineShortRpcs(true);
+    MockTransport::MockServerRpc* rpc = new MockTransport::MockServerRpc(
+            &transport, "0x10007 3 4");
+    RpcLatencyStats::reset();
+    manager->handleRpc(rpc);
+
+    // The RPC completed before handleRpc returned, without a worker.
+    EXPECT_EQ("rpc: 0x10007 3 4", service.log);
+    EXPECT_EQ("serverReply: 0x10008 4 5", transport.outputLog);
+    EXPECT_EQ(0U, manager->busyThreads.size());
+    EXPECT_EQ(0, manager->levels[RpcLevel::getLevel(WireFormat::PING)]
+            .requestsRunning);
+    EXPECT_TRUE(manager->inlineWorker->rpc == NULL);
+    EXPECT_EQ(1U, RpcLatencyStats::threadLatencies->serviceTime[
+            WireFormat::PING]->getTotalSamples());
+}
+
+TEST_F(WorkerManagerTest, handleRpc_inlineShortRpc_workerBusy) {
+    RpcLevel::levelsPtr = RpcLevel::levels;
+    manager->setInlineShortRpcs(true);
+
+    // Keep a worker busy with a request that isn't short.
+    service.gate = -1;
+    MockTransport::MockServerRpc* rpc1 = new MockTransport::MockServerRpc(
+            &transport, "0x10000 3");
+    manager->handleRpc(rpc1);
+    EXPECT_EQ(1U, manager->busyThreads.size());
+
+    // A short request must now go to a worker as well.
+    MockTransport::MockServerRpc* rpc2 = new MockTransport::MockServerRpc(
+            &transport, "0x10007 4");
+    manager->handleRpc(rpc2);
+    EXPECT_EQ(2U, manager->busyThreads.size());
+    EXPECT_EQ("", transport.outputLog);
+}
+
+TEST_F(WorkerManagerTest, handleRpc_inlineShortRpcs_disabled) {
+    RpcLevel::levelsPtr = RpcLevel::levels;
+    service.gate = -1;
+    MockTransport::MockServerRpc* rpc = new MockTransport::MockServerRpc(
+            &transport, "0x10007 3");
+    manager->handleRpc(rpc);
+    EXPECT_EQ(1U, manager->busyThreads.size());
+}
+
+TEST_F(WorkerManagerTest, finishBatch_resend) {
+    MockTransport::MockServerRpc* rpc = new MockTransport::MockServerRpc(
+            &transport, NULL);
+    WorkerManager::Batch* batch = new WorkerManager::Batch(rpc);
+    batch->requests.push_back(
+            manager->batchedRpcPool.construct(manager.get(), batch));
+    batch->requests.push_back(
+            manager->batchedRpcPool.construct(manager.get(), batch));
+    batch->requests.push_back(
+            manager->batchedRpcPool.construct(manager.get(), batch));
+    batch->outstanding = 3;
+    batch->requests[0]->replyPayload.fillFromString("1");
+    std::unique_ptr<char[]> big(new char[Transport::MAX_RPC_LEN]);
+    batch->requests[1]->replyPayload.appendExternal(big.get(),
+            Transport::MAX_RPC_LEN);
+    batch->requests[2]->replyPayload.fillFromString("2");
+    for (uint32_t i = 0; i < 3; i++) {
+        batch->requests[i]->sendReply();
+    }
+    EXPECT_EQ("serverReply: 0 3 4 1 -1 4 2", transport.outputLog);
+    EXPECT_EQ(0U, manager->batchedRpcPool.outstandingAllocations);
+}
+
+TEST_F(WorkerManagerTest, handleBatch_tooShort) {
+    MockTransport::MockServerRpc* rpc = new MockTransport::MockServerRpc(
+            &transport, NULL);
+    WireFormat::RequestCommon* header =
+            rpc->requestPayload.emplaceAppend<WireFormat::RequestCommon>();
+    header->opcode = WireFormat::BATCH;
+    header->service = WireFormat::Batch::service;
+    manager->handleRpc(rpc);
+    EXPECT_STREQ("STATUS_MESSAGE_TOO_SHORT",
+            statusToSymbol(transport.status));
+}
+
+TEST_F(WorkerManagerTest, handleBatch_malformed) {
+    TestLog::Enable _;
+    MockTransport::MockServerRpc* rpc = new MockTransport::MockServerRpc(
+            &transport, NULL);
+    WireFormat::Batch::Request* header =
+            rpc->requestPayload.emplaceAppend<WireFormat::Batch::Request>();
+    header->common.opcode = WireFormat::BATCH;
+    header->common.service = WireFormat::Batch::service;
+    header->count = 2;
+    rpc->requestPayload.emplaceAppend<uint32_t>(4);
+    rpc->requestPayload.fillFromString("0x10000");
+    rpc->requestPayload.emplaceAppend<uint32_t>(5);
+    rpc->requestPayload.fillFromString("0x10000");
+    manager->handleRpc(rpc);
+    EXPECT_EQ("handleBatch: Incoming BATCH request is malformed (message "
+            "length 24, 2 requests)", TestLog::get());
+    EXPECT_STREQ("STATUS_REQUEST_FORMAT_ERROR",
+            statusToSymbol(transport.status));
+    EXPECT_EQ(0U, manager->batchedRpcPool.outstandingAllocations);
+
+    // Too many requests.
+    TestLog::reset();
+    rpc = new MockTransport::MockServerRpc(&transport, NULL);
+    header = rpc->requestPayload.emplaceAppend<WireFormat::Batch::Request>();
+    header->common.opcode = WireFormat::BATCH;
+    header->common.service = WireFormat::Batch::service;
+    header->count = WireFormat::Batch::MAX_REQUESTS + 1;
+    manager->handleRpc(rpc);
+    EXPECT_EQ("handleBatch: Incoming BATCH request is malformed (message "
+            "length 8, 65 requests)", TestLog::get());
+}
+
+TEST_F(WorkerManagerTest, handleBatch_nestedBatch) {
+    MockTransport::MockServerRpc* rpc = new MockTransport::MockServerRpc(
+            &transport, NULL);
+    WireFormat::Batch::Request* header =
+            rpc->requestPayload.emplaceAppend<WireFormat::Batch::Request>();
+    header->common.opcode = WireFormat::BATCH;
+    header->common.service = WireFormat::Batch::service;
+    header->count = 1;
+    rpc->requestPayload.emplaceAppend<uint32_t>(8);
+    rpc->requestPayload.appendCopy(header);
+
+    // The inner batch is rejected without being started, and the outer
+    // one finishes before handleRpc returns.
+    manager->handleRpc(rpc);
+    EXPECT_EQ("serverReply: 0 1 4 9", transport.outputLog);
+    EXPECT_EQ(0U, manager->batchedRpcPool.outstandingAllocations);
+}
+
+TEST_F(WorkerManagerTest, isShortRpc) {
+    Buffer request;
+    WireFormat::RequestCommon* header =
+            request.emplaceAppend<WireFormat::RequestCommon>();
+    header->service = WireFormat::MASTER_SERVICE;
+    header->opcode = WireFormat::READ;
+    EXPECT_TRUE(WorkerManager::isShortRpc(header, &request));
+    header->opcode = WireFormat::WRITE;
+    EXPECT_FALSE(WorkerManager::isShortRpc(header, &request));
+
+    // MULTI_OP requests are short only if they read, and only if the
+    // request is long enough to tell.
+    header->opcode = WireFormat::MULTI_OP;
+    EXPECT_FALSE(WorkerManager::isShortRpc(header, &request));
+
+    Buffer multiRequest;
+    WireFormat::MultiOp::Request* multiOp =
+            multiRequest.emplaceAppend<WireFormat::MultiOp::Request>();
+    multiOp->common.service = WireFormat::MASTER_SERVICE;
+    multiOp->common.opcode = WireFormat::MULTI_OP;
+    multiOp->count = 1;
+    multiOp->type = WireFormat::MultiOp::READ;
+    EXPECT_TRUE(WorkerManager::isShortRpc(&multiOp->common, &multiRequest));
+    multiOp->type = WireFormat::MultiOp::WRITE;
+    EXPECT_FALSE(WorkerManager::isShortRpc(&multiOp->common, &multiRequest));
+}
+
 TEST_F(WorkerManagerTest, idle) {
     EXPECT_TRUE(manager->idle());
     // Start one RPC.
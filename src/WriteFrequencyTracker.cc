@@ -0,0 +1,104 @@
+/* Copyright (c) 2026 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "BitOps.h"
+#include "WriteFrequencyTracker.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a new tracker with all counters zeroed.
+ *
+ * \param numCounters
+ *      Number of one-byte counters to allocate. Rounded up to a power of
+ *      two. More counters mean fewer collisions between keys, and also a
+ *      longer aging period.
+ * \param hotThreshold
+ *      Estimated write count at or above which isHot() returns true.
+ */
+WriteFrequencyTracker::WriteFrequencyTracker(uint32_t numCounters,
+                                             uint8_t hotThreshold)
+    : numCounters(BitOps::powerOfTwoGreaterOrEqual(
+            std::max(numCounters, 1U)))
+    , mask(this->numCounters - 1)
+    , hotThreshold(hotThreshold)
+    , counters(new std::atomic<uint8_t>[this->numCounters])
+    , writesSinceAging(0)
+{
+    for (uint32_t i = 0; i < this->numCounters; i++)
+        counters[i].store(0, std::memory_order_relaxed);
+}
+
+/**
+ * Note that the key with the given hash has just been written (or
+ * overwritten, or deleted).
+ */
+void
+WriteFrequencyTracker::recordWrite(KeyHash keyHash)
+{
+    std::atomic<uint8_t>& first = counters[firstIndex(keyHash)];
+    std::atomic<uint8_t>& second = counters[secondIndex(keyHash)];
+    uint8_t a = first.load(std::memory_order_relaxed);
+    uint8_t b = second.load(std::memory_order_relaxed);
+    uint8_t min = std::min(a, b);
+
+    // Only bump the counters that currently hold the estimate. This keeps
+    // keys that merely collide with a hot key on one counter from being
+    // inflated further than necessary.
+    if (min < MAX_COUNT) {
+        if (a == min)
+            first.store(downCast<uint8_t>(a + 1), std::memory_order_relaxed);
+        if (b == min && &second != &first)
+            second.store(downCast<uint8_t>(b + 1), std::memory_order_relaxed);
+    }
+
+    uint32_t writes = writesSinceAging.fetch_add(1,
+            std::memory_order_relaxed) + 1;
+    if (writes == numCounters) {
+        age();
+        writesSinceAging.fetch_sub(numCounters, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Return the estimated number of recent writes to the key with the given
+ * hash. The estimate is never lower than the true (aged) count, except for
+ * increments lost to races.
+ */
+uint8_t
+WriteFrequencyTracker::getEstimate(KeyHash keyHash) const
+{
+    return std::min(counters[firstIndex(keyHash)].load(
+                        std::memory_order_relaxed),
+                    counters[secondIndex(keyHash)].load(
+                        std::memory_order_relaxed));
+}
+
+/**
+ * Halve every counter, so that writes from the distant past gradually
+ * stop counting towards a key's hotness.
+ */
+void
+WriteFrequencyTracker::age()
+{
+    for (uint32_t i = 0; i < numCounters; i++) {
+        uint8_t count = counters[i].load(std::memory_order_relaxed);
+        if (count != 0)
+            counters[i].store(downCast<uint8_t>(count >> 1),
+                              std::memory_order_relaxed);
+    }
+}
+
+} // namespace RAMCloud
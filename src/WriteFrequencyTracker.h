@@ -0,0 +1,120 @@
+/* Copyright (c) 2026 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_WRITEFREQUENCYTRACKER_H
+#define RAMCLOUD_WRITEFREQUENCYTRACKER_H
+
+#include <atomic>
+#include <memory>
+
+#include "Common.h"
+#include "Key.h"
+
+namespace RAMCloud {
+
+/**
+ * Approximates how often each key has recently been written, so that the
+ * log cleaner can keep frequently overwritten ("hot") objects apart from
+ * rarely overwritten ("cold") ones when it relocates live data. Hot objects
+ * die quickly, so packing them together produces survivor segments that
+ * empty out on their own instead of dragging cold data through another
+ * round of cleaning.
+ *
+ * The tracker is a small counting sketch: each key hash maps to two
+ * saturating 8-bit counters in a fixed array, and a key's estimated write
+ * count is the smaller of the two. Collisions can only inflate an
+ * estimate, never deflate it. To forget old history, all counters are
+ * halved each time the number of recorded writes reaches the number of
+ * counters.
+ *
+ * The tracker is shared by all worker threads without locking. Counter
+ * updates are relaxed loads and stores, so concurrent writes to colliding
+ * counters may occasionally lose an increment. That is harmless for a
+ * heuristic like this one.
+ */
+class WriteFrequencyTracker {
+  public:
+    /// Default number of counters (one byte each).
+    static const uint32_t DEFAULT_COUNTERS = 1 << 20;
+
+    /// Default estimated write count at or above which a key is hot. Since
+    /// counters are halved periodically, a key must be written at least
+    /// about this many times per aging period to remain hot.
+    static const uint8_t DEFAULT_HOT_THRESHOLD = 4;
+
+    explicit WriteFrequencyTracker(uint32_t numCounters = DEFAULT_COUNTERS,
+                                   uint8_t hotThreshold =
+                                        DEFAULT_HOT_THRESHOLD);
+    void recordWrite(KeyHash keyHash);
+    uint8_t getEstimate(KeyHash keyHash) const;
+
+    /**
+     * Return true if the key with the given hash has been written often
+     * enough recently to be considered hot.
+     */
+    bool
+    isHot(KeyHash keyHash) const
+    {
+        return getEstimate(keyHash) >= hotThreshold;
+    }
+
+  PRIVATE:
+    void age();
+
+    /// Largest value a counter can hold.
+    static const uint8_t MAX_COUNT = 255;
+
+    /**
+     * Return the index of the first counter for a key hash. The two
+     * counters are taken from opposite halves of the 64-bit hash so that
+     * keys colliding on one are unlikely to collide on the other.
+     */
+    uint32_t
+    firstIndex(KeyHash keyHash) const
+    {
+        return downCast<uint32_t>(keyHash & mask);
+    }
+
+    /**
+     * Return the index of the second counter for a key hash. See
+     * firstIndex().
+     */
+    uint32_t
+    secondIndex(KeyHash keyHash) const
+    {
+        return downCast<uint32_t>((keyHash >> 32) & mask);
+    }
+
+    /// Number of counters in #counters. Always a power of two.
+    const uint32_t numCounters;
+
+    /// numCounters - 1; used to map hashes to counter indexes.
+    const uint64_t mask;
+
+    /// Keys whose estimate is at least this large are hot.
+    const uint8_t hotThreshold;
+
+    /// The counters themselves.
+    std::unique_ptr<std::atomic<uint8_t>[]> counters;
+
+    /// Writes recorded since the counters were last aged.
+    std::atomic<uint32_t> writesSinceAging;
+
+    DISALLOW_COPY_AND_ASSIGN(WriteFrequencyTracker);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_WRITEFREQUENCYTRACKER_H
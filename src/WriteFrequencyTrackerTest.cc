@@ -0,0 +1,71 @@
+/* Copyright (c) 2026 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "WriteFrequencyTracker.h"
+
+namespace RAMCloud {
+
+TEST(WriteFrequencyTrackerTest, constructor) {
+    WriteFrequencyTracker tracker(1000, 3);
+    EXPECT_EQ(1024U, tracker.numCounters);
+    EXPECT_EQ(1023U, tracker.mask);
+    EXPECT_EQ(3U, tracker.hotThreshold);
+    EXPECT_EQ(0U, tracker.getEstimate(12345));
+
+    WriteFrequencyTracker tiny(0);
+    EXPECT_EQ(1U, tiny.numCounters);
+}
+
+TEST(WriteFrequencyTrackerTest, recordWrite) {
+    WriteFrequencyTracker tracker(1024, 2);
+    KeyHash hot = (5UL << 32) | 7;
+    KeyHash collides = (9UL << 32) | 7;
+
+    tracker.recordWrite(hot);
+    EXPECT_EQ(1U, tracker.getEstimate(hot));
+    EXPECT_FALSE(tracker.isHot(hot));
+    tracker.recordWrite(hot);
+    EXPECT_EQ(2U, tracker.getEstimate(hot));
+    EXPECT_TRUE(tracker.isHot(hot));
+
+    // Sharing one counter with a hot key isn't enough to look hot.
+    EXPECT_EQ(0U, tracker.getEstimate(collides));
+    tracker.recordWrite(collides);
+    EXPECT_EQ(1U, tracker.getEstimate(collides));
+    EXPECT_EQ(2U, tracker.counters[7].load());
+    EXPECT_EQ(2U, tracker.getEstimate(hot));
+}
+
+TEST(WriteFrequencyTrackerTest, recordWrite_saturates) {
+    WriteFrequencyTracker tracker(1U << 16);
+    for (int i = 0; i < 300; i++)
+        tracker.recordWrite(1);
+    EXPECT_EQ(255U, tracker.getEstimate(1));
+}
+
+TEST(WriteFrequencyTrackerTest, recordWrite_ages) {
+    WriteFrequencyTracker tracker(16);
+    for (int i = 0; i < 15; i++)
+        tracker.recordWrite(3);
+    EXPECT_EQ(15U, tracker.getEstimate(3));
+    EXPECT_EQ(15U, tracker.writesSinceAging.load());
+
+    tracker.recordWrite(3);
+    EXPECT_EQ(8U, tracker.getEstimate(3));
+    EXPECT_EQ(0U, tracker.writesSinceAging.load());
+}
+
+}  // namespace RAMCloud